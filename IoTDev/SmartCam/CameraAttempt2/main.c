@@ -3,21 +3,26 @@
  *  ---------------------------------
  *  If cross-compiling from an x86_64 Ubuntu host:
  *
- *      aarch64-linux-gnu-gcc -O2 -Wall -o iot_cam_emulator main.c
+ *      aarch64-linux-gnu-gcc -O2 -Wall -o iot_cam_emulator main.c ../common/scenario.c -lm
  *
  *  Alternatively, compile natively on the RB3:
  *
- *      gcc -O2 -Wall -o iot_cam_emulator main.c
+ *      gcc -O2 -Wall -o iot_cam_emulator main.c ../common/scenario.c -lm
  *
  *
  *  RUN INSTRUCTIONS
  *  ----------------
  *  ./iot_cam_emulator <host_ip> <host_port> \
  *                     <idle_min_minutes> <idle_max_minutes> \
- *                     <capture_min_seconds> <capture_max_seconds>
+ *                     <capture_min_seconds> <capture_max_seconds> \
+ *                     [scenario_file|- [seed]]
  *
  *  Example:
  *      ./iot_cam_emulator 192.168.10.1 9000 1 5 3 10
+ *      ./iot_cam_emulator 192.168.10.1 9000 1 5 3 10 office.scn 42
+ *
+ *  Idle gaps and capture lengths are drawn ahead of time into a timeline
+ *  (../common/scenario.h); the same scenario and seed repeat the same schedule.
  *
  */
 
@@ -33,6 +38,7 @@
 #include <sys/socket.h>
 #include <arpa/inet.h>
 
+#include "../common/scenario.h"
 
 //Utility: Generate ISO-8601 UTC timestamp with millisecond precision         
 void get_iso_timestamp(char *buffer, size_t len)
@@ -91,13 +97,6 @@ int send_start_sync(const char *host_ip, int port)
     return 0;
 }
 
-// Generate a random integer within an inclusive range                         
-
-int rand_range(int min, int max)
-{
-    return min + rand() % (max - min + 1);
-}
-
 // Capture video using GStreamer (V4L2 camera)                                 
 void capture_video(int duration_sec, const char *filename)
 {
@@ -152,12 +151,13 @@ void upload_file(const char *host_ip, int port, const char *filename)
 
 int main(int argc, char *argv[])
 {
-    if (argc != 7)
+    if (argc < 7 || argc > 9)
     {
         fprintf(stderr,
             "Usage: %s <host_ip> <host_port> "
             "<idle_min_minutes> <idle_max_minutes> "
-            "<capture_min_seconds> <capture_max_seconds>\n",
+            "<capture_min_seconds> <capture_max_seconds> "
+            "[scenario_file|- [seed]]\n",
             argv[0]);
         return 1;
     }
@@ -169,16 +169,33 @@ int main(int argc, char *argv[])
     int cap_min = atoi(argv[5]);
     int cap_max = atoi(argv[6]);
 
-    srand(time(NULL));
+    /* Schedule: the ranges above are the defaults, an optional scenario file overrides them */
+    struct scenario scn;
+    scenario_init(&scn);
+    scn.phase[0].idle = sc_uniform((uint64_t)idle_min * 60 * SC_NS_PER_S, (uint64_t)idle_max * 60 * SC_NS_PER_S);
+    scn.phase[0].capture = sc_uniform((uint64_t)cap_min * SC_NS_PER_S, (uint64_t)cap_max * SC_NS_PER_S);
+    if (argc > 7 && strcmp(argv[7], "-") != 0 && scenario_load(&scn, argv[7]) != 0)
+        return 1;
+    uint64_t seed = scenario_seed(&scn, argc > 8 ? argv[8] : NULL);
+    scenario_print(&scn, seed, stderr);
+
+    struct sc_gen gen;
+    struct sc_timeline timeline = { 0 };
+    sc_gen_init(&gen, &scn, seed, 0);
 
     send_start_sync(host_ip, port);
 
-    while (1)
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0); // Timeline offsets count from here
+    const struct sc_event *ev;
+
+    while ((ev = sc_peek(&gen, &timeline, SC_WINDOW_NS)) && ev->type != SC_EV_END)
     {
-        int idle_minutes = rand_range(idle_min, idle_max);
-        sleep(idle_minutes * 60);
+        if (ev->type != SC_EV_MOTION) { sc_pop(&timeline); continue; } // Only captures matter here
+        if (!sc_sleep_until(&t0, ev->t_ns)) continue;                  // Interrupted: re-check
 
-        int capture_seconds = rand_range(cap_min, cap_max);
+        int capture_seconds = (int)((ev->dur_ns + SC_NS_PER_S / 2) / SC_NS_PER_S);
+        sc_pop(&timeline);
         char filename[128];
 
         snprintf(filename, sizeof(filename),
@@ -186,7 +203,9 @@ int main(int argc, char *argv[])
 
         capture_video(capture_seconds, filename);
         upload_file(host_ip, port, filename);
+        sc_motion_done(&timeline, sc_elapsed_ns(&t0)); // Next idle gap counts from here
     }
 
+    sc_timeline_free(&timeline);
     return 0;
 }
@@ -3,21 +3,39 @@
  *  ---------------------------------
  *  If cross-compiling from an x86_64 Ubuntu host:
  *
- *      aarch64-linux-gnu-gcc -O2 -Wall -o iot_cam_emulator main.c
+ *      aarch64-linux-gnu-gcc -O2 -Wall -o iot_cam_emulator main.c ../common/scenario.c ../common/gstcap.c ../common/label.c -lm
  *
  *  Alternatively, compile natively on the RB3:
  *
- *      gcc -O2 -Wall -o iot_cam_emulator main.c
+ *      gcc -O2 -Wall -o iot_cam_emulator main.c ../common/scenario.c ../common/gstcap.c ../common/label.c -lm
+ *
+ *  With the GStreamer development packages, add the warm in-process
+ *  pipeline (../common/gstcap.h) instead of a gst-launch-1.0 per clip:
+ *
+ *      gcc -O2 -Wall -DHAVE_GST -o iot_cam_emulator main.c ../common/scenario.c ../common/gstcap.c \
+ *          ../common/label.c $(pkg-config --cflags --libs gstreamer-app-1.0) -lm
  *
  *
  *  RUN INSTRUCTIONS
  *  ----------------
- *  ./iot_cam_emulator <host_ip> <host_port> \
+ *  ./iot_cam_emulator [-t] [-G] [-L <batch>] [-i <id>] <host_ip> <host_port> \
  *                     <idle_min_minutes> <idle_max_minutes> \
- *                     <capture_min_seconds> <capture_max_seconds>
+ *                     <capture_min_seconds> <capture_max_seconds> \
+ *                     [scenario_file|- [seed]]
  *
  *  Example:
  *      ./iot_cam_emulator 192.168.10.1 9000 1 5 3 10
+ *      ./iot_cam_emulator 192.168.10.1 9000 1 5 3 10 office.scn 42
+ *
+ *  -t  videotestsrc and x264enc instead of the camera (no hardware needed)
+ *  -G  gst-launch-1.0 per capture even when built with HAVE_GST
+ *  -L  binary labels (../common/label.h), <batch> records per datagram (1-16),
+ *      instead of one JSON datagram per label
+ *  -i  device id carried by the binary labels; also picks this camera's
+ *      event stream, as device i of a UDPMimic fleet (default: 0)
+ *
+ *  Idle gaps and capture lengths are drawn ahead of time into a timeline
+ *  (../common/scenario.h); the same scenario and seed repeat the same schedule.
  *
  */
 
@@ -32,9 +50,20 @@
 #include <errno.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <getopt.h>
+
+#include "../common/gstcap.h"
+#include "../common/label.h"
+#include "../common/scenario.h"
 
 #define SYNC_PORT_OFFSET 1
 
+static const char *video_source = "v4l2src device=/dev/video0"; // -t: videotestsrc
+static const char *video_encoder = "x264enc tune=zerolatency";
+static struct gc_pipe *gst_pipe;              // Warm in-process pipeline; NULL: gst-launch-1.0 per capture
+static struct gc_stats gst_stats;
+static struct lbl_chan labels = { .fd = -1 }; // -L: binary labels, one socket for the whole run
+
 // Utility: Generate ISO-8601 UTC timestamp with millisecond precision
 void get_iso_timestamp(char *buffer, size_t len)
 {
@@ -80,6 +109,7 @@ int send_udp_json(const char *host_ip, int port, const char *json)
 // Send START_SYNC JSON packet (UDP)
 int send_start_sync(const char *host_ip, int sync_port)
 {
+    if (labels.fd >= 0) { lbl_event(&labels, "START_SYNC"); return 0; }
     char timestamp[64];
     char json[256];
 
@@ -97,6 +127,7 @@ int send_start_sync(const char *host_ip, int sync_port)
 // Send LABEL JSON packet (UDP)
 void send_label(const char *host_ip, int sync_port, const char *event)
 {
+    if (labels.fd >= 0) { lbl_event(&labels, event); return; }
     char timestamp[64];
     char json[256];
 
@@ -112,28 +143,28 @@ void send_label(const char *host_ip, int sync_port, const char *event)
     send_udp_json(host_ip, sync_port, json);
 }
 
-// Generate a random integer within an inclusive range
-int rand_range(int min, int max)
-{
-    return min + rand() % (max - min + 1);
-}
-
 // Capture video using GStreamer (V4L2 camera)
 void capture_video(int duration_sec, const char *filename)
 {
+    if (gst_pipe)
+    {
+        gc_capture(gst_pipe, duration_sec, filename, &gst_stats);
+        return;
+    }
+
     char cmd[512];
 
+    /* timeout, not alarm(): SIGALRM would end the emulator, not gst-launch.
+       SIGINT is what -e turns into EOS, so the MP4 gets its index */
     snprintf(cmd, sizeof(cmd),
-        "gst-launch-1.0 -e "
-        "v4l2src device=/dev/video0 ! "
+        "timeout -s INT --preserve-status %d gst-launch-1.0 -e "
+        "%s ! "
         "video/x-raw,width=1280,height=720,framerate=30/1 ! "
-        "x264enc tune=zerolatency ! "
+        "%s ! "
         "mp4mux ! filesink location=%s",
-        filename);
+        duration_sec, video_source, video_encoder, filename);
 
-    alarm(duration_sec);
     system(cmd);
-    alarm(0);
 }
 
 // Upload a file to the host over TCP
@@ -171,35 +202,80 @@ void upload_file(const char *host_ip, int port, const char *filename)
 // Main
 int main(int argc, char *argv[])
 {
-    if (argc != 7)
+    const char *prog = argv[0];
+    int spawn = 0, bad = 0, label_batch = 0, device = 0, opt;
+
+    while ((opt = getopt(argc, argv, "tGL:i:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't': video_source = GC_TEST_SOURCE; video_encoder = GC_TEST_ENCODER; break;
+        case 'G': spawn = 1; break;
+        case 'L': label_batch = atoi(optarg); break;
+        case 'i': device = atoi(optarg); break;
+        default: bad = 1; break;
+        }
+    }
+    argv += optind - 1; argc -= optind - 1; // Positional arguments as before
+
+    if (bad || argc < 7 || argc > 9 || device < 0 || device > UINT16_MAX)
     {
         fprintf(stderr,
-            "Usage: %s <host_ip> <host_port> "
+            "Usage: %s [-t] [-G] [-L <batch>] [-i <id>] <host_ip> <host_port> "
             "<idle_min_minutes> <idle_max_minutes> "
-            "<capture_min_seconds> <capture_max_seconds>\n",
-            argv[0]);
+            "<capture_min_seconds> <capture_max_seconds> "
+            "[scenario_file|- [seed]]\n",
+            prog);
         return 1;
     }
 
     const char *host_ip = argv[1];
     int port = atoi(argv[2]);
     int sync_port = port + SYNC_PORT_OFFSET;
+    if (label_batch && lbl_open(&labels, host_ip, sync_port, (uint16_t)device, (unsigned)label_batch) != 0)
+        return 1;
 
     int idle_min = atoi(argv[3]);
     int idle_max = atoi(argv[4]);
     int cap_min = atoi(argv[5]);
     int cap_max = atoi(argv[6]);
 
-    srand(time(NULL));
+    /* Schedule: the ranges above are the defaults, an optional scenario file overrides them */
+    struct scenario scn;
+    scenario_init(&scn);
+    scn.phase[0].idle = sc_uniform((uint64_t)idle_min * 60 * SC_NS_PER_S, (uint64_t)idle_max * 60 * SC_NS_PER_S);
+    scn.phase[0].capture = sc_uniform((uint64_t)cap_min * SC_NS_PER_S, (uint64_t)cap_max * SC_NS_PER_S);
+    if (argc > 7 && strcmp(argv[7], "-") != 0 && scenario_load(&scn, argv[7]) != 0)
+        return 1;
+    uint64_t seed = scenario_seed(&scn, argc > 8 ? argv[8] : NULL);
+    scenario_print(&scn, seed, stderr);
+
+    struct sc_gen gen;
+    struct sc_timeline timeline = { 0 };
+    sc_gen_init(&gen, &scn, seed, (unsigned)device);
+
+    if (!spawn) // Warm-up stays outside the labelled windows
+    {
+        struct gc_cfg gc = { video_source, video_encoder, 1280, 720, 30 };
+        gst_pipe = gc_open(&gc, &gst_stats);
+    }
+    if (!gst_pipe)
+        fprintf(stderr, "[gst] gst-launch-1.0 per capture\n");
 
     send_start_sync(host_ip, sync_port);
 
-    while (1)
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0); // Timeline offsets count from here
+    const struct sc_event *ev;
+
+    while ((ev = sc_peek(&gen, &timeline, SC_WINDOW_NS)) && ev->type != SC_EV_END)
     {
-        int idle_minutes = rand_range(idle_min, idle_max);
-        sleep(idle_minutes * 60);
+        if (ev->type != SC_EV_MOTION) { sc_pop(&timeline); continue; } // Only captures matter here
+        lbl_flush(&labels);                                            // Batched labels out before the idle gap
+        if (!sc_sleep_until(&t0, ev->t_ns)) continue;                  // Interrupted: re-check
 
-        int capture_seconds = rand_range(cap_min, cap_max);
+        int capture_seconds = (int)((ev->dur_ns + SC_NS_PER_S / 2) / SC_NS_PER_S);
+        sc_pop(&timeline);
         char filename[128];
 
         snprintf(filename, sizeof(filename),
@@ -212,7 +288,19 @@ int main(int argc, char *argv[])
         send_label(host_ip, sync_port, "BACKUP_OPERATION_START");
         upload_file(host_ip, port, filename);
         send_label(host_ip, sync_port, "BACKUP_OPERATION_END");
+        sc_motion_done(&timeline, sc_elapsed_ns(&t0)); // Next idle gap counts from here
     }
 
+    if (labels.fd >= 0)
+    {
+        lbl_close(&labels);
+        lbl_report(&labels, stderr);
+    }
+    if (gst_pipe)
+    {
+        gc_report(&gst_stats, stderr);
+        gc_close(gst_pipe);
+    }
+    sc_timeline_free(&timeline);
     return 0;
 }
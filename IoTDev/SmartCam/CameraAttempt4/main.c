@@ -1,3 +1,47 @@
+/*
+ *  BUILD INSTRUCTIONS (ARM / AARCH64)
+ *  ---------------------------------
+ *  If cross-compiling from an x86_64 Ubuntu host:
+ *
+ *      aarch64-linux-gnu-gcc -O2 -Wall -o iot_cam main.c ../common/scenario.c ../common/upload.c \
+ *          ../common/resume.c ../common/crc32c.c ../common/label.c ../common/gstcap.c -lm
+ *
+ *  Alternatively, compile natively on the RB3:
+ *
+ *      gcc -O2 -Wall -o iot_cam main.c ../common/scenario.c ../common/upload.c \
+ *          ../common/resume.c ../common/crc32c.c ../common/label.c ../common/gstcap.c -lm
+ *
+ *  With the GStreamer development packages, add the warm in-process
+ *  pipeline (../common/gstcap.h) instead of a gst-launch-1.0 per clip:
+ *
+ *      gcc -O2 -Wall -DHAVE_GST -o iot_cam main.c ../common/scenario.c ../common/upload.c \
+ *          ../common/resume.c ../common/crc32c.c ../common/label.c ../common/gstcap.c \
+ *          $(pkg-config --cflags --libs gstreamer-app-1.0) -lm
+ *
+ *
+ *  RUN INSTRUCTIONS
+ *  ----------------
+ *  ./iot_cam [-2] [-C <chunk_kb>] [-r <mbps>] [-j none|uniform[:frac]|exp] [-L <batch>] [-i <id>] [-t] [-G] \
+ *            <host_ip> <host_port> <idle_min_minutes> <idle_max_minutes> \
+ *            <capture_min_seconds> <capture_max_seconds> [scenario_file|- [seed]]
+ *
+ *  Example:
+ *      ./iot_cam 192.168.10.1 9000 1 5 3 10
+ *      ./iot_cam -2 -r 8 -j exp 192.168.10.1 9000 1 5 3 10 office.scn 42
+ *
+ *  -2  resumable v2 uploads (../common/resume.h, tcprecv only); default v1
+ *  -C  v2 chunk size in KB (default: 1024)
+ *  -r  upload target rate in Mbps, 0 = as fast as the link allows (default: 0)
+ *  -j  upload jitter with -r (../common/upload.h; default: none, kernel pacing)
+ *  -L  binary labels (../common/label.h), <batch> records per datagram (1-16),
+ *      instead of one JSON datagram per label
+ *  -i  device id carried by the binary labels; also picks this camera's
+ *      event stream, as device i of a UDPMimic fleet (default: 0)
+ *  -t  videotestsrc and x264enc instead of the camera (no hardware needed)
+ *  -G  gst-launch-1.0 per capture even when built with HAVE_GST
+ *
+ */
+
 #define _POSIX_C_SOURCE 200809L
 
 #include <stdio.h>
@@ -11,13 +55,27 @@
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <getopt.h>
 
+#include "../common/gstcap.h"
+#include "../common/label.h"
+#include "../common/resume.h"
+#include "../common/scenario.h"
+#include "../common/upload.h"
 
 #define SYNC_PORT_OFFSET 1
 #define VIDEO_DEVICE "/dev/video0"
 #define OUTPUT_DIR   "/home/root/temp"
 
 static volatile sig_atomic_t keep_running = 1;
+static struct lbl_chan labels = { .fd = -1 }; // -L: binary labels, one socket for the whole run
+static const char *video_source = "v4l2src device=" VIDEO_DEVICE; // -t: videotestsrc
+static const char *video_encoder = "v4l2h264enc";                  // -t: x264enc
+static struct gc_pipe *gst_pipe;               // Warm in-process pipeline; NULL: gst-launch-1.0 per capture
+static struct gc_stats gst_stats;
+static struct up_shape upload_shape;           // -r: paced uploads (v1 and v2), 0 = as fast as the link allows; -j
+static struct sc_rng jitter_rng;               // -j draws, seeded with the schedule
 
 static uint64_t htobe64(uint64_t host_64) {
 #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
@@ -56,31 +114,34 @@ int send_udp_json(const char *host_ip, int port, const char *json) {
 }
 
 void send_label(const char *host_ip, int port, const char *event) {
+    if (labels.fd >= 0) { lbl_event(&labels, event); return; }
     char ts[64], json[256];
     get_iso_timestamp(ts, sizeof(ts));
     snprintf(json, sizeof(json), "{ \"type\":\"LABEL\", \"event\":\"%s\", \"timestamp\":\"%s\" }\n", event, ts);
     send_udp_json(host_ip, port, json);
 }
 
-int rand_range(int min, int max) { return (min>max)?min:(min + rand() % (max-min+1)); }
-
+/* Embedded pipeline when built with -DHAVE_GST ../common/gstcap.c `pkg-config --cflags --libs gstreamer-app-1.0`
+   (see ../common/gstcap.h), else one gst-launch-1.0 per clip. SIGINT is what -e turns into EOS, so the
+   MP4 gets its index when the time is up */
 int capture_video(int seconds, const char *filename) {
+    if (gst_pipe) return gc_capture(gst_pipe, seconds, filename, &gst_stats) == 0;
     char cmd[1024];
     snprintf(cmd, sizeof(cmd),
-        "timeout %d gst-launch-1.0 -e "
-        "v4l2src device=%s ! "
+        "timeout -s INT --preserve-status %d gst-launch-1.0 -e "
+        "%s ! "
         "video/x-raw,width=1280,height=720,framerate=30/1 ! "
-        "v4l2h264enc ! "
+        "%s ! "
         "h264parse ! mp4mux ! filesink location=%s",
-        seconds, VIDEO_DEVICE, filename);
+        seconds, video_source, video_encoder, filename);
 
     return (system(cmd) == 0);
 }
 
 int upload_file(const char *host_ip, int port, const char *filename) {
     struct stat st;
-    if(stat(filename, &st)!=0) return -1;
-    FILE *fp = fopen(filename, "rb"); if(!fp) return -1;
+    int fd = open(filename, O_RDONLY); if(fd<0) return -1;
+    if(fstat(fd,&st)!=0){ close(fd); return -1; }
 
     int sock = socket(AF_INET, SOCK_STREAM, 0); if(sock<0) goto fail;
     struct sockaddr_in addr = {0}; addr.sin_family = AF_INET; addr.sin_port = htons(port);
@@ -94,51 +155,112 @@ int upload_file(const char *host_ip, int port, const char *filename) {
     send(sock,&name_len,sizeof(name_len),0);
     send(sock,filename,strlen(filename),0);
 
-    /* ---- PAYLOAD ---- */
-    char buf[4096]; size_t n;
-    while((n=fread(buf,1,sizeof(buf),fp))>0) send(sock,buf,n,0);
+    /* ---- PAYLOAD ---- sendfile(): page cache straight to the socket, paced with -r */
+    struct up_stats us = {0};
+    int rc = up_send_file(sock, fd, 0, (uint64_t)st.st_size, &upload_shape, &us);
+    up_report(&us, &upload_shape, stderr);
 
-    fclose(fp); close(sock); return 0;
+    close(fd); close(sock); return rc;
 
 fail:
-    if(sock>=0) close(sock); fclose(fp); return -1;
+    if(sock>=0) close(sock);
+    close(fd); return -1;
+}
+
+// v2: resumable chunks with CRC32C; the server names the file after our basename
+static int upload_file_v2(const char *host_ip, int port, const char *filename, uint32_t chunk) {
+    const char *base = strrchr(filename, '/');
+    struct rs_stats st;
+    int rc = rs_upload(host_ip, port, filename, base ? base + 1 : filename, chunk, &upload_shape, &st);
+    rs_report(&st, stderr);
+    return rc;
 }
 
 int main(int argc,char*argv[]) {
-    if(argc!=7){
-        fprintf(stderr,"Usage: %s <host_ip> <host_port> <idle_min_m> <idle_max_m> <cap_min_s> <cap_max_s>\n",argv[0]);
+    const char *prog = argv[0];
+    int v2 = 0, bad = 0, label_batch = 0, spawn = 0, device = 0; uint32_t chunk = RS_CHUNK_DEFAULT;
+    int opt;
+    while((opt=getopt(argc,argv,"2C:r:j:L:i:tG"))!=-1){
+        switch(opt){
+        case '2': v2 = 1; break;                                  // Resumable framing (tcprecv only)
+        case 'C': chunk = (uint32_t)atoi(optarg) * 1024u; break; // v2 chunk size in KB
+        case 'r': upload_shape.rate = atof(optarg) * 1e6 / 8; break; // Upload Mbps: kernel pacing, a token bucket with -j
+        case 'j': bad |= up_jitter_parse(optarg, &upload_shape) != 0; break; // -r jitter: none, uniform[:frac], exp
+        case 'L': label_batch = atoi(optarg); break;              // Binary labels, records per datagram
+        case 'i': device = atoi(optarg); break;                   // Device id in the labels and event stream
+        case 't': video_source = GC_TEST_SOURCE; video_encoder = GC_TEST_ENCODER; break; // No camera needed
+        case 'G': spawn = 1; break;                               // gst-launch-1.0 per capture, as before
+        default: bad = 1; break;
+        }
+    }
+    argv += optind - 1; argc -= optind - 1;                       // Positional arguments as before
+    if(bad || argc<7 || argc>9 || chunk==0 || chunk>RS_CHUNK_MAX || upload_shape.rate<0 || device<0 || device>UINT16_MAX){
+        fprintf(stderr,"Usage: %s [-2] [-C <chunk_kb>] [-r <mbps>] [-j none|uniform[:frac]|exp] [-L <batch>] [-i <id>] [-t] [-G] <host_ip> <host_port> <idle_min_m> <idle_max_m> <cap_min_s> <cap_max_s> [scenario_file|- [seed]]\n",prog);
         return 1;
     }
 
     signal(SIGINT,handle_signal); signal(SIGTERM,handle_signal);
 
     const char *host_ip = argv[1]; int port = atoi(argv[2]); int sync_port = port+SYNC_PORT_OFFSET;
+    if (label_batch && lbl_open(&labels, host_ip, sync_port, (uint16_t)device, (unsigned)label_batch) != 0) return 1;
     int idle_min = atoi(argv[3]); int idle_max = atoi(argv[4]);
     int cap_min = atoi(argv[5]); int cap_max = atoi(argv[6]);
-    srand(time(NULL));
+    /* Schedule: the ranges above are the defaults, an optional scenario file overrides them */
+    struct scenario scn;
+    scenario_init(&scn);
+    scn.phase[0].idle = sc_uniform((uint64_t)idle_min * 60 * SC_NS_PER_S, (uint64_t)idle_max * 60 * SC_NS_PER_S);
+    scn.phase[0].capture = sc_uniform((uint64_t)cap_min * SC_NS_PER_S, (uint64_t)cap_max * SC_NS_PER_S);
+    if (argc > 7 && strcmp(argv[7], "-") != 0 && scenario_load(&scn, argv[7]) != 0)
+        return 1;
+    uint64_t seed = scenario_seed(&scn, argc > 8 ? argv[8] : NULL);
+    scenario_print(&scn, seed, stderr);
+
+    struct sc_gen gen;
+    struct sc_timeline timeline = { 0 };
+    sc_gen_init(&gen, &scn, seed, (unsigned)device);
+    sc_aux_rng(&jitter_rng, seed, (unsigned)device, SC_AUX_JITTER);
+    upload_shape.rng = &jitter_rng;
+
+    if (!spawn) {                                                 // Warm-up stays outside the labelled windows
+        struct gc_cfg gc = { video_source, video_encoder, 1280, 720, 30 };
+        gst_pipe = gc_open(&gc, &gst_stats);
+    }
+    if (!gst_pipe) fprintf(stderr, "[gst] gst-launch-1.0 per capture\n");
 
     send_label(host_ip,sync_port,"START_SYNC");
 
-    while(keep_running){
-        sleep(rand_range(idle_min,idle_max)*60);
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0); // Timeline offsets count from here
+    const struct sc_event *ev;
+
+    while (keep_running && (ev = sc_peek(&gen, &timeline, SC_WINDOW_NS)) && ev->type != SC_EV_END)
+    {
+        if (ev->type != SC_EV_MOTION) { sc_pop(&timeline); continue; } // Only captures matter here
+        lbl_flush(&labels);                                            // Batched labels out before the idle gap
+        if (!sc_sleep_until(&t0, ev->t_ns)) continue;                  // Interrupted: re-check
+        int cap_time = (int)((ev->dur_ns + SC_NS_PER_S / 2) / SC_NS_PER_S);
+        sc_pop(&timeline);
 
         char filename[256];
         snprintf(filename,sizeof(filename), OUTPUT_DIR "/capture_%ld.mp4", time(NULL));
 
-        int cap_time = rand_range(cap_min,cap_max);
-
         send_label(host_ip,sync_port,"CAMERA_START");
         if(!capture_video(cap_time,filename)){
             send_label(host_ip,sync_port,"CAMERA_FAILED");
+            sc_motion_done(&timeline, sc_elapsed_ns(&t0));
             continue;
         }
         send_label(host_ip,sync_port,"CAMERA_END");
 
         send_label(host_ip,sync_port,"UPLOAD_START");
-        upload_file(host_ip,port,filename);
-        send_label(host_ip,sync_port,"UPLOAD_END");
+        int up = v2 ? upload_file_v2(host_ip,port,filename,chunk) : upload_file(host_ip,port,filename);
+        send_label(host_ip,sync_port,up==0 ? "UPLOAD_END" : "UPLOAD_FAILED");
+        sc_motion_done(&timeline, sc_elapsed_ns(&t0)); // Next idle gap counts from here
     }
 
     send_label(host_ip,sync_port,"SHUTDOWN");
+    if (labels.fd >= 0) { lbl_close(&labels); lbl_report(&labels, stderr); }
+    if (gst_pipe) { gc_report(&gst_stats, stderr); gc_close(gst_pipe); }
+    sc_timeline_free(&timeline);
     return 0;
 }
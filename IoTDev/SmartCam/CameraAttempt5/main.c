@@ -1,3 +1,28 @@
+/*
+ *  BUILD INSTRUCTIONS (ARM / AARCH64)
+ *  ---------------------------------
+ *  If cross-compiling from an x86_64 Ubuntu host:
+ *
+ *      aarch64-linux-gnu-gcc -O2 -Wall -o iot_cam main.c ../common/scenario.c ../common/label.c -lm
+ *
+ *  Alternatively, compile natively on the RB3:
+ *
+ *      gcc -O2 -Wall -o iot_cam main.c ../common/scenario.c ../common/label.c -lm
+ *
+ *
+ *  RUN INSTRUCTIONS
+ *  ----------------
+ *  ./iot_cam [-L <batch>] [-i <id>] <host_ip> <host_port> \
+ *            <idle_min_minutes> <idle_max_minutes> \
+ *            <capture_min_seconds> <capture_max_seconds> [scenario_file|- [seed]]
+ *
+ *  -L  binary labels (../common/label.h), <batch> records per datagram (1-16),
+ *      instead of one JSON datagram per label
+ *  -i  device id carried by the binary labels; also picks this camera's
+ *      event stream, as device i of a UDPMimic fleet (default: 0)
+ *
+ */
+
 #define _POSIX_C_SOURCE 200809L
 
 #include <stdio.h>
@@ -12,11 +37,18 @@
 #include <arpa/inet.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <getopt.h>
+
+#include "../common/label.h"
+#include "../common/scenario.h"
 
 #define SYNC_PORT_OFFSET 1
 #define OUTPUT_DIR "/home/root/temp"
+#define CHILD_POLL_MS   100  // How often the capture wait checks on the camera process
+#define STOP_TIMEOUT_MS 5000 // SIGINT grace period before SIGKILL
 
 static volatile sig_atomic_t keep_running = 1;
+static struct lbl_chan labels = { .fd = -1 }; // -L: binary labels, one socket for the whole run
 
 /* ------------------- Utility ------------------- */
 
@@ -50,12 +82,6 @@ void get_iso_timestamp(char *buffer, size_t len) {
              ts.tv_nsec / 1000000);
 }
 
-int rand_range(int min, int max) {
-    if (min >= max)
-        return min;
-    return min + rand() % (max - min + 1);
-}
-
 /* ------------------- UDP JSON ------------------- */
 
 int send_udp_json(const char *host_ip, int port, const char *json) {
@@ -80,6 +106,7 @@ int send_udp_json(const char *host_ip, int port, const char *json) {
 }
 
 void send_label(const char *host_ip, int port, const char *event) {
+    if (labels.fd >= 0) { lbl_event(&labels, event); return; }
     char ts[64];
     char json[256];
 
@@ -94,6 +121,19 @@ void send_label(const char *host_ip, int port, const char *event) {
 
 /* ------------------- Camera Capture ------------------- */
 
+// Wait up to timeout_ms for `pid` to exit; 1 and *status filled if it did.
+// `interruptible`: also give up (0) once a stop has been requested
+static int wait_child(pid_t pid, int *status, int timeout_ms, int interruptible) {
+    for (int waited = 0;; waited += CHILD_POLL_MS) {
+        pid_t r = waitpid(pid, status, WNOHANG);
+        if (r == pid) return 1;
+        if (r < 0 && errno != EINTR) return -1;
+        if (waited >= timeout_ms || (interruptible && !keep_running)) return 0;
+        struct timespec ts = { 0, CHILD_POLL_MS * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+}
+
 int capture_video(int duration_sec, const char *filename) {
     int camera_index = 1;
 
@@ -114,15 +154,28 @@ int capture_video(int duration_sec, const char *filename) {
         exit(EXIT_FAILURE);
     }
 
-    /* Parent */
+    /* Parent: a camera process that dies early ends the capture instead of being waited out,
+       and a stop request (SIGTERM here, or Ctrl-C, which the camera gets as well) cuts it short */
     printf("Camera running for %d seconds...\n", duration_sec);
-    sleep(duration_sec);
-
-    printf("Stopping camera (SIGINT)...\n");
-    kill(pid, SIGINT);
-
     int status;
-    waitpid(pid, &status, 0);
+    int r = wait_child(pid, &status, duration_sec * 1000, 1);
+    if (r == 1 && !(WIFEXITED(status) && WEXITSTATUS(status) == 0)) {
+        fprintf(stderr, "Camera process exited early (status %d)\n",
+                WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+        return -1;
+    }
+
+    if (r != 1) {               // Still running: stop it; a clean exit already finished the file
+        printf("Stopping camera (SIGINT)...\n");
+        kill(pid, SIGINT);
+        r = wait_child(pid, &status, STOP_TIMEOUT_MS, 0);
+    }
+    if (r != 1) {
+        fprintf(stderr, "Camera process ignored SIGINT for %dms, killing it\n", STOP_TIMEOUT_MS);
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+        return -1;
+    }
 
     if (!WIFEXITED(status)) {
         fprintf(stderr, "Camera process did not exit cleanly\n");
@@ -196,11 +249,23 @@ fail:
 /* ------------------- Main ------------------- */
 
 int main(int argc, char *argv[]) {
+    const char *prog = argv[0];
+    int label_batch = 0, device = 0, bad = 0, opt;
+
+    while ((opt = getopt(argc, argv, "L:i:")) != -1) {
+        switch (opt) {
+        case 'L': label_batch = atoi(optarg); break; // Binary labels, records per datagram
+        case 'i': device = atoi(optarg); break;      // Device id in the labels and event stream
+        default: bad = 1; break;
+        }
+    }
+    argv += optind - 1; argc -= optind - 1;          // Positional arguments as before
 
-    if (argc != 7) {
+    if (bad || argc < 7 || argc > 9 || device < 0 || device > UINT16_MAX) {
         fprintf(stderr,
-                "Usage: %s <host_ip> <host_port> <idle_min_m> <idle_max_m> <cap_min_s> <cap_max_s>\n",
-                argv[0]);
+                "Usage: %s [-L <batch>] [-i <id>] <host_ip> <host_port> <idle_min_m> <idle_max_m> <cap_min_s> <cap_max_s>"
+                " [scenario_file|- [seed]]\n",
+                prog);
         return 1;
     }
 
@@ -210,32 +275,53 @@ int main(int argc, char *argv[]) {
     const char *host_ip = argv[1];
     int port = (int)strtol(argv[2], NULL, 10);
     int sync_port = port + SYNC_PORT_OFFSET;
+    if (label_batch && lbl_open(&labels, host_ip, sync_port, (uint16_t)device, (unsigned)label_batch) != 0)
+        return 1;
 
     int idle_min = (int)strtol(argv[3], NULL, 10);
     int idle_max = (int)strtol(argv[4], NULL, 10);
     int cap_min  = (int)strtol(argv[5], NULL, 10);
     int cap_max  = (int)strtol(argv[6], NULL, 10);
 
-    srand(time(NULL));
+    /* Schedule: the ranges above are the defaults, an optional scenario file overrides them */
+    struct scenario scn;
+    scenario_init(&scn);
+    scn.phase[0].idle = sc_uniform((uint64_t)idle_min * 60 * SC_NS_PER_S, (uint64_t)idle_max * 60 * SC_NS_PER_S);
+    scn.phase[0].capture = sc_uniform((uint64_t)cap_min * SC_NS_PER_S, (uint64_t)cap_max * SC_NS_PER_S);
+    if (argc > 7 && strcmp(argv[7], "-") != 0 && scenario_load(&scn, argv[7]) != 0)
+        return 1;
+    uint64_t seed = scenario_seed(&scn, argc > 8 ? argv[8] : NULL);
+    scenario_print(&scn, seed, stderr);
+
+    struct sc_gen gen;
+    struct sc_timeline timeline = { 0 };
+    sc_gen_init(&gen, &scn, seed, (unsigned)device);
 
     send_label(host_ip, sync_port, "START_SYNC");
 
-    while (keep_running) {
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0); // Timeline offsets count from here
+    const struct sc_event *ev;
+
+    while (keep_running && (ev = sc_peek(&gen, &timeline, SC_WINDOW_NS)) && ev->type != SC_EV_END) {
 
-        int idle_time = rand_range(idle_min, idle_max) * 60;
-        printf("Idling for %d seconds...\n", idle_time);
-        sleep(idle_time);
+        if (ev->type != SC_EV_MOTION) { sc_pop(&timeline); continue; } // Only captures matter here
+        printf("Idling until t=%llus...\n", (unsigned long long)(ev->t_ns / SC_NS_PER_S));
+        lbl_flush(&labels);                                            // Batched labels out before the idle gap
+        if (!sc_sleep_until(&t0, ev->t_ns)) continue;                  // Interrupted: re-check
+
+        int cap_time = (int)((ev->dur_ns + SC_NS_PER_S / 2) / SC_NS_PER_S);
+        sc_pop(&timeline);
 
         char filename[256];
         snprintf(filename, sizeof(filename),
                  OUTPUT_DIR "/capture_%ld.mp4", time(NULL));
 
-        int cap_time = rand_range(cap_min, cap_max);
-
         send_label(host_ip, sync_port, "CAMERA_START");
 
         if (capture_video(cap_time, filename) != 0) {
             send_label(host_ip, sync_port, "CAMERA_FAILED");
+            sc_motion_done(&timeline, sc_elapsed_ns(&t0));
             continue;
         }
 
@@ -244,8 +330,14 @@ int main(int argc, char *argv[]) {
         send_label(host_ip, sync_port, "UPLOAD_START");
         upload_file(host_ip, port, filename);
         send_label(host_ip, sync_port, "UPLOAD_END");
+        sc_motion_done(&timeline, sc_elapsed_ns(&t0)); // Next idle gap counts from here
     }
 
     send_label(host_ip, sync_port, "SHUTDOWN");
+    if (labels.fd >= 0) {
+        lbl_close(&labels);
+        lbl_report(&labels, stderr);
+    }
+    sc_timeline_free(&timeline);
     return 0;
 }
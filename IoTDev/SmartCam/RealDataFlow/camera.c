@@ -0,0 +1,369 @@
+/*
+ * Long-lived capture session and the V4L2 frame source (see camera.h).
+ */
+
+#define _POSIX_C_SOURCE 200809L /* clock_gettime() */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include <linux/videodev2.h>
+
+#include "camera.h"
+
+static uint64_t mono_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+void cam_session_init(struct cam_session *c, const struct cam_source *src, const char *device,
+                      unsigned width, unsigned height, enum cam_idle idle) {
+    memset(c, 0, sizeof(*c));
+    c->src = src;
+    c->device = device;
+    c->width = width;
+    c->height = height;
+    c->idle = idle;
+    c->fd = -1;
+}
+
+/* ------------------- V4L2 source ------------------- */
+
+static int v4l2_stream_on(struct cam_session *c) {
+    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    for (unsigned i = 0; i < c->nbuf; i++) {
+        struct v4l2_buffer buf = {0};
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        if (ioctl(c->fd, VIDIOC_QBUF, &buf) < 0) { perror("VIDIOC_QBUF"); return -1; }
+    }
+    if (ioctl(c->fd, VIDIOC_STREAMON, &type) < 0) { perror("VIDIOC_STREAMON"); return -1; }
+    return 0;
+}
+
+static void v4l2_stream_off(struct cam_session *c) {
+    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    ioctl(c->fd, VIDIOC_STREAMOFF, &type); // Also returns every buffer to userspace
+}
+
+static void v4l2_close(struct cam_session *c) {
+    if (c->fd < 0) return;
+    for (unsigned i = 0; i < c->nbuf; i++) {
+        if (c->buf[i].addr) munmap(c->buf[i].addr, c->buf[i].len);
+        c->buf[i].addr = NULL;
+    }
+    c->nbuf = 0;
+    close(c->fd);
+    c->fd = -1;
+}
+
+static int v4l2_open(struct cam_session *c) {
+    c->fd = open(c->device, O_RDWR);
+    if (c->fd < 0) { fprintf(stderr, "%s: %s\n", c->device, strerror(errno)); return -1; }
+
+    struct v4l2_format fmt = {0};
+    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    fmt.fmt.pix.width = c->width;
+    fmt.fmt.pix.height = c->height;
+    fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+    if (ioctl(c->fd, VIDIOC_S_FMT, &fmt) < 0) { perror("VIDIOC_S_FMT"); goto fail; }
+    c->width = fmt.fmt.pix.width;      // The driver may have picked the nearest size
+    c->height = fmt.fmt.pix.height;
+
+    struct v4l2_requestbuffers req = {0};
+    req.count = CAMERA_BUFFERS;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (ioctl(c->fd, VIDIOC_REQBUFS, &req) < 0 || req.count == 0) { perror("VIDIOC_REQBUFS"); goto fail; }
+    c->nbuf = req.count < CAMERA_BUFFERS ? req.count : CAMERA_BUFFERS;
+
+    for (unsigned i = 0; i < c->nbuf; i++) {
+        struct v4l2_buffer buf = {0};
+        buf.type = req.type;
+        buf.memory = req.memory;
+        buf.index = i;
+        if (ioctl(c->fd, VIDIOC_QUERYBUF, &buf) < 0) { perror("VIDIOC_QUERYBUF"); goto fail; }
+        c->buf[i].len = buf.length;
+        c->buf[i].addr = mmap(NULL, buf.length, PROT_READ | PROT_WRITE,
+                              MAP_SHARED, c->fd, buf.m.offset);
+        if (c->buf[i].addr == MAP_FAILED) { c->buf[i].addr = NULL; perror("mmap"); goto fail; }
+    }
+    return 0;
+
+fail:
+    v4l2_close(c);
+    return -1;
+}
+
+static int v4l2_wait(struct cam_session *c, int timeout_ms) {
+    struct pollfd pfd = { c->fd, POLLIN, 0 };
+    int r = poll(&pfd, 1, timeout_ms);
+    if (r < 0) {
+        if (errno == EINTR) return CAM_TIMEOUT; // Let the caller check its stop flag
+        perror("poll");
+        return CAM_ERROR;
+    }
+    if (r == 0) return CAM_TIMEOUT;
+    if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        fprintf(stderr, "%s: device error or disconnected\n", c->device);
+        return CAM_ERROR;
+    }
+    return CAM_FRAME;
+}
+
+static int v4l2_dequeue(struct cam_session *c, struct cam_frame *f) {
+    struct v4l2_buffer b = {0};
+    b.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    b.memory = V4L2_MEMORY_MMAP;
+    if (ioctl(c->fd, VIDIOC_DQBUF, &b) < 0) {
+        if (errno == EAGAIN || errno == EINTR) return CAM_TIMEOUT;
+        perror("VIDIOC_DQBUF");
+        return CAM_ERROR;
+    }
+    f->index = b.index;
+    f->bytesused = b.bytesused;
+    f->sequence = b.sequence;
+    f->flags = (b.flags & V4L2_BUF_FLAG_ERROR) ? CAM_FRAME_ERROR : 0;
+    f->ts_ns = 0;
+    if ((b.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+        f->ts_ns = (uint64_t)b.timestamp.tv_sec * 1000000000ULL + (uint64_t)b.timestamp.tv_usec * 1000ULL;
+    return CAM_FRAME;
+}
+
+static void v4l2_queue(struct cam_session *c, unsigned index) {
+    struct v4l2_buffer buf = {0};
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = index;
+    ioctl(c->fd, VIDIOC_QBUF, &buf);
+}
+
+const struct cam_source cam_v4l2 = {
+    "v4l2", v4l2_open, v4l2_close, v4l2_stream_on, v4l2_stream_off,
+    v4l2_wait, v4l2_dequeue, v4l2_queue, NULL
+};
+
+/* ------------------- Source-independent ------------------- */
+
+static int stream_on(struct cam_session *c) {
+    if (c->src->stream_on(c) != 0) return -1;
+    c->streaming = 1;
+    return 0;
+}
+
+static void stream_off(struct cam_session *c) {
+    c->src->stream_off(c);
+    c->streaming = 0;
+}
+
+int cam_open(struct cam_session *c) {
+    if (c->src->open(c) != 0) return -1;
+    c->opened = 1;
+    return 0;
+}
+
+void cam_close(struct cam_session *c) {
+    if (!c->opened) return;
+    if (c->streaming) stream_off(c);
+    c->src->close(c);
+    c->opened = 0;
+}
+
+/* ------------------- Latency histogram ------------------- */
+
+static unsigned h_index(uint64_t v) {
+    if (v < (1u << CAM_H_SUB_BITS)) return (unsigned)v;
+    unsigned msb = 63u - (unsigned)__builtin_clzll(v);
+    if (msb > CAM_H_MAX_MSB) return CAM_H_BUCKETS - 1;
+    return ((msb - CAM_H_SUB_BITS + 1) << CAM_H_SUB_BITS) |
+           (unsigned)((v >> (msb - CAM_H_SUB_BITS)) & ((1u << CAM_H_SUB_BITS) - 1));
+}
+
+/* Lowest value that lands in bucket i */
+static uint64_t h_value(unsigned i) {
+    if (i < (1u << CAM_H_SUB_BITS)) return i;
+    unsigned m = i >> CAM_H_SUB_BITS;
+    return (uint64_t)((1u << CAM_H_SUB_BITS) + (i & ((1u << CAM_H_SUB_BITS) - 1))) << (m - 1);
+}
+
+uint64_t cam_latency_quantile(const struct cam_session *c, double q) {
+    if (c->lat_n == 0) return 0;
+    uint64_t want = (uint64_t)(q * (double)(c->lat_n - 1)), seen = 0;
+    for (unsigned i = 0; i < CAM_H_BUCKETS; ++i) {
+        seen += c->lat[i];
+        if (seen > want) return h_value(i);
+    }
+    return h_value(CAM_H_BUCKETS - 1);
+}
+
+/* ------------------- Session ------------------- */
+
+int cam_start(struct cam_session *c) {
+    c->start_ns = mono_ns();
+    c->ttff_ns = 0;
+    c->stale = 0;
+    c->frames = c->drops = c->errors = c->timeouts = 0;
+    c->first_ns = c->last_ns = 0;
+    c->lat_n = 0;
+    memset(c->lat, 0, sizeof(c->lat));
+
+    if (!c->opened && cam_open(c) != 0) return -1;
+    if (!c->streaming) return stream_on(c);
+
+    /* Warm session: whatever the source filled while idle is stale, give it straight back */
+    struct cam_frame f;
+    while (c->src->wait(c, 0) == CAM_FRAME && c->src->dequeue(c, &f) == CAM_FRAME) {
+        c->src->queue(c, f.index);
+        c->stale++;
+    }
+    return 0;
+}
+
+void cam_stop(struct cam_session *c) {
+    if (c->ttff_ns) {
+        if (c->captures == 0 || c->ttff_ns < c->ttff_min_ns) c->ttff_min_ns = c->ttff_ns;
+        if (c->ttff_ns > c->ttff_max_ns) c->ttff_max_ns = c->ttff_ns;
+        c->ttff_sum_ns += c->ttff_ns;
+        c->captures++;
+    }
+    if (!c->opened) return;
+    switch (c->idle) {
+    case CAM_IDLE_DRAIN:  break;               // Sensor keeps running, exposure stays settled
+    case CAM_IDLE_OFF:    stream_off(c); break;
+    case CAM_IDLE_REOPEN: cam_close(c); break;
+    }
+}
+
+int cam_dequeue(struct cam_session *c, struct cam_frame *f, int timeout_ms) {
+    uint64_t deadline = mono_ns() + (uint64_t)timeout_ms * 1000000ULL;
+    for (;;) {
+        uint64_t now = mono_ns();
+        if (now >= deadline) { c->timeouts++; return CAM_TIMEOUT; }
+        int r = c->src->wait(c, (int)((deadline - now + 999999) / 1000000));
+        if (r == CAM_ERROR) return CAM_ERROR;
+        if (r == CAM_TIMEOUT) {
+            if (mono_ns() < deadline) return CAM_TIMEOUT; // Signal: let the caller check its stop flag
+            continue;
+        }
+
+        r = c->src->dequeue(c, f);
+        if (r == CAM_ERROR) return CAM_ERROR;
+        if (r == CAM_TIMEOUT) continue;
+        now = mono_ns();
+
+        /* Sequence numbers count every frame the sensor produced, including ones dropped for lack of a buffer */
+        if (c->frames + c->errors > 0 && f->sequence > c->last_seq + 1)
+            c->drops += f->sequence - c->last_seq - 1;
+        c->last_seq = f->sequence;
+
+        if (f->flags & CAM_FRAME_ERROR) { // Data is corrupt: give it straight back
+            c->errors++;
+            c->src->queue(c, f->index);
+            continue;
+        }
+
+        if (f->ts_ns) {
+            c->lat[h_index(now > f->ts_ns ? now - f->ts_ns : 0)]++;
+            c->lat_n++;
+        }
+
+        if (!c->ttff_ns) c->ttff_ns = now - c->start_ns;
+        if (!c->first_ns) c->first_ns = now;
+        c->last_ns = now;
+        c->frames++;
+        return CAM_FRAME;
+    }
+}
+
+int cam_preview(struct cam_session *c, struct cam_frame *f, int timeout_ms) {
+    if (!c->opened && cam_open(c) != 0) return CAM_ERROR;
+    if (!c->streaming && stream_on(c) != 0) return CAM_ERROR;
+
+    int have = 0;
+    for (;;) {
+        int r = c->src->wait(c, have ? 0 : timeout_ms);
+        if (r == CAM_ERROR) return CAM_ERROR;
+        if (r == CAM_TIMEOUT) break;
+        struct cam_frame next;
+        r = c->src->dequeue(c, &next);
+        if (r == CAM_ERROR) return CAM_ERROR;
+        if (r == CAM_TIMEOUT) break;
+        if (next.flags & CAM_FRAME_ERROR) { c->src->queue(c, next.index); continue; }
+        if (have) c->src->queue(c, f->index); // Superseded by a newer frame
+        *f = next;
+        have = 1;
+    }
+    return have ? CAM_FRAME : CAM_TIMEOUT;
+}
+
+void cam_requeue(struct cam_session *c, const struct cam_frame *f) {
+    c->src->queue(c, f->index);
+}
+
+void cam_requeue_index(struct cam_session *c, unsigned index) {
+    c->src->queue(c, index);
+}
+
+int cam_idle_parse(const char *s) {
+    if (strcmp(s, "drain") == 0) return CAM_IDLE_DRAIN;
+    if (strcmp(s, "off") == 0) return CAM_IDLE_OFF;
+    if (strcmp(s, "reopen") == 0) return CAM_IDLE_REOPEN;
+    return -1;
+}
+
+const char *cam_idle_name(enum cam_idle idle) {
+    switch (idle) {
+    case CAM_IDLE_DRAIN:  return "drain";
+    case CAM_IDLE_OFF:    return "off";
+    case CAM_IDLE_REOPEN: return "reopen";
+    }
+    return "?";
+}
+
+static double achieved_fps(const struct cam_session *c) {
+    if (c->frames < 2 || c->last_ns <= c->first_ns) return 0.0;
+    return (double)(c->frames - 1) * 1e9 / (double)(c->last_ns - c->first_ns);
+}
+
+void cam_summary_json(const struct cam_session *c, char *buf, size_t len) {
+    snprintf(buf, len,
+             "\"frames\":%llu,\"drops\":%llu,\"errors\":%llu,\"timeouts\":%llu,"
+             "\"lat_p50_us\":%.0f,\"lat_p99_us\":%.0f,\"fps\":%.2f,\"ttff_ms\":%.1f",
+             (unsigned long long)c->frames, (unsigned long long)c->drops,
+             (unsigned long long)c->errors, (unsigned long long)c->timeouts,
+             (double)cam_latency_quantile(c, 0.50) / 1e3, (double)cam_latency_quantile(c, 0.99) / 1e3,
+             achieved_fps(c), (double)c->ttff_ns / 1e6);
+}
+
+void cam_summary_args(const struct cam_session *c, int32_t arg[4]) {
+    arg[0] = (int32_t)c->frames;
+    arg[1] = (int32_t)c->drops;
+    arg[2] = (int32_t)(cam_latency_quantile(c, 0.50) / 1000);
+    arg[3] = (int32_t)(cam_latency_quantile(c, 0.99) / 1000);
+}
+
+void cam_report(const struct cam_session *c, FILE *out) {
+    fprintf(out, "[camera] frames=%llu drops=%llu errors=%llu timeouts=%llu fps=%.2f "
+            "latency p50=%.2fms p99=%.2fms%s\n",
+            (unsigned long long)c->frames, (unsigned long long)c->drops,
+            (unsigned long long)c->errors, (unsigned long long)c->timeouts, achieved_fps(c),
+            (double)cam_latency_quantile(c, 0.50) / 1e6, (double)cam_latency_quantile(c, 0.99) / 1e6,
+            c->lat_n ? "" : " (no monotonic driver timestamps)");
+    fprintf(out, "[camera] source=%s idle=%s ttff=%.1fms stale=%u", c->src->name, cam_idle_name(c->idle),
+            (double)c->ttff_ns / 1e6, c->stale);
+    if (c->captures)
+        fprintf(out, " (over %u captures: min=%.1fms mean=%.1fms max=%.1fms)", c->captures,
+                (double)c->ttff_min_ns / 1e6, (double)c->ttff_sum_ns / 1e6 / c->captures,
+                (double)c->ttff_max_ns / 1e6);
+    fputc('\n', out);
+    if (c->src->report) c->src->report(c, out);
+}
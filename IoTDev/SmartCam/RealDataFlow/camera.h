@@ -0,0 +1,162 @@
+/*
+ * Long-lived capture session over a pluggable frame source.
+ *
+ * A source (struct cam_source) supplies the buffers and the frames: cam_v4l2
+ * drives a V4L2 device with mmap'd buffers, cam_synth (synth.h) generates
+ * patterned YUYV frames in-process at a set rate, so the whole pipeline
+ * can run and be benchmarked without a camera. Everything below the source
+ * (idle policy, statistics, preview) is shared.
+ *
+ * The source is opened and its buffers set up once. Between captures the
+ * session idles in one of three ways:
+ *   CAM_IDLE_DRAIN   keep streaming; the driver stops once every buffer is
+ *                    full, and cam_start() discards those stale frames
+ *   CAM_IDLE_OFF     STREAMOFF, buffers stay mapped; cam_start() requeues
+ *                    them and turns streaming back on
+ *   CAM_IDLE_REOPEN  full close/reopen each cycle (the old behaviour, kept
+ *                    for comparing startup latency)
+ * Each capture records the time from cam_start() to its first frame.
+ *
+ * Frames are dequeued when poll() says one is ready, with a timeout, so a
+ * stalled or unplugged camera cannot hang the capture loop. Per capture the
+ * session counts frames, driver drops (gaps in the frame sequence) and
+ * buffers flagged as errors, and keeps a histogram of the delay from the
+ * driver's capture timestamp to our dequeue.
+ */
+
+#ifndef REALDATAFLOW_CAMERA_H
+#define REALDATAFLOW_CAMERA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define CAMERA_BUFFERS 4            // Number of memory-mapped buffers
+#define CAM_DQ_TIMEOUT_MS 1000      // No frame for this long: report a timeout
+
+/* Dequeue latency histogram: log-linear, 16 sub-buckets per power of two, up to ~17 s */
+#define CAM_H_SUB_BITS 4
+#define CAM_H_MAX_MSB  34
+#define CAM_H_BUCKETS  ((CAM_H_MAX_MSB - CAM_H_SUB_BITS + 2) << CAM_H_SUB_BITS)
+
+/* cam_dequeue() results */
+#define CAM_FRAME    0
+#define CAM_TIMEOUT  1
+#define CAM_ERROR   -1
+
+enum cam_idle { CAM_IDLE_DRAIN, CAM_IDLE_OFF, CAM_IDLE_REOPEN };
+
+struct cam_buf { void *addr; size_t len; }; // Represents a memory-mapped buffer
+
+#define CAM_FRAME_ERROR 0x1         // cam_frame.flags: the data is corrupt
+
+/* One dequeued frame */
+struct cam_frame {
+    uint32_t index;                // Into cam_session.buf[]
+    uint32_t bytesused;
+    uint32_t sequence;             // Counts every frame the sensor produced
+    uint32_t flags;
+    uint64_t ts_ns;                // CLOCK_MONOTONIC capture time, 0 if unknown
+};
+
+struct cam_session;
+
+/* Frame source backend. Results are CAM_FRAME, CAM_TIMEOUT or CAM_ERROR
+ * (message on stderr). */
+struct cam_source {
+    const char *name;
+    int  (*open)(struct cam_session *c);       // Set up buf[0..nbuf); 0 or -1, cleaned up on failure
+    void (*close)(struct cam_session *c);
+    int  (*stream_on)(struct cam_session *c);  // Every buffer queued, frames start arriving; 0 or -1
+    void (*stream_off)(struct cam_session *c); // Every buffer back to us
+    /* Wait up to timeout_ms for a frame to be ready; a signal ends the wait with CAM_TIMEOUT */
+    int  (*wait)(struct cam_session *c, int timeout_ms);
+    /* Take the oldest ready frame without waiting; CAM_TIMEOUT if there is none */
+    int  (*dequeue)(struct cam_session *c, struct cam_frame *f);
+    void (*queue)(struct cam_session *c, unsigned index);
+    void (*report)(const struct cam_session *c, FILE *out); // May be NULL
+};
+
+extern const struct cam_source cam_v4l2;
+
+struct cam_session {
+    const struct cam_source *src;
+    const char *device;            // V4L2 device, or a name for messages
+    unsigned width, height;
+    enum cam_idle idle;
+
+    int opened;
+    int streaming;
+    unsigned nbuf;
+    struct cam_buf buf[CAMERA_BUFFERS];
+
+    /* V4L2 source only */
+    int fd;                        // -1 while closed
+
+    /* Synthetic source only */
+    double fps;
+    unsigned motion_pct;           // Share of the picture in motion
+    void *priv;
+
+    /* Current capture */
+    uint64_t start_ns;             // cam_start() time
+    uint64_t ttff_ns;              // Time to first frame, 0 until it arrives
+    unsigned stale;                // Frames left over from idle and discarded
+    uint64_t frames, drops, errors, timeouts;
+    uint64_t first_ns, last_ns;    // Dequeue times of the first and last frame
+    uint32_t last_seq;
+    uint64_t lat_n;                // Frames with a monotonic driver timestamp
+    uint32_t lat[CAM_H_BUCKETS];   // Driver timestamp -> dequeue (ns)
+
+    /* Across captures */
+    unsigned captures;
+    uint64_t ttff_sum_ns, ttff_min_ns, ttff_max_ns;
+};
+
+/* Fill in defaults; nothing is opened yet */
+void cam_session_init(struct cam_session *c, const struct cam_source *src, const char *device,
+                      unsigned width, unsigned height, enum cam_idle idle);
+
+/* Open the source, set the format and set up buffers; 0 or -1 (message on stderr) */
+int  cam_open(struct cam_session *c);
+void cam_close(struct cam_session *c);
+
+/* Enter recording: stream on (or flush stale frames) and start the TTFF clock */
+int  cam_start(struct cam_session *c);
+
+/* Leave recording according to the idle policy; records TTFF statistics */
+void cam_stop(struct cam_session *c);
+
+/* Wait up to timeout_ms for a frame: CAM_FRAME, CAM_TIMEOUT or CAM_ERROR (device
+ * gone or ioctl failure, message on stderr). Error-flagged buffers are counted
+ * and requeued here. The first frame after cam_start() sets ttff_ns. */
+int  cam_dequeue(struct cam_session *c, struct cam_frame *f, int timeout_ms);
+void cam_requeue(struct cam_session *c, const struct cam_frame *f);
+
+/* Preview between captures: stream on if needed, take the newest ready frame
+ * (older ones go straight back), waiting up to timeout_ms if none is ready.
+ * Capture statistics are not touched. CAM_FRAME, CAM_TIMEOUT or CAM_ERROR;
+ * the caller requeues the frame. */
+int  cam_preview(struct cam_session *c, struct cam_frame *f, int timeout_ms);
+
+/* Requeue a buffer handed back by index (zero-copy sender) */
+void cam_requeue_index(struct cam_session *c, unsigned index);
+
+/* "drain", "off" or "reopen"; -1 if unknown */
+int  cam_idle_parse(const char *s);
+const char *cam_idle_name(enum cam_idle idle);
+
+/* Latency quantile (ns) of the current capture */
+uint64_t cam_latency_quantile(const struct cam_session *c, double q);
+
+/* Capture summary as JSON members (no braces) for the CAPTURE_END label */
+void cam_summary_json(const struct cam_session *c, char *buf, size_t len);
+
+/* The same for a binary label: frames, drops, p50 and p99 latency (us). Four
+ * slots leave no room for fps: frames over the CAPTURE_START..CAPTURE_END
+ * mono_ns span gives it */
+void cam_summary_args(const struct cam_session *c, int32_t arg[4]);
+
+void cam_report(const struct cam_session *c, FILE *out);
+
+#endif /* REALDATAFLOW_CAMERA_H */
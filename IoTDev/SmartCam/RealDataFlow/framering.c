@@ -0,0 +1,81 @@
+/*
+ * Bounded SPSC frame ring (see framering.h).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "framering.h"
+
+int framering_init(struct frame_ring *r, unsigned slots, size_t slot_size) {
+    memset(r, 0, sizeof(*r));
+    unsigned n = 1;
+    while (n < slots) n <<= 1;
+    r->data = malloc((size_t)n * slot_size);
+    r->len = calloc(n, sizeof(*r->len));
+    if (!r->data || !r->len) { framering_free(r); return -1; }
+    r->slots = n;
+    r->slot_size = slot_size;
+    return 0;
+}
+
+void framering_free(struct frame_ring *r) {
+    free(r->data);
+    free(r->len);
+    r->data = NULL;
+    r->len = NULL;
+}
+
+void framering_reset(struct frame_ring *r) {
+    atomic_store(&r->head, 0);
+    atomic_store(&r->tail, 0);
+    atomic_store(&r->closed, 0);
+    r->pushed = r->dropped = r->occ_sum = 0;
+    r->occ_max = 0;
+}
+
+unsigned char *framering_claim(struct frame_ring *r) {
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    unsigned occ = (unsigned)(head - tail);
+    r->occ_sum += occ;
+    if (occ > r->occ_max) r->occ_max = occ;
+    if (occ == r->slots) { r->dropped++; return NULL; }
+    return r->data + (size_t)(head & (r->slots - 1)) * r->slot_size;
+}
+
+void framering_commit(struct frame_ring *r, size_t len) {
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    r->len[head & (r->slots - 1)] = len;
+    r->pushed++;
+    atomic_store_explicit(&r->head, head + 1, memory_order_release); // Frame bytes visible first
+}
+
+void framering_close(struct frame_ring *r) {
+    atomic_store_explicit(&r->closed, 1, memory_order_release);
+}
+
+const unsigned char *framering_peek(struct frame_ring *r, size_t *len) {
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&r->head, memory_order_acquire)) return NULL;
+    size_t i = tail & (r->slots - 1);
+    *len = r->len[i];
+    return r->data + i * r->slot_size;
+}
+
+void framering_release(struct frame_ring *r) {
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release); // Slot free for the producer
+}
+
+int framering_closed(struct frame_ring *r) {
+    return atomic_load_explicit(&r->closed, memory_order_acquire);
+}
+
+void framering_report(const struct frame_ring *r, FILE *out) {
+    uint64_t offered = r->pushed + r->dropped;
+    fprintf(out, "[ring] slots=%u frames=%llu dropped=%llu (%.1f%%) occupancy mean=%.2f max=%u\n",
+            r->slots, (unsigned long long)r->pushed, (unsigned long long)r->dropped,
+            offered ? 100.0 * (double)r->dropped / (double)offered : 0.0,
+            offered ? (double)r->occ_sum / (double)offered : 0.0, r->occ_max);
+}
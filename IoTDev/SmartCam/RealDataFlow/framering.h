@@ -0,0 +1,57 @@
+/*
+ * Bounded single-producer/single-consumer frame ring.
+ *
+ * The capture thread claims a slot, copies a dequeued V4L2 frame into it and
+ * commits it; the sender thread peeks the oldest committed frame, sends it
+ * and releases the slot. head/tail are free-running counters on separate
+ * cache lines, published with release/acquire, so neither side takes a lock.
+ * When the ring is full the producer drops the frame instead of blocking:
+ * the camera must keep being drained or the driver drops frames itself.
+ */
+
+#ifndef REALDATAFLOW_FRAMERING_H
+#define REALDATAFLOW_FRAMERING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define FRAMERING_CACHELINE 64
+
+struct frame_ring {
+    unsigned char *data;           // slots * slot_size bytes
+    size_t *len;                   // Bytes used per slot
+    size_t slot_size;
+    unsigned slots;                // Power of two
+
+    _Alignas(FRAMERING_CACHELINE) _Atomic uint64_t head; // Next slot to fill (producer)
+    uint64_t pushed;               // Producer-side statistics
+    uint64_t dropped;              // Frames lost because the ring was full
+    uint64_t occ_sum;              // Occupancy seen at each push, for the mean
+    unsigned occ_max;
+
+    _Alignas(FRAMERING_CACHELINE) _Atomic uint64_t tail; // Next slot to send (consumer)
+    _Atomic int closed;            // Producer finished; consumer drains and exits
+};
+
+/* `slots` is rounded up to a power of two; returns 0 or -1 */
+int  framering_init(struct frame_ring *r, unsigned slots, size_t slot_size);
+void framering_free(struct frame_ring *r);
+
+/* Empty the ring and clear statistics between captures (no thread attached) */
+void framering_reset(struct frame_ring *r);
+
+/* Producer: slot to copy the next frame into, NULL when full (counted as a drop) */
+unsigned char *framering_claim(struct frame_ring *r);
+void framering_commit(struct frame_ring *r, size_t len);
+void framering_close(struct frame_ring *r);
+
+/* Consumer: oldest frame or NULL when empty */
+const unsigned char *framering_peek(struct frame_ring *r, size_t *len);
+void framering_release(struct frame_ring *r);
+int  framering_closed(struct frame_ring *r);
+
+void framering_report(const struct frame_ring *r, FILE *out);
+
+#endif /* REALDATAFLOW_FRAMERING_H */
@@ -1,3 +1,104 @@
+/*
+ * Real camera data flow: V4L2 (or synthetic) capture, TCP upload and UDP event labels
+ *
+ * Build:
+ *   gcc -O2 -std=c11 -o smartcam_sim main.c camera.c synth.c framering.c stream.c zcopy.c yuvz.c motion.c uring.c ../common/scenario.c ../common/upload.c ../common/label.c ../common/syncpulse.c -pthread -lm
+ *   gcc -O2 -std=c11 -o yuvz yuvz_tool.c yuvz.c     (decompressor/benchmark, see yuvz_tool.c)
+ *
+ * Usage:
+ *   ./smartcam_sim [-S <scenario>] [-z <seed>] [-s] [-R <slots>] [-I drain|off|reopen] [-Z] [-c] [-K <n>]
+ *                [-D [-T <score>] [-P <frames>] [-V <fps>]] [-d <device> | -g <WxH@fps> [-M <pct>]] [-u <host>]
+ *                [-r <Mbps>] [-j none|uniform[:frac]|exp] [-U] [-L <batch>] [-i <id>] [-Y <deg>[:<chip_ms>]]
+ *
+ * Options:
+ *   -S <file>    Scenario file: idle/capture/sync distributions (../common/scenario.h)
+ *   -z <seed>    Seed for the schedule (default: scenario's seed, else random and printed)
+ *   -s           Stream frames over TCP while capturing instead of capture-to-file-then-upload
+ *   -R <slots>   Frame ring size for -s (default: 16)
+ *   -I <mode>    Camera between captures: drain (keep streaming, discard stale
+ *                frames), off (STREAMOFF, buffers stay mapped) or reopen
+ *                (close and reinitialise every cycle) (default: drain)
+ *   -Z           Zero-copy export: frames reach the file (vmsplice/splice) or,
+ *                with -s, the socket (MSG_ZEROCOPY) without a user-space copy
+ *   -c           Compress frames (yuvz: inter-frame delta, bit-packed) before
+ *                they are stored or streamed; not with -Z
+ *   -K <n>       With -c: key frame every n frames (default: 0 = first of each upload)
+ *   -D           Motion-triggered captures: a preview stream is scored for
+ *                scene changes and a capture starts when the score stays over
+ *                the threshold; the timeline's motion events are ignored
+ *   -T <score>   -D threshold: mean luma change per pixel (default: 4)
+ *   -P <frames>  -D: consecutive preview frames over the threshold (default: 3)
+ *   -V <fps>     -D: preview rate, at most 1000 (default: 5)
+ *   -d <device>  V4L2 device (default: /dev/video0)
+ *   -g <WxH@fps> Synthetic frame source instead of a camera, e.g. 1920x1080@60
+ *                (fps up to 1000)
+ *   -M <pct>     -g: share of the picture in motion (default: 10, 0 = still)
+ *   -u <host>    Upload server (default: 10.0.0.1)
+ *   -r <Mbps>    Upload target rate, 0 = as fast as possible (default: 4)
+ *   -j <model>   Upload jitter between window-sized bursts: none (kernel
+ *                pacing), uniform[:frac] (+-frac of the mean gap) or exp
+ *                (default: uniform:0.5)
+ *   -U           io_uring capture path: frames go to the file (or, with -s,
+ *                the socket) straight from the camera buffers with several
+ *                writes/sends in flight; not with -c
+ *   -L <batch>   Binary labels (../common/label.h) on one connected socket,
+ *                <batch> records per datagram (1-16); default: JSON labels
+ *   -i <id>      Device id in the binary labels; also picks this camera's
+ *                event stream, as device <id> of a UDPMimic fleet (default: 0)
+ *   -Y <d[:ms]>  Sync code: maximal-length sequence of degree d (5-16) with
+ *                chips of ms milliseconds (default: 9:10, 5.1 s per sync)
+ *
+ * Idle gaps, capture lengths and sync times are compiled ahead of time into
+ * an event timeline; the same scenario and seed give the same schedule.
+ * Without -S: idle 10-40s, capture 3-7s, sync every 30-40 min.
+ *
+ * With -s the capture thread copies each dequeued frame into a bounded
+ * lock-free ring and a sender thread pushes it over the TCP connection as
+ * capture continues. A full ring drops the frame (the camera is never made
+ * to wait); frames dropped and ring occupancy are reported per capture.
+ *
+ * The camera is opened and its buffers mapped once at start-up; each capture
+ * reports its time to first frame so the idle modes can be compared.
+ * Every capture also reports how many bytes per frame were copied between
+ * user space and the kernel on the way out, with and without -Z.
+ *
+ * Frames are dequeued through poll() with a timeout. The CAPTURE_END label
+ * carries a summary of the capture: frames, driver drops (sequence gaps),
+ * p50/p99 delay from driver timestamp to dequeue, and the achieved fps.
+ *
+ * With -D the detector's decisions go out as MOTION_DETECTED / MOTION_QUIET
+ * labels carrying the score; a detected capture lasts a draw from the
+ * scenario's capture distribution. The scenario's motion events are not
+ * generated at all then (idle off), so syncs still run on time and the
+ * loop sleeps until the next preview frame or sync, whichever is first.
+ *
+ * -g replaces the camera with an in-process generator (synth.h) that paces
+ * frames and drops them like a driver, so the capture -> store -> upload
+ * path can be load-tested on any Linux machine. At exit a [total] line
+ * sums every capture: frames, drops, capture and upload throughput.
+ *
+ * The stored file goes out with sendfile(), shaped to -r by kernel pacing
+ * or a token bucket (../common/upload.h); the defaults keep the mean rate
+ * and spread of the old 2 KB-and-sleep loop with far fewer wakeups.
+ *
+ * With -U the capture thread never blocks on a write or send: requests are
+ * queued on an io_uring (uring.h) against the camera buffers, registered
+ * once per capture where the driver's memory allows it, and each buffer is
+ * requeued to the camera when its I/O completes. -s -U -Z uses zero-copy
+ * sends. Without -U the synchronous paths above are unchanged; [total]
+ * reports the capture CPU share so the two can be compared.
+ *
+ * -L replaces the JSON labels (a socket, a format and a close per label)
+ * with fixed-size binary records stamped with CLOCK_MONOTONIC and
+ * CLOCK_REALTIME nanoseconds; batches are flushed when the main loop goes
+ * to sleep. NetData/LABELS/labeldec turns them back into a labels CSV.
+ *
+ * A sync plays a pseudo-random on/off code (../common/syncpulse.h) in both
+ * CPU load and UDP packets to the sync port, so IoTDev/scripts/SyncAlign
+ * can find it in the current samples and in the capture by correlation and
+ * print the offset between the two clocks instead of it being set by hand.
+ */
+
 #define _POSIX_C_SOURCE 200809L  // Enable modern POSIX features for clock_gettime and nanosleep
 
 #include <stdio.h>
@@ -10,17 +111,30 @@
 #include <string.h>
 #include <errno.h>
 
-#include <sys/ioctl.h>
-#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <arpa/inet.h>
-#include <linux/videodev2.h>
+
+#include "../common/label.h"
+#include "../common/scenario.h"
+#include "../common/syncpulse.h"
+#include "../common/upload.h"
+#include "camera.h"
+#include "framering.h"
+#include "motion.h"
+#include "stream.h"
+#include "synth.h"
+#include "uring.h"
+#include "yuvz.h"
+#include "zcopy.h"
 
 /* ============================================================
    GLOBALS
    ============================================================ */
 
 volatile sig_atomic_t stop_requested = 0;  // Flag set by signal handler to safely stop program
+static struct sc_rng jitter_rng;           // Upload pacing jitter, seeded with the schedule
 
 // Signal handler to catch CTRL+C and request a stop
 static void handle_sigint(int sig)
@@ -38,6 +152,23 @@ static uint64_t now_ms(void)
            (uint64_t)t.tv_nsec / 1000000ULL;
 }
 
+// CPU time used by the whole process (all threads, io_uring workers included) in nanoseconds
+static uint64_t cpu_ns(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (uint64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000ULL +
+           (uint64_t)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000ULL;
+}
+
+// Return current time in nanoseconds (for short intervals)
+static uint64_t mono_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
 // Sleep for a given number of milliseconds
 static void msleep(uint64_t ms)
 {
@@ -45,6 +176,13 @@ static void msleep(uint64_t ms)
     nanosleep(&ts, NULL);  // High-precision sleep
 }
 
+// Sleep until a CLOCK_MONOTONIC deadline in milliseconds (returns early on a signal)
+static void sleep_until_ms(uint64_t deadline)
+{
+    struct timespec ts = { deadline / 1000, (deadline % 1000) * 1000000 };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
 /* ============================================================
    UDP EVENT SENDER
    ============================================================ */
@@ -53,8 +191,10 @@ static void msleep(uint64_t ms)
 #define SYNC_PORT  9001           // Port to send aggressive sync events
 #define LABEL_DST  "10.0.0.1"    // Destination IP for UDP events
 
-// Send a simple JSON label over UDP
-static void send_label(const char *label)
+static struct lbl_chan labels = { .fd = -1 }; // -L: binary labels instead of JSON
+
+// Send a JSON label over UDP, with optional extra members (e.g. a capture summary)
+static void send_label_fields(const char *label, const char *fields)
 {
     int sock = socket(AF_INET, SOCK_DGRAM, 0); // Create UDP socket
 
@@ -63,17 +203,26 @@ static void send_label(const char *label)
     dst.sin_port   = htons(LABEL_PORT);
     inet_pton(AF_INET, LABEL_DST, &dst.sin_addr); // Convert IP string to binary
 
-    char msg[128];
+    char msg[512];
     snprintf(msg, sizeof(msg),
-             "{\"event\":\"%s\",\"t_ms\":%llu}",  // Format JSON with label and timestamp
-             label, (unsigned long long)now_ms());
+             "{\"event\":\"%s\",\"t_ms\":%llu%s%s}",  // Format JSON with label and timestamp
+             label, (unsigned long long)now_ms(), fields ? "," : "", fields ? fields : "");
 
     sendto(sock, msg, strlen(msg), 0, (struct sockaddr *)&dst, sizeof(dst)); // Send UDP packet
 
     close(sock); // Close socket
 }
 
-// Aggressive sync event: CPU + UDP burst to mark power activity
+// Send a simple label: a binary record with -L, JSON otherwise
+static void send_label(const char *label)
+{
+    if (labels.fd >= 0) lbl_event(&labels, label);
+    else send_label_fields(label, NULL);
+}
+
+static struct sp_params sync_code = { SP_DEGREE_DEFAULT, SP_CHIP_MS_DEFAULT }; // -Y
+
+// Sync event: the MLS code in CPU load and UDP packets, for automatic alignment of power and network traces
 static void send_aggressive_sync(void)
 {
     int sock = socket(AF_INET, SOCK_DGRAM, 0); // UDP socket for sync
@@ -82,22 +231,18 @@ static void send_aggressive_sync(void)
     dst.sin_family = AF_INET;
     dst.sin_port   = htons(SYNC_PORT);
     inet_pton(AF_INET, LABEL_DST, &dst.sin_addr);
-
-    const char msg[] = "{\"event\":\"SYNC\"}";
+    if (connect(sock, (struct sockaddr *)&dst, sizeof(dst)) != 0) { close(sock); sock = -1; } // Load pattern only
 
     send_label("SYNC_START"); // Mark start of sync
+    lbl_flush(&labels);       // Keep label traffic out of the code
 
-    uint64_t end = now_ms() + 1500; // Run for 1.5 seconds
-
-    while (now_ms() < end) {
-        for (volatile int i = 0; i < 50000; i++); // Burn CPU cycles intentionally
-        sendto(sock, msg, sizeof(msg) - 1, 0, (struct sockaddr *)&dst, sizeof(dst)); // Send sync packet
-        msleep(5); // Small delay to control activity
-    }
+    struct sp_stats st = {0};
+    sp_emit(&sync_code, sock, &st);
 
     send_label("SYNC_END"); // Mark end of sync
+    sp_report(&sync_code, &st, stderr);
 
-    close(sock); // Close socket
+    if (sock >= 0) close(sock); // Close socket
 }
 
 /* ============================================================
@@ -105,66 +250,36 @@ static void send_aggressive_sync(void)
    ============================================================ */
 
 #define CAMERA_DEVICE "/dev/video0" // Default camera device
-#define CAMERA_BUFFERS 4            // Number of memory-mapped buffers
 #define VIDEO_FILE "/tmp/capture.raw"
 
-struct cam_buf { void *addr; size_t len; }; // Represents a memory-mapped buffer
-
-static int cam_fd = -1;                    // File descriptor for camera device
-static struct cam_buf buffers[CAMERA_BUFFERS]; // Array of camera buffers
+static struct cam_session cam;     // Opened once, idles between captures (camera.h)
+static int zero_copy;              // -Z
+static struct zc_pipe zpipe;       // vmsplice/splice staging pipe for -Z
+static struct copy_stats copies;   // Per capture cycle, reset at CAPTURE_START
+static int compress_frames;        // -c
+static unsigned key_interval;      // -K
+static struct yz_enc yenc;         // -c: set up on the first capture (needs the frame size)
+static uint8_t *ybuf;              // -c: one encoded frame
 
-// Initialize camera for capture
-static void camera_init(void)
-{
-    cam_fd = open(CAMERA_DEVICE, O_RDWR); // Open camera device
-    if (cam_fd < 0) exit(1);             // Exit if cannot open
-
-    struct v4l2_format fmt = {0};
-    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    fmt.fmt.pix.width = 640;
-    fmt.fmt.pix.height = 480;
-    fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
-    ioctl(cam_fd, VIDIOC_S_FMT, &fmt);   // Set video format
-
-    struct v4l2_requestbuffers req = {0};
-    req.count = CAMERA_BUFFERS;
-    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    req.memory = V4L2_MEMORY_MMAP;
-    ioctl(cam_fd, VIDIOC_REQBUFS, &req); // Request buffers
-
-    for (int i = 0; i < CAMERA_BUFFERS; i++) {
-        struct v4l2_buffer buf = {0};
-        buf.type = req.type;
-        buf.memory = req.memory;
-        buf.index = i;
-        ioctl(cam_fd, VIDIOC_QUERYBUF, &buf); // Query buffer info
-
-        buffers[i].len = buf.length;
-        buffers[i].addr = mmap(NULL, buf.length,
-                               PROT_READ | PROT_WRITE,
-                               MAP_SHARED, cam_fd, buf.m.offset); // Map buffer to memory
-        ioctl(cam_fd, VIDIOC_QBUF, &buf); // Queue buffer for capture
-    }
-
-    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    ioctl(cam_fd, VIDIOC_STREAMON, &type); // Start streaming
-}
+/* ============================================================
+   TCP UPLOAD
+   ============================================================ */
 
-// Shutdown camera and clean up
-static void camera_shutdown(void)
-{
-    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    ioctl(cam_fd, VIDIOC_STREAMOFF, &type); // Stop streaming
+#define UPLOAD_DST  "10.0.0.1"   // Upload server (tcpserver.py)
+#define UPLOAD_PORT 10000
 
-    for (int i = 0; i < CAMERA_BUFFERS; i++)
-        munmap(buffers[i].addr, buffers[i].len); // Unmap memory
+#define UPLOAD_MBPS_DEFAULT   4.0          // Mean of the old 2 KB per 2-6 ms loop
+#define UPLOAD_JITTER_DEFAULT "uniform:0.5"
 
-    close(cam_fd); // Close device
-}
+static const char *upload_host = UPLOAD_DST; // -u
+static struct up_shape upload_shape;         // -r, -j
 
-/* ============================================================
-   TCP UPLOAD
-   ============================================================ */
+/* Summed over every capture for the [total] line */
+static struct {
+    unsigned captures;
+    uint64_t frames, drops, bytes, capture_ns, capture_cpu_ns;
+    uint64_t sent, upload_ns;
+} totals;
 
 // Upload file over TCP with event labels
 static void upload_file(const char *path)
@@ -178,18 +293,18 @@ static void upload_file(const char *path)
 
     struct sockaddr_in dst = {0};
     dst.sin_family = AF_INET;
-    dst.sin_port = htons(10000);
-    inet_pton(AF_INET, "10.0.0.1", &dst.sin_addr); // Destination server
+    dst.sin_port = htons(UPLOAD_PORT);
+    inet_pton(AF_INET, upload_host, &dst.sin_addr); // Destination server
 
-    if (connect(sock, (struct sockaddr *)&dst, sizeof(dst)) < 0) goto out; // Exit on failure
+    struct stat st;
+    if (fstat(fd, &st) != 0 || connect(sock, (struct sockaddr *)&dst, sizeof(dst)) < 0) goto out; // Exit on failure
 
-    char buf[2048];
-    ssize_t n;
-
-    while ((n = read(fd, buf, sizeof(buf))) > 0) { // Read file chunks
-        send(sock, buf, n, 0); // Send over TCP
-        msleep(2 + rand() % 5); // Add small jitter for realistic traffic
-    }
+    /* Page cache straight to the socket; the shape comes from pacing or whole-window bursts */
+    struct up_stats us = {0};
+    up_send_file(sock, fd, 0, (uint64_t)st.st_size, &upload_shape, &us);
+    totals.sent += us.bytes;
+    totals.upload_ns += us.ns;
+    up_report(&us, &upload_shape, stderr);
 
 out:
     close(fd);   // Close file
@@ -202,50 +317,629 @@ out:
    MAIN
    ============================================================ */
 
-int main(void)
+#define SCENARIO_WINDOW_NS (3600ULL * SC_NS_PER_S) // Timeline compiled an hour at a time
+#define RING_SLOTS_DEFAULT 16
+
+static struct frame_ring ring;     // Streaming mode frame ring, sized on the first capture
+static struct frame_ring zc_ring;  // -s -Z: frame_refs to the sender
+static struct frame_ring zc_ret;   // -s -Z: buffer indices back for requeue
+static uint64_t capture_cpu0;      // cpu_ns() at CAPTURE_START
+static int use_uring;              // -U
+static struct uring uring;         // -U: set up once at start-up
+
+// CAPTURE_END carries the capture summary: frames, drops, dequeue latency, fps
+static void capture_end_label(void)
 {
-    signal(SIGINT, handle_sigint); // Handle CTRL+C
-    srand(time(NULL));             // Seed random numbers
+    totals.captures++;
+    totals.frames += cam.frames;
+    totals.drops += cam.drops;
+    totals.bytes += copies.payload;
+    totals.capture_ns += mono_ns() - cam.start_ns;
+    totals.capture_cpu_ns += cpu_ns() - capture_cpu0;
+
+    if (labels.fd >= 0) {
+        int32_t arg[4];
+        cam_summary_args(&cam, arg);
+        lbl_emit(&labels, "CAPTURE_END", 4, arg);
+        return;
+    }
+    char summary[384];
+    cam_summary_json(&cam, summary, sizeof(summary));
+    send_label_fields("CAPTURE_END", summary);
+}
 
-    msleep(2000);                  // Wait 2 seconds before starting
-    send_aggressive_sync();        // Initial aggressive sync
-    msleep(2000);                  // Wait 2 seconds
+// Start a capture: labels, camera, per-cycle counters and the -Z pipe
+static void capture_begin(void)
+{
+    send_label("CAPTURE_START");       // Mark capture start
+    capture_cpu0 = cpu_ns();
+    if (cam_start(&cam) != 0) exit(1); // Stream on, or flush frames left over from idle
+    memset(&copies, 0, sizeof(copies));
+    if (zero_copy && !use_uring && !zpipe.size && zc_pipe_open(&zpipe, cam.buf[0].len) != 0) exit(1);
+    if (compress_frames && !yenc.prev) {
+        size_t len = (size_t)cam.width * cam.height * 2; // YUYV
+        if (yz_enc_init(&yenc, yz_kernel_get(NULL), len, key_interval) != 0 ||
+            !(ybuf = malloc(yz_bound(len)))) {
+            fprintf(stderr, "Cannot allocate the frame compressor\n");
+            exit(1);
+        }
+    }
+}
 
-    uint64_t next_sync = now_ms() + (30 + rand() % 10) * 60 * 1000; // Next periodic sync 30–40 min later
+// One capture + upload cycle for a timeline motion event
+static void capture_and_upload(uint64_t capture_ms)
+{
+    capture_begin();
+
+    int out = open(VIDEO_FILE, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    uint64_t end = now_ms() + capture_ms; // Capture length from the timeline
+    uint64_t packed = 0, encode_ns = 0;
+    if (compress_frames) yz_enc_reset(&yenc); // The file starts with a key frame
+
+    while (now_ms() < end && !stop_requested) {
+        struct cam_frame buf;
+        int r = cam_dequeue(&cam, &buf, CAM_DQ_TIMEOUT_MS); // Wait for a frame
+        if (r == CAM_ERROR) break;     // Camera gone: end the capture early
+        if (r == CAM_TIMEOUT) continue;
+        if (compress_frames) {
+            if (buf.bytesused < yenc.len) { cam_requeue(&cam, &buf); continue; } // Short frame
+            uint64_t t = mono_ns();
+            size_t n = yz_encode(&yenc, cam.buf[buf.index].addr, ybuf); // Compress, then write the result
+            encode_ns += mono_ns() - t;
+            write(out, ybuf, n);
+            packed += n;
+            copies.user += yenc.len + n;   // Encoder keeps a reference copy; write() copies the output
+        } else if (zero_copy) {
+            zc_write(&zpipe, cam.buf[buf.index].addr, buf.bytesused, out); // Pages into the page cache
+            copies.kernel += buf.bytesused;
+        } else {
+            write(out, cam.buf[buf.index].addr, buf.bytesused); // Write frame to file
+            copies.user += buf.bytesused;
+        }
+        copies.frames++;
+        copies.payload += buf.bytesused;
+        cam_requeue(&cam, &buf);       // Requeue buffer
+    }
 
-    while (!stop_requested) {
+    close(out);            // Close file
+    cam_stop(&cam);        // Back to idle
+    capture_end_label();   // Mark capture end, with the summary
+    cam_report(&cam, stderr);
+    if (compress_frames && copies.frames)
+        fprintf(stderr, "[yuvz] kernel=%s ratio=%.2f encode=%.2fms/frame (%.0f MB/s)\n", yenc.k->name,
+                packed ? (double)copies.payload / (double)packed : 0.0,
+                (double)encode_ns / 1e6 / (double)copies.frames,
+                encode_ns ? (double)copies.payload / ((double)encode_ns / 1e9) / 1e6 : 0.0);
+
+    upload_file(VIDEO_FILE); // Upload captured file
+    unlink(VIDEO_FILE);      // Delete file
+    copy_stats_report(&copies, stderr);
+}
+
+// One capture cycle with frames streamed to the upload server as they arrive
+static void capture_and_stream(uint64_t capture_ms, unsigned ring_slots)
+{
+    capture_begin();
+
+    if (!ring.data && framering_init(&ring, ring_slots, cam.buf[0].len) != 0) {
+        fprintf(stderr, "Cannot allocate %u x %zu byte frame ring\n", ring_slots, cam.buf[0].len);
+        exit(1);
+    }
+    framering_reset(&ring);
+
+    struct streamer tx;
+    int streaming = stream_start(&tx, &ring, compress_frames ? &yenc : NULL, upload_host, UPLOAD_PORT) == 0;
+    if (streaming) send_label("UPLOAD_START");
+    else perror("stream connect");
+
+    uint64_t end = now_ms() + capture_ms;
+
+    while (now_ms() < end && !stop_requested) {
+        struct cam_frame buf;
+        int r = cam_dequeue(&cam, &buf, CAM_DQ_TIMEOUT_MS);
+        if (r == CAM_ERROR) break;
+        if (r == CAM_TIMEOUT) continue;
+        if (streaming) {
+            size_t len = buf.bytesused < ring.slot_size ? buf.bytesused : ring.slot_size;
+            unsigned char *slot = framering_claim(&ring); // NULL: sender behind, frame dropped
+            if (slot) {
+                memcpy(slot, cam.buf[buf.index].addr, len);
+                framering_commit(&ring, len);
+                copies.frames++;
+                copies.payload += len;
+                copies.user += 2 * (uint64_t)len; // Into the ring, then send() into the kernel
+                if (compress_frames) copies.user += len; // Encoder's reference copy
+            }
+        }
+        cam_requeue(&cam, &buf);  // Requeue right away; the ring holds the copy
+    }
+
+    cam_stop(&cam);
+    capture_end_label();
+    cam_report(&cam, stderr);
+
+    if (streaming) {
+        stream_finish(&tx);        // Drain what is still queued
+        send_label("UPLOAD_END");
+        totals.sent += tx.st.bytes;
+        totals.upload_ns += tx.st.total_ns;
+        framering_report(&ring, stderr);
+        stream_report(&tx, stderr);
+        copy_stats_report(&copies, stderr);
+    }
+}
+
+// Streaming capture with -Z: the sender transmits out of the V4L2 buffers themselves
+static void capture_and_stream_zc(uint64_t capture_ms)
+{
+    capture_begin();
+
+    if (!zc_ring.data && (framering_init(&zc_ring, cam.nbuf, sizeof(struct frame_ref)) != 0 ||
+                          framering_init(&zc_ret, cam.nbuf, sizeof(uint32_t)) != 0)) {
+        fprintf(stderr, "Cannot allocate zero-copy rings\n");
+        exit(1);
+    }
+    framering_reset(&zc_ring);
+    framering_reset(&zc_ret);
+
+    struct streamer tx;
+    int streaming = stream_start_zc(&tx, &zc_ring, &zc_ret, cam.buf, upload_host, UPLOAD_PORT) == 0;
+    if (streaming) send_label("UPLOAD_START");
+    else perror("stream connect");
+
+    uint64_t end = now_ms() + capture_ms;
+    unsigned queued = cam.nbuf;        // Buffers the driver can fill; the rest are with the sender
+
+    while (now_ms() < end && !stop_requested) {
+        size_t len;
+        const unsigned char *ret;
+        while ((ret = framering_peek(&zc_ret, &len))) { // Sends the kernel has finished with
+            uint32_t index;
+            memcpy(&index, ret, sizeof(index));
+            framering_release(&zc_ret);
+            cam_requeue_index(&cam, index);
+            queued++;
+        }
+        if (queued == 0) {             // Every buffer in flight: the driver is dropping frames
+            msleep(1);
+            continue;
+        }
+
+        struct cam_frame buf;
+        int r = cam_dequeue(&cam, &buf, CAM_DQ_TIMEOUT_MS);
+        if (r == CAM_ERROR) break;
+        if (r == CAM_TIMEOUT) continue;
+        queued--;
+        unsigned char *slot = streaming ? framering_claim(&zc_ring) : NULL;
+        if (slot) {
+            struct frame_ref ref = { buf.index, buf.bytesused };
+            memcpy(slot, &ref, sizeof(ref));
+            framering_commit(&zc_ring, sizeof(ref));
+            copies.frames++;
+            copies.payload += buf.bytesused;
+        } else {
+            cam_requeue(&cam, &buf);
+            queued++;
+        }
+    }
+
+    capture_end_label();
+    if (streaming) {
+        stream_finish(&tx);        // Waits for the last completions
+        send_label("UPLOAD_END");
+        totals.sent += tx.st.bytes;
+        totals.upload_ns += tx.st.total_ns;
+        size_t len;
+        const unsigned char *ret;
+        while ((ret = framering_peek(&zc_ret, &len))) {
+            uint32_t index;
+            memcpy(&index, ret, sizeof(index));
+            framering_release(&zc_ret);
+            cam_requeue_index(&cam, index);
+        }
+        copies.kernel = tx.st.zc_copied;
+    }
+    cam_stop(&cam);                // Only now: the sender may have been reading the buffers
+    cam_report(&cam, stderr);
+
+    if (streaming) {
+        framering_report(&zc_ring, stderr);
+        stream_report(&tx, stderr);
+        copy_stats_report(&copies, stderr);
+    }
+}
 
-        msleep((10 + rand() % 30) * 1000); // Random idle 10–30s
+#define URING_ENTRIES 32
 
-        send_label("CAPTURE_START");       // Mark capture start
-        camera_init();                     // Initialize camera
 
-        int out = open(VIDEO_FILE, O_CREAT | O_TRUNC | O_WRONLY, 0644);
-        uint64_t end = now_ms() + (3000 + rand() % 4000); // Capture 3–7s
+/* -U: what each camera buffer has in flight */
+static struct {
+    uint32_t len, done;            // Bytes to write/send, bytes completed
+    uint64_t off;                  // File offset
+    unsigned notifs;               // Zero-copy notifications still to come
+    int busy;
+} uio[CAMERA_BUFFERS];
+
+// Queue (the rest of) buffer i's write or send; exits if the ring is full, which the sizing rules out
+static void uring_queue_io(unsigned i, int sock, int out)
+{
+    const uint8_t *addr = (const uint8_t *)cam.buf[i].addr + uio[i].done;
+    uint32_t left = uio[i].len - uio[i].done;
+    int r = sock >= 0 ? uring_send(&uring, sock, addr, left, zero_copy, (int)i, i)
+                      : uring_write(&uring, out, addr, left, uio[i].off + uio[i].done, (int)i, i);
+    if (r != 0) { fprintf(stderr, "io_uring submission queue full\n"); exit(1); }
+}
+
+// One capture cycle on io_uring (-U): file writes (or sends, with -s) stay in flight while the
+// next frames are dequeued; a buffer goes back to the camera once its I/O has completed
+static void capture_uring(uint64_t capture_ms, int stream_mode)
+{
+    capture_begin();
+
+    int sock = -1, out = -1;
+    if (stream_mode) {
+        struct sockaddr_in dst = {0};
+        dst.sin_family = AF_INET;
+        dst.sin_port = htons(UPLOAD_PORT);
+        inet_pton(AF_INET, upload_host, &dst.sin_addr);
+        sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(sock, (struct sockaddr *)&dst, sizeof(dst)) < 0) { perror("stream connect"); close(sock); sock = -1; }
+        else send_label("UPLOAD_START");
+    } else {
+        out = open(VIDEO_FILE, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    }
+    int sink = stream_mode ? sock >= 0 : out >= 0;
+
+    /* Register the camera buffers: fixed writes/sends skip the per-request page pinning.
+     * Device memory (VM_PFNMAP) cannot be registered; the requests then name the address. */
+    struct iovec iov[CAMERA_BUFFERS];
+    for (unsigned i = 0; i < cam.nbuf; i++) iov[i] = (struct iovec){ cam.buf[i].addr, cam.buf[i].len };
+    int reg = uring_register(&uring, iov, cam.nbuf);
+
+    uint64_t end = now_ms() + capture_ms, foff = 0, t0 = mono_ns(), sent = 0;
+    unsigned inflight = 0;         // Buffers held for I/O
+    unsigned fifo[CAMERA_BUFFERS], fifo_head = 0, fifo_n = 0; // -s: frames waiting for the socket
+    int sending = 0, io_error = 0;
+    memset(uio, 0, sizeof(uio));
+
+    for (;;) {
+        /* Completions: finished buffers go back to the camera */
+        struct uring_cqe c;
+        while (uring_peek(&uring, &c)) {
+            unsigned i = (unsigned)c.user_data;
+            if (c.flags & URING_CQE_NOTIF) uio[i].notifs--;
+            else {
+                if (c.flags & URING_CQE_MORE) uio[i].notifs++;
+                if (c.res <= 0) {
+                    if (!io_error) fprintf(stderr, "io_uring %s: %s\n", stream_mode ? "send" : "write", c.res ? strerror(-c.res) : "no progress");
+                    io_error = 1;
+                    uio[i].done = uio[i].len;  // Give up on this one
+                } else {
+                    uio[i].done += (uint32_t)c.res;
+                    sent += (uint64_t)c.res;
+                }
+                if (uio[i].done < uio[i].len) uring_queue_io(i, sock, out); // Short: the rest
+                else if (stream_mode) sending = 0;
+            }
+            if (uio[i].busy && uio[i].done == uio[i].len && uio[i].notifs == 0) {
+                uio[i].busy = 0;
+                cam_requeue_index(&cam, i);
+                inflight--;
+            }
+        }
+        if (stream_mode && !sending && fifo_n) { // One send at a time keeps the byte stream in order
+            unsigned i = fifo[fifo_head];
+            fifo_head = (fifo_head + 1) % CAMERA_BUFFERS;
+            fifo_n--;
+            if (io_error) uio[i].done = uio[i].len; // Socket is dead: drop queued frames
+            else { uring_queue_io(i, sock, out); sending = 1; }
+            if (uio[i].done == uio[i].len) { uio[i].busy = 0; cam_requeue_index(&cam, i); inflight--; }
+        }
 
-        while (now_ms() < end && !stop_requested) {
-            struct v4l2_buffer buf = {0};
-            buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-            buf.memory = V4L2_MEMORY_MMAP;
-            ioctl(cam_fd, VIDIOC_DQBUF, &buf); // Dequeue frame
-            write(out, buffers[buf.index].addr, buf.bytesused); // Write frame to file
-            ioctl(cam_fd, VIDIOC_QBUF, &buf); // Requeue buffer
+        /* Nothing for the camera to fill, or only I/O left: sleep in the ring */
+        int capturing = now_ms() < end && !stop_requested;
+        if (!capturing && inflight == 0) break;
+        if (!capturing || inflight == cam.nbuf) {
+            int r = uring_submit(&uring, 1);
+            if (r < 0 && r != -EINTR) { fprintf(stderr, "io_uring_enter: %s\n", strerror(-r)); exit(1); }
+            continue;
         }
+        uring_submit(&uring, 0);
+
+        struct cam_frame buf;
+        int r = cam_dequeue(&cam, &buf, CAM_DQ_TIMEOUT_MS);
+        if (r == CAM_ERROR) { end = 0; continue; } // Camera gone: finish the I/O in flight
+        if (r == CAM_TIMEOUT) continue;
+        if (!sink || io_error) { cam_requeue(&cam, &buf); continue; }
+
+        unsigned i = buf.index;
+        uio[i].len = buf.bytesused;
+        uio[i].done = 0;
+        uio[i].off = foff;
+        uio[i].notifs = 0;
+        uio[i].busy = 1;
+        inflight++;
+        foff += buf.bytesused;
+        copies.frames++;
+        copies.payload += buf.bytesused;
+        if (!(stream_mode && zero_copy)) copies.user += buf.bytesused; // write()/send() copy, without a syscall of ours
+        if (stream_mode) fifo[(fifo_head + fifo_n++) % CAMERA_BUFFERS] = i;
+        else uring_queue_io(i, sock, out);
+    }
+    uint64_t io_ns = mono_ns() - t0;
+    uring_unregister(&uring);
+
+    if (!stream_mode) {
+        if (out >= 0) close(out);
+        cam_stop(&cam);
+        capture_end_label();
+        cam_report(&cam, stderr);
+        fprintf(stderr, "[uring] writes: %.2f MB, %s buffers\n", (double)sent / 1e6, reg == 0 ? "registered" : "unregistered");
+        upload_file(VIDEO_FILE);
+        unlink(VIDEO_FILE);
+    } else {
+        cam_stop(&cam);
+        capture_end_label();
+        cam_report(&cam, stderr);
+        if (sock >= 0) {
+            close(sock);
+            send_label("UPLOAD_END");
+            totals.sent += sent;
+            totals.upload_ns += io_ns;
+            fprintf(stderr, "[uring] sends: %.2f MB in %.2fs (%.0f Mbps)%s, %s buffers\n", (double)sent / 1e6,
+                    (double)io_ns / 1e9, (double)sent * 8 / ((double)io_ns / 1e9) / 1e6,
+                    zero_copy ? " zero-copy" : "", reg == 0 ? "registered" : "unregistered");
+        }
+    }
+    copy_stats_report(&copies, stderr);
+}
 
-        close(out);            // Close file
-        camera_shutdown();     // Shutdown camera
-        send_label("CAPTURE_END");// Mark capture end
+#define MOTION_THRESHOLD_DEFAULT 4.0
+#define MOTION_PERSIST_DEFAULT   3
+#define PREVIEW_FPS_DEFAULT      5.0
 
-        upload_file(VIDEO_FILE); // Upload captured file
-        unlink(VIDEO_FILE);      // Delete file
+static struct motion_det md;       // -D
 
-        if (now_ms() > next_sync) { // Periodic sync
+// Throughput over the whole run, comparable between builds with the same -g and scenario
+static void totals_report(FILE *out)
+{
+    double cap_s = (double)totals.capture_ns / 1e9, up_s = (double)totals.upload_ns / 1e9;
+    fprintf(out, "[total] captures=%u frames=%llu drops=%llu (%.2f%%) capture=%.1ffps %.1fMB/s cpu=%.1f%% upload=%.1fMB/s (%.1f MB)\n",
+            totals.captures, (unsigned long long)totals.frames, (unsigned long long)totals.drops,
+            totals.frames + totals.drops ? 100.0 * (double)totals.drops / (double)(totals.frames + totals.drops) : 0.0,
+            cap_s > 0 ? (double)totals.frames / cap_s : 0.0, cap_s > 0 ? (double)totals.bytes / cap_s / 1e6 : 0.0,
+            cap_s > 0 ? (double)totals.capture_cpu_ns / 1e9 / cap_s * 100.0 : 0.0,
+            up_s > 0 ? (double)totals.sent / up_s / 1e6 : 0.0, (double)totals.sent / 1e6);
+}
+
+// One capture cycle in whichever mode was selected
+static void capture(uint64_t capture_ms, int stream_mode, unsigned ring_slots)
+{
+    if (use_uring) capture_uring(capture_ms, stream_mode);
+    else if (stream_mode && zero_copy) capture_and_stream_zc(capture_ms);
+    else if (stream_mode) capture_and_stream(capture_ms, ring_slots);
+    else capture_and_upload(capture_ms);
+}
+
+// Score the newest preview frame; 1 when the detector asks for a capture
+static int preview_sample(void)
+{
+    struct cam_frame buf;
+    int r = cam_preview(&cam, &buf, CAM_DQ_TIMEOUT_MS);
+    if (r == CAM_ERROR) { stop_requested = 1; return 0; }
+    if (r != CAM_FRAME) return 0;
+
+    double score = -1;
+    if (buf.bytesused >= (size_t)md.width * md.height * 2)
+        score = md_score(&md, cam.buf[buf.index].addr);
+    cam_requeue(&cam, &buf);
+
+    enum md_event ev = md_update(&md, score);
+    if (ev == MD_NONE) return 0;
+    const char *label = ev == MD_TRIGGER ? "MOTION_DETECTED" : "MOTION_QUIET";
+    if (labels.fd >= 0) {          // Score and threshold x 100
+        int32_t arg[3] = { (int32_t)(score * 100.0 + 0.5), (int32_t)(md.threshold * 100.0 + 0.5), (int32_t)md.persist };
+        lbl_emit(&labels, label, 3, arg);
+    } else {
+        char fields[128];
+        snprintf(fields, sizeof(fields), "\"score\":%.2f,\"threshold\":%.2f,\"persist\":%u",
+                 score, md.threshold, md.persist);
+        send_label_fields(label, fields);
+    }
+    return ev == MD_TRIGGER;
+}
+
+int main(int argc, char **argv)
+{
+    const char *scenario_path = NULL;
+    const char *seed_opt = NULL;
+    int stream_mode = 0;
+    unsigned ring_slots = RING_SLOTS_DEFAULT;
+    int idle = CAM_IDLE_DRAIN;
+    int detect = 0;
+    double threshold = MOTION_THRESHOLD_DEFAULT, preview_fps = PREVIEW_FPS_DEFAULT;
+    unsigned persist = MOTION_PERSIST_DEFAULT;
+    const char *device = CAMERA_DEVICE, *synth_spec = NULL;
+    unsigned motion_pct = SYNTH_MOTION_DEFAULT;
+    double upload_mbps = UPLOAD_MBPS_DEFAULT;
+    int label_batch = 0;           // -L
+    int device_id = 0;             // -i
+    up_jitter_parse(UPLOAD_JITTER_DEFAULT, &upload_shape);
+    int opt;
+    while ((opt = getopt(argc, argv, "S:z:sR:I:ZcK:DT:P:V:d:g:M:u:r:j:UL:i:Y:h")) != -1) {
+        switch (opt) {
+        case 'S': scenario_path = optarg; break;
+        case 'z': seed_opt = optarg; break;
+        case 's': stream_mode = 1; break;
+        case 'R': ring_slots = (unsigned)atoi(optarg); break;
+        case 'Z': zero_copy = 1; break;
+        case 'c': compress_frames = 1; break;
+        case 'K': key_interval = (unsigned)atoi(optarg); break;
+        case 'D': detect = 1; break;
+        case 'T': threshold = atof(optarg); break;
+        case 'P': persist = (unsigned)atoi(optarg); break;
+        case 'V': preview_fps = atof(optarg); break;
+        case 'd': device = optarg; break;
+        case 'g': synth_spec = optarg; break;
+        case 'M': motion_pct = (unsigned)atoi(optarg); break;
+        case 'u': upload_host = optarg; break;
+        case 'U': use_uring = 1; break;
+        case 'L': label_batch = atoi(optarg); break;
+        case 'i': device_id = atoi(optarg); break;
+        case 'Y':
+            if (sp_parse(optarg, &sync_code) != 0) {
+                fprintf(stderr, "-Y wants <degree 5-16>[:<chip ms, at least 2>], e.g. 9:10\n");
+                return 1;
+            }
+            break;
+        case 'r': upload_mbps = atof(optarg); break;
+        case 'j':
+            if (up_jitter_parse(optarg, &upload_shape) != 0) {
+                fprintf(stderr, "Unknown jitter model: %s (none, uniform[:frac] or exp)\n", optarg);
+                return 1;
+            }
+            break;
+        case 'I':
+            if ((idle = cam_idle_parse(optarg)) < 0) {
+                fprintf(stderr, "Unknown idle mode: %s (drain, off or reopen)\n", optarg);
+                return 1;
+            }
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-S <scenario>] [-z <seed>] [-s] [-R <slots>] [-I drain|off|reopen] [-Z] [-c] [-K <n>]"
+                    " [-D [-T <score>] [-P <frames>] [-V <fps>]]"
+                    " [-d <device> | -g <WxH@fps> [-M <pct>]] [-u <host>]"
+                    " [-r <Mbps>] [-j none|uniform[:frac]|exp] [-U] [-L <batch>] [-i <id>] [-Y <deg>[:<chip_ms>]]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    /* Defaults match the original fixed schedule; a scenario file can override them */
+    struct scenario scn;
+    scenario_init(&scn);
+    scn.phase[0].idle = sc_uniform(10 * SC_NS_PER_S, 40 * SC_NS_PER_S);            // Idle 10-40s
+    scn.phase[0].capture = sc_uniform(3 * SC_NS_PER_S, 7 * SC_NS_PER_S);           // Capture 3-7s
+    scn.phase[0].sync = sc_uniform(30 * 60 * SC_NS_PER_S, 40 * 60 * SC_NS_PER_S);  // Sync every 30-40 min
+    if (ring_slots < 2) { fprintf(stderr, "-R needs at least 2 slots\n"); return 1; }
+    if (compress_frames && zero_copy) { fprintf(stderr, "-c and -Z are exclusive: compression reads every byte\n"); return 1; }
+    if (detect && (threshold <= 0 || preview_fps <= 0)) { fprintf(stderr, "-T and -V must be positive\n"); return 1; }
+    if (detect && preview_fps > 1000) { fprintf(stderr, "-V must be at most 1000 (1 ms per preview frame)\n"); return 1; }
+    if (upload_mbps < 0) { fprintf(stderr, "-r must not be negative\n"); return 1; }
+    if (device_id < 0 || device_id > UINT16_MAX) { fprintf(stderr, "-i wants 0-65535\n"); return 1; }
+    if (use_uring && compress_frames) { fprintf(stderr, "-U and -c are exclusive: frames go out of the camera buffers as they are\n"); return 1; }
+    if (use_uring && zero_copy && !stream_mode) { fprintf(stderr, "-U -Z needs -s (zero-copy sends)\n"); return 1; }
+    if (use_uring) {
+        int r = uring_init(&uring, URING_ENTRIES);
+        if (r < 0) {
+            fprintf(stderr, "io_uring unavailable (%s): using the synchronous path\n", strerror(-r));
+            use_uring = 0;
+        }
+    }
+    if (label_batch && lbl_open(&labels, LABEL_DST, LABEL_PORT, (uint16_t)device_id, (unsigned)label_batch) != 0) return 1;
+    if (scenario_path && scenario_load(&scn, scenario_path) != 0) return 1;
+    if (detect)                    // Captures come from the detector instead
+        for (unsigned i = 0; i < scn.nphases; i++) scn.phase[i].idle.kind = SC_DIST_OFF;
+    uint64_t seed = scenario_seed(&scn, seed_opt);
+    scenario_print(&scn, seed, stderr);
+
+    struct sc_gen gen;
+    struct sc_timeline timeline = { 0 };
+    sc_gen_init(&gen, &scn, seed, (unsigned)device_id);
+    sc_aux_rng(&jitter_rng, seed, (unsigned)device_id, SC_AUX_JITTER);
+    upload_shape.rate = upload_mbps * 1e6 / 8; // Bytes/s
+    upload_shape.rng = &jitter_rng;
+    struct sc_rng capture_rng;     // -D capture lengths, apart from the timeline and upload jitter
+    sc_aux_rng(&capture_rng, seed, (unsigned)device_id, SC_AUX_CAPTURE);
+
+    if (synth_spec) {
+        unsigned w, h;
+        double fps;
+        if (synth_parse(synth_spec, &w, &h, &fps) != 0 || motion_pct > 100) {
+            fprintf(stderr, "-g wants WxH@fps with an even width and fps up to %.0f, e.g. 1920x1080@60; -M 0-100\n", SYNTH_FPS_MAX);
+            return 1;
+        }
+        cam_session_init(&cam, &cam_synth, "synthetic", w, h, idle);
+        cam.fps = fps;
+        cam.motion_pct = motion_pct;
+    } else {
+        cam_session_init(&cam, &cam_v4l2, device, 640, 480, idle);
+    }
+    if (idle != CAM_IDLE_REOPEN && cam_open(&cam) != 0) return 1; // Buffers stay mapped from here on
+    if (detect && md_init(&md, cam.width, cam.height, threshold, persist) != 0) return 1;
+
+    signal(SIGINT, handle_sigint); // Handle CTRL+C
+
+    msleep(2000);                  // Wait 2 seconds before starting
+    send_aggressive_sync();        // Initial aggressive sync
+    msleep(2000);                  // Wait 2 seconds
+
+    uint64_t t0 = now_ms();        // Timeline offsets count from here
+    uint64_t preview_ms = (uint64_t)(1000.0 / preview_fps);
+    uint64_t next_preview = t0;
+    unsigned cur_phase = 0;
+
+    /* Walk the timeline; an event that comes due during a capture/upload runs right after it */
+    const struct sc_event *ev;
+    while (!stop_requested) {
+        ev = sc_peek(&gen, &timeline, SCENARIO_WINDOW_NS);
+        if (!ev && !detect) break; // Nothing left to do; -D keeps watching the preview
+        uint64_t due = ev ? t0 + ev->t_ns / 1000000ULL : UINT64_MAX;
+        if (now_ms() < due) {
+            lbl_flush(&labels);    // Batched labels go out while nothing is being measured
+            sleep_until_ms(detect && next_preview < due ? next_preview : due);
+            if (detect && now_ms() >= next_preview) {
+                next_preview += preview_ms;
+                if (preview_sample()) {
+                    uint64_t len = sc_draw(&capture_rng, &scn.phase[cur_phase].capture);
+                    if (len != SC_NEVER) capture(len / 1000000ULL, stream_mode, ring_slots);
+                    md_report(&md, preview_fps, stderr);
+                    md_reset(&md);                      // Compare the scene afresh
+                    next_preview = now_ms() + preview_ms; // No catching up on missed ticks
+                }
+            }
+            continue;              // Woken early by a signal: re-check stop
+        }
+
+        switch (ev->type) {
+        case SC_EV_MOTION: {
+            uint64_t len_ms = ev->dur_ns / 1000000ULL;
+            sc_pop(&timeline);
+            capture(len_ms, stream_mode, ring_slots);
+            sc_motion_done(&timeline, (now_ms() - t0) * 1000000ULL); // Next idle gap counts from here
+            continue;
+        }
+        case SC_EV_PHASE:
+            cur_phase = ev->phase;
+            break;
+        case SC_EV_SYNC:           // Periodic sync
             msleep(3000);
             send_aggressive_sync();
             msleep(3000);
-            next_sync = now_ms() + (30 + rand() % 10) * 60 * 1000; // Schedule next
+            break;
+        case SC_EV_END:
+            stop_requested = 1;
+            break;
+        default:                   // Keepalives have no effect here
+            break;
         }
+        sc_pop(&timeline);
     }
 
+    if (detect) md_report(&md, preview_fps, stderr);
+    totals_report(stderr);
+    if (labels.fd >= 0) {
+        lbl_close(&labels);
+        lbl_report(&labels, stderr);
+    }
+    md_free(&md);
+    sc_timeline_free(&timeline);
+    framering_free(&ring);
+    framering_free(&zc_ring);
+    framering_free(&zc_ret);
+    if (zpipe.size) zc_pipe_close(&zpipe);
+    if (use_uring) uring_free(&uring);
+    yz_enc_free(&yenc);
+    free(ybuf);
+    cam_close(&cam);
     return 0;
 }
@@ -0,0 +1,141 @@
+/*
+ * Frame-differencing motion detector (see motion.h).
+ */
+
+#define _POSIX_C_SOURCE 200809L /* clock_gettime() */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define MD_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MD_NEON 1
+#endif
+
+#include "motion.h"
+
+static uint64_t mono_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+/* Luma of one YUYV row into cur[0..w), returning SAD against ref[0..w) */
+static uint64_t row_scalar(const uint8_t *yuyv, uint8_t *cur, const uint8_t *ref, unsigned x, unsigned w) {
+    uint64_t sad = 0;
+    for (; x < w; x++) {
+        uint8_t y = yuyv[2 * x];
+        cur[x] = y;
+        sad += (unsigned)(y > ref[x] ? y - ref[x] : ref[x] - y);
+    }
+    return sad;
+}
+
+#if defined(MD_SSE2)
+#define MD_KERNEL "sse2"
+static uint64_t row_sad(const uint8_t *yuyv, uint8_t *cur, const uint8_t *ref, unsigned w) {
+    const __m128i lo = _mm_set1_epi16(0x00FF);
+    __m128i acc = _mm_setzero_si128();
+    unsigned x = 0;
+    for (; x + 16 <= w; x += 16) {
+        __m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i *)(yuyv + 2 * x)), lo);
+        __m128i b = _mm_and_si128(_mm_loadu_si128((const __m128i *)(yuyv + 2 * x + 16)), lo);
+        __m128i y = _mm_packus_epi16(a, b);                  // 16 luma bytes
+        _mm_storeu_si128((__m128i *)(cur + x), y);
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(y, _mm_loadu_si128((const __m128i *)(ref + x))));
+    }
+    uint64_t sad = (uint64_t)_mm_cvtsi128_si32(acc) + (uint64_t)_mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+    return sad + row_scalar(yuyv, cur, ref, x, w);
+}
+#elif defined(MD_NEON)
+#define MD_KERNEL "neon"
+static uint64_t row_sad(const uint8_t *yuyv, uint8_t *cur, const uint8_t *ref, unsigned w) {
+    uint32x4_t acc = vdupq_n_u32(0);
+    unsigned x = 0;
+    for (; x + 16 <= w; x += 16) {
+        uint8x16_t y = vld2q_u8(yuyv + 2 * x).val[0];        // De-interleave: val[0] is luma
+        vst1q_u8(cur + x, y);
+        acc = vpadalq_u16(acc, vpaddlq_u8(vabdq_u8(y, vld1q_u8(ref + x))));
+    }
+    uint64_t sad = (uint64_t)vgetq_lane_u32(acc, 0) + vgetq_lane_u32(acc, 1) +
+                   vgetq_lane_u32(acc, 2) + vgetq_lane_u32(acc, 3);
+    return sad + row_scalar(yuyv, cur, ref, x, w);
+}
+#else
+#define MD_KERNEL "scalar"
+static uint64_t row_sad(const uint8_t *yuyv, uint8_t *cur, const uint8_t *ref, unsigned w) {
+    return row_scalar(yuyv, cur, ref, 0, w);
+}
+#endif
+
+int md_init(struct motion_det *m, unsigned width, unsigned height, double threshold, unsigned persist) {
+    memset(m, 0, sizeof(*m));
+    size_t n = (size_t)width * ((height + MD_ROW_STEP - 1) / MD_ROW_STEP);
+    m->ref = malloc(n);
+    m->cur = malloc(n);
+    if (!m->ref || !m->cur) { md_free(m); return -1; }
+    m->width = width;
+    m->height = height;
+    m->threshold = threshold;
+    m->persist = persist ? persist : 1;
+    m->kernel = MD_KERNEL;
+    return 0;
+}
+
+void md_free(struct motion_det *m) {
+    free(m->ref);
+    free(m->cur);
+    m->ref = m->cur = NULL;
+}
+
+void md_reset(struct motion_det *m) {
+    m->primed = 0;
+    m->over = 0;
+}
+
+double md_score(struct motion_det *m, const uint8_t *yuyv) {
+    uint64_t t = mono_ns();
+    uint64_t sad = 0, pixels = 0;
+    uint8_t *cur = m->cur;
+    const uint8_t *ref = m->ref;
+    for (unsigned y = 0; y < m->height; y += MD_ROW_STEP) {
+        sad += row_sad(yuyv + (size_t)y * m->width * 2, cur, ref, m->width);
+        cur += m->width;
+        ref += m->width;
+        pixels += m->width;
+    }
+    uint8_t *swap = m->ref; // This sample is the next one's reference
+    m->ref = m->cur;
+    m->cur = swap;
+
+    double score = -1.0;
+    if (m->primed) score = (double)sad / (double)pixels;
+    m->primed = 1;
+    m->samples++;
+    m->busy_ns += mono_ns() - t;
+    m->last_score = score;
+    return score;
+}
+
+enum md_event md_update(struct motion_det *m, double score) {
+    if (score < 0) return MD_NONE;
+    if (score < m->threshold) {
+        m->over = 0;
+        if (m->active) { m->active = 0; return MD_QUIET; }
+        return MD_NONE;
+    }
+    if (m->active) return MD_NONE;
+    if (++m->over < m->persist) return MD_NONE;
+    m->active = 1;
+    return MD_TRIGGER;
+}
+
+void md_report(const struct motion_det *m, double fps, FILE *out) {
+    double per = m->samples ? (double)m->busy_ns / (double)m->samples : 0.0;
+    fprintf(out, "[motion] kernel=%s samples=%llu cost=%.1fus/frame (%.3f%% of a core at %.1f fps) last score=%.2f\n",
+            m->kernel, (unsigned long long)m->samples, per / 1e3, per * fps / 1e9 * 100.0, fps, m->last_score);
+}
@@ -0,0 +1,58 @@
+/*
+ * Frame-differencing motion detector for the preview stream (-D).
+ *
+ * Every MD_ROW_STEP-th row of a YUYV frame is reduced to its luma bytes,
+ * kept as the reference for the next sample, and compared with the
+ * previous sample by sum of absolute differences. The score is the mean
+ * |dY| per sampled pixel. A trigger needs `persist` consecutive samples over
+ * the threshold, so sensor noise and single glitches do not start a
+ * capture. After a trigger the detector reports the scene quiet again
+ * once a sample falls back under the threshold.
+ *
+ * The row kernel (luma extract + SAD in one pass) has SSE2 and NEON
+ * versions and a scalar fallback. At 640x480 with MD_ROW_STEP 4 that is
+ * 76800 pixels per sample.
+ */
+
+#ifndef REALDATAFLOW_MOTION_H
+#define REALDATAFLOW_MOTION_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define MD_ROW_STEP 4
+
+enum md_event { MD_NONE, MD_TRIGGER, MD_QUIET };
+
+struct motion_det {
+    unsigned width, height;
+    uint8_t *ref, *cur;        // Sampled luma, width bytes per sampled row
+    int primed;                // ref holds a frame
+    double threshold;          // Mean |dY| per pixel
+    unsigned persist;          // Samples over the threshold before a trigger
+    unsigned over;             // Current streak
+    int active;                // Triggered and not yet quiet
+    double last_score;
+    uint64_t samples, busy_ns; // Cost accounting
+    const char *kernel;
+};
+
+/* 0 or -1 (allocation failure) */
+int  md_init(struct motion_det *m, unsigned width, unsigned height, double threshold, unsigned persist);
+void md_free(struct motion_det *m);
+
+/* Forget the reference (after a capture the scene is compared afresh). A
+ * trigger stays active: the next quiet sample reports MD_QUIET, and motion
+ * that never settled does not trigger again until it has */
+void md_reset(struct motion_det *m);
+
+/* Score one YUYV frame against the previous sample; -1 for the first one */
+double md_score(struct motion_det *m, const uint8_t *yuyv);
+
+/* Feed a score to the trigger logic */
+enum md_event md_update(struct motion_det *m, double score);
+
+/* Cost so far as a share of one core at `fps` samples per second */
+void md_report(const struct motion_det *m, double fps, FILE *out);
+
+#endif /* REALDATAFLOW_MOTION_H */
@@ -0,0 +1,241 @@
+/*
+ * Streaming-mode TCP sender (see stream.h).
+ */
+
+#define _POSIX_C_SOURCE 200809L /* clock_gettime(), nanosleep() */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "stream.h"
+
+#define STREAM_IDLE_POLL_NS 1000000L // Empty-ring back-off; frames arrive every ~33 ms
+
+static uint64_t mono_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+static int send_all(int sock, const unsigned char *p, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(sock, p, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static void hand_back(struct streamer *s, uint32_t index) {
+    unsigned char *slot = framering_claim(s->ret); // Never full: it has a slot per V4L2 buffer
+    if (!slot) return;
+    memcpy(slot, &index, sizeof(index));
+    framering_commit(s->ret, sizeof(index));
+}
+
+/* Frames sent with MSG_ZEROCOPY whose pages the kernel may still be reading */
+struct inflight { struct frame_ref ref; uint32_t last_id; };
+
+static void *sender_zc_main(void *arg) {
+    struct streamer *s = arg;
+    struct stream_stats *st = &s->st;
+    struct inflight fl[CAMERA_BUFFERS];
+    unsigned fl_head = 0, fl_n = 0;
+    uint64_t start = mono_ns(), closing = 0;
+
+    for (;;) {
+        /* Completed sends: their buffers go back to the capture thread */
+        int copied;
+        size_t len;
+        int wait_ms = fl_n && !framering_peek(s->ring, &len) ? 1 : 0; // Nothing to send: block on completions
+        uint64_t t = mono_ns();
+        zc_reap(&s->zc, wait_ms, &copied);
+        if (wait_ms) st->idle_ns += mono_ns() - t;
+        while (fl_n && (int32_t)(s->zc.done - fl[fl_head].last_id) > 0) {
+            struct inflight *f = &fl[fl_head];
+            if (copied) st->zc_copied += f->ref.len;
+            hand_back(s, f->ref.index);
+            fl_head = (fl_head + 1) % CAMERA_BUFFERS;
+            fl_n--;
+        }
+
+        const unsigned char *slot = framering_peek(s->ring, &len);
+        if (!slot) {
+            int closed = framering_closed(s->ring);
+            if (framering_peek(s->ring, &len)) continue;
+            if (closed) {
+                if (!closing) closing = mono_ns();
+                if (fl_n == 0) break;
+                if (mono_ns() - closing > 2000000000ULL) { // Completions lost: release anyway
+                    for (; fl_n; fl_n--, fl_head = (fl_head + 1) % CAMERA_BUFFERS)
+                        hand_back(s, fl[fl_head].ref.index);
+                    break;
+                }
+                continue;
+            }
+            if (!fl_n) {
+                struct timespec ts = { 0, STREAM_IDLE_POLL_NS };
+                nanosleep(&ts, NULL);
+                st->idle_ns += mono_ns() - t;
+            }
+            continue;
+        }
+
+        struct frame_ref ref;
+        memcpy(&ref, slot, sizeof(ref));
+        framering_release(s->ring);
+
+        uint32_t last_id;
+        t = mono_ns();
+        if (!st->error && zc_send(&s->zc, s->bufs[ref.index].addr, ref.len, &last_id) == 0) {
+            st->frames++;
+            st->bytes += ref.len;
+            fl[(fl_head + fl_n) % CAMERA_BUFFERS] = (struct inflight){ ref, last_id };
+            fl_n++;
+        } else {
+            if (!st->error) st->error = errno;
+            hand_back(s, ref.index);
+        }
+        st->send_ns += mono_ns() - t;
+    }
+
+    st->total_ns = mono_ns() - start;
+    return NULL;
+}
+
+static void *sender_main(void *arg) {
+    struct streamer *s = arg;
+    struct stream_stats *st = &s->st;
+    uint64_t start = mono_ns();
+
+    for (;;) {
+        size_t len;
+        const unsigned char *frame = framering_peek(s->ring, &len);
+        if (!frame) {
+            /* Check closed before re-peeking so a frame committed just before close is not lost */
+            int closed = framering_closed(s->ring);
+            if (framering_peek(s->ring, &len)) continue;
+            if (closed) break;
+            uint64_t t = mono_ns();
+            struct timespec ts = { 0, STREAM_IDLE_POLL_NS };
+            nanosleep(&ts, NULL);
+            st->idle_ns += mono_ns() - t;
+            continue;
+        }
+
+        if (!st->error && s->enc && len < s->enc->len) {
+            framering_release(s->ring); // Short frame: cannot be coded at the stream's frame size
+            continue;
+        }
+        if (!st->error) {
+            uint64_t t = mono_ns();
+            size_t raw = len;
+            if (s->enc) {
+                len = yz_encode(s->enc, frame, s->zbuf);
+                frame = s->zbuf;
+                st->encode_ns += mono_ns() - t;
+                t = mono_ns();
+            }
+            if (send_all(s->sock, frame, len) == 0) {
+                st->frames++;
+                st->bytes += len;
+                st->raw_bytes += raw;
+            } else {
+                st->error = errno; // Keep draining so capture sees drops, not a stall
+            }
+            st->send_ns += mono_ns() - t;
+        }
+        framering_release(s->ring);
+    }
+
+    st->total_ns = mono_ns() - start;
+    return NULL;
+}
+
+static int stream_connect(struct streamer *s, const char *host, int port) {
+    s->sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (s->sock < 0) return -1;
+
+    struct sockaddr_in dst = {0};
+    dst.sin_family = AF_INET;
+    dst.sin_port = htons((uint16_t)port);
+    inet_pton(AF_INET, host, &dst.sin_addr);
+    if (connect(s->sock, (struct sockaddr *)&dst, sizeof(dst)) < 0) {
+        close(s->sock);
+        s->sock = -1;
+        return -1;
+    }
+    return 0;
+}
+
+int stream_start(struct streamer *s, struct frame_ring *ring, struct yz_enc *enc,
+                 const char *host, int port) {
+    memset(s, 0, sizeof(*s));
+    s->ring = ring;
+    s->enc = enc;
+    if (enc) {
+        s->zbuf = malloc(yz_bound(enc->len));
+        if (!s->zbuf) return -1;
+        yz_enc_reset(enc);              // Each upload starts with a key frame
+    }
+    if (stream_connect(s, host, port) != 0 ||
+        pthread_create(&s->thread, NULL, sender_main, s) != 0) {
+        if (s->sock >= 0) close(s->sock);
+        free(s->zbuf);
+        return -1;
+    }
+    return 0;
+}
+
+int stream_start_zc(struct streamer *s, struct frame_ring *ring, struct frame_ring *ret,
+                    const struct cam_buf *bufs, const char *host, int port) {
+    memset(s, 0, sizeof(*s));
+    s->ring = ring;
+    s->ret = ret;
+    s->bufs = bufs;
+    if (stream_connect(s, host, port) != 0) return -1;
+    if (zc_sock_init(&s->zc, s->sock) != 0) {
+        perror("SO_ZEROCOPY");
+        close(s->sock);
+        return -1;
+    }
+    if (pthread_create(&s->thread, NULL, sender_zc_main, s) != 0) {
+        close(s->sock);
+        return -1;
+    }
+    return 0;
+}
+
+void stream_finish(struct streamer *s) {
+    framering_close(s->ring);
+    pthread_join(s->thread, NULL);
+    close(s->sock);
+    free(s->zbuf);
+}
+
+void stream_report(const struct streamer *s, FILE *out) {
+    const struct stream_stats *st = &s->st;
+    double secs = (double)st->total_ns / 1e9;
+    fprintf(out, "[stream] sent=%llu frames %.2f MB in %.2fs (%.2f Mbps) send=%.0f%% idle=%.0f%%%s%s%s\n",
+            (unsigned long long)st->frames, (double)st->bytes / 1e6, secs,
+            secs > 0 ? (double)st->bytes * 8 / secs / 1e6 : 0.0,
+            st->total_ns ? 100.0 * (double)st->send_ns / (double)st->total_ns : 0.0,
+            st->total_ns ? 100.0 * (double)st->idle_ns / (double)st->total_ns : 0.0,
+            s->bufs ? (st->zc_copied ? " zerocopy=fell back to copy" : " zerocopy") : "",
+            st->error ? " error=" : "", st->error ? strerror(st->error) : "");
+    if (s->enc && st->frames)
+        fprintf(out, "[yuvz] kernel=%s ratio=%.2f encode=%.2fms/frame (%.0f MB/s)\n", s->enc->k->name,
+                st->bytes ? (double)st->raw_bytes / (double)st->bytes : 0.0,
+                (double)st->encode_ns / 1e6 / (double)st->frames,
+                st->encode_ns ? (double)st->raw_bytes / ((double)st->encode_ns / 1e9) / 1e6 : 0.0);
+}
@@ -0,0 +1,71 @@
+/*
+ * TCP sender thread for streaming mode (-s): drains a frame_ring onto an
+ * already-connected socket while the capture thread keeps filling it.
+ *
+ * With -Z the ring carries frame_refs instead of frame copies: the sender
+ * transmits straight out of the mmap'd V4L2 buffer with MSG_ZEROCOPY and,
+ * once the kernel reports the send complete, hands the buffer index back
+ * on a second ring for the capture thread to requeue.
+ *
+ * With -c the sender compresses each frame (yuvz.h) just before sending it,
+ * so the capture thread never pays for compression.
+ */
+
+#ifndef REALDATAFLOW_STREAM_H
+#define REALDATAFLOW_STREAM_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "camera.h"
+#include "framering.h"
+#include "yuvz.h"
+#include "zcopy.h"
+
+/* Zero-copy ring entry: which V4L2 buffer, how many bytes */
+struct frame_ref { uint32_t index; uint32_t len; };
+
+struct stream_stats {
+    uint64_t frames;           // Frames fully sent
+    uint64_t bytes;            // Bytes on the wire
+    uint64_t raw_bytes;        // Frame bytes before compression
+    uint64_t encode_ns;        // Time compressing (-c)
+    uint64_t send_ns;          // Time inside send(): the network pushing back
+    uint64_t idle_ns;          // Time waiting on an empty ring: the camera is the limit
+    uint64_t total_ns;
+    uint64_t zc_copied;        // Zero-copy bytes the kernel ended up copying anyway
+    int error;                 // errno of a failed send, 0 if none
+};
+
+struct streamer {
+    pthread_t thread;
+    struct frame_ring *ring;
+    int sock;
+    struct stream_stats st;
+
+    /* Compression (-c) only */
+    struct yz_enc *enc;
+    uint8_t *zbuf;
+
+    /* Zero-copy mode only */
+    const struct cam_buf *bufs;
+    struct frame_ring *ret;    // Buffer indices (uint32_t) done with, for requeue
+    struct zc_sock zc;
+};
+
+/* Connect to host:port and start draining `ring`, compressing with `enc` unless
+ * NULL; 0 or -1 (nothing started) */
+int  stream_start(struct streamer *s, struct frame_ring *ring, struct yz_enc *enc,
+                  const char *host, int port);
+
+/* Same, zero-copy: `ring` carries frame_refs into `bufs`, finished indices go to `ret` */
+int  stream_start_zc(struct streamer *s, struct frame_ring *ring, struct frame_ring *ret,
+                     const struct cam_buf *bufs, const char *host, int port);
+
+/* Close the ring, wait for the sender to drain it, close the socket */
+void stream_finish(struct streamer *s);
+
+void stream_report(const struct streamer *s, FILE *out);
+
+#endif /* REALDATAFLOW_STREAM_H */
@@ -0,0 +1,200 @@
+/*
+ * Synthetic frame source (see synth.h).
+ */
+
+#define _POSIX_C_SOURCE 200809L /* clock_nanosleep() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "synth.h"
+
+#define BAND_NONE UINT32_MAX
+#define SYNTH_ALIGN 4096           // Page-aligned buffers, like mmap'd ones (vmsplice, MSG_ZEROCOPY)
+
+struct synth {
+    uint8_t *background;           // Static scene, one frame
+    uint64_t period_ns;
+    uint64_t start_ns;             // Due time of frame 0
+    uint32_t next_seq;             // Next frame the sensor produces
+    unsigned free;                 // Buffers queued to the "driver" (bitmask)
+    unsigned done[CAMERA_BUFFERS]; // Filled buffers waiting to be dequeued, oldest first
+    uint32_t done_seq[CAMERA_BUFFERS];
+    unsigned done_head, done_n;
+    unsigned band_w;
+    uint32_t band_x[CAMERA_BUFFERS]; // Band drawn into each buffer, BAND_NONE if none
+    uint64_t gen_frames, gen_ns;
+};
+
+static uint64_t mono_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+/* Produce every frame due by `now`: each takes a free buffer or is dropped */
+static void advance(struct synth *s, uint64_t now) {
+    if (now < s->start_ns) return;
+    uint32_t newest = (uint32_t)((now - s->start_ns) / s->period_ns);
+    while (s->next_seq <= newest) {
+        if (!s->free) { s->next_seq = newest + 1; break; } // No buffer: the rest are lost
+        unsigned i = (unsigned)__builtin_ctz(s->free);
+        unsigned slot = (s->done_head + s->done_n++) % CAMERA_BUFFERS;
+        s->free &= ~(1u << i);
+        s->done[slot] = i;
+        s->done_seq[slot] = s->next_seq++;
+    }
+}
+
+/* Move the band to where frame `seq` has it: restore the old one from the background, draw the new one */
+static void draw(struct cam_session *c, struct synth *s, unsigned i, uint32_t seq) {
+    if (!s->band_w) return;
+    unsigned w = c->width, h = c->height;
+    uint8_t *f = c->buf[i].addr;
+    uint32_t old = s->band_x[i];
+    if (old != BAND_NONE)
+        for (unsigned y = 0; y < h; y++)
+            memcpy(f + ((size_t)y * w + old) * 2, s->background + ((size_t)y * w + old) * 2, s->band_w * 2);
+
+    uint32_t x0 = (uint32_t)((uint64_t)seq * 8 % (w - s->band_w + 1)) & ~1u;
+    for (unsigned y = 0; y < h; y++) {
+        uint8_t *row = f + ((size_t)y * w + x0) * 2;
+        for (unsigned x = 0; x < s->band_w; x++)
+            row[x * 2] = (uint8_t)(((x0 + x) ^ y) * 3 + seq); // Luma only
+    }
+    s->band_x[i] = x0;
+}
+
+static void synth_close(struct cam_session *c) {
+    struct synth *s = c->priv;
+    for (unsigned i = 0; i < c->nbuf; i++) {
+        free(c->buf[i].addr);
+        c->buf[i].addr = NULL;
+    }
+    c->nbuf = 0;
+    if (s) free(s->background);
+    free(s);
+    c->priv = NULL;
+}
+
+static int synth_open(struct cam_session *c) {
+    if (c->width < 2 || (c->width & 1) || c->height < 1 || c->fps <= 0 || c->fps > SYNTH_FPS_MAX) {
+        fprintf(stderr, "%s: bad format %ux%u@%.1f\n", c->device, c->width, c->height, c->fps);
+        return -1;
+    }
+    struct synth *s = calloc(1, sizeof(*s));
+    size_t len = (size_t)c->width * c->height * 2; // YUYV
+    size_t alloc = (len + SYNTH_ALIGN - 1) / SYNTH_ALIGN * SYNTH_ALIGN;
+    c->priv = s;
+    if (!s || !(s->background = malloc(len))) goto fail;
+
+    for (unsigned y = 0; y < c->height; y++) {
+        uint8_t *row = s->background + (size_t)y * c->width * 2;
+        for (unsigned x = 0; x < c->width; x += 2) {
+            row[x * 2 + 0] = (uint8_t)(16 + (x + y) * 200 / (c->width + c->height));     // Y0
+            row[x * 2 + 1] = 128;                                                      // U
+            row[x * 2 + 2] = (uint8_t)(16 + (x + 1 + y) * 200 / (c->width + c->height)); // Y1
+            row[x * 2 + 3] = (uint8_t)(96 + y * 64 / c->height);                       // V
+        }
+    }
+    for (c->nbuf = 0; c->nbuf < CAMERA_BUFFERS; c->nbuf++) {
+        unsigned i = c->nbuf;
+        if (!(c->buf[i].addr = aligned_alloc(SYNTH_ALIGN, alloc))) goto fail;
+        memcpy(c->buf[i].addr, s->background, len);
+        c->buf[i].len = len;
+        s->band_x[i] = BAND_NONE;
+    }
+    s->period_ns = (uint64_t)(1e9 / c->fps);
+    s->band_w = (c->width * (c->motion_pct > 100 ? 100 : c->motion_pct) / 100) & ~1u;
+    return 0;
+
+fail:
+    fprintf(stderr, "%s: cannot allocate %u x %zu byte buffers\n", c->device, CAMERA_BUFFERS, len);
+    synth_close(c);
+    return -1;
+}
+
+static int synth_stream_on(struct cam_session *c) {
+    struct synth *s = c->priv;
+    s->start_ns = mono_ns() + s->period_ns; // First exposure ends one frame time after stream-on
+    s->next_seq = 0;
+    s->free = (1u << c->nbuf) - 1;
+    s->done_head = s->done_n = 0;
+    return 0;
+}
+
+static void synth_stream_off(struct cam_session *c) {
+    struct synth *s = c->priv;
+    s->free = 0;
+    s->done_n = 0;
+}
+
+static int synth_wait(struct cam_session *c, int timeout_ms) {
+    struct synth *s = c->priv;
+    uint64_t now = mono_ns();
+    advance(s, now);
+    if (s->done_n) return CAM_FRAME;
+    if (timeout_ms <= 0) return CAM_TIMEOUT;
+
+    uint64_t until = now + (uint64_t)timeout_ms * 1000000ULL;
+    if (s->free) {                 // Otherwise nothing can arrive before a buffer comes back
+        uint64_t due = s->start_ns + (uint64_t)s->next_seq * s->period_ns;
+        if (due < until) until = due;
+    }
+    struct timespec ts = { (time_t)(until / 1000000000ULL), (long)(until % 1000000000ULL) };
+    if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) return CAM_TIMEOUT; // Signal
+    advance(s, mono_ns());
+    return s->done_n ? CAM_FRAME : CAM_TIMEOUT;
+}
+
+static int synth_dequeue(struct cam_session *c, struct cam_frame *f) {
+    struct synth *s = c->priv;
+    advance(s, mono_ns());
+    if (!s->done_n) return CAM_TIMEOUT;
+    unsigned i = s->done[s->done_head];
+    uint32_t seq = s->done_seq[s->done_head];
+    s->done_head = (s->done_head + 1) % CAMERA_BUFFERS;
+    s->done_n--;
+
+    uint64_t t = mono_ns();
+    draw(c, s, i, seq);
+    s->gen_ns += mono_ns() - t;
+    s->gen_frames++;
+
+    f->index = i;
+    f->bytesused = (uint32_t)c->buf[i].len;
+    f->sequence = seq;
+    f->flags = 0;
+    f->ts_ns = s->start_ns + (uint64_t)seq * s->period_ns;
+    return CAM_FRAME;
+}
+
+static void synth_queue(struct cam_session *c, unsigned index) {
+    struct synth *s = c->priv;
+    advance(s, mono_ns());         // Frames due while the caller held the buffer could not use it
+    s->free |= 1u << index;
+}
+
+static void synth_report(const struct cam_session *c, FILE *out) {
+    const struct synth *s = c->priv;
+    if (!s) return;
+    double per = s->gen_frames ? (double)s->gen_ns / (double)s->gen_frames : 0.0;
+    fprintf(out, "[synth] %ux%u@%.1f motion=%u%% generated=%llu cost=%.1fus/frame (%.2f%% of a core)\n",
+            c->width, c->height, c->fps, c->motion_pct, (unsigned long long)s->gen_frames,
+            per / 1e3, per * c->fps / 1e9 * 100.0);
+}
+
+const struct cam_source cam_synth = {
+    "synthetic", synth_open, synth_close, synth_stream_on, synth_stream_off,
+    synth_wait, synth_dequeue, synth_queue, synth_report
+};
+
+int synth_parse(const char *str, unsigned *w, unsigned *h, double *fps) {
+    double rate = SYNTH_FPS_DEFAULT;
+    int n = sscanf(str, "%ux%u@%lf", w, h, &rate);
+    if (n < 2 || *w < 2 || (*w & 1) || *h < 1 || rate <= 0 || rate > SYNTH_FPS_MAX) return -1;
+    *fps = rate;
+    return 0;
+}
@@ -0,0 +1,34 @@
+/*
+ * Synthetic frame source: a cam_source that generates YUYV frames
+ * in-process, for runs and load tests without a camera (-g).
+ *
+ * The scene is a static gradient with a full-height textured band that
+ * moves every frame; motion_pct sets the band's share of the picture (0 is
+ * a still scene). Frames become due at the requested rate from
+ * stream-on, and the source behaves like a V4L2 driver: a due frame takes
+ * a free buffer and waits to be dequeued, and is dropped (a sequence gap)
+ * when every buffer is full or held by the caller. Timestamps are the due
+ * times, so dequeue latency means the same as for a real camera.
+ *
+ * Buffers start as copies of the background; a frame only restores the
+ * band drawn into that buffer last time and draws the new one, so the
+ * generator costs a fraction of a frame copy. Frames are drawn when
+ * dequeued; the cost is reported on its own [synth] line.
+ */
+
+#ifndef REALDATAFLOW_SYNTH_H
+#define REALDATAFLOW_SYNTH_H
+
+#include "camera.h"
+
+#define SYNTH_FPS_DEFAULT    30.0
+#define SYNTH_FPS_MAX        1000.0 // Keeps the frame period at 1 ms or more
+#define SYNTH_MOTION_DEFAULT 10     // Percent of the width
+
+/* Reads width, height, fps and motion_pct from the session */
+extern const struct cam_source cam_synth;
+
+/* "WxH@fps" (or "WxH", default fps; fps up to SYNTH_FPS_MAX) into w, h, fps; 0 or -1 */
+int synth_parse(const char *s, unsigned *w, unsigned *h, double *fps);
+
+#endif /* REALDATAFLOW_SYNTH_H */
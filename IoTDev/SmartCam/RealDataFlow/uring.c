@@ -0,0 +1,169 @@
+/*
+ * Minimal io_uring wrapper (see uring.h).
+ */
+
+#define _GNU_SOURCE /* syscall(), MSG_NOSIGNAL */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "uring.h"
+
+#if defined(__linux__) && defined(__has_include) && !defined(NO_IO_URING)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+int uring_init(struct uring *r, unsigned entries) {
+    memset(r, 0, sizeof(*r));
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    r->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) { int e = errno; r->fd = -1; return -e; }
+
+    r->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_len > r->sq_len) r->sq_len = r->cq_len;
+        r->cq_len = r->sq_len;
+    }
+    r->sq_ptr = mmap(NULL, r->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED) goto fail;
+    r->cq_ptr = r->sq_ptr;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        r->cq_ptr = mmap(NULL, r->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ptr == MAP_FAILED) goto fail;
+    }
+    r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) goto fail;
+
+    char *sq = r->sq_ptr, *cq = r->cq_ptr;
+    r->sq_head = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = cq + p.cq_off.cqes;
+    return 0;
+
+fail:;
+    int e = errno;
+    uring_free(r);
+    return -e;
+}
+
+void uring_free(struct uring *r) {
+    if (r->fd < 0) return;
+    if (r->sqes && r->sqes != MAP_FAILED) munmap(r->sqes, r->sqes_len);
+    if (r->cq_ptr && r->cq_ptr != MAP_FAILED && r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_len);
+    if (r->sq_ptr && r->sq_ptr != MAP_FAILED) munmap(r->sq_ptr, r->sq_len);
+    close(r->fd);
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+int uring_register(struct uring *r, const struct iovec *iov, unsigned n) {
+    if (syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_BUFFERS, iov, n) < 0) return -errno;
+    r->fixed = 1;
+    return 0;
+}
+
+void uring_unregister(struct uring *r) {
+    if (r->fixed) syscall(__NR_io_uring_register, r->fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+    r->fixed = 0;
+}
+
+/* Next free SQE, zeroed; NULL when the ring is full */
+static struct io_uring_sqe *get_sqe(struct uring *r) {
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *r->sq_tail + r->pending;
+    if (tail - head > *r->sq_mask) return NULL;
+    unsigned i = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = (struct io_uring_sqe *)r->sqes + i;
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[i] = i;
+    r->pending++;
+    return sqe;
+}
+
+int uring_write(struct uring *r, int fd, const void *addr, uint32_t len, uint64_t off, int buf, uint64_t user_data) {
+    struct io_uring_sqe *sqe = get_sqe(r);
+    if (!sqe) return -1;
+    sqe->opcode = buf >= 0 && r->fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->len = len;
+    sqe->off = off;
+    if (sqe->opcode == IORING_OP_WRITE_FIXED) sqe->buf_index = (uint16_t)buf;
+    sqe->user_data = user_data;
+    return 0;
+}
+
+int uring_send(struct uring *r, int sock, const void *addr, uint32_t len, int zerocopy, int buf, uint64_t user_data) {
+    struct io_uring_sqe *sqe = get_sqe(r);
+    if (!sqe) return -1;
+    sqe->opcode = zerocopy ? IORING_OP_SEND_ZC : IORING_OP_SEND;
+    sqe->fd = sock;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->len = len;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    if (zerocopy && buf >= 0 && r->fixed) {
+        sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+        sqe->buf_index = (uint16_t)buf;
+    }
+    sqe->user_data = user_data;
+    return 0;
+}
+
+int uring_submit(struct uring *r, unsigned wait) {
+    unsigned n = r->pending;
+    if (n) __atomic_store_n(r->sq_tail, *r->sq_tail + n, __ATOMIC_RELEASE);
+    r->pending = 0;
+    if (!n && !wait) return 0;
+    if (syscall(__NR_io_uring_enter, r->fd, n, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0) < 0)
+        return -errno;
+    return 0;
+}
+
+int uring_peek(struct uring *r, struct uring_cqe *c) {
+    unsigned head = *r->cq_head;
+    if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) return 0;
+    const struct io_uring_cqe *cqe = (const struct io_uring_cqe *)r->cqes + (head & *r->cq_mask);
+    c->user_data = cqe->user_data;
+    c->res = cqe->res;
+    c->flags = (cqe->flags & IORING_CQE_F_MORE ? URING_CQE_MORE : 0) |
+               (cqe->flags & IORING_CQE_F_NOTIF ? URING_CQE_NOTIF : 0);
+    __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+#else /* !HAVE_IO_URING */
+
+int  uring_init(struct uring *r, unsigned entries) { (void)entries; memset(r, 0, sizeof(*r)); r->fd = -1; return -ENOSYS; }
+void uring_free(struct uring *r) { (void)r; }
+int  uring_register(struct uring *r, const struct iovec *iov, unsigned n) { (void)r; (void)iov; (void)n; return -ENOSYS; }
+void uring_unregister(struct uring *r) { (void)r; }
+int  uring_write(struct uring *r, int fd, const void *addr, uint32_t len, uint64_t off, int buf, uint64_t user_data) {
+    (void)r; (void)fd; (void)addr; (void)len; (void)off; (void)buf; (void)user_data;
+    return -1;
+}
+int  uring_send(struct uring *r, int sock, const void *addr, uint32_t len, int zerocopy, int buf, uint64_t user_data) {
+    (void)r; (void)sock; (void)addr; (void)len; (void)zerocopy; (void)buf; (void)user_data;
+    return -1;
+}
+int  uring_submit(struct uring *r, unsigned wait) { (void)r; (void)wait; return -ENOSYS; }
+int  uring_peek(struct uring *r, struct uring_cqe *c) { (void)r; (void)c; return 0; }
+
+#endif
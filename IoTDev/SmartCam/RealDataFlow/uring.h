@@ -0,0 +1,54 @@
+/*
+ * Minimal io_uring wrapper for the capture pipeline (-U), on the raw
+ * syscalls so there is no liburing dependency.
+ *
+ * Only what the capture loop needs: file writes at an offset, socket sends
+ * (optionally zero-copy), buffer registration so both can name the camera
+ * buffers by index instead of having the kernel map them on every request,
+ * and completion reaping. Callers never see kernel structures.
+ *
+ * Built without io_uring (no <linux/io_uring.h>, or -DNO_IO_URING),
+ * uring_init() fails with -ENOSYS and callers keep the synchronous path.
+ */
+
+#ifndef REALDATAFLOW_URING_H
+#define REALDATAFLOW_URING_H
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+#define URING_CQE_MORE  0x1        // A zero-copy notification follows for this request
+#define URING_CQE_NOTIF 0x2        // Zero-copy notification: the kernel is done with the buffer
+
+struct uring_cqe { uint64_t user_data; int32_t res; uint32_t flags; };
+
+struct uring {
+    int fd;                        // -1 while closed
+    int fixed;                     // Buffers registered
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    void *sqes, *cqes;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_len, cq_len, sqes_len;
+    unsigned pending;              // SQEs prepared but not submitted yet
+};
+
+/* 0 or -errno */
+int  uring_init(struct uring *r, unsigned entries);
+void uring_free(struct uring *r);
+
+/* Register buffers for the *_fixed forms (index = position in iov); 0 or -errno */
+int  uring_register(struct uring *r, const struct iovec *iov, unsigned n);
+void uring_unregister(struct uring *r);
+
+/* Queue a request; buf is a registered buffer index or -1. 0, or -1 when the SQ is full */
+int  uring_write(struct uring *r, int fd, const void *addr, uint32_t len, uint64_t off, int buf, uint64_t user_data);
+int  uring_send(struct uring *r, int sock, const void *addr, uint32_t len, int zerocopy, int buf, uint64_t user_data);
+
+/* Submit what is queued and wait for at least `wait` completions; 0 or -errno (-EINTR on a signal) */
+int  uring_submit(struct uring *r, unsigned wait);
+
+/* Take the next completion; 1, or 0 if there is none */
+int  uring_peek(struct uring *r, struct uring_cqe *c);
+
+#endif /* REALDATAFLOW_URING_H */
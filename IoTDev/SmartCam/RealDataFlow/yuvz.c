@@ -0,0 +1,343 @@
+/*
+ * yuvz frame codec (see yuvz.h).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define YZ_X86 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define YZ_NEON 1
+#endif
+
+#include "yuvz.h"
+
+/* ------------------- Tables ------------------- */
+
+/* Width code -> bits per value, and payload bytes of one block */
+static const uint8_t code_bits[5] = { 0, 2, 3, 4, 8 };
+#define BL(c) ((c) == 0 ? 0 : (c) == 1 ? 4 : (c) == 2 ? 6 : (c) == 3 ? 8 : 16)
+
+/* Mode byte -> payload bytes of its group; 0xFF = not a valid mode */
+#define GL(m) ((m) < 125 ? BL((m) % 5) + BL((m) / 5 % 5) + BL((m) / 25) : 0xFF)
+/* Byte b -> eight bytes holding its bits (0 or 1), bit i in byte i */
+#define E8(b) (((b) >> 0 & 1ULL) | ((b) >> 1 & 1ULL) << 8 | ((b) >> 2 & 1ULL) << 16 | ((b) >> 3 & 1ULL) << 24 | \
+               ((b) >> 4 & 1ULL) << 32 | ((b) >> 5 & 1ULL) << 40 | ((b) >> 6 & 1ULL) << 48 | ((b) >> 7 & 1ULL) << 56)
+#define X4(M, b)  M(b), M((b) + 1), M((b) + 2), M((b) + 3)
+#define X16(M, b) X4(M, b), X4(M, (b) + 4), X4(M, (b) + 8), X4(M, (b) + 12)
+#define X64(M, b) X16(M, b), X16(M, (b) + 16), X16(M, (b) + 32), X16(M, (b) + 48)
+#define X256(M)   X64(M, 0), X64(M, 64), X64(M, 128), X64(M, 192)
+
+static const uint8_t group_len[256] = { X256(GL) };
+static const uint64_t expand8[256] = { X256(E8) };
+
+/* Zigzag: 0, -1, 1, -2, 2, .. <-> 0, 1, 2, 3, 4, .. on bytes */
+static inline uint8_t zz(uint8_t d) { return (uint8_t)((uint8_t)(d << 1) ^ (uint8_t)((int8_t)d >> 7)); }
+
+/* Width code for a block whose values OR (or max) to o */
+static inline unsigned width_code(unsigned o) {
+    return !o ? 0 : o < 4 ? 1 : o < 8 ? 2 : o < 16 ? 3 : 4;
+}
+
+/* Differences of one coded block, eight bytes at a time (little-endian
+   hosts): planes back to zigzag values, then zigzag undone per byte */
+static inline void unpack(uint64_t d[2], const uint8_t *ip, unsigned code) {
+    if (code == 4) {
+        memcpy(d, ip, YZ_BLOCK);
+        return;
+    }
+    uint64_t lo = 0, hi = 0;
+    for (unsigned k = 0; k < code_bits[code]; k++) {
+        lo |= expand8[ip[2 * k]] << k;
+        hi |= expand8[ip[2 * k + 1]] << k;
+    }
+    const uint64_t ones = 0x0101010101010101ULL;
+    d[0] = (lo >> 1 & 0x7F7F7F7F7F7F7F7FULL) ^ (lo & ones) * 0xFF;
+    d[1] = (hi >> 1 & 0x7F7F7F7F7F7F7F7FULL) ^ (hi & ones) * 0xFF;
+}
+
+/* ------------------- Scalar kernel ------------------- */
+
+static uint8_t *enc_group_scalar(uint8_t *op, const uint8_t *cur, uint8_t *prev) {
+    uint8_t *mode = op++;
+    unsigned m = 0, scale = 1;
+    for (unsigned j = 0; j < 3; j++, cur += YZ_BLOCK, prev += YZ_BLOCK, scale *= 5) {
+        uint8_t d[YZ_BLOCK], z[YZ_BLOCK];
+        unsigned o = 0;
+        for (unsigned i = 0; i < YZ_BLOCK; i++) {
+            d[i] = (uint8_t)(cur[i] - prev[i]);
+            z[i] = zz(d[i]);
+            o |= z[i];
+        }
+        memcpy(prev, cur, YZ_BLOCK);
+        unsigned code = width_code(o);
+        m += code * scale;
+        if (code == 4) {
+            memcpy(op, d, YZ_BLOCK);
+            op += YZ_BLOCK;
+            continue;
+        }
+        for (unsigned k = 0; k < code_bits[code]; k++) {
+            unsigned plane = 0;
+            for (unsigned i = 0; i < YZ_BLOCK; i++) plane |= (unsigned)(z[i] >> k & 1) << i;
+            *op++ = (uint8_t)plane;
+            *op++ = (uint8_t)(plane >> 8);
+        }
+    }
+    *mode = (uint8_t)m;
+    return op;
+}
+
+static void dec_group_scalar(uint8_t *f, const uint8_t *ip, unsigned mode) {
+    for (unsigned j = 0; j < 3; j++, f += YZ_BLOCK, mode /= 5) {
+        unsigned code = mode % 5;
+        if (!code) continue;
+        uint64_t d[2];
+        unpack(d, ip, code);
+        ip += BL(code);
+        const uint8_t *b = (const uint8_t *)d;
+        for (unsigned i = 0; i < YZ_BLOCK; i++) f[i] = (uint8_t)(f[i] + b[i]);
+    }
+}
+
+static const struct yz_kernel k_scalar = { "scalar", enc_group_scalar, dec_group_scalar };
+
+/* ------------------- SSE2 kernel ------------------- */
+
+#ifdef YZ_X86
+static uint8_t *enc_group_sse2(uint8_t *op, const uint8_t *cur, uint8_t *prev) {
+    uint8_t *mode = op++;
+    unsigned m = 0, scale = 1;
+    for (unsigned j = 0; j < 3; j++, scale *= 5) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(cur + j * YZ_BLOCK));
+        __m128i y = _mm_loadu_si128((const __m128i *)(prev + j * YZ_BLOCK));
+        _mm_storeu_si128((__m128i *)(prev + j * YZ_BLOCK), x);
+        __m128i d = _mm_sub_epi8(x, y);
+        __m128i z = _mm_xor_si128(_mm_add_epi8(d, d), _mm_cmpgt_epi8(_mm_setzero_si128(), d));
+
+        /* Largest value decides the width */
+        __m128i t = _mm_max_epu8(z, _mm_srli_si128(z, 8));
+        t = _mm_max_epu8(t, _mm_srli_si128(t, 4));
+        t = _mm_max_epu8(t, _mm_srli_si128(t, 2));
+        t = _mm_max_epu8(t, _mm_srli_si128(t, 1));
+        unsigned code = width_code((unsigned)_mm_cvtsi128_si32(t) & 0xFF);
+        m += code * scale;
+        if (code == 4) {
+            _mm_storeu_si128((__m128i *)op, d);
+            op += YZ_BLOCK;
+            continue;
+        }
+        /* Bit k of every byte -> bit 7 -> movemask; shifting the 16-bit
+           lanes right only pulls junk into bit 7, which the next << 7 drops */
+        for (unsigned k = 0; k < code_bits[code]; k++, z = _mm_srli_epi16(z, 1)) {
+            unsigned plane = (unsigned)_mm_movemask_epi8(_mm_slli_epi16(z, 7));
+            *op++ = (uint8_t)plane;
+            *op++ = (uint8_t)(plane >> 8);
+        }
+    }
+    *mode = (uint8_t)m;
+    return op;
+}
+
+static void dec_group_sse2(uint8_t *f, const uint8_t *ip, unsigned mode) {
+    for (unsigned j = 0; j < 3; j++, f += YZ_BLOCK, mode /= 5) {
+        unsigned code = mode % 5;
+        if (!code) continue;
+        uint64_t d[2];
+        unpack(d, ip, code);
+        ip += BL(code);
+        __m128i x = _mm_loadu_si128((const __m128i *)f);
+        _mm_storeu_si128((__m128i *)f, _mm_add_epi8(x, _mm_loadu_si128((const __m128i *)d)));
+    }
+}
+
+/* 16-byte blocks leave nothing for 32-byte AVX2 vectors to add over this */
+static const struct yz_kernel k_sse2 = { "sse2", enc_group_sse2, dec_group_sse2 };
+#endif /* YZ_X86 */
+
+/* ------------------- NEON kernel ------------------- */
+
+#ifdef YZ_NEON
+static uint8_t *enc_group_neon(uint8_t *op, const uint8_t *cur, uint8_t *prev) {
+    static const uint8_t lane_bit[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    const uint8x16_t bits = vld1q_u8(lane_bit);
+    uint8_t *mode = op++;
+    unsigned m = 0, scale = 1;
+    for (unsigned j = 0; j < 3; j++, scale *= 5) {
+        uint8x16_t x = vld1q_u8(cur + j * YZ_BLOCK), y = vld1q_u8(prev + j * YZ_BLOCK);
+        vst1q_u8(prev + j * YZ_BLOCK, x);
+        uint8x16_t d = vsubq_u8(x, y);
+        uint8x16_t z = veorq_u8(vshlq_n_u8(d, 1), vreinterpretq_u8_s8(vshrq_n_s8(vreinterpretq_s8_u8(d), 7)));
+
+        /* Largest value decides the width (pairwise max works on Armv7 too) */
+        uint8x8_t t = vmax_u8(vget_low_u8(z), vget_high_u8(z));
+        t = vpmax_u8(t, t);
+        t = vpmax_u8(t, t);
+        t = vpmax_u8(t, t);
+        unsigned code = width_code(vget_lane_u8(t, 0));
+        m += code * scale;
+        if (code == 4) {
+            vst1q_u8(op, d);
+            op += YZ_BLOCK;
+            continue;
+        }
+        /* Bit k of every byte -> lane weight 1 << (i % 8) -> pairwise sums */
+        for (unsigned k = 0; k < code_bits[code]; k++, z = vshrq_n_u8(z, 1)) {
+            uint8x16_t b = vandq_u8(vtstq_u8(z, vdupq_n_u8(1)), bits);
+            uint8x8_t s = vpadd_u8(vget_low_u8(b), vget_high_u8(b));
+            s = vpadd_u8(s, s);
+            s = vpadd_u8(s, s);
+            *op++ = vget_lane_u8(s, 0);
+            *op++ = vget_lane_u8(s, 1);
+        }
+    }
+    *mode = (uint8_t)m;
+    return op;
+}
+
+static void dec_group_neon(uint8_t *f, const uint8_t *ip, unsigned mode) {
+    for (unsigned j = 0; j < 3; j++, f += YZ_BLOCK, mode /= 5) {
+        unsigned code = mode % 5;
+        if (!code) continue;
+        uint64_t d[2];
+        unpack(d, ip, code);
+        ip += BL(code);
+        vst1q_u8(f, vaddq_u8(vld1q_u8(f), vld1q_u8((const uint8_t *)d)));
+    }
+}
+
+static const struct yz_kernel k_neon = { "neon", enc_group_neon, dec_group_neon };
+#endif /* YZ_NEON */
+
+const struct yz_kernel *yz_kernel_get(const char *name) {
+    if (name && strcmp(name, "scalar") == 0) return &k_scalar;
+#ifdef YZ_X86
+    if (!name || strcmp(name, "sse2") == 0) return &k_sse2;
+#endif
+#ifdef YZ_NEON
+    if (!name || strcmp(name, "neon") == 0) return &k_neon;
+#endif
+    return name ? NULL : &k_scalar;
+}
+
+/* ------------------- Codec ------------------- */
+
+size_t yz_bound(size_t n) {
+    return YZ_HDR_LEN + n + n / YZ_GROUP + 16; // Mode byte per group, nothing else grows
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+int yz_enc_init(struct yz_enc *e, const struct yz_kernel *k, size_t frame_len, unsigned key_interval) {
+    memset(e, 0, sizeof(*e));
+    e->prev = malloc(frame_len);
+    if (!e->prev) return -1;
+    e->k = k;
+    e->len = frame_len;
+    e->key_interval = key_interval;
+    return 0;
+}
+
+void yz_enc_free(struct yz_enc *e) {
+    free(e->prev);
+    e->prev = NULL;
+}
+
+void yz_enc_reset(struct yz_enc *e) {
+    e->count = 0;
+}
+
+size_t yz_encode(struct yz_enc *e, const uint8_t *cur, uint8_t *out) {
+    const struct yz_kernel *k = e->k;
+    size_t n = e->len, whole = n - n % YZ_GROUP;
+    int key = e->count == 0 || (e->key_interval && e->count % e->key_interval == 0);
+    if (key) memset(e->prev, 0, n);
+    e->count++;
+
+    uint8_t *op = out + YZ_HDR_LEN, *zrun = NULL;
+    for (size_t i = 0; i < whole; i += YZ_GROUP) {
+        uint8_t *g = op;
+        op = k->enc_group(op, cur + i, e->prev + i); // Also moves the reference on
+        if (*g) {
+            zrun = NULL;
+        } else if (zrun && *zrun < 255) {
+            (*zrun)++;                                // One more unchanged group
+            op = g;
+        } else {
+            *op++ = 0;                                // Start a run
+            zrun = op - 1;
+        }
+    }
+    for (size_t i = whole; i < n; i++) *op++ = (uint8_t)(cur[i] - e->prev[i]);
+    memcpy(e->prev + whole, cur + whole, n - whole);
+
+    out[0] = 'Y';
+    out[1] = 'Z';
+    out[2] = YZ_VERSION;
+    out[3] = key ? YZ_KEY : 0;
+    put_u32(out + 4, (uint32_t)n);
+    put_u32(out + 8, (uint32_t)(op - out - YZ_HDR_LEN));
+    return (size_t)(op - out);
+}
+
+int yz_dec_init(struct yz_dec *d, const struct yz_kernel *k, size_t frame_len) {
+    memset(d, 0, sizeof(*d));
+    d->frame = calloc(1, frame_len);
+    if (!d->frame) return -1;
+    d->k = k;
+    d->len = frame_len;
+    return 0;
+}
+
+void yz_dec_free(struct yz_dec *d) {
+    free(d->frame);
+    d->frame = NULL;
+}
+
+int yz_parse_header(const uint8_t *hdr, uint32_t *raw_len, uint32_t *payload_len, int *key) {
+    if (hdr[0] != 'Y' || hdr[1] != 'Z' || hdr[2] != YZ_VERSION) return -1;
+    *key = hdr[3] & YZ_KEY;
+    *raw_len = get_u32(hdr + 4);
+    *payload_len = get_u32(hdr + 8);
+    return 0;
+}
+
+int yz_decode(struct yz_dec *d, const uint8_t *in, size_t len) {
+    uint32_t raw, plen;
+    int key;
+    if (len < YZ_HDR_LEN || yz_parse_header(in, &raw, &plen, &key) != 0) return -1;
+    if (raw != d->len || plen > len - YZ_HDR_LEN) return -1;
+    if (key) memset(d->frame, 0, d->len);
+
+    const struct yz_kernel *k = d->k;
+    const uint8_t *ip = in + YZ_HDR_LEN, *end = ip + plen;
+    uint8_t *f = d->frame;
+    size_t ngroups = d->len / YZ_GROUP, tail = d->len % YZ_GROUP;
+    for (size_t g = 0; g < ngroups;) {
+        if (ip >= end) return -1;
+        unsigned mode = *ip++;
+        if (!mode) {                         // Unchanged groups are already there
+            if (ip >= end || (size_t)*ip + 1 > ngroups - g) return -1;
+            g += (size_t)*ip++ + 1;
+            continue;
+        }
+        if (group_len[mode] > (size_t)(end - ip)) return -1; // Also rejects modes >= 125
+        k->dec_group(f + g * YZ_GROUP, ip, mode); // In place: the frame buffer is the reference
+        ip += group_len[mode];
+        g++;
+    }
+    if ((size_t)(end - ip) != tail) return -1;
+    f += ngroups * YZ_GROUP;
+    for (size_t i = 0; i < tail; i++) f[i] = (uint8_t)(f[i] + ip[i]);
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * yuvz: fast lossless compression for raw YUYV frames.
+ *
+ * Each frame is coded against the previous one as byte-wise differences
+ * (cur - prev, mod 256). Sensor noise leaves most differences within a few
+ * steps of 0, so they are zigzag-mapped (0, -1, 1, -2, .. -> 0, 1, 2, 3, ..)
+ * and each 16-byte block is stored at the narrowest width that holds its
+ * largest value: 0, 2, 3 or 4 bits as bit planes (two bytes per plane, bit
+ * k of every value, value i in bit i), or 8 = the 16 plain differences.
+ *
+ * Three blocks (48 bytes) form a group: a mode byte c0 + 5 c1 + 25 c2 with
+ * their width codes (0..4 for 0, 2, 3, 4, 8 bits), then their planes. A mode
+ * byte of 0 is followed by a count of further all-zero groups (0-255), so a
+ * still scene costs almost nothing. Bytes past the last whole group are
+ * stored as plain differences. A key frame is coded against an all-zero
+ * previous frame, so it decodes on its own.
+ *
+ * The difference/zigzag/plane loop runs in SSE2 or NEON kernels, with a
+ * scalar fallback. The decoder rebuilds blocks through constant tables and
+ * works in place on the previous frame: unchanged groups cost nothing.
+ *
+ * Frame container (all little-endian):
+ *   "YZ" | version (2) | flags (YZ_KEY) | raw length u32 | payload length u32 | payload
+ */
+
+#ifndef REALDATAFLOW_YUVZ_H
+#define REALDATAFLOW_YUVZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define YZ_VERSION  2
+#define YZ_KEY      0x01
+#define YZ_HDR_LEN  12
+#define YZ_BLOCK    16         // Bytes per packing block
+#define YZ_GROUP    48         // Bytes per mode byte (three blocks)
+
+/* Kernel set: the SIMD part of the codec */
+struct yz_kernel {
+    const char *name;
+    /* Code one group of cur against prev: mode byte then block payloads at op.
+       prev is updated to cur. Returns the end of what was written. */
+    uint8_t *(*enc_group)(uint8_t *op, const uint8_t *cur, uint8_t *prev);
+    /* Add one coded group (mode != 0, payload at ip) onto the YZ_GROUP bytes at f */
+    void (*dec_group)(uint8_t *f, const uint8_t *ip, unsigned mode);
+};
+
+/* Best kernel for this CPU, or the one named ("scalar", "sse2", "neon"); NULL if unavailable */
+const struct yz_kernel *yz_kernel_get(const char *name);
+
+/* Worst-case encoded size of an n-byte frame, header included */
+size_t yz_bound(size_t n);
+
+struct yz_enc {
+    const struct yz_kernel *k;
+    size_t len;                // Frame size this encoder was set up for
+    uint8_t *prev;             // Last frame coded (what the decoder will hold)
+    unsigned key_interval;     // Key frame every N frames (0 = first frame only)
+    unsigned count;
+};
+
+/* 0 or -1 (allocation failure) */
+int  yz_enc_init(struct yz_enc *e, const struct yz_kernel *k, size_t frame_len, unsigned key_interval);
+void yz_enc_free(struct yz_enc *e);
+
+/* Force the next frame to be a key frame (new file, dropped frames upstream) */
+void yz_enc_reset(struct yz_enc *e);
+
+/* Encode one frame (frame_len bytes) into out (yz_bound(frame_len) bytes); returns bytes written */
+size_t yz_encode(struct yz_enc *e, const uint8_t *cur, uint8_t *out);
+
+struct yz_dec {
+    const struct yz_kernel *k;
+    size_t len;
+    uint8_t *frame;            // Current reconstructed frame
+};
+
+int  yz_dec_init(struct yz_dec *d, const struct yz_kernel *k, size_t frame_len);
+void yz_dec_free(struct yz_dec *d);
+
+/* Parse a frame header; payload length and raw length out. 0 or -1 (not a yuvz frame) */
+int yz_parse_header(const uint8_t *hdr, uint32_t *raw_len, uint32_t *payload_len, int *key);
+
+/* Decode one frame (header included, `len` bytes); d->frame holds the result. 0 or -1 (corrupt) */
+int yz_decode(struct yz_dec *d, const uint8_t *in, size_t len);
+
+#endif /* REALDATAFLOW_YUVZ_H */
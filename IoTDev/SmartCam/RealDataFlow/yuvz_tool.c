@@ -0,0 +1,242 @@
+/*
+ * yuvz: compress, decompress and benchmark raw YUYV video (see yuvz.h)
+ *
+ * Build x86:
+ *   gcc -O2 -std=c11 -o yuvz yuvz_tool.c yuvz.c
+ * Build Arm64:
+ *   aarch64-linux-gnu-gcc -O2 -std=c11 -o yuvz yuvz_tool.c yuvz.c
+ *
+ * Usage:
+ *   ./yuvz c [-W w] [-H h] [-K n] <in.raw> <out.yz>     Compress
+ *   ./yuvz d <in.yz> <out.raw>                           Decompress
+ *   ./yuvz bench [-W w] [-H h] [-n frames] [-m pct] [-N pct] [-k kernel] [in.raw]
+ *
+ * Options:
+ *   -W/-H <px>   Frame size (default: 640x480)
+ *   -K <n>       Key frame every n frames (default: 0 = first frame only)
+ *   -n <frames>  Synthetic frames to benchmark (default: 300)
+ *   -m <pct>     Synthetic: share of the picture in motion (default: 10)
+ *   -N <pct>     Synthetic: bytes with +-1 sensor noise per frame (default: 2)
+ *   -k <kernel>  scalar, sse2 or neon (default: every one this CPU has)
+ *
+ * The benchmark codes every frame, decodes it again, checks the round trip
+ * and reports encode/decode MB/s (of raw YUYV) and the compression ratio.
+ * Without an input file it uses a synthetic scene: a static gradient with
+ * sensor noise and a moving textured block.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* clock_gettime() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "yuvz.h"
+
+static uint64_t mono_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+static uint64_t rng_next(void) { // xorshift64*: plenty for test patterns
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+/* Synthetic YUYV frame i: gradient + noise + a moving block covering motion_pct of the area */
+static void synth_frame(uint8_t *f, unsigned w, unsigned h, unsigned i, unsigned motion_pct, unsigned noise_pct) {
+    for (unsigned y = 0; y < h; y++) {
+        uint8_t *row = f + (size_t)y * w * 2;
+        for (unsigned x = 0; x < w; x += 2) {
+            row[x * 2 + 0] = (uint8_t)(16 + (x + y) * 200 / (w + h)); // Y0
+            row[x * 2 + 1] = 128;                                      // U
+            row[x * 2 + 2] = (uint8_t)(16 + (x + 1 + y) * 200 / (w + h)); // Y1
+            row[x * 2 + 3] = (uint8_t)(96 + y * 64 / h);              // V
+        }
+    }
+    size_t n = (size_t)w * h * 2;
+    for (size_t k = 0, noisy = n * noise_pct / 100; k < noisy; k++) {
+        uint64_t r = rng_next();
+        f[r % n] += (r >> 40) & 1 ? 1 : 255;
+    }
+    if (motion_pct) {
+        unsigned bw = w * motion_pct / 100, bh = h;                    // Full-height band
+        unsigned bx = (i * 8) % (w - bw + 1) & ~1u;
+        for (unsigned y = 0; y < bh; y++)
+            for (unsigned x = bx; x < bx + bw; x++)
+                f[((size_t)y * w + x) * 2] = (uint8_t)((x ^ y) * 3 + i);
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s c [-W w] [-H h] [-K n] <in.raw> <out.yz>\n"
+            "       %s d <in.yz> <out.raw>\n"
+            "       %s bench [-W w] [-H h] [-n frames] [-m pct] [-N pct] [-k kernel] [in.raw]\n",
+            prog, prog, prog);
+}
+
+static int do_compress(const char *in, const char *out, size_t len, unsigned key) {
+    FILE *fi = fopen(in, "rb"), *fo = fopen(out, "wb");
+    if (!fi || !fo) { perror(!fi ? in : out); return 1; }
+    struct yz_enc e;
+    uint8_t *frame = malloc(len), *buf = malloc(yz_bound(len));
+    if (!frame || !buf || yz_enc_init(&e, yz_kernel_get(NULL), len, key) != 0) return 1;
+
+    uint64_t raw = 0, packed = 0;
+    while (fread(frame, 1, len, fi) == len) {
+        size_t n = yz_encode(&e, frame, buf);
+        fwrite(buf, 1, n, fo);
+        raw += len;
+        packed += n;
+    }
+    fprintf(stderr, "%llu -> %llu bytes (ratio %.2f, kernel %s)\n", (unsigned long long)raw,
+            (unsigned long long)packed, packed ? (double)raw / (double)packed : 0.0, e.k->name);
+    yz_enc_free(&e);
+    free(frame);
+    free(buf);
+    fclose(fi);
+    return fclose(fo) != 0;
+}
+
+static int do_decompress(const char *in, const char *out) {
+    FILE *fi = fopen(in, "rb"), *fo = fopen(out, "wb");
+    if (!fi || !fo) { perror(!fi ? in : out); return 1; }
+    struct yz_dec d = { 0 };
+    uint8_t *buf = NULL;
+    size_t cap = 0;
+    unsigned frames = 0;
+    uint8_t hdr[YZ_HDR_LEN];
+
+    while (fread(hdr, 1, YZ_HDR_LEN, fi) == YZ_HDR_LEN) {
+        uint32_t raw, plen;
+        int key;
+        if (yz_parse_header(hdr, &raw, &plen, &key) != 0) { fprintf(stderr, "frame %u: bad header\n", frames); return 1; }
+        if (!d.frame || d.len != raw) {
+            if (!key) { fprintf(stderr, "frame %u: size change without a key frame\n", frames); return 1; }
+            yz_dec_free(&d);
+            if (yz_dec_init(&d, yz_kernel_get(NULL), raw) != 0) return 1;
+        }
+        if (YZ_HDR_LEN + (size_t)plen > cap) {
+            cap = YZ_HDR_LEN + (size_t)plen;
+            buf = realloc(buf, cap);
+            if (!buf) return 1;
+        }
+        memcpy(buf, hdr, YZ_HDR_LEN);
+        if (fread(buf + YZ_HDR_LEN, 1, plen, fi) != plen || yz_decode(&d, buf, YZ_HDR_LEN + plen) != 0) {
+            fprintf(stderr, "frame %u: truncated or corrupt\n", frames);
+            return 1;
+        }
+        fwrite(d.frame, 1, d.len, fo);
+        frames++;
+    }
+    fprintf(stderr, "%u frames\n", frames);
+    yz_dec_free(&d);
+    free(buf);
+    fclose(fi);
+    return fclose(fo) != 0;
+}
+
+static int bench_kernel(const struct yz_kernel *k, uint8_t *frames, unsigned nframes, size_t len, unsigned key) {
+    struct yz_enc e;
+    struct yz_dec d;
+    size_t bound = yz_bound(len);
+    uint8_t *packed = malloc(bound * nframes);
+    size_t *plen = malloc(sizeof(*plen) * nframes);
+    if (!packed || !plen || yz_enc_init(&e, k, len, key) != 0 || yz_dec_init(&d, k, len) != 0) return 1;
+
+    uint64_t total = 0, t = mono_ns();
+    for (unsigned i = 0; i < nframes; i++) {
+        plen[i] = yz_encode(&e, frames + (size_t)i * len, packed + (size_t)i * bound);
+        total += plen[i];
+    }
+    uint64_t enc_ns = mono_ns() - t;
+
+    int bad = 0;
+    t = mono_ns();
+    for (unsigned i = 0; i < nframes; i++)
+        if (yz_decode(&d, packed + (size_t)i * bound, plen[i]) != 0) bad = 1;
+    uint64_t dec_ns = mono_ns() - t;
+
+    /* Verify separately so the check is not in the timing */
+    yz_dec_free(&d);
+    yz_dec_init(&d, k, len);
+    for (unsigned i = 0; i < nframes && !bad; i++)
+        if (yz_decode(&d, packed + (size_t)i * bound, plen[i]) != 0 ||
+            memcmp(d.frame, frames + (size_t)i * len, len) != 0)
+            bad = 1;
+
+    double mb = (double)len * nframes / 1e6;
+    printf("%-7s encode %8.1f MB/s  decode %8.1f MB/s  ratio %6.2f  (%.1f KB/frame)%s\n",
+           k->name, mb / ((double)enc_ns / 1e9), mb / ((double)dec_ns / 1e9),
+           (double)len * nframes / (double)total, (double)total / nframes / 1024.0,
+           bad ? "  ROUND TRIP FAILED" : "");
+    yz_enc_free(&e);
+    yz_dec_free(&d);
+    free(packed);
+    free(plen);
+    return bad;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) { usage(argv[0]); return 1; }
+    const char *cmd = argv[1];
+    unsigned w = 640, h = 480, key = 0, nframes = 300, motion = 10, noise = 2;
+    const char *kname = NULL;
+    int opt;
+    optind = 2;
+    while ((opt = getopt(argc, argv, "W:H:K:n:m:N:k:h")) != -1) {
+        switch (opt) {
+        case 'W': w = (unsigned)atoi(optarg) & ~1u; break;
+        case 'H': h = (unsigned)atoi(optarg); break;
+        case 'K': key = (unsigned)atoi(optarg); break;
+        case 'n': nframes = (unsigned)atoi(optarg); break;
+        case 'm': motion = (unsigned)atoi(optarg); break;
+        case 'N': noise = (unsigned)atoi(optarg); break;
+        case 'k': kname = optarg; break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (w < 2 || h < 1 || motion > 100 || noise > 100) { usage(argv[0]); return 1; }
+    size_t len = (size_t)w * h * 2;
+
+    if (strcmp(cmd, "c") == 0 && argc - optind == 2) return do_compress(argv[optind], argv[optind + 1], len, key);
+    if (strcmp(cmd, "d") == 0 && argc - optind == 2) return do_decompress(argv[optind], argv[optind + 1]);
+    if (strcmp(cmd, "bench") != 0) { usage(argv[0]); return 1; }
+
+    uint8_t *frames;
+    if (optind < argc) {
+        FILE *f = fopen(argv[optind], "rb");
+        if (!f) { perror(argv[optind]); return 1; }
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        rewind(f);
+        nframes = (unsigned)(size / (long)len);
+        if (nframes == 0) { fprintf(stderr, "%s: shorter than one %ux%u frame\n", argv[optind], w, h); return 1; }
+        frames = malloc(len * nframes);
+        if (!frames || fread(frames, len, nframes, f) != nframes) { perror(argv[optind]); return 1; }
+        fclose(f);
+    } else {
+        frames = malloc(len * nframes);
+        if (!frames) return 1;
+        for (unsigned i = 0; i < nframes; i++) synth_frame(frames + (size_t)i * len, w, h, i, motion, noise);
+    }
+    printf("%u frames of %ux%u YUYV (%.1f MB)\n", nframes, w, h, (double)len * nframes / 1e6);
+
+    int rc = 0;
+    static const char *const all[] = { "scalar", "sse2", "neon" };
+    for (unsigned i = 0; i < sizeof(all) / sizeof(all[0]); i++) {
+        if (kname && strcmp(kname, all[i]) != 0) continue;
+        const struct yz_kernel *k = yz_kernel_get(all[i]);
+        if (k) rc |= bench_kernel(k, frames, nframes, len, key);
+        else if (kname) { fprintf(stderr, "Kernel %s not available on this CPU\n", kname); rc = 1; }
+    }
+    free(frames);
+    return rc;
+}
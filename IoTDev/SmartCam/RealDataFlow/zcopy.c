@@ -0,0 +1,133 @@
+/*
+ * Zero-copy export helpers (see zcopy.h).
+ */
+
+#define _GNU_SOURCE /* vmsplice(), splice(), F_SETPIPE_SZ, MSG_ZEROCOPY */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+
+#include "zcopy.h"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+void copy_stats_report(const struct copy_stats *s, FILE *out) {
+    double n = s->frames ? (double)s->frames : 1.0;
+    fprintf(out, "[copies] frames=%llu frame=%.0fB copied/frame: user=%.0fB (%.2fx) kernel=%.0fB (%.2fx)\n",
+            (unsigned long long)s->frames, (double)s->payload / n,
+            (double)s->user / n, s->payload ? (double)s->user / (double)s->payload : 0.0,
+            (double)s->kernel / n, s->payload ? (double)s->kernel / (double)s->payload : 0.0);
+}
+
+int zc_pipe_open(struct zc_pipe *p, size_t want) {
+    if (pipe(p->fd) != 0) { perror("pipe"); return -1; }
+    int size = fcntl(p->fd[1], F_SETPIPE_SZ, (int)want);
+    if (size < 0) size = fcntl(p->fd[1], F_GETPIPE_SZ); // Over pipe-max-size: work in pieces
+    p->size = size > 0 ? (size_t)size : 65536;
+    return 0;
+}
+
+void zc_pipe_close(struct zc_pipe *p) {
+    close(p->fd[0]);
+    close(p->fd[1]);
+}
+
+/* Empty `n` bytes out of the pipe into `out` */
+static int drain_pipe(struct zc_pipe *p, size_t n, int out) {
+    while (n > 0) {
+        ssize_t m = splice(p->fd[0], NULL, out, NULL, n, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (m < 0 && errno == EINTR) continue;
+        if (m <= 0) return -1;
+        n -= (size_t)m;
+    }
+    return 0;
+}
+
+int zc_write(struct zc_pipe *p, const void *addr, size_t len, int out) {
+    const char *ptr = addr;
+    while (len > 0) {
+        struct iovec iov = { (void *)ptr, len < p->size ? len : p->size };
+        ssize_t n = vmsplice(p->fd[1], &iov, 1, 0); // Pages by reference, no copy
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        if (drain_pipe(p, (size_t)n, out) != 0) return -1; // Done with the pages when this returns
+        ptr += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+ssize_t zc_splice(struct zc_pipe *p, int in, size_t len, int out) {
+    if (len > p->size) len = p->size;
+    ssize_t n;
+    do n = splice(in, NULL, p->fd[1], NULL, len, SPLICE_F_MOVE);
+    while (n < 0 && errno == EINTR);
+    if (n <= 0) return n;
+    return drain_pipe(p, (size_t)n, out) == 0 ? n : -1;
+}
+
+int zc_sock_init(struct zc_sock *z, int fd) {
+    memset(z, 0, sizeof(*z));
+    z->fd = fd;
+    int one = 1;
+    return setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+}
+
+int zc_send(struct zc_sock *z, const void *p, size_t len, uint32_t *last_id) {
+    const char *ptr = p;
+    while (len > 0) {
+        ssize_t n = send(z->fd, ptr, len, MSG_ZEROCOPY | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == ENOBUFS) { int c; zc_reap(z, 1, &c); continue; } // Pinned-page budget: let completions free it
+            return -1;
+        }
+        *last_id = z->next_id++;
+        ptr += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int zc_reap(struct zc_sock *z, int timeout_ms, int *copied) {
+    *copied = 0;
+    struct pollfd pfd = { z->fd, 0, 0 }; // Error-queue data shows up as POLLERR
+    if (poll(&pfd, 1, timeout_ms) <= 0) return 0;
+
+    int got = 0;
+    for (;;) {
+        char control[128];
+        struct msghdr msg = {0};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(z->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return got ? got : -1;
+        }
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                  (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+                continue;
+            struct sock_extended_err *serr = (struct sock_extended_err *)CMSG_DATA(cm);
+            if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+            /* [ee_info, ee_data] completed; TCP reports ranges in send order */
+            if ((int32_t)(serr->ee_data + 1 - z->done) > 0) z->done = serr->ee_data + 1;
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) { *copied = 1; z->copied_reports++; }
+            got++;
+        }
+    }
+    return got;
+}
@@ -0,0 +1,70 @@
+/*
+ * Zero-copy export of V4L2 frames (-Z).
+ *
+ * To a file: vmsplice() hands the pages of the mmap'd V4L2 buffer to a
+ * pipe by reference and splice() moves them into the page cache, so the
+ * only copy is the one the kernel makes into the file. Once splice()
+ * returns the buffer can be requeued.
+ *
+ * File to socket: splice() through the same pipe; page-cache pages go to
+ * TCP by reference.
+ *
+ * To a socket straight from the V4L2 buffer: send(MSG_ZEROCOPY). The
+ * kernel pins the pages until TCP is done with them and reports each
+ * completed send call on the socket error queue; the buffer must not be
+ * requeued before that. On paths without scatter-gather (loopback, some
+ * drivers) the kernel copies instead and says so, which is counted.
+ *
+ * VIDIOC_EXPBUF DMABUF descriptors are not used: a dmabuf fd cannot be
+ * spliced or sendfile'd into a file or TCP socket.
+ */
+
+#ifndef REALDATAFLOW_ZCOPY_H
+#define REALDATAFLOW_ZCOPY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/* Bytes that crossed the user/kernel boundary by copy, per capture */
+struct copy_stats {
+    uint64_t frames;
+    uint64_t payload;          // Frame bytes captured
+    uint64_t user;             // Copied by us or by read()/write()/send()
+    uint64_t kernel;           // Copied inside the kernel (page cache, zerocopy fallback)
+};
+
+void copy_stats_report(const struct copy_stats *s, FILE *out);
+
+struct zc_pipe { int fd[2]; size_t size; };
+
+/* Pipe sized for `want` bytes (capped by fs.pipe-max-size); 0 or -1 */
+int  zc_pipe_open(struct zc_pipe *p, size_t want);
+void zc_pipe_close(struct zc_pipe *p);
+
+/* Move `len` bytes of user memory to `out` via vmsplice+splice; 0 or -1 */
+int zc_write(struct zc_pipe *p, const void *addr, size_t len, int out);
+
+/* Move up to `len` bytes from `in` (current offset) to `out`; bytes moved or -1 */
+ssize_t zc_splice(struct zc_pipe *p, int in, size_t len, int out);
+
+/* MSG_ZEROCOPY socket state: every successful send call gets the next id */
+struct zc_sock {
+    int fd;
+    uint32_t next_id;          // Id of the next send call
+    uint32_t done;             // All ids below this have completed
+    uint64_t copied_reports;   // Completions the kernel served by copying
+};
+
+/* SO_ZEROCOPY on a connected socket; 0 or -1 (kernel or socket without support) */
+int zc_sock_init(struct zc_sock *z, int fd);
+
+/* Send all of [p, p+len); *last_id receives the id of the final send call; 0 or -1 */
+int zc_send(struct zc_sock *z, const void *p, size_t len, uint32_t *last_id);
+
+/* Collect completions; waits up to timeout_ms for one. Returns the number of
+ * completions read, -1 on error; *copied is set if any was served by copying */
+int zc_reap(struct zc_sock *z, int timeout_ms, int *copied);
+
+#endif /* REALDATAFLOW_ZCOPY_H */
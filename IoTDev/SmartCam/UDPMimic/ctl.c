@@ -0,0 +1,143 @@
+/*
+ * Shared-memory control and telemetry block (see ctl.h).
+ */
+
+#define _POSIX_C_SOURCE 200809L /* shm_open() */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ctl.h"
+
+#define LD(x)    atomic_load_explicit(&(x), memory_order_relaxed)
+#define ST(x, v) atomic_store_explicit(&(x), (v), memory_order_relaxed)
+
+static struct ctl_block *map_block(const char *name, int flags) {
+    char path[256];
+    snprintf(path, sizeof(path), "/%s", name);
+    int fd = shm_open(path, flags, 0600);
+    if (fd < 0) { fprintf(stderr, "shm_open %s: %s\n", path, strerror(errno)); return NULL; }
+    if ((flags & O_CREAT) && ftruncate(fd, sizeof(struct ctl_block)) != 0) {
+        perror("ftruncate");
+        close(fd);
+        return NULL;
+    }
+    void *p = mmap(NULL, sizeof(struct ctl_block), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) { perror("mmap"); return NULL; }
+    return p;
+}
+
+struct ctl_block *ctl_create(const char *name, const struct ctl_params *initial) {
+    struct ctl_block *b = map_block(name, O_RDWR | O_CREAT);
+    if (!b) return NULL;
+    memset(b, 0, sizeof(*b));
+    b->pid = (int32_t)getpid();
+    ctl_applied(b, 0, initial);
+    ST(b->req_streaming, initial->streaming);
+    ST(b->req_keepalive_ms, initial->keepalive_ms);
+    ST(b->req_base_mbps, initial->base_mbps);
+    ST(b->req_motion_mbps, initial->motion_mbps);
+    b->version = CTL_VERSION;
+    atomic_store_explicit(&b->gen, 0, memory_order_release);
+    b->magic = CTL_MAGIC; // Last: an attaching CLI never sees a half-built block
+    return b;
+}
+
+struct ctl_block *ctl_attach(const char *name) {
+    struct ctl_block *b = map_block(name, O_RDWR);
+    if (!b) return NULL;
+    if (b->magic != CTL_MAGIC || b->version != CTL_VERSION) {
+        fprintf(stderr, "/dev/shm/%s is not a smartcam_sim v%d control block\n", name, CTL_VERSION);
+        ctl_detach(b);
+        return NULL;
+    }
+    return b;
+}
+
+void ctl_detach(struct ctl_block *b) {
+    if (b) munmap(b, sizeof(*b));
+}
+
+void ctl_remove(const char *name) {
+    char path[256];
+    snprintf(path, sizeof(path), "/%s", name);
+    shm_unlink(path);
+}
+
+int ctl_poll(struct ctl_block *b, uint64_t *seen_gen, struct ctl_params *out) {
+    uint64_t g1 = atomic_load_explicit(&b->gen, memory_order_acquire);
+    if (g1 == *seen_gen || (g1 & 1)) return 0; // Unchanged, or a writer is mid-update
+
+    struct ctl_params p;
+    p.streaming = LD(b->req_streaming);
+    p.keepalive_ms = LD(b->req_keepalive_ms);
+    p.base_mbps = LD(b->req_base_mbps);
+    p.motion_mbps = LD(b->req_motion_mbps);
+    p.motion_now_ms = LD(b->req_motion_now_ms);
+    atomic_thread_fence(memory_order_acquire);
+    if (LD(b->gen) != g1) return 0; // Torn read: take it on the next wake
+
+    *out = p;
+    *seen_gen = g1;
+    return 1;
+}
+
+void ctl_applied(struct ctl_block *b, uint64_t gen, const struct ctl_params *p) {
+    ST(b->streaming, p->streaming);
+    ST(b->keepalive_ms, p->keepalive_ms);
+    ST(b->base_mbps, p->base_mbps);
+    ST(b->motion_mbps, p->motion_mbps);
+    atomic_store_explicit(&b->applied_gen, gen, memory_order_release);
+}
+
+void ctl_publish(struct ctl_block *b, const struct tx_stats *st, double target_pps,
+                 int in_motion, uint64_t now) {
+    ST(b->packets, st->packets);
+    ST(b->bytes, st->bytes);
+    ST(b->syscalls, st->syscalls);
+    ST(b->errors, st->errors);
+    ST(b->eagain, st->eagain);
+    ST(b->target_pps, target_pps);
+    ST(b->in_motion, in_motion);
+    ST(b->updated_ns, now);
+
+    if (b->window_ns == 0) { b->window_ns = now; b->window_packets = st->packets; }
+    if (now - b->window_ns >= 1000000000ULL) {
+        ST(b->current_pps, (double)(st->packets - b->window_packets) * 1e9 / (double)(now - b->window_ns));
+        b->window_ns = now;
+        b->window_packets = st->packets;
+    }
+}
+
+uint64_t ctl_request(struct ctl_block *b, const struct ctl_params *p) {
+    /* Take the write side: move the generation from even to odd */
+    uint64_t g = atomic_load_explicit(&b->gen, memory_order_relaxed);
+    for (;;) {
+        if (g & 1) { g = atomic_load_explicit(&b->gen, memory_order_relaxed); continue; } // Another CLI
+        if (atomic_compare_exchange_weak_explicit(&b->gen, &g, g + 1, memory_order_acquire, memory_order_relaxed))
+            break;
+    }
+    atomic_thread_fence(memory_order_release); // Odd generation visible before any data store (pairs with ctl_poll)
+    ST(b->req_streaming, p->streaming);
+    ST(b->req_keepalive_ms, p->keepalive_ms);
+    ST(b->req_base_mbps, p->base_mbps);
+    ST(b->req_motion_mbps, p->motion_mbps);
+    ST(b->req_motion_now_ms, p->motion_now_ms);
+    atomic_store_explicit(&b->gen, g + 2, memory_order_release);
+    return g + 2;
+}
+
+void ctl_current(struct ctl_block *b, struct ctl_params *out) {
+    out->streaming = LD(b->streaming);
+    out->keepalive_ms = LD(b->keepalive_ms);
+    out->base_mbps = LD(b->base_mbps);
+    out->motion_mbps = LD(b->motion_mbps);
+    out->motion_now_ms = 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * Shared-memory control and telemetry block for smartcam_sim (-C <name>).
+ *
+ * The sender maps /dev/shm/<name> and, once per loop iteration, compares a
+ * generation counter against the last one it applied. smartcam_ctl writes a
+ * new parameter set under a sequence lock (generation odd while writing),
+ * so the sender either sees a complete set or keeps the old one. In the
+ * other direction the sender publishes its transmit counters with relaxed
+ * atomic stores. Neither side makes a syscall on the hot path; a change is
+ * picked up on the sender's next wake (the next packet, or at most 10 ms
+ * when idle).
+ */
+
+#ifndef SMARTCAM_CTL_H
+#define SMARTCAM_CTL_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "tx.h"
+
+#define CTL_MAGIC   0x54434D53u /* "SMCT" */
+#define CTL_VERSION 1
+
+/* Parameters the CLI can change; 0 in a rate/interval means "follow the scenario" */
+struct ctl_params {
+    int32_t streaming;         // 0 = stream paused (keepalive/motion metadata continue)
+    int32_t keepalive_ms;      // Own keepalive interval instead of the scenario's
+    double base_mbps;          // Override the phase's base bitrate
+    double motion_mbps;        // Override the phase's motion bitrate
+    int32_t motion_now_ms;     // One-shot: start a motion event of this length
+};
+
+struct ctl_block {
+    uint32_t magic;
+    uint32_t version;
+    int32_t pid;               // Sender process
+
+    /* CLI -> sender (sequence lock: odd while a writer is mid-update) */
+    _Atomic uint64_t gen;
+    _Atomic int32_t req_streaming;
+    _Atomic int32_t req_keepalive_ms;
+    _Atomic double req_base_mbps;
+    _Atomic double req_motion_mbps;
+    _Atomic int32_t req_motion_now_ms;
+
+    /* Sender -> CLI */
+    _Atomic uint64_t applied_gen;  // Last generation the sender acted on
+    _Atomic int32_t streaming;
+    _Atomic int32_t keepalive_ms;
+    _Atomic double base_mbps;
+    _Atomic double motion_mbps;
+    _Atomic int32_t in_motion;
+    _Atomic double target_pps;     // Rate the pacer is running at
+    _Atomic double current_pps;    // Packets actually sent over the last second
+    _Atomic uint64_t packets, bytes, syscalls, errors, eagain;
+    _Atomic uint64_t updated_ns;   // CLOCK_MONOTONIC of the last publish
+
+    /* Sender-private bookkeeping for current_pps */
+    uint64_t window_ns;
+    uint64_t window_packets;
+};
+
+/* Sender: create (or reset) /dev/shm/<name>; NULL on error */
+struct ctl_block *ctl_create(const char *name, const struct ctl_params *initial);
+
+/* CLI: map an existing block; NULL on error (message on stderr) */
+struct ctl_block *ctl_attach(const char *name);
+
+void ctl_detach(struct ctl_block *b);
+void ctl_remove(const char *name);
+
+/* Sender: 1 and *out filled when a new complete parameter set is waiting */
+int ctl_poll(struct ctl_block *b, uint64_t *seen_gen, struct ctl_params *out);
+
+/* Sender: acknowledge the parameters now in effect */
+void ctl_applied(struct ctl_block *b, uint64_t gen, const struct ctl_params *p);
+
+/* Sender: publish counters (relaxed stores only) */
+void ctl_publish(struct ctl_block *b, const struct tx_stats *st, double target_pps,
+                 int in_motion, uint64_t now);
+
+/* CLI: write a full parameter set; returns the new generation */
+uint64_t ctl_request(struct ctl_block *b, const struct ctl_params *p);
+
+/* CLI: the parameters currently in effect */
+void ctl_current(struct ctl_block *b, struct ctl_params *out);
+
+#endif /* SMARTCAM_CTL_H */
@@ -0,0 +1,319 @@
+/*
+ * Fleet mode: many simulated cameras from one smartcam_sim process (see fleet.h).
+ */
+
+#define _GNU_SOURCE /* pthread affinity helpers */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "fleet.h"
+#include "tx.h"
+#include "pacer.h"
+#include "twheel.h"
+#include "../common/scenario.h"
+
+#define FLEET_TICK_NS 100000ULL /* 100 us wheel resolution */
+#define FLEET_SLOTS   4096      /* ~410 ms per wheel revolution */
+#define FLEET_MAX_DUE 64        /* Packets a device may catch up in one firing */
+#define NS_PER_S      1000000000ULL
+#define FLEET_WINDOW_NS (60ULL * NS_PER_S) /* Timeline compiled a minute at a time per device */
+#define FLEET_IDLE_NS   NS_PER_S  /* Longest a device sleeps when nothing is scheduled */
+
+/* One simulated camera */
+struct device {
+    struct tw_timer timer;     // First member: wheel entries cast back to the device
+    int id;
+    int sock;                  // Own socket -> own source port/address
+    struct tx_ctx tx;
+    struct pacer pacer;        // Per-device packet timeline
+    uint64_t seq;
+    uint64_t t0;               // Start of this device's timeline
+    struct sc_gen gen;         // Scenario compiler seeded with (seed, id)
+    struct sc_timeline tl;     // Compiled events, one window at a time
+    const struct sc_phase *phase;
+    uint64_t motion_end_ns;
+    int in_motion;
+    double current_pps;
+};
+
+struct worker {
+    pthread_t thread;
+    unsigned lane;             // Lane of the shared wheel this worker owns
+    int cpu;                   // Core it is pinned to
+    const struct fleet_cfg *cfg;
+    struct twheel *wheel;
+    struct device *devs;       // Slice of the fleet owned by this worker
+    int ndevs;
+    struct tx_pool pool;       // Per worker: headers are patched in place
+    int live;                  // Devices whose scenario has not ended
+    volatile sig_atomic_t *stop;
+};
+
+static const char keepalive_msg[] = "{\"type\":\"keepalive\"}";
+static const char sync_msg[] = "{\"type\":\"startSync\"}";
+
+static uint64_t min_u64(uint64_t a, uint64_t b) { return a < b ? a : b; }
+
+static double mbps_to_pps(double mbps, size_t pkt_size) {
+    return mbps * 1000000.0 / 8.0 / (double)pkt_size;
+}
+
+/* Advance one device along its timeline and send whatever is due; returns
+   its next deadline, or 0 once its scenario has ended */
+static uint64_t device_fire(struct device *d, const struct fleet_cfg *cfg, uint64_t now) {
+    const struct sc_event *ev;
+    while ((ev = sc_peek(&d->gen, &d->tl, FLEET_WINDOW_NS)) && d->t0 + ev->t_ns <= now) {
+        switch (ev->type) {
+        case SC_EV_PHASE:
+            d->phase = &cfg->scenario->phase[ev->phase];
+            break;
+        case SC_EV_KEEPALIVE:
+            tx_send_raw(&d->tx, keepalive_msg, sizeof(keepalive_msg) - 1);
+            break;
+        case SC_EV_SYNC:
+            tx_send_raw(&d->tx, sync_msg, sizeof(sync_msg) - 1);
+            break;
+        case SC_EV_MOTION: { /* Same metadata as the single-camera mode */
+            int dur = (int)((ev->dur_ns + NS_PER_S / 2) / NS_PER_S);
+            d->in_motion = 1;
+            d->motion_end_ns = d->t0 + ev->t_ns + ev->dur_ns;
+
+            char meta[256];
+            int n = snprintf(meta, sizeof(meta),
+                             "{\"type\":\"motion_event\",\"start_ms\":%llu,\"duration_s\":%d}",
+                             (unsigned long long)(now / 1000000ULL), dur);
+            if (n > 0) tx_send_raw(&d->tx, meta, (size_t)n);
+            break;
+        }
+        case SC_EV_END:
+            return 0;
+        }
+        sc_pop(&d->tl);
+    }
+    if (d->in_motion && now >= d->motion_end_ns) d->in_motion = 0;
+
+    /* Stream */
+    double target_pps = mbps_to_pps(d->in_motion ? d->phase->motion_mbps : d->phase->base_mbps, cfg->pkt_size);
+    if (target_pps != d->current_pps) {
+        pacer_set_rate(&d->pacer, target_pps, now);
+        d->current_pps = target_pps;
+    }
+    unsigned due = pacer_due(&d->pacer, now, FLEET_MAX_DUE);
+    if (due > 0) {
+        tx_send_stream(&d->tx, &d->seq, due);
+        pacer_sent(&d->pacer, now_ns());
+    }
+
+    uint64_t next = min_u64(pacer_next(&d->pacer), now + FLEET_IDLE_NS);
+    if (ev) next = min_u64(next, d->t0 + ev->t_ns);
+    return d->in_motion ? min_u64(next, d->motion_end_ns) : next;
+}
+
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    const struct fleet_cfg *cfg = w->cfg;
+
+    if (pacer_rt_setup(w->cpu, cfg->rt_prio) != 0)
+        fprintf(stderr, "[fleet] worker %u: real-time setup incomplete\n", w->lane);
+
+    /* Stagger device start times over one base packet interval so the
+       fleet does not transmit in lock-step */
+    uint64_t now = now_ns();
+    double base_pps = mbps_to_pps(cfg->scenario->phase[0].base_mbps, cfg->pkt_size);
+    uint64_t spread = base_pps > 0 ? (uint64_t)(1e9 / base_pps) : 1000000ULL;
+    for (int i = 0; i < w->ndevs; ++i) {
+        struct device *d = &w->devs[i];
+        struct sc_rng aux; // Stagger draw kept off the timeline stream
+        sc_aux_rng(&aux, cfg->seed, (unsigned)d->id, SC_AUX_STAGGER);
+        d->t0 = now + sc_rng_range(&aux, 0, spread ? spread - 1 : 0);
+        tx_send_raw(&d->tx, sync_msg, sizeof(sync_msg) - 1);
+        d->phase = &cfg->scenario->phase[0];
+        d->current_pps = -1.0;
+        tw_schedule(w->wheel, w->lane, &d->timer, d->t0);
+    }
+    w->live = w->ndevs;
+
+    while (!*w->stop && w->live > 0) {
+        now = now_ns();
+        struct tw_timer *t = tw_expire(w->wheel, w->lane, now);
+        while (t) {
+            struct tw_timer *next = t->next;
+            struct device *d = (struct device *)t;
+            uint64_t due = device_fire(d, cfg, now);
+            if (due) tw_schedule(w->wheel, w->lane, &d->timer, due);
+            else w->live--;     // Scenario over for this device
+            t = next;
+        }
+
+        /* Sleep until the tick of this lane's earliest deadline; every device
+           rearms within FLEET_IDLE_NS, so the stop flag is still seen */
+        uint64_t wake = min_u64(tw_next_armed_ns(w->wheel, w->lane), now + FLEET_IDLE_NS);
+        if (wake <= now_ns()) continue;
+        struct timespec ts;
+        ts.tv_sec = (time_t)(wake / NS_PER_S);
+        ts.tv_nsec = (long)(wake % NS_PER_S);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+    return NULL;
+}
+
+/* Socket for device `id`: own ephemeral source port, optionally own source address */
+static int device_socket(const struct fleet_cfg *cfg, int id) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        perror("socket");
+        if (errno == EMFILE) fprintf(stderr, "Raise the open file limit (ulimit -n) for %d devices\n", cfg->devices);
+        return -1;
+    }
+
+    struct sockaddr_in src;
+    memset(&src, 0, sizeof(src));
+    src.sin_family = AF_INET;
+    src.sin_port = 0; // Kernel picks a distinct ephemeral port
+    src.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (cfg->src_base) {
+        struct in_addr base;
+        inet_pton(AF_INET, cfg->src_base, &base); // Validated by fleet_run()
+        src.sin_addr.s_addr = htonl(ntohl(base.s_addr) + (uint32_t)id);
+    }
+    if (bind(sock, (struct sockaddr *)&src, sizeof(src)) != 0) {
+        char addr[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &src.sin_addr, addr, sizeof(addr));
+        fprintf(stderr, "bind %s for device %d: %s\n", addr, id, strerror(errno));
+        close(sock);
+        return -1;
+    }
+
+    /* A full socket buffer must not stall the other devices on this worker */
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+    return sock;
+}
+
+int fleet_run(const struct fleet_cfg *cfg, volatile sig_atomic_t *stop) {
+    int ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu < 1) ncpu = 1;
+    int nworkers = cfg->workers > 0 ? cfg->workers : ncpu;
+    if (nworkers > cfg->devices) nworkers = cfg->devices;
+
+    if (cfg->src_base) {
+        struct in_addr tmp;
+        if (inet_pton(AF_INET, cfg->src_base, &tmp) != 1) {
+            fprintf(stderr, "Invalid source base address: %s\n", cfg->src_base);
+            return 1;
+        }
+    }
+
+    struct device *devs = calloc((size_t)cfg->devices, sizeof(*devs));
+    struct worker *workers = calloc((size_t)nworkers, sizeof(*workers));
+    struct twheel wheel;
+    if (!devs || !workers || tw_init(&wheel, (unsigned)nworkers, FLEET_SLOTS, FLEET_TICK_NS, now_ns()) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        free(devs);
+        free(workers);
+        return 1;
+    }
+
+    int rc = 0;
+    int opened = 0; // Devices with a live socket/tx context
+
+    /* Contiguous slices of the device array, one per worker */
+    for (int wi = 0, first = 0; wi < nworkers; ++wi) {
+        struct worker *w = &workers[wi];
+        int count = cfg->devices / nworkers + (wi < cfg->devices % nworkers ? 1 : 0);
+        w->lane = (unsigned)wi;
+        w->cpu = wi % ncpu;
+        w->cfg = cfg;
+        w->wheel = &wheel;
+        w->devs = &devs[first];
+        w->ndevs = count;
+        w->stop = stop;
+        if (tx_pool_init(&w->pool, cfg->pkt_size) != 0) { fprintf(stderr, "Out of memory\n"); rc = 1; goto out; }
+        first += count;
+    }
+
+    for (int wi = 0; wi < nworkers; ++wi) {
+        struct worker *w = &workers[wi];
+        for (int i = 0; i < w->ndevs; ++i) {
+            struct device *d = &w->devs[i];
+            d->id = (int)(d - devs);
+            sc_gen_init(&d->gen, cfg->scenario, cfg->seed, (unsigned)d->id);
+            pacer_init(&d->pacer, 0);
+            d->sock = device_socket(cfg, d->id);
+            if (d->sock < 0) { rc = 1; goto out; }
+            if (tx_init(&d->tx, d->sock, &cfg->dst, &w->pool, cfg->batch) != 0) {
+                close(d->sock);
+                fprintf(stderr, "Out of memory\n");
+                rc = 1;
+                goto out;
+            }
+            opened++;
+        }
+    }
+
+    fprintf(stderr, "[fleet] devices=%d workers=%d tick=%lluus src=%s\n",
+            cfg->devices, nworkers, (unsigned long long)(FLEET_TICK_NS / 1000),
+            cfg->src_base ? cfg->src_base : "ephemeral ports");
+
+    uint64_t t0 = now_ns();
+    int started = 0;
+    for (; started < nworkers; ++started) {
+        if (pthread_create(&workers[started].thread, NULL, worker_main, &workers[started]) != 0) {
+            fprintf(stderr, "pthread_create failed\n");
+            *stop = 1;
+            rc = 1;
+            break;
+        }
+    }
+    for (int wi = 0; wi < started; ++wi) pthread_join(workers[wi].thread, NULL);
+    double secs = (double)(now_ns() - t0) / 1e9;
+
+    /* Per-worker and fleet-wide totals */
+    struct tx_ctx total;
+    struct pacer jitter;
+    memset(&total, 0, sizeof(total));
+    pacer_init(&jitter, 0);
+    for (int wi = 0; wi < nworkers; ++wi) {
+        struct worker *w = &workers[wi];
+        uint64_t pkts = 0;
+        for (int i = 0; i < w->ndevs; ++i) {
+            const struct tx_stats *st = &w->devs[i].tx.stats;
+            pkts += st->packets;
+            total.stats.packets += st->packets;
+            total.stats.bytes += st->bytes;
+            total.stats.syscalls += st->syscalls;
+            total.stats.errors += st->errors;
+            total.stats.eagain += st->eagain;
+            pacer_merge(&jitter, &w->devs[i].pacer);
+        }
+        fprintf(stderr, "[fleet] worker %d cpu=%d devices=%d packets=%llu pps=%.0f\n",
+                wi, w->cpu, w->ndevs, (unsigned long long)pkts, secs > 0 ? (double)pkts / secs : 0.0);
+    }
+    total.batch = cfg->batch;
+    fprintf(stderr, "[fleet] total pps=%.0f Mbps=%.2f over %.1fs\n",
+            secs > 0 ? (double)total.stats.packets / secs : 0.0,
+            secs > 0 ? (double)total.stats.bytes * 8.0 / secs / 1e6 : 0.0, secs);
+    tx_report(&total, stderr);
+    pacer_report(&jitter, stderr);
+
+out:
+    for (int i = 0; i < opened; ++i) {
+        sc_timeline_free(&devs[i].tl);
+        tx_free(&devs[i].tx);
+        close(devs[i].sock);
+    }
+    for (int wi = 0; wi < nworkers; ++wi) tx_pool_free(&workers[wi].pool);
+    tw_free(&wheel);
+    free(workers);
+    free(devs);
+    return rc;
+}
@@ -0,0 +1,37 @@
+/*
+ * Fleet mode: many simulated cameras from one smartcam_sim process.
+ *
+ * Each device carries its own state machine (keepalive, motion schedule,
+ * bitrate) driven by its own scenario timeline, its own UDP socket and therefore its own source port (or source
+ * address with -L), and its own sequence number. Devices are spread across
+ * worker threads pinned one per core; the workers share one timer wheel
+ * (twheel.c) and each only touches the devices it owns.
+ */
+
+#ifndef SMARTCAM_FLEET_H
+#define SMARTCAM_FLEET_H
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <netinet/in.h>
+
+struct scenario;
+
+struct fleet_cfg {
+    struct sockaddr_in dst;    // Collector address
+    int devices;               // Number of simulated cameras
+    int workers;               // Worker threads (0 = one per online core)
+    const char *src_base;      // First source IPv4 (device i binds base+i), NULL = ephemeral ports only
+    const struct scenario *scenario; // Phases, bitrates and event distributions
+    uint64_t seed;             // Device i compiles its timeline from (seed, i)
+    size_t pkt_size;           // UDP payload size
+    unsigned batch;            // Packets per sendmmsg() when a device is behind
+    int rt_prio;               // SCHED_FIFO priority for workers, 0 = normal
+};
+
+/* Run until *stop is set; returns 0 on clean shutdown */
+int fleet_run(const struct fleet_cfg *cfg, volatile sig_atomic_t *stop);
+
+#endif /* SMARTCAM_FLEET_H */
@@ -4,9 +4,9 @@
  * - Simulates base stream bitrate, keepalive messages, randomized motion events
  *
  * Build x86:
- *   gcc -O2 -std=c11 -o smartcam_sim main.c
+ *   gcc -O2 -std=c11 -o smartcam_sim main.c tx.c txring.c pacer.c fleet.c twheel.c replay.c ctl.c ../common/scenario.c -pthread -lm -lrt
  * Build Arm64:
- *   aarch64-linux-gnu-gcc -o smartcam_sim main.c
+ *   aarch64-linux-gnu-gcc -O2 -std=c11 -o smartcam_sim main.c tx.c txring.c pacer.c fleet.c twheel.c replay.c ctl.c ../common/scenario.c -pthread -lm -lrt
  *
  * Usage:
  *   ./smartcam_sim [options]
@@ -20,16 +20,65 @@
  *   -s <bytes>   UDP payload size in bytes (default: 1200)
  *   -i <sec>     Min interval between motion events (default: 20)
  *   -x <sec>     Max interval between motion events (default: 180)
+ *   -B <n>       Stream packets per sendmmsg() call (default: 1 = sendto per packet)
+ *   -t <us>      Busy-poll the last <us> microseconds before each deadline (default: 0, 50 with -r)
+ *   -r <prio>    Real-time mode: SCHED_FIFO at <prio>, mlockall, busy-poll tail
+ *   -c <cpu>     Pin the sender to CPU core <cpu>
+ *   -n <devs>    Fleet mode: simulate <devs> cameras from this process (default: 1)
+ *   -w <n>       Fleet worker threads, pinned one per core (default: online cores)
+ *   -L <addr>    Fleet: first source IPv4, device i binds <addr>+i (default: own port only)
+ *   -f <pcap>    Replay mode: re-emit the camera flow of a pcap file with its timing
+ *   -F <addr>    Replay: camera IPv4 source in the capture (default: busiest sender)
+ *   -X <factor>  Replay: time-scale factor, 2.0 = twice as fast (default: 1.0)
+ *   -l           Replay: loop the capture until stopped
+ *   -I <ifname>  Send stream packets as raw frames through an AF_PACKET TX ring on <ifname>
+ *   -M <mac>     TX ring: next-hop MAC of the server (default: from the ARP cache)
+ *   -G <segs>    UDP GSO: hand the kernel <segs> payloads per send (UDP_SEGMENT), 2..64
+ *   -S <file>    Scenario file: phases, bitrates and event distributions (../common/scenario.h)
+ *   -z <seed>    Seed for the event schedule (default: scenario's seed, else random and printed)
+ *   -C <name>    Shared-memory control/telemetry block /dev/shm/<name> for smartcam_ctl
  *   -h           Show this help and exit
  *
  * Notes:
  * - Intended to simulate network patterns for lab/testing. 
+ * - Stream payloads come from a pre-generated pool (tx.c); only the 4-byte
+ *   sequence header is patched per packet. Transmit counters, including the
+ *   packets-per-syscall actually achieved, are printed on shutdown.
+ * - Packets are paced on an absolute nanosecond timeline (pacer.c) rather than
+ *   in 5 ms ticks; a histogram of send-time lateness is printed on shutdown.
+ * - Fleet mode (fleet.c) gives every device its own socket, sequence number
+ *   and keepalive/motion state; devices are scheduled on a timer wheel
+ *   (twheel.c, 100 us ticks) shared by per-core worker threads, each of
+ *   which sleeps until the earliest deadline on its lane. -L addresses must
+ *   already be assigned to the sending interface; -G, -t and -c are
+ *   single-camera options and are rejected with -n, and -L is rejected
+ *   without it.
+ * - Replay mode (replay.c) memory-maps the capture and streams through it, so
+ *   resident memory stays constant whatever the file size. Each packet of the
+ *   chosen flow is sent with the same transport payload size and scaled
+ *   inter-arrival time; keepalive/motion generation is off (they are in the trace).
+ * - The TX ring backend (txring.c, needs CAP_NET_RAW) pre-builds whole
+ *   Ethernet/IP/UDP frames and only patches sequence and checksum; one send()
+ *   flushes each batch. Keepalive and metadata still use the UDP socket.
+ * - UDP GSO (-G) sends runs of adjacent pool slots as one super-packet that the
+ *   kernel segments once; it falls back to sendto/sendmmsg if rejected. Packets
+ *   are held back up to 1 ms to fill a super-packet. The shutdown stats include
+ *   segments per send.
+ * - Keepalive, motion and sync times come from a timeline compiled ahead of
+ *   time from the scenario (-S, or the -b/-m/-k/-i/-x options) with a seeded
+ *   xoshiro256** generator; the send loop only walks it. The same scenario and
+ *   seed (-z, printed at startup) reproduce the same schedule, per device in
+ *   fleet mode.
+ * - With -C the sender maps a control block (ctl.c) that smartcam_ctl uses to
+ *   pause/resume the stream, override bitrates and keepalive, or trigger a
+ *   motion event without restarting, and to read live counters. The send loop
+ *   only reads a generation counter and stores counters; no syscalls.
  */
 
 #define _POSIX_C_SOURCE 200809L /* Enable POSIX features like clock_gettime, nanosleep, etc. */
 
 #include <stdio.h>      // Standard I/O functions (printf, fprintf)
-#include <stdlib.h>     // Standard library functions (malloc, free, rand, atoi, strtod)
+#include <stdlib.h>     // Standard library functions (malloc, free, atoi, strtod)
 #include <string.h>     // String manipulation functions (memcpy, memset, strncpy)
 #include <time.h>       // Time functions (time, nanosleep, clock_gettime)
 #include <stdint.h>     // Fixed-width integer types (uint64_t, uint32_t)
@@ -43,42 +92,40 @@
 #include <arpa/inet.h>  // Internet address conversions (inet_pton, htons)
 #include <netinet/in.h> // sockaddr_in structure
 
+#include "tx.h"         // Payload pool and sendto/sendmmsg transmit path
+#include "pacer.h"      // Absolute-deadline packet pacing and jitter histogram
+#include "fleet.h"      // Many cameras per process (-n)
+#include "replay.h"     // pcap trace replay (-f)
+#include "txring.h"     // AF_PACKET TX ring backend (-I)
+#include "ctl.h"        // Shared-memory control/telemetry block (-C)
+#include "../common/scenario.h" // Scenario files and seeded event timelines (-S, -z)
+
 volatile sig_atomic_t stop = 0; // Global flag for clean shutdown via signal
 static void handle_sigint(int sig) { (void)sig; stop = 1; } 
 // Signal handler for SIGINT (Ctrl+C). Sets `stop` to 1 to exit main loop safely.
 
+#define IDLE_WAKE_NS 10000000ULL /* Longest sleep between event checks (10 ms) */
+#define GSO_MAX_HOLD_NS 1000000ULL /* Longest a packet waits to fill a GSO super-packet (1 ms) */
+#define SCENARIO_WINDOW_NS (3600ULL * 1000000000ULL) /* Timeline compiled an hour at a time */
+
 /* Return monotonic time in milliseconds (good for intervals) */
 static inline uint64_t now_ms(void) {
-    struct timespec t;
-    if (clock_gettime(CLOCK_MONOTONIC, &t) != 0) return 0; // Get monotonic clock
-    return (uint64_t)t.tv_sec * 1000ULL + (uint64_t)(t.tv_nsec / 1000000L); 
-    // Convert seconds+nano to milliseconds
-}
-
-/* Sleep best-effort for given milliseconds (handles interrupts) */
-static void msleep(uint64_t ms) {
-    struct timespec req, rem;
-    req.tv_sec = (time_t)(ms / 1000);                   // Seconds part
-    req.tv_nsec = (long)((ms % 1000) * 1000000);        // Nanoseconds part
-    while (nanosleep(&req, &rem) == -1 && errno == EINTR) req = rem; 
-    // Repeat if interrupted by signal
-}
-
-/* Send UDP packet (ignore individual send errors) */
-static void udp_send(int sock, const struct sockaddr_in *dst, const void *buf, size_t len) {
-    sendto(sock, buf, len, 0, (const struct sockaddr*)dst, sizeof(*dst));
-    // Fire-and-forget UDP send
-}
-
-/* Generate pseudo-random next motion event interval in seconds (uniform) */
-static int next_motion_interval_s(int min_s, int max_s) {
-    if (max_s <= min_s) return min_s;                   // Edge case
-    return min_s + rand() % (max_s - min_s + 1);       // Random number between min and max inclusive
+    return now_ns() / 1000000ULL; // Same clock as the pacer timeline
 }
 
-/* Motion event duration: 10-30s (configurable easily here) */
-static int motion_duration_s(void) {
-    return 10 + rand() % 21; // Random duration between 10 and 30 seconds
+/* Motion event duration when no scenario says otherwise: 10-30s */
+#define MOTION_MIN_S 10
+#define MOTION_MAX_S 30
+
+/* Send motion metadata for an event of `dur_ns` and log it */
+static void motion_meta(struct tx_ctx *tx, uint64_t dur_ns) {
+    int dur = (int)((dur_ns + SC_NS_PER_S / 2) / SC_NS_PER_S);
+    char meta[256];                      // Buffer for motion metadata
+    int n = snprintf(meta, sizeof(meta),
+                     "{\"type\":\"motion_event\",\"start_ms\":%llu,\"duration_s\":%d}",
+                     (unsigned long long)now_ms(), dur); // Format JSON
+    if (n > 0) tx_send_raw(tx, meta, (size_t)n); // Send motion metadata
+    fprintf(stderr, "[event] motion start t=%llu dur=%ds\n", (unsigned long long)now_ms(), dur);
 }
 
 /* Convert Mbps to bytes-per-second (double for fractional pps) */
@@ -97,8 +144,25 @@ static void print_usage(const char *prog) {
             "  -s <bytes>   UDP payload size in bytes (default: 1200)\n"
             "  -i <sec>     Min interval between motion events (default: 600)\n"
             "  -x <sec>     Max interval between motion events (default: 7200)\n"
+            "  -B <n>       Stream packets per sendmmsg() call, 1..%d (default: 1 = sendto)\n"
+            "  -t <us>      Busy-poll tail before each packet deadline (default: 0, 50 with -r)\n"
+            "  -r <prio>    Real-time mode: SCHED_FIFO priority, mlockall, busy-poll tail\n"
+            "  -c <cpu>     Pin the sender to CPU core\n"
+            "  -n <devs>    Fleet mode: number of simulated cameras (default: 1)\n"
+            "  -w <n>       Fleet worker threads, one per core (default: online cores)\n"
+            "  -L <addr>    Fleet: first source IPv4, device i uses <addr>+i\n"
+            "  -f <pcap>    Replay the camera flow of a pcap file instead of the synthetic stream\n"
+            "  -F <addr>    Replay: camera IPv4 source (default: busiest UDP/TCP sender)\n"
+            "  -X <factor>  Replay: time-scale factor, 2.0 = twice as fast (default: 1.0)\n"
+            "  -l           Replay: loop until stopped\n"
+            "  -I <ifname>  Raw AF_PACKET TX ring backend on <ifname> (needs CAP_NET_RAW)\n"
+            "  -M <mac>     TX ring: server/next-hop MAC (default: ARP cache)\n"
+            "  -G <segs>    UDP GSO super-packets of <segs> payloads, 2..%d (default: off)\n"
+            "  -S <file>    Scenario file (phases, bitrates, event distributions)\n"
+            "  -z <seed>    Event schedule seed (default: scenario's, else random)\n"
+            "  -C <name>    Control/telemetry block /dev/shm/<name> for smartcam_ctl\n"
             "  -h           Show this help and exit\n",
-            prog); // Prints CLI usage information
+            prog, TX_MAX_BATCH, TX_MAX_GSO); // Prints CLI usage information
 }
 
 int main(int argc, char **argv) {
@@ -111,9 +175,23 @@ int main(int argc, char **argv) {
     size_t packet_size = 1200;        // Default UDP payload size
     int min_motion_interval_s = 600;   // Minimum interval between motion events
     int max_motion_interval_s = 7200;  // Maximum interval between motion events
+    int batch = 1;                     // Stream packets per send syscall
+    long spin_us = -1;                 // Busy-poll tail, -1 = mode default
+    int rt_prio = 0;                   // SCHED_FIFO priority, 0 = normal scheduling
+    int cpu = -1;                      // Core to pin to, -1 = no pinning
+    int devices = 1;                   // Simulated cameras (fleet mode when > 1)
+    int workers = 0;                   // Fleet worker threads, 0 = one per core
+    const char *src_base = NULL;       // Fleet source address base
+    struct replay_cfg replay = { NULL, NULL, 1.0, 0 }; // Trace replay, off unless -f
+    const char *ring_if = NULL;        // TX ring interface, NULL = socket path
+    const char *ring_mac = NULL;       // TX ring destination MAC
+    int gso_segs = 0;                  // UDP GSO segments per send, 0 = off
+    const char *scenario_path = NULL;  // Scenario file, NULL = options only
+    const char *seed_opt = NULL;       // -z seed as given
+    const char *ctl_name = NULL;       // Control block name, NULL = no live control
 
     int opt;
-    while ((opt = getopt(argc, argv, "a:p:b:m:k:s:i:x:h")) != -1) {
+    while ((opt = getopt(argc, argv, "a:p:b:m:k:s:i:x:B:t:r:c:n:w:L:f:F:X:lI:M:G:S:z:C:h")) != -1) {
         switch (opt) {
         case 'a':
             strncpy(server_ip, optarg, sizeof(server_ip) - 1); // Copy user-supplied server IP
@@ -153,6 +231,71 @@ int main(int argc, char **argv) {
                 return 1;
             }
             break;
+        case 'B':
+            batch = atoi(optarg);
+            if (batch < 1 || batch > TX_MAX_BATCH) {
+                fprintf(stderr, "Batch size must be 1..%d\n", TX_MAX_BATCH);
+                return 1;
+            }
+            break;
+        case 't':
+            spin_us = atol(optarg);
+            if (spin_us < 0) { fprintf(stderr, "Invalid spin tail\n"); return 1; }
+            break;
+        case 'r':
+            rt_prio = atoi(optarg);
+            if (rt_prio < 1 || rt_prio > 99) { fprintf(stderr, "SCHED_FIFO priority must be 1..99\n"); return 1; }
+            break;
+        case 'c':
+            cpu = atoi(optarg);
+            if (cpu < 0) { fprintf(stderr, "Invalid CPU\n"); return 1; }
+            break;
+        case 'n':
+            devices = atoi(optarg);
+            if (devices < 1) { fprintf(stderr, "Invalid device count\n"); return 1; }
+            break;
+        case 'w':
+            workers = atoi(optarg);
+            if (workers < 1) { fprintf(stderr, "Invalid worker count\n"); return 1; }
+            break;
+        case 'L':
+            src_base = optarg;
+            break;
+        case 'f':
+            replay.path = optarg;
+            break;
+        case 'F':
+            replay.flow_src = optarg;
+            break;
+        case 'X':
+            replay.speed = strtod(optarg, NULL);
+            if (replay.speed <= 0) { fprintf(stderr, "Invalid time-scale factor\n"); return 1; }
+            break;
+        case 'l':
+            replay.loop = 1;
+            break;
+        case 'I':
+            ring_if = optarg;
+            break;
+        case 'M':
+            ring_mac = optarg;
+            break;
+        case 'G':
+            gso_segs = atoi(optarg);
+            if (gso_segs < 2 || gso_segs > TX_MAX_GSO) {
+                fprintf(stderr, "GSO segments must be 2..%d\n", TX_MAX_GSO);
+                return 1;
+            }
+            break;
+        case 'S':
+            scenario_path = optarg;
+            break;
+        case 'z':
+            seed_opt = optarg;
+            break;
+        case 'C':
+            ctl_name = optarg;
+            break;
         case 'h':
         default:
             print_usage(argv[0]); // Show help if unknown option
@@ -160,17 +303,37 @@ int main(int argc, char **argv) {
         }
     }
 
+    if (ring_if && (devices > 1 || replay.path)) {
+        fprintf(stderr, "-I drives the single-camera synthetic stream; it cannot be combined with -n or -f\n");
+        return 1;
+    }
+    if (devices > 1 && (gso_segs || spin_us >= 0 || cpu >= 0)) {
+        fprintf(stderr, "-G, -t and -c apply to the single-camera sender; fleet workers are pinned one per core (-w)\n");
+        return 1;
+    }
+    if (src_base && devices <= 1) {
+        fprintf(stderr, "-L sets the fleet's source addresses; it needs -n greater than 1\n");
+        return 1;
+    }
+    if (ctl_name && (devices > 1 || replay.path)) {
+        fprintf(stderr, "-C controls the single-camera synthetic stream; it cannot be combined with -n or -f\n");
+        return 1;
+    }
+
     /* Install SIGINT handler for clean shutdown */
     signal(SIGINT, handle_sigint); // Ctrl+C sets stop=1
 
-    /* Seed PRNG (simple) */
-    srand((unsigned)time(NULL) ^ (unsigned)getpid()); // Seed random number generator
-
-    /* Derived values for pacing (packets per second) */
-    const double base_Bps = mbps_to_Bps(base_stream_mbps);  // Base bytes/sec
-    const double motion_Bps = mbps_to_Bps(motion_burst_mbps);// Motion bytes/sec
-    const double base_pps = base_Bps / (double)packet_size; // Packets/sec for base stream
-    const double motion_pps = motion_Bps / (double)packet_size; // Packets/sec for motion burst
+    /* Scenario: the options are the defaults every phase starts from */
+    struct scenario scn;
+    scenario_init(&scn);
+    scn.phase[0].base_mbps = base_stream_mbps;
+    scn.phase[0].motion_mbps = motion_burst_mbps;
+    scn.phase[0].keepalive_ns = (uint64_t)keepalive_interval_s * SC_NS_PER_S;
+    scn.phase[0].idle = sc_uniform((uint64_t)min_motion_interval_s * SC_NS_PER_S,
+                                   (uint64_t)max_motion_interval_s * SC_NS_PER_S);
+    scn.phase[0].capture = sc_uniform(MOTION_MIN_S * SC_NS_PER_S, MOTION_MAX_S * SC_NS_PER_S);
+    if (scenario_path && scenario_load(&scn, scenario_path) != 0) return 1;
+    const uint64_t seed = scenario_seed(&scn, seed_opt); // Same seed + scenario = same schedule
 
     /* Setup UDP socket and destination address */
     int sock = socket(AF_INET, SOCK_DGRAM, 0); // Create UDP socket
@@ -186,102 +349,218 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    /* Fleet mode: per-device sockets and state live in fleet.c */
+    if (devices > 1) {
+        close(sock);
+        struct fleet_cfg fc;
+        memset(&fc, 0, sizeof(fc));
+        fc.dst = dst;
+        fc.devices = devices;
+        fc.workers = workers;
+        fc.src_base = src_base;
+        fc.scenario = &scn;
+        fc.seed = seed;
+        fc.pkt_size = packet_size;
+        fc.batch = (unsigned)batch;
+        fc.rt_prio = rt_prio;
+        fprintf(stderr,
+                "Starting fleet -> server=%s:%d devices=%d base=%.2fMbps motion=%.2fMbps keepalive=%ds pkt=%zuB\n",
+                server_ip, server_port, devices, base_stream_mbps, motion_burst_mbps,
+                keepalive_interval_s, packet_size);
+        scenario_print(&scn, seed, stderr);
+        int rc = fleet_run(&fc, &stop);
+        fprintf(stderr, "Simulation stopped%s.\n", rc == 0 ? " cleanly" : " with errors");
+        return rc;
+    }
+
     /* Streaming state and timing */
-    int streaming_mode = 1; /* streaming on by default; could be toggled externally */
-    uint64_t last_keepalive_ms = now_ms(); // Last keepalive send time
-    uint64_t next_motion_ms = now_ms() + (uint64_t)next_motion_interval_s(min_motion_interval_s, max_motion_interval_s) * 1000ULL;
-    // Schedule first motion event
+    int streaming_mode = 1; /* streaming on by default; toggled externally through -C */
     int in_motion = 0;       // Flag indicating if currently in motion
-    uint64_t motion_end_ms = 0; // End time for current motion
+    uint64_t motion_end_ns = 0; // End time for current motion
+    const struct sc_phase *phase = &scn.phase[0]; // Current scenario phase (rates)
+    struct sc_gen gen;       // Scenario compiler, one window ahead of the send loop
+    struct sc_timeline timeline = { 0 };
+    sc_gen_init(&gen, &scn, seed, 0);
 
     uint64_t seq = 0; // Packet sequence number
-    unsigned char *payload = malloc(packet_size); // Allocate buffer for UDP packet
-    if (!payload) { fprintf(stderr, "Out of memory\n"); close(sock); return 1; }
+    struct tx_pool pool;  // Pre-generated payloads, one per low sequence byte
+    struct tx_ctx tx;     // Socket + batching state
+    if (tx_pool_init(&pool, packet_size) != 0) { fprintf(stderr, "Out of memory\n"); close(sock); return 1; }
+    if (tx_init(&tx, sock, &dst, &pool, (unsigned)batch) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        tx_pool_free(&pool);
+        close(sock);
+        return 1;
+    }
+
+    if (gso_segs && !ring_if) {
+        unsigned got = tx_enable_gso(&tx, (unsigned)gso_segs);
+        if (got == 0) fprintf(stderr, "UDP GSO unavailable, using %s\n", batch > 1 ? "sendmmsg" : "sendto");
+        else if (got != (unsigned)gso_segs) fprintf(stderr, "UDP GSO limited to %u segments of %zuB\n", got, packet_size);
+    }
+
+    struct txring ring;   // Raw frame backend, only with -I
+    if (ring_if) {
+        if (txring_open(&ring, ring_if, &dst, ring_mac, packet_size) != 0) {
+            tx_free(&tx);
+            tx_pool_free(&pool);
+            close(sock);
+            return 1;
+        }
+        tx.ring = &ring;
+    }
 
     const char keepalive_msg[] = "{\"type\":\"keepalive\"}"; // Keepalive JSON message
     const char sync_msg[] = "{\"type\":\"startSync\"}"; // Start Sync JSON message
 
-    fprintf(stderr,
-            "Starting simulation -> server=%s:%d base=%.2fMbps motion=%.2fMbps keepalive=%ds pkt=%zuB motion_interval=%ds..%ds\n",
+    if (!replay.path) fprintf(stderr,
+            "Starting simulation -> server=%s:%d base=%.2fMbps motion=%.2fMbps keepalive=%ds pkt=%zuB motion_interval=%ds..%ds batch=%d\n",
             server_ip, server_port, base_stream_mbps, motion_burst_mbps,
-            keepalive_interval_s, packet_size, min_motion_interval_s, max_motion_interval_s);
+            keepalive_interval_s, packet_size, min_motion_interval_s, max_motion_interval_s, batch);
+    if (!replay.path) scenario_print(&scn, seed, stderr);
+
+    /* Pacing: one absolute deadline per packet, optionally real-time */
+    if (spin_us < 0) spin_us = rt_prio > 0 ? 50 : 0;
+    if ((cpu >= 0 || rt_prio > 0) && pacer_rt_setup(cpu, rt_prio) != 0)
+        fprintf(stderr, "Warning: real-time setup incomplete, continuing\n");
+    struct pacer pacer;
+    pacer_init(&pacer, (uint64_t)spin_us * 1000ULL);
+    double current_pps = -1.0;               // Rate the pacer is running at
+    unsigned max_burst = (unsigned)batch > 1 ? (unsigned)batch : 64; // Packets per wake when late
+    if (tx.gso) {                     // A whole super-packet per wake, held back at most 1 ms
+        max_burst = tx.gso;
+        pacer_set_group(&pacer, tx.gso, GSO_MAX_HOLD_NS);
+    }
 
-    /* Accumulator approach: keep fractional packets between ticks */
-    uint64_t last_send_ms = now_ms();
-    double send_accumulator = 0.0;
+    /* Replay mode: the trace supplies sizes and timing */
+    if (replay.path) {
+        int rc = replay_run(&replay, &tx, &pacer, &stop);
+        tx_report(&tx, stderr);
+        pacer_report(&pacer, stderr);
+        tx_free(&tx);
+        tx_pool_free(&pool);
+        close(sock);
+        fprintf(stderr, "Replay stopped%s.\n", rc == 0 ? " cleanly" : " with errors");
+        return rc;
+    }
+
+    /* Live control: parameters in effect, and the last generation applied */
+    struct ctl_params live = { 1, 0, 0.0, 0.0, 0 };
+    uint64_t ctl_gen = 0;
+    uint64_t next_ctl_keepalive_ns = 0; // Own keepalive schedule while overridden
+    struct ctl_block *ctl = NULL;
+    if (ctl_name) {
+        ctl = ctl_create(ctl_name, &live);
+        if (!ctl) fprintf(stderr, "Warning: no control block, continuing without live control\n");
+        else fprintf(stderr, "Control block /dev/shm/%s (smartcam_ctl -C %s)\n", ctl_name, ctl_name);
+    }
 
     uint8_t start = 0;
+    const uint64_t t0 = now_ns(); // Timeline offsets are relative to this
 
     while (!stop) { // Main simulation loop
-        uint64_t now = now_ms(); // Current time in ms
+        uint64_t now = now_ns(); // Current time in ns
 
         /* send a sync packet at beginning of operation*/
         if (start == 0 ) {
-            udp_send(sock, &dst, sync_msg, sizeof(sync_msg) - 1); // Send sync packet
+            tx_send_raw(&tx, sync_msg, sizeof(sync_msg) - 1); // Send sync packet
             start = 1;
         }
 
-        /* Keepalive: send a small control/heartbeat periodically */
-        if (now - last_keepalive_ms >= (uint64_t)keepalive_interval_s * 1000ULL) {
-            udp_send(sock, &dst, keepalive_msg, sizeof(keepalive_msg) - 1); // Send keepalive packet
-            last_keepalive_ms = now;
+        /* New parameters from smartcam_ctl: a generation check, no syscall */
+        struct ctl_params req;
+        if (ctl && ctl_poll(ctl, &ctl_gen, &req)) {
+            if (req.keepalive_ms && req.keepalive_ms != live.keepalive_ms)
+                next_ctl_keepalive_ns = now + (uint64_t)req.keepalive_ms * 1000000ULL;
+            live = req;
+            streaming_mode = live.streaming;
+            if (live.motion_now_ms > 0) { // One-shot motion event
+                in_motion = 1;
+                motion_end_ns = now + (uint64_t)live.motion_now_ms * 1000000ULL;
+                motion_meta(&tx, (uint64_t)live.motion_now_ms * 1000000ULL);
+                live.motion_now_ms = 0;
+            }
+            ctl_applied(ctl, ctl_gen, &live);
+            fprintf(stderr, "[ctl] stream=%s base=%.2f motion=%.2f keepalive=%dms (0 = scenario)\n",
+                    streaming_mode ? "on" : "off", live.base_mbps, live.motion_mbps, live.keepalive_ms);
+        }
+        if (live.keepalive_ms && now >= next_ctl_keepalive_ns) {
+            tx_send_raw(&tx, keepalive_msg, sizeof(keepalive_msg) - 1);
+            next_ctl_keepalive_ns = now + (uint64_t)live.keepalive_ms * 1000000ULL;
         }
 
-        /* Motion event scheduling: when due, enter motion state and send metadata */
-        if (!in_motion && now >= next_motion_ms) {
-            in_motion = 1;                       // Enter motion state
-            int dur = motion_duration_s();       // Determine random motion duration
-            motion_end_ms = now + (uint64_t)dur * 1000ULL; // Set motion end timestamp
-            next_motion_ms = motion_end_ms + (uint64_t)next_motion_interval_s(min_motion_interval_s, max_motion_interval_s) * 1000ULL;
-            // Schedule next motion after this one ends
-
-            char meta[256];                      // Buffer for motion metadata
-            int n = snprintf(meta, sizeof(meta),
-                             "{\"type\":\"motion_event\",\"start_ms\":%llu,\"duration_s\":%d}",
-                             (unsigned long long)now, dur); // Format JSON
-            if (n > 0) udp_send(sock, &dst, meta, (size_t)n); // Send motion metadata
-            fprintf(stderr, "[event] motion start t=%llu dur=%ds\n", (unsigned long long)now, dur);
+        /* Act on every timeline event that has come due (all draws were made at compile time) */
+        const struct sc_event *ev;
+        while ((ev = sc_peek(&gen, &timeline, SCENARIO_WINDOW_NS)) && t0 + ev->t_ns <= now) {
+            switch (ev->type) {
+            case SC_EV_PHASE:     // New bitrates for the following packets
+                phase = &scn.phase[ev->phase];
+                if (ev->t_ns) fprintf(stderr, "[event] phase %s t=%llu\n", phase->name, (unsigned long long)now_ms());
+                break;
+            case SC_EV_KEEPALIVE: // Small control/heartbeat, unless smartcam_ctl set its own interval
+                if (!live.keepalive_ms) tx_send_raw(&tx, keepalive_msg, sizeof(keepalive_msg) - 1);
+                break;
+            case SC_EV_SYNC:
+                tx_send_raw(&tx, sync_msg, sizeof(sync_msg) - 1);
+                break;
+            case SC_EV_MOTION:    // Enter motion state and send metadata
+                in_motion = 1;
+                motion_end_ns = t0 + ev->t_ns + ev->dur_ns;
+                motion_meta(&tx, ev->dur_ns);
+                break;
+            case SC_EV_END:       // Scenario duration reached
+                stop = 1;
+                break;
+            }
+            sc_pop(&timeline);
         }
+        if (stop) break;
 
         /* End motion when time elapses */
-        if (in_motion && now >= motion_end_ms) {
+        if (in_motion && now >= motion_end_ns) {
             in_motion = 0; // Exit motion state
-            fprintf(stderr, "[event] motion end t=%llu\n", (unsigned long long)now);
+            fprintf(stderr, "[event] motion end t=%llu\n", (unsigned long long)now_ms());
         }
 
         /* Determine current target packets-per-second */
-        double target_pps = streaming_mode ? (in_motion ? motion_pps : base_pps) : 0.0;
+        double base_mbps = live.base_mbps > 0 ? live.base_mbps : phase->base_mbps;     // smartcam_ctl override
+        double motion_mbps = live.motion_mbps > 0 ? live.motion_mbps : phase->motion_mbps;
+        double target_pps = streaming_mode ? mbps_to_Bps(in_motion ? motion_mbps : base_mbps) / (double)packet_size : 0.0;
         // Use motion PPS if in motion, else base PPS
 
-        /* Throttle by elapsed time (ms) to calculate how many packets to send now */
-        uint64_t elapsed_ms = now - last_send_ms;
-        if (elapsed_ms == 0) {
-            msleep(1); // Prevent division by zero and busy spin
-            continue;
-        }
-        last_send_ms = now;
-
-        double want_packets = (target_pps * (double)elapsed_ms) / 1000.0; // Fractional packets for this interval
-        send_accumulator += want_packets;
-        int to_send = (int)send_accumulator; // Number of whole packets to send
-        send_accumulator -= to_send;          // Keep leftover fractional packets
-
-        /* Send the computed number of packets */
-        for (int i = 0; i < to_send && !stop; ++i) {
-            uint32_t s = (uint32_t)seq++; // Packet sequence number
-            /* simple header (sequence) + filler bytes for plausible payload */
-            memcpy(payload, &s, sizeof(s)); // Copy sequence number at start
-            for (size_t p = sizeof(s); p < packet_size; ++p) {
-                payload[p] = (unsigned char)((s + p) & 0xFF); // Fill rest of packet deterministically
-            }
-            udp_send(sock, &dst, payload, packet_size); // Send UDP packet
+        if (target_pps != current_pps) {     // Rate changed: restart the timeline
+            pacer_set_rate(&pacer, target_pps, now_ns());
+            current_pps = target_pps;
         }
 
-        /* Short sleep to avoid busy spin; loop will wake frequently to keep pacing */
-        msleep(5);
+        /* Sleep until the next packet deadline (or the idle cap) and send what is due.
+           Normally one packet per wake; several only when running behind. */
+        uint64_t limit = now_ns() + IDLE_WAKE_NS;              // Also wake for the next event
+        if (ev && t0 + ev->t_ns < limit) limit = t0 + ev->t_ns;
+        if (in_motion && motion_end_ns < limit) limit = motion_end_ns;
+        if (live.keepalive_ms && next_ctl_keepalive_ns < limit) limit = next_ctl_keepalive_ns;
+        uint64_t woke = pacer_wait(&pacer, limit);
+        unsigned to_send = pacer_due(&pacer, woke, max_burst);
+        if (to_send > 0) {
+            tx_send_stream(&tx, &seq, to_send); // Sequence header + pooled filler
+            pacer_sent(&pacer, now_ns());       // Lateness includes building and sending
+        }
+        if (ctl) ctl_publish(ctl, &tx.stats, current_pps, in_motion, woke); // Plain stores into the shared block
     }
 
-    free(payload); // Release allocated memory
+    tx_report(&tx, stderr); // Packets, syscalls and packets-per-syscall achieved
+    if (tx.ring) {
+        txring_report(&ring, stderr); // Frames/sec and ring-full stalls
+        txring_close(&ring);
+    }
+    pacer_report(&pacer, stderr); // Send-time jitter histogram
+    sc_timeline_free(&timeline);
+    if (ctl) {
+        ctl_detach(ctl);
+        ctl_remove(ctl_name);
+    }
+    tx_free(&tx);
+    tx_pool_free(&pool);  // Release payload pool
     close(sock);   // Close UDP socket
     fprintf(stderr, "Simulation stopped cleanly.\n");
     return 0;
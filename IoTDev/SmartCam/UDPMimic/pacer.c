@@ -0,0 +1,177 @@
+/*
+ * Packet pacing engine for the SmartCam simulator (see pacer.h).
+ */
+
+#define _GNU_SOURCE /* CPU affinity and SCHED_FIFO */
+
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "pacer.h"
+
+uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+void pacer_init(struct pacer *p, uint64_t spin_ns) {
+    memset(p, 0, sizeof(*p));
+    p->spin_ns = spin_ns;
+    p->group = 1;
+}
+
+void pacer_set_group(struct pacer *p, unsigned group, uint64_t max_hold_ns) {
+    p->group = group ? group : 1;
+    p->max_hold_ns = max_hold_ns;
+}
+
+void pacer_set_rate(struct pacer *p, double pps, uint64_t now) {
+    p->interval_ns = pps > 0.0 ? 1e9 / pps : 0.0;
+    p->anchor_ns = now;
+    p->k = 0;
+}
+
+uint64_t pacer_next(const struct pacer *p) {
+    if (p->interval_ns <= 0.0) return UINT64_MAX;
+    return p->anchor_ns + (uint64_t)((double)p->k * p->interval_ns);
+}
+
+uint64_t pacer_wait(struct pacer *p, uint64_t limit) {
+    uint64_t target = pacer_next(p);
+    if (p->group > 1 && target != UINT64_MAX) {
+        /* Hold for as many extra packets as fit in max_hold; none at low rates */
+        uint64_t extra = (uint64_t)((double)p->max_hold_ns / p->interval_ns);
+        if (extra > p->group - 1) extra = p->group - 1;
+        target += (uint64_t)((double)extra * p->interval_ns);
+    }
+    return pacer_wait_until(p, target < limit ? target : limit);
+}
+
+uint64_t pacer_wait_until(struct pacer *p, uint64_t target) {
+    /* Sleep on the absolute timeline, leaving the spin tail (if any) for polling */
+    uint64_t sleep_until = target > p->spin_ns ? target - p->spin_ns : 0;
+    uint64_t now = now_ns();
+    if (now < sleep_until) {
+        struct timespec ts;
+        ts.tv_sec = (time_t)(sleep_until / 1000000000ULL);
+        ts.tv_nsec = (long)(sleep_until % 1000000000ULL);
+        if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            return now_ns(); // Signal: let the caller re-check its stop flag
+        now = now_ns();
+    }
+
+    while (now < target) now = now_ns(); // Busy-poll tail
+    return now;
+}
+
+static void hist_add(struct pacer_hist *h, uint64_t late_ns) {
+    uint64_t us = late_ns / 1000;
+    unsigned b = 0;
+    while (us && b < PACER_HIST_BUCKETS - 1) { us >>= 1; ++b; } // b = bit length of us
+    h->buckets[b]++;
+    h->count++;
+    h->sum_ns += late_ns;
+    if (late_ns > h->max_ns) h->max_ns = late_ns;
+}
+
+void pacer_note(struct pacer *p, uint64_t deadline, uint64_t now) {
+    hist_add(&p->jitter, now > deadline ? now - deadline : 0);
+}
+
+unsigned pacer_due(struct pacer *p, uint64_t now, unsigned max) {
+    if (p->interval_ns <= 0.0) return 0;
+
+    /* Too far behind (stopped, descheduled): skip ahead rather than bursting */
+    uint64_t next = pacer_next(p);
+    if (now > next && now - next > PACER_MAX_LAG_NS) {
+        p->anchor_ns = now;
+        p->k = 0;
+        p->resyncs++;
+    }
+
+    p->due_anchor = p->anchor_ns;
+    p->due_k = p->k;
+    unsigned n = 0;
+    while (n < max && pacer_next(p) <= now) {
+        p->k++;
+        n++;
+    }
+    p->due_n = n;
+    return n;
+}
+
+void pacer_sent(struct pacer *p, uint64_t now) {
+    for (unsigned i = 0; i < p->due_n; ++i) {
+        uint64_t deadline = p->due_anchor + (uint64_t)((double)(p->due_k + i) * p->interval_ns);
+        hist_add(&p->jitter, now > deadline ? now - deadline : 0);
+    }
+    p->due_n = 0;
+}
+
+/* Upper bound (us) of the bucket containing the q-quantile */
+static uint64_t hist_quantile_us(const struct pacer_hist *h, double q) {
+    if (h->count == 0) return 0;
+    uint64_t want = (uint64_t)(q * (double)h->count);
+    uint64_t seen = 0;
+    for (unsigned b = 0; b < PACER_HIST_BUCKETS; ++b) {
+        seen += h->buckets[b];
+        if (seen > want) return 1ULL << b;
+    }
+    return 1ULL << (PACER_HIST_BUCKETS - 1);
+}
+
+void pacer_merge(struct pacer *into, const struct pacer *from) {
+    for (unsigned b = 0; b < PACER_HIST_BUCKETS; ++b) into->jitter.buckets[b] += from->jitter.buckets[b];
+    into->jitter.count += from->jitter.count;
+    into->jitter.sum_ns += from->jitter.sum_ns;
+    if (from->jitter.max_ns > into->jitter.max_ns) into->jitter.max_ns = from->jitter.max_ns;
+    into->resyncs += from->resyncs;
+}
+
+void pacer_report(const struct pacer *p, FILE *out) {
+    const struct pacer_hist *h = &p->jitter;
+    double mean_us = h->count ? (double)h->sum_ns / (double)h->count / 1000.0 : 0.0;
+
+    fprintf(out, "[pacer] packets=%llu mean=%.1fus p50<%lluus p99<%lluus max=%.1fus resyncs=%llu spin=%lluus\n",
+            (unsigned long long)h->count, mean_us,
+            (unsigned long long)hist_quantile_us(h, 0.50),
+            (unsigned long long)hist_quantile_us(h, 0.99),
+            (double)h->max_ns / 1000.0, (unsigned long long)p->resyncs,
+            (unsigned long long)(p->spin_ns / 1000));
+
+    for (unsigned b = 0; b < PACER_HIST_BUCKETS; ++b) {
+        if (!h->buckets[b]) continue;
+        uint64_t lo = b ? 1ULL << (b - 1) : 0;
+        double pct = 100.0 * (double)h->buckets[b] / (double)h->count;
+        char range[48];
+        if (b == PACER_HIST_BUCKETS - 1)
+            snprintf(range, sizeof(range), ">=%lluus", (unsigned long long)lo);
+        else
+            snprintf(range, sizeof(range), "%llu-%lluus", (unsigned long long)lo, (unsigned long long)(1ULL << b));
+        fprintf(out, "[pacer] %16s %12llu %6.2f%%\n", range, (unsigned long long)h->buckets[b], pct);
+    }
+}
+
+int pacer_rt_setup(int cpu, int fifo_prio) {
+    int rc = 0;
+
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) { perror("sched_setaffinity"); rc = -1; }
+    }
+
+    if (fifo_prio > 0) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) perror("mlockall"); // Avoid page faults mid-stream
+        struct sched_param sp;
+        memset(&sp, 0, sizeof(sp));
+        sp.sched_priority = fifo_prio;
+        if (sched_setscheduler(0, SCHED_FIFO, &sp) != 0) { perror("sched_setscheduler"); rc = -1; }
+    }
+    return rc;
+}
@@ -0,0 +1,81 @@
+/*
+ * Packet pacing engine for the SmartCam simulator.
+ *
+ * Every stream packet gets an absolute deadline on a CLOCK_MONOTONIC
+ * nanosecond timeline (anchor + k * interval), so packets are evenly spaced
+ * instead of leaving in per-tick bursts. The sender sleeps with
+ * clock_nanosleep(TIMER_ABSTIME) until the next deadline, optionally
+ * busy-polling the last few microseconds, and the lateness of every packet,
+ * taken when its send call returns, is recorded in a log2 histogram that is
+ * printed on shutdown.
+ */
+
+#ifndef SMARTCAM_PACER_H
+#define SMARTCAM_PACER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define PACER_HIST_BUCKETS 24            /* <1us, 1-2us, 2-4us, ... >=2^22us */
+#define PACER_MAX_LAG_NS   50000000ULL   /* Further behind than this: re-anchor instead of bursting */
+
+/* Send-time lateness histogram (actual send time - scheduled deadline) */
+struct pacer_hist {
+    uint64_t buckets[PACER_HIST_BUCKETS];
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+};
+
+struct pacer {
+    double interval_ns;   // Spacing between packets, 0 when idle
+    uint64_t anchor_ns;   // Deadline of packet k = anchor + k * interval
+    uint64_t k;           // Index of the next packet since the anchor
+    uint64_t spin_ns;     // Busy-poll tail before each deadline (0 = sleep only)
+    unsigned group;       // Packets to let fall due before waking (UDP GSO), 1 = each packet
+    uint64_t max_hold_ns; // Longest a packet may be held back to complete a group
+    uint64_t resyncs;     // Times the timeline was re-anchored after falling behind
+    uint64_t due_anchor;  // Timeline of the packets claimed by the last pacer_due()
+    uint64_t due_k;       // Index of the first of them
+    unsigned due_n;       // How many, 0 once recorded by pacer_sent()
+    struct pacer_hist jitter;
+};
+
+/* Current CLOCK_MONOTONIC time in nanoseconds */
+uint64_t now_ns(void);
+
+void pacer_init(struct pacer *p, uint64_t spin_ns);
+
+/* Change the packet rate; the timeline is re-anchored at `now` */
+void pacer_set_rate(struct pacer *p, double pps, uint64_t now);
+
+/* Wake once `group` packets are due, holding the first back by at most `max_hold_ns` */
+void pacer_set_group(struct pacer *p, unsigned group, uint64_t max_hold_ns);
+
+/* Deadline of the next packet, or UINT64_MAX when idle */
+uint64_t pacer_next(const struct pacer *p);
+
+/* Sleep until the next deadline (at most until `limit`); returns the time on wake */
+uint64_t pacer_wait(struct pacer *p, uint64_t limit);
+
+/* Number of packets due at `now` (at most `max`); claims them for pacer_sent() */
+unsigned pacer_due(struct pacer *p, uint64_t now, unsigned max);
+
+/* Record the lateness of the packets claimed by pacer_due(), whose send call returned at `now` */
+void pacer_sent(struct pacer *p, uint64_t now);
+
+/* Sleep until an explicit deadline (trace replay); returns the time on wake */
+uint64_t pacer_wait_until(struct pacer *p, uint64_t deadline);
+
+/* Record the lateness of one packet sent at `now` against `deadline` */
+void pacer_note(struct pacer *p, uint64_t deadline, uint64_t now);
+
+/* Add the jitter histogram and resync count of `from` into `into` */
+void pacer_merge(struct pacer *into, const struct pacer *from);
+
+void pacer_report(const struct pacer *p, FILE *out);
+
+/* Pin the calling thread to `cpu` (if >= 0), lock memory and switch to SCHED_FIFO (if prio > 0) */
+int pacer_rt_setup(int cpu, int fifo_prio);
+
+#endif /* SMARTCAM_PACER_H */
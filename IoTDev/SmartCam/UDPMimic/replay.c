@@ -0,0 +1,299 @@
+/*
+ * pcap trace replay for the SmartCam simulator (see replay.h).
+ */
+
+#define _GNU_SOURCE /* madvise() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include "replay.h"
+
+#define PCAP_MAGIC_US    0xa1b2c3d4u
+#define PCAP_MAGIC_NS    0xa1b23c4du
+#define PCAP_HDR_LEN     24
+#define PCAP_REC_LEN     16
+#define RELEASE_STEP     (64u << 20)   /* Drop mapped pages every 64 MB of progress */
+#define SRC_TABLE_SIZE   4096          /* Sources tracked when picking the camera flow */
+
+#define DLT_NULL         0
+#define DLT_EN10MB       1
+#define DLT_RAW_BSD      12
+#define DLT_RAW_OPENBSD  14
+#define DLT_RAW          101
+#define DLT_LOOP         108
+#define DLT_LINUX_SLL    113
+#define DLT_LINUX_SLL2   276
+
+struct pcap_map {
+    const unsigned char *base;
+    size_t size;
+    size_t released;       // Bytes at the start already given back with MADV_DONTNEED
+    int swapped;           // File byte order differs from ours
+    int nsec;              // Timestamps in nanoseconds
+    uint32_t linktype;
+};
+
+/* One record, reduced to what the replay needs */
+struct rec {
+    uint64_t ts_ns;
+    uint32_t src;          // IPv4 source (network order), 0 if not IPv4
+    uint8_t proto;         // IPPROTO_UDP/IPPROTO_TCP, 0 otherwise
+    size_t payload;        // Transport payload length from the IP header
+};
+
+static uint32_t rd32(const struct pcap_map *m, const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return m->swapped ? __builtin_bswap32(v) : v;
+}
+
+static uint16_t be16(const unsigned char *p) { return (uint16_t)(p[0] << 8 | p[1]); }
+
+static int map_open(const char *path, struct pcap_map *m) {
+    memset(m, 0, sizeof(*m));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { perror(path); return -1; }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < PCAP_HDR_LEN) {
+        fprintf(stderr, "%s: not a pcap file\n", path);
+        close(fd);
+        return -1;
+    }
+    m->size = (size_t)st.st_size;
+    void *p = mmap(NULL, m->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file referenced
+    if (p == MAP_FAILED) { perror("mmap"); return -1; }
+    m->base = p;
+    madvise(p, m->size, MADV_SEQUENTIAL); // Aggressive readahead, early reclaim
+
+    uint32_t magic;
+    memcpy(&magic, m->base, sizeof(magic));
+    if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS) {
+        m->swapped = 0;
+    } else if (__builtin_bswap32(magic) == PCAP_MAGIC_US || __builtin_bswap32(magic) == PCAP_MAGIC_NS) {
+        m->swapped = 1;
+        magic = __builtin_bswap32(magic);
+    } else {
+        fprintf(stderr, "%s: unsupported capture format (pcapng? convert with editcap -F pcap)\n", path);
+        munmap(p, m->size);
+        return -1;
+    }
+    m->nsec = magic == PCAP_MAGIC_NS;
+    m->linktype = rd32(m, m->base + 20) & 0x0FFFFFFF; // Upper bits carry FCS flags
+    return 0;
+}
+
+static void map_close(struct pcap_map *m) {
+    if (m->base) munmap((void *)m->base, m->size);
+    m->base = NULL;
+}
+
+/* Give back the pages behind `off` so resident memory stays constant */
+static void map_release(struct pcap_map *m, size_t off) {
+    long page = sysconf(_SC_PAGESIZE);
+    size_t upto = off & ~((size_t)page - 1);
+    if (upto <= m->released) return;
+    madvise((void *)(m->base + m->released), upto - m->released, MADV_DONTNEED);
+    m->released = upto;
+}
+
+/* Locate the IPv4 header inside a link-layer frame; NULL if not IPv4 */
+static const unsigned char *l3_start(uint32_t linktype, const unsigned char *f, size_t caplen, size_t *left) {
+    size_t off;
+    uint16_t proto;
+
+    switch (linktype) {
+    case DLT_EN10MB:
+        if (caplen < 14) return NULL;
+        off = 12;
+        proto = be16(f + off);
+        while ((proto == 0x8100 || proto == 0x88a8) && caplen >= off + 6) { // 802.1Q / QinQ tags
+            off += 4;
+            proto = be16(f + off);
+        }
+        off += 2;
+        if (proto != 0x0800) return NULL;
+        break;
+    case DLT_LINUX_SLL:
+        if (caplen < 16 || be16(f + 14) != 0x0800) return NULL;
+        off = 16;
+        break;
+    case DLT_LINUX_SLL2:
+        if (caplen < 20 || be16(f) != 0x0800) return NULL;
+        off = 20;
+        break;
+    case DLT_NULL:
+    case DLT_LOOP: {
+        if (caplen < 4) return NULL;
+        uint32_t fam;
+        memcpy(&fam, f, sizeof(fam));
+        if (fam != 2 && __builtin_bswap32(fam) != 2) return NULL; // AF_INET in either byte order
+        off = 4;
+        break;
+    }
+    case DLT_RAW:
+    case DLT_RAW_BSD:
+    case DLT_RAW_OPENBSD:
+        off = 0;
+        break;
+    default:
+        return NULL;
+    }
+
+    if (caplen < off + 20 || (f[off] >> 4) != 4) return NULL;
+    *left = caplen - off;
+    return f + off;
+}
+
+/* Parse the record at *off; returns 1 and advances *off, 0 at end of file */
+static int next_record(const struct pcap_map *m, size_t *off, struct rec *r) {
+    if (*off + PCAP_REC_LEN > m->size) return 0;
+    const unsigned char *h = m->base + *off;
+    uint32_t sec = rd32(m, h), frac = rd32(m, h + 4), caplen = rd32(m, h + 8);
+    if (*off + PCAP_REC_LEN + caplen > m->size) return 0; // Truncated final record
+
+    r->ts_ns = (uint64_t)sec * 1000000000ULL + (m->nsec ? frac : (uint64_t)frac * 1000ULL);
+    r->src = 0;
+    r->proto = 0;
+    r->payload = 0;
+
+    size_t left;
+    const unsigned char *ip = l3_start(m->linktype, h + PCAP_REC_LEN, caplen, &left);
+    *off += PCAP_REC_LEN + caplen;
+    if (!ip) return 1;
+
+    /* Sizes come from the headers, not caplen, so snaplen-truncated captures still replay at full size */
+    size_t ihl = (size_t)(ip[0] & 0x0F) * 4;
+    size_t total = be16(ip + 2);
+    if ((be16(ip + 6) & 0x1FFF) != 0) return 1; // Non-first fragment: counted with the first
+    if (ihl < 20 || total < ihl || left < ihl) return 1;
+
+    if (ip[9] == IPPROTO_UDP && left >= ihl + 8 && be16(ip + ihl + 4) >= 8) {
+        r->payload = be16(ip + ihl + 4) - 8u; // UDP length covers the whole datagram, even if fragmented
+    } else if (ip[9] == IPPROTO_TCP && left >= ihl + 13) {
+        size_t thl = (size_t)(ip[ihl + 12] >> 4) * 4;
+        if (thl < 20 || total < ihl + thl) return 1;
+        r->payload = total - ihl - thl;
+    } else {
+        return 1;
+    }
+    r->proto = ip[9];
+    memcpy(&r->src, ip + 12, sizeof(r->src));
+    return 1;
+}
+
+/* First pass: the IPv4 source with the most UDP/TCP payload bytes */
+static uint32_t busiest_source(struct pcap_map *m) {
+    struct { uint32_t addr; uint64_t bytes; } *tab = calloc(SRC_TABLE_SIZE, sizeof(*tab));
+    if (!tab) return 0;
+
+    struct rec r;
+    size_t off = PCAP_HDR_LEN;
+    while (next_record(m, &off, &r)) {
+        if (!r.proto || !r.src) continue;
+        uint32_t h = (ntohl(r.src) * 2654435761u) & (SRC_TABLE_SIZE - 1);
+        for (unsigned probe = 0; probe < SRC_TABLE_SIZE; ++probe, h = (h + 1) & (SRC_TABLE_SIZE - 1)) {
+            if (tab[h].addr == r.src || tab[h].addr == 0) {
+                tab[h].addr = r.src;
+                tab[h].bytes += r.payload;
+                break;
+            }
+        }
+        if (off - m->released >= RELEASE_STEP) map_release(m, off);
+    }
+
+    uint32_t best = 0;
+    uint64_t best_bytes = 0;
+    for (unsigned i = 0; i < SRC_TABLE_SIZE; ++i)
+        if (tab[i].addr && tab[i].bytes > best_bytes) { best = tab[i].addr; best_bytes = tab[i].bytes; }
+    free(tab);
+
+    /* Start the replay with nothing resident */
+    madvise((void *)m->base, m->size, MADV_DONTNEED);
+    m->released = 0;
+    return best;
+}
+
+int replay_run(const struct replay_cfg *cfg, struct tx_ctx *tx, struct pacer *pacer,
+               volatile sig_atomic_t *stop) {
+    struct pcap_map m;
+    if (map_open(cfg->path, &m) != 0) return 1;
+
+    uint32_t flow = 0;
+    if (cfg->flow_src) {
+        struct in_addr a;
+        if (inet_pton(AF_INET, cfg->flow_src, &a) != 1) {
+            fprintf(stderr, "Invalid flow source: %s\n", cfg->flow_src);
+            map_close(&m);
+            return 1;
+        }
+        flow = a.s_addr;
+    } else {
+        flow = busiest_source(&m);
+    }
+
+    char flow_str[INET_ADDRSTRLEN];
+    struct in_addr fa = { .s_addr = flow };
+    inet_ntop(AF_INET, &fa, flow_str, sizeof(flow_str));
+    fprintf(stderr, "[replay] file=%s linktype=%u flow_src=%s speed=%.3fx loop=%s\n",
+            cfg->path, m.linktype, flow ? flow_str : "(none)", cfg->speed, cfg->loop ? "yes" : "no");
+    if (!flow) {
+        fprintf(stderr, "[replay] no UDP/TCP traffic found\n");
+        map_close(&m);
+        return 1;
+    }
+
+    uint64_t seq = 0, replayed = 0, clamped = 0, loops = 0;
+    uint64_t t_base = now_ns();      // Wall-clock deadline of the first packet of this pass
+    uint64_t last_deadline = t_base;
+    uint64_t mean_gap = 0;           // Average inter-arrival, used to space passes when looping
+
+    while (!*stop) {
+        size_t off = PCAP_HDR_LEN;
+        uint64_t first_ts = 0, prev_ts = 0, pass_pkts = 0;
+        struct rec r;
+
+        while (!*stop && next_record(&m, &off, &r)) {
+            if (off - m.released >= RELEASE_STEP) map_release(&m, off);
+            if (r.src != flow || r.payload == 0) continue; // Other hosts, bare ACKs
+
+            if (pass_pkts == 0) first_ts = prev_ts = r.ts_ns;
+            if (r.ts_ns < prev_ts) r.ts_ns = prev_ts; // Keep the timeline monotonic
+            prev_ts = r.ts_ns;
+
+            uint64_t deadline = t_base + (uint64_t)((double)(r.ts_ns - first_ts) / cfg->speed);
+            uint64_t now = now_ns();
+            while (now < deadline && !*stop) now = pacer_wait_until(pacer, deadline);
+            if (*stop) break;
+
+            if (r.payload > TX_MAX_DGRAM) clamped++; // GRO/TSO super-segments
+            tx_send_sized(tx, &seq, r.payload);
+            pacer_note(pacer, deadline, now_ns());
+            last_deadline = deadline;
+            pass_pkts++;
+        }
+
+        replayed += pass_pkts;
+        if (pass_pkts > 1) mean_gap = (last_deadline - t_base) / (pass_pkts - 1);
+        if (!cfg->loop || pass_pkts == 0 || *stop) break;
+        loops++;
+        t_base = last_deadline + mean_gap; // Next pass continues the timeline
+        madvise((void *)m.base, m.size, MADV_DONTNEED);
+        m.released = 0;
+    }
+
+    fprintf(stderr, "[replay] packets=%llu loops=%llu clamped=%llu\n",
+            (unsigned long long)replayed, (unsigned long long)loops, (unsigned long long)clamped);
+    map_close(&m);
+    return 0;
+}
@@ -0,0 +1,35 @@
+/*
+ * pcap trace replay for the SmartCam simulator.
+ *
+ * The capture is memory-mapped and walked record by record; nothing is
+ * copied to the heap, and pages behind the read cursor are released as the
+ * replay advances, so multi-GB captures replay in constant memory. Packets
+ * from the camera flow (one IPv4 source) keep their transport payload size
+ * and inter-arrival time and are re-emitted as stream datagrams through the
+ * normal UDP socket.
+ *
+ * Supported: classic pcap (us and ns timestamps, either byte order) with
+ * Ethernet (incl. 802.1Q), Linux cooked (SLL/SLL2), raw IP and BSD loopback
+ * link types. pcapng is not supported; convert with `editcap -F pcap`.
+ */
+
+#ifndef SMARTCAM_REPLAY_H
+#define SMARTCAM_REPLAY_H
+
+#include <signal.h>
+
+#include "tx.h"
+#include "pacer.h"
+
+struct replay_cfg {
+    const char *path;      // pcap file
+    const char *flow_src;  // Camera IPv4 source, NULL = busiest UDP/TCP sender
+    double speed;          // Time-scale factor: 2.0 replays twice as fast
+    int loop;              // Start over at end of file
+};
+
+/* Replay until end of file (or *stop when looping); returns 0 on success */
+int replay_run(const struct replay_cfg *cfg, struct tx_ctx *tx, struct pacer *pacer,
+               volatile sig_atomic_t *stop);
+
+#endif /* SMARTCAM_REPLAY_H */
@@ -0,0 +1,160 @@
+/*
+ * smartcam_ctl: retune and watch a running smartcam_sim through its
+ * shared-memory control block (smartcam_sim -C <name>, see ctl.h)
+ *
+ * Build x86:
+ *   gcc -O2 -std=c11 -o smartcam_ctl smartcam_ctl.c ctl.c -lrt
+ * Build Arm64:
+ *   aarch64-linux-gnu-gcc -O2 -std=c11 -o smartcam_ctl smartcam_ctl.c ctl.c -lrt
+ *
+ * Usage:
+ *   ./smartcam_ctl [-C <name>] status
+ *   ./smartcam_ctl [-C <name>] watch [interval_ms]
+ *   ./smartcam_ctl [-C <name>] set <key>=<value> ...
+ *   ./smartcam_ctl [-C <name>] motion <seconds>
+ *
+ * Keys for set:
+ *   stream=on|off        Pause or resume the stream
+ *   base=<mbps>          Base bitrate (0 = back to the scenario's)
+ *   motion=<mbps>        Motion bitrate (0 = back to the scenario's)
+ *   keepalive=<sec>      Keepalive interval (0 = back to the scenario's)
+ *
+ * Options:
+ *   -C <name>    Control block name under /dev/shm (default: smartcam)
+ *   -h           Show this help and exit
+ */
+
+#define _POSIX_C_SOURCE 200809L /* nanosleep(), clock_gettime() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "ctl.h"
+
+#define ACK_TIMEOUT_MS 1000
+
+volatile sig_atomic_t stop = 0;
+static void handle_sigint(int sig) { (void)sig; stop = 1; }
+
+static uint64_t mono_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+static void sleep_us(long us) {
+    struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+static const char *rate_str(double mbps, char *buf, size_t len) {
+    if (mbps > 0) snprintf(buf, len, "%.2fMbps", mbps);
+    else snprintf(buf, len, "scenario");
+    return buf;
+}
+
+static void print_status(struct ctl_block *b) {
+    uint64_t age = mono_ns() - atomic_load(&b->updated_ns);
+    char base[32], motion[32], ka[32];
+    int32_t ka_ms = atomic_load(&b->keepalive_ms);
+    if (ka_ms > 0) snprintf(ka, sizeof(ka), "%.3fs", ka_ms / 1000.0);
+    else snprintf(ka, sizeof(ka), "scenario");
+    printf("pid=%d stream=%s base=%s motion=%s keepalive=%s in_motion=%d\n",
+           b->pid, atomic_load(&b->streaming) ? "on" : "off",
+           rate_str(atomic_load(&b->base_mbps), base, sizeof(base)),
+           rate_str(atomic_load(&b->motion_mbps), motion, sizeof(motion)), ka,
+           atomic_load(&b->in_motion));
+    printf("packets=%llu bytes=%llu syscalls=%llu errors=%llu eagain=%llu target_pps=%.1f pps=%.1f updated=%.1fms ago\n",
+           (unsigned long long)atomic_load(&b->packets), (unsigned long long)atomic_load(&b->bytes),
+           (unsigned long long)atomic_load(&b->syscalls), (unsigned long long)atomic_load(&b->errors),
+           (unsigned long long)atomic_load(&b->eagain), atomic_load(&b->target_pps),
+           atomic_load(&b->current_pps), (double)age / 1e6);
+}
+
+/* Write a request and wait for the sender to apply it */
+static int send_request(struct ctl_block *b, const struct ctl_params *p) {
+    uint64_t t0 = mono_ns();
+    uint64_t gen = ctl_request(b, p);
+    while (atomic_load(&b->applied_gen) < gen) {
+        if (mono_ns() - t0 > ACK_TIMEOUT_MS * 1000000ULL) {
+            fprintf(stderr, "No acknowledgement from pid %d within %dms (not running?)\n", b->pid, ACK_TIMEOUT_MS);
+            return 1;
+        }
+        sleep_us(50);
+    }
+    printf("applied in %.3fms\n", (double)(mono_ns() - t0) / 1e6);
+    return 0;
+}
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-C <name>] status | watch [ms] | set key=value... | motion <sec>\n"
+            "  keys: stream=on|off base=<mbps> motion=<mbps> keepalive=<sec> (0 = scenario's)\n"
+            "  -C <name>    Control block name under /dev/shm (default: smartcam)\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    const char *name = "smartcam";
+    int opt;
+    while ((opt = getopt(argc, argv, "C:h")) != -1) {
+        switch (opt) {
+        case 'C': name = optarg; break;
+        case 'h':
+        default:
+            print_usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind >= argc) { print_usage(argv[0]); return 1; }
+    const char *cmd = argv[optind++];
+
+    struct ctl_block *b = ctl_attach(name);
+    if (!b) return 1;
+
+    int rc = 0;
+    if (strcmp(cmd, "status") == 0) {
+        print_status(b);
+    } else if (strcmp(cmd, "watch") == 0) {
+        long ms = optind < argc ? atol(argv[optind]) : 500;
+        if (ms < 1) ms = 1;
+        signal(SIGINT, handle_sigint);
+        while (!stop) {
+            print_status(b);
+            fflush(stdout);
+            sleep_us(ms * 1000);
+        }
+    } else if (strcmp(cmd, "set") == 0 || strcmp(cmd, "motion") == 0) {
+        struct ctl_params p;
+        ctl_current(b, &p); // Unchanged keys keep their current values
+        if (strcmp(cmd, "motion") == 0) {
+            double secs = optind < argc ? strtod(argv[optind], NULL) : 0;
+            if (secs <= 0) { fprintf(stderr, "motion needs a duration in seconds\n"); rc = 1; }
+            p.motion_now_ms = (int32_t)(secs * 1000.0);
+        }
+        for (int i = optind; rc == 0 && strcmp(cmd, "set") == 0 && i < argc; ++i) {
+            char *eq = strchr(argv[i], '=');
+            if (!eq) { fprintf(stderr, "Expected key=value: %s\n", argv[i]); rc = 1; break; }
+            *eq = '\0';
+            const char *key = argv[i], *val = eq + 1;
+            if (strcmp(key, "stream") == 0) p.streaming = strcmp(val, "on") == 0 || strcmp(val, "1") == 0;
+            else if (strcmp(key, "base") == 0) p.base_mbps = strtod(val, NULL);
+            else if (strcmp(key, "motion") == 0) p.motion_mbps = strtod(val, NULL);
+            else if (strcmp(key, "keepalive") == 0) p.keepalive_ms = (int32_t)(strtod(val, NULL) * 1000.0);
+            else { fprintf(stderr, "Unknown key: %s\n", key); rc = 1; }
+            if (p.base_mbps < 0 || p.motion_mbps < 0 || p.keepalive_ms < 0) { fprintf(stderr, "Negative value for %s\n", key); rc = 1; }
+        }
+        if (rc == 0) rc = send_request(b, &p);
+    } else {
+        print_usage(argv[0]);
+        rc = 1;
+    }
+
+    ctl_detach(b);
+    return rc;
+}
@@ -0,0 +1,98 @@
+/*
+ * Hashed timer wheel shared by the fleet workers (see twheel.h).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "twheel.h"
+
+int tw_init(struct twheel *w, unsigned lanes, unsigned slots, uint64_t tick_ns, uint64_t start_ns) {
+    unsigned s = 1;
+    while (s < slots) s <<= 1; // Round up to a power of two for cheap masking
+
+    w->start_ns = start_ns;
+    w->tick_ns = tick_ns ? tick_ns : 1;
+    w->slots = s;
+    w->lanes = lanes;
+    w->slot = calloc((size_t)lanes * s, sizeof(*w->slot));
+    w->lane = aligned_alloc(TW_CACHE_LINE, (size_t)lanes * sizeof(*w->lane)); // sizeof is a line multiple
+    if (!w->slot || !w->lane) { tw_free(w); return -1; }
+    memset(w->lane, 0, (size_t)lanes * sizeof(*w->lane));
+    for (unsigned i = 0; i < lanes; ++i) w->lane[i].armed = UINT64_MAX;
+    return 0;
+}
+
+void tw_free(struct twheel *w) {
+    free(w->slot);
+    free(w->lane);
+    w->slot = NULL;
+    w->lane = NULL;
+}
+
+void tw_schedule(struct twheel *w, unsigned lane, struct tw_timer *t, uint64_t deadline_ns) {
+    struct tw_lane *l = &w->lane[lane];
+    uint64_t rel = deadline_ns > w->start_ns ? deadline_ns - w->start_ns : 0;
+    uint64_t tick = (rel + w->tick_ns - 1) / w->tick_ns; // Never fire early
+    if (tick < l->cursor) tick = l->cursor;              // Already passed: fire on the next expiry
+
+    struct tw_timer **head = &w->slot[(size_t)lane * w->slots + (tick & (w->slots - 1))];
+    t->tick = tick;
+    t->next = *head;
+    *head = t;
+    if (tick < l->armed) l->armed = tick;
+}
+
+struct tw_timer *tw_expire(struct twheel *w, unsigned lane, uint64_t now_ns) {
+    struct tw_lane *l = &w->lane[lane];
+    if (now_ns < w->start_ns) return NULL;
+    uint64_t now_tick = (now_ns - w->start_ns) / w->tick_ns;
+    uint64_t first = l->cursor;
+    if (now_tick < first) return NULL;
+
+    /* Visit each slot between the cursor and now once; entries for later
+       rounds of the wheel stay where they are */
+    uint64_t span = now_tick - first + 1;
+    if (span > w->slots) span = w->slots;
+
+    struct tw_timer *out = NULL;
+    struct tw_timer **base = &w->slot[(size_t)lane * w->slots];
+    for (uint64_t i = 0; i < span; ++i) {
+        struct tw_timer **pp = &base[(first + i) & (w->slots - 1)];
+        while (*pp) {
+            struct tw_timer *t = *pp;
+            if (t->tick <= now_tick) {
+                *pp = t->next; // Unlink and hand back to the caller
+                t->next = out;
+                out = t;
+            } else {
+                pp = &t->next;
+            }
+        }
+    }
+
+    l->cursor = now_tick + 1;
+    return out;
+}
+
+uint64_t tw_next_tick_ns(const struct twheel *w, unsigned lane) {
+    return w->start_ns + w->lane[lane].cursor * w->tick_ns;
+}
+
+uint64_t tw_next_armed_ns(struct twheel *w, unsigned lane) {
+    struct tw_lane *l = &w->lane[lane];
+    if (l->armed != UINT64_MAX && l->armed < l->cursor) {
+        /* The earliest timer has been expired: walk one revolution from the
+           cursor. The first slot holding a timer for its own round is the
+           answer; otherwise the minimum over later rounds is. */
+        struct tw_timer **base = &w->slot[(size_t)lane * w->slots];
+        uint64_t best = UINT64_MAX;
+        for (uint64_t i = 0; i < w->slots; ++i) {
+            for (const struct tw_timer *t = base[(l->cursor + i) & (w->slots - 1)]; t; t = t->next)
+                if (t->tick < best) best = t->tick;
+            if (best == l->cursor + i) break;
+        }
+        l->armed = best;
+    }
+    return l->armed == UINT64_MAX ? UINT64_MAX : w->start_ns + l->armed * w->tick_ns;
+}
@@ -0,0 +1,56 @@
+/*
+ * Hashed timer wheel shared by the fleet workers.
+ *
+ * All workers run on the same wheel geometry and epoch (start time, tick
+ * length, slot count), so a deadline maps to the same tick everywhere. Each
+ * worker owns one lane of slots, which keeps timer insertion and expiry
+ * lock-free: a device is only ever scheduled on the lane of the worker that
+ * owns it. Per-lane bookkeeping is padded to a cache line so workers
+ * advancing their cursors do not share lines.
+ */
+
+#ifndef SMARTCAM_TWHEEL_H
+#define SMARTCAM_TWHEEL_H
+
+#include <stdalign.h>
+#include <stdint.h>
+
+#define TW_CACHE_LINE 64
+
+/* Intrusive timer, embedded in whatever is being scheduled */
+struct tw_timer {
+    struct tw_timer *next;
+    uint64_t tick;        // Absolute tick the timer fires on
+};
+
+/* Written by the owning worker only, one cache line per lane */
+struct tw_lane {
+    alignas(TW_CACHE_LINE) uint64_t cursor; // Next tick not yet expired
+    uint64_t armed;       // Earliest armed tick, UINT64_MAX = none; recomputed once the cursor passes it
+};
+
+struct twheel {
+    uint64_t start_ns;    // Epoch of tick 0 (CLOCK_MONOTONIC)
+    uint64_t tick_ns;     // Tick length
+    unsigned slots;       // Slots per lane (power of two)
+    unsigned lanes;       // One lane per worker
+    struct tw_timer **slot; // lanes * slots list heads
+    struct tw_lane *lane; // lanes entries
+};
+
+int  tw_init(struct twheel *w, unsigned lanes, unsigned slots, uint64_t tick_ns, uint64_t start_ns);
+void tw_free(struct twheel *w);
+
+/* Schedule `t` on `lane` to fire at `deadline_ns` (rounded up to a tick) */
+void tw_schedule(struct twheel *w, unsigned lane, struct tw_timer *t, uint64_t deadline_ns);
+
+/* Unlink every timer on `lane` due at or before `now_ns`; returns them as a list */
+struct tw_timer *tw_expire(struct twheel *w, unsigned lane, uint64_t now_ns);
+
+/* Start time of the lane's next unexpired tick */
+uint64_t tw_next_tick_ns(const struct twheel *w, unsigned lane);
+
+/* Start time of the tick of the lane's earliest armed timer, UINT64_MAX if none */
+uint64_t tw_next_armed_ns(struct twheel *w, unsigned lane);
+
+#endif /* SMARTCAM_TWHEEL_H */
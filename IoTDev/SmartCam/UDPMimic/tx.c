@@ -0,0 +1,267 @@
+/*
+ * Transmit path for the SmartCam simulator stream (see tx.h).
+ */
+
+#define _GNU_SOURCE /* sendmmsg() and struct mmsghdr */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <netinet/udp.h> // UDP_SEGMENT
+
+#include "tx.h"
+#include "txring.h"
+
+/* Fill every slot with the filler pattern of its low sequence byte */
+int tx_pool_init(struct tx_pool *pool, size_t pkt_size) {
+    pool->pkt_size = pkt_size;
+    pool->slots = malloc((size_t)TX_POOL_SLOTS * pkt_size);
+    if (!pool->slots) return -1;
+
+    for (unsigned s = 0; s < TX_POOL_SLOTS; ++s) {
+        unsigned char *slot = pool->slots + (size_t)s * pkt_size;
+        uint32_t hdr = s;
+        memcpy(slot, &hdr, sizeof(hdr)); // Overwritten on every send
+        for (size_t p = sizeof(hdr); p < pkt_size; ++p)
+            slot[p] = (unsigned char)((s + p) & 0xFF); // Same pattern as the per-packet fill
+    }
+    return 0;
+}
+
+void tx_pool_free(struct tx_pool *pool) {
+    free(pool->slots);
+    pool->slots = NULL;
+}
+
+int tx_init(struct tx_ctx *tx, int sock, const struct sockaddr_in *dst,
+            const struct tx_pool *pool, unsigned batch) {
+    memset(tx, 0, sizeof(*tx));
+    tx->sock = sock;
+    tx->dst = *dst;
+    tx->pool = pool;
+    if (batch < 1) batch = 1;
+    if (batch > TX_MAX_BATCH) batch = TX_MAX_BATCH;
+    tx->batch = batch;
+
+    if (batch > 1) {
+        tx->msgs = calloc(batch, sizeof(*tx->msgs));
+        tx->iov = calloc(batch, sizeof(*tx->iov));
+        if (!tx->msgs || !tx->iov) { tx_free(tx); return -1; }
+
+        /* Everything but the iovec base is fixed, so set it up once */
+        for (unsigned i = 0; i < batch; ++i) {
+            tx->iov[i].iov_len = pool->pkt_size;
+            tx->msgs[i].msg_hdr.msg_name = &tx->dst;
+            tx->msgs[i].msg_hdr.msg_namelen = sizeof(tx->dst);
+            tx->msgs[i].msg_hdr.msg_iov = &tx->iov[i];
+            tx->msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+    return 0;
+}
+
+void tx_free(struct tx_ctx *tx) {
+    free(tx->msgs);
+    free(tx->iov);
+    tx->msgs = NULL;
+    tx->iov = NULL;
+}
+
+static void note_error(struct tx_ctx *tx) {
+    tx->stats.errors++;
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) tx->stats.eagain++;
+}
+
+/* Patch the sequence header of the slot that seq maps to and return it */
+static unsigned char *stamp(const struct tx_pool *pool, uint64_t seq) {
+    uint32_t s = (uint32_t)seq;
+    unsigned char *slot = pool->slots + (size_t)(s % TX_POOL_SLOTS) * pool->pkt_size;
+    memcpy(slot, &s, sizeof(s));
+    return slot;
+}
+
+/* One sendto() per datagram */
+static void send_single(struct tx_ctx *tx, uint64_t *seq, unsigned count) {
+    const size_t len = tx->pool->pkt_size;
+    for (unsigned i = 0; i < count; ++i) {
+        unsigned char *p = stamp(tx->pool, (*seq)++);
+        tx->stats.syscalls++;
+        if (sendto(tx->sock, p, len, 0, (const struct sockaddr *)&tx->dst, sizeof(tx->dst)) < 0) {
+            note_error(tx);
+            continue; // Fire-and-forget, as before
+        }
+        tx->stats.packets++;
+        tx->stats.bytes += len;
+    }
+}
+
+/* Up to `batch` datagrams per sendmmsg() */
+static void send_batched(struct tx_ctx *tx, uint64_t *seq, unsigned count) {
+    const size_t len = tx->pool->pkt_size;
+    while (count > 0) {
+        unsigned n = count < tx->batch ? count : tx->batch;
+        for (unsigned i = 0; i < n; ++i)
+            tx->iov[i].iov_base = stamp(tx->pool, (*seq)++);
+        count -= n;
+
+        /* sendmmsg() may stop early; resubmit the tail until it errors */
+        unsigned done = 0;
+        while (done < n) {
+            tx->stats.syscalls++;
+            int r = sendmmsg(tx->sock, tx->msgs + done, n - done, 0);
+            if (r < 0) {
+                note_error(tx); // Drop the rest of this batch
+                break;
+            }
+            done += (unsigned)r;
+            tx->stats.packets += (uint64_t)r;
+            tx->stats.bytes += (uint64_t)r * len;
+        }
+    }
+}
+
+unsigned tx_enable_gso(struct tx_ctx *tx, unsigned segs) {
+    unsigned max = TX_MAX_DGRAM / (unsigned)tx->pool->pkt_size;
+    if (segs > max) segs = max;
+    if (segs > TX_MAX_GSO) segs = TX_MAX_GSO;
+    tx->gso = 0;
+    if (segs < 2) return 0;
+
+    /* Probe: kernels without UDP GSO reject the option outright */
+    int size = (int)tx->pool->pkt_size;
+    if (setsockopt(tx->sock, SOL_UDP, UDP_SEGMENT, &size, sizeof(size)) != 0) return 0;
+    size = 0; // Segment per call through a cmsg instead, keepalives stay untouched
+    setsockopt(tx->sock, SOL_UDP, UDP_SEGMENT, &size, sizeof(size));
+    tx->gso = segs;
+    return segs;
+}
+
+/* One sendmsg() per run of adjacent pool slots, segmented by the kernel */
+static void send_gso(struct tx_ctx *tx, uint64_t *seq, unsigned count) {
+    const size_t len = tx->pool->pkt_size;
+    union { char buf[CMSG_SPACE(sizeof(uint16_t))]; struct cmsghdr align; } ctrl;
+
+    while (count > 0 && tx->gso) {
+        /* Consecutive sequence numbers use consecutive slots until slot 255 wraps */
+        unsigned first = (uint32_t)*seq % TX_POOL_SLOTS;
+        unsigned n = count < tx->gso ? count : tx->gso;
+        if (first + n > TX_POOL_SLOTS) n = TX_POOL_SLOTS - first;
+
+        unsigned char *base = stamp(tx->pool, *seq);
+        for (unsigned i = 1; i < n; ++i) stamp(tx->pool, *seq + i);
+
+        struct iovec iov = { base, (size_t)n * len };
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &tx->dst;
+        msg.msg_namelen = sizeof(tx->dst);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        if (n > 1) {
+            msg.msg_control = ctrl.buf;
+            msg.msg_controllen = sizeof(ctrl.buf);
+            struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t gso_size = (uint16_t)len;
+            memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+        }
+
+        tx->stats.syscalls++;
+        if (sendmsg(tx->sock, &msg, 0) < 0) {
+            if (n > 1 && (errno == EINVAL || errno == EIO || errno == EOPNOTSUPP || errno == ENOPROTOOPT)) {
+                /* Route/device cannot segment: fall back for good and resend these normally */
+                fprintf(stderr, "[tx] UDP GSO rejected (%s), falling back to %s\n",
+                        strerror(errno), tx->batch > 1 ? "sendmmsg" : "sendto");
+                tx->gso = 0;
+                tx->stats.syscalls--;
+                break;
+            }
+            note_error(tx);
+            *seq += n; // Fire-and-forget: the sequence numbers are spent
+            count -= n;
+            continue;
+        }
+        *seq += n;
+        count -= n;
+        tx->stats.packets += n;
+        tx->stats.bytes += (uint64_t)n * len;
+        tx->stats.gso_sends++;
+        tx->stats.gso_segs += n;
+    }
+
+    if (count > 0) tx_send_stream(tx, seq, count); // After a fallback
+}
+
+void tx_send_stream(struct tx_ctx *tx, uint64_t *seq, unsigned count) {
+    if (tx->ring) {
+        /* Same counters as the socket paths, so tx_report() and -C see the ring */
+        struct txring_stats before = tx->ring->stats;
+        txring_send(tx->ring, seq, count);
+        uint64_t frames = tx->ring->stats.frames - before.frames;
+        tx->stats.packets += frames;
+        tx->stats.bytes += frames * tx->pool->pkt_size;
+        tx->stats.syscalls += tx->ring->stats.flushes - before.flushes;
+        tx->stats.errors += tx->ring->stats.errors - before.errors;
+        return;
+    }
+    if (tx->gso) { send_gso(tx, seq, count); return; }
+    if (tx->batch > 1) send_batched(tx, seq, count);
+    else send_single(tx, seq, count);
+}
+
+/* Byte i is i & 0xFF, so the filler of any sequence number s starts at
+   offset (s & 0xFF): sized packets need no per-length pool */
+static unsigned char filler[TX_POOL_SLOTS + TX_MAX_DGRAM];
+
+void tx_send_sized(struct tx_ctx *tx, uint64_t *seq, size_t len) {
+    if (filler[1] == 0)
+        for (size_t i = 0; i < sizeof(filler); ++i) filler[i] = (unsigned char)(i & 0xFF);
+
+    uint32_t s = (uint32_t)(*seq)++;
+    if (len < sizeof(s)) len = sizeof(s);
+    if (len > TX_MAX_DGRAM) len = TX_MAX_DGRAM;
+
+    /* Header and filler as two iovecs: nothing is copied in user space */
+    struct iovec iov[2];
+    iov[0].iov_base = &s;
+    iov[0].iov_len = sizeof(s);
+    iov[1].iov_base = filler + (s & 0xFF) + sizeof(s);
+    iov[1].iov_len = len - sizeof(s);
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &tx->dst;
+    msg.msg_namelen = sizeof(tx->dst);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    tx->stats.syscalls++;
+    if (sendmsg(tx->sock, &msg, 0) < 0) {
+        note_error(tx);
+        return;
+    }
+    tx->stats.packets++;
+    tx->stats.bytes += len;
+}
+
+void tx_send_raw(struct tx_ctx *tx, const void *buf, size_t len) {
+    if (sendto(tx->sock, buf, len, 0, (const struct sockaddr *)&tx->dst, sizeof(tx->dst)) < 0)
+        note_error(tx);
+}
+
+void tx_report(const struct tx_ctx *tx, FILE *out) {
+    const struct tx_stats *st = &tx->stats;
+    double per_call = st->syscalls ? (double)st->packets / (double)st->syscalls : 0.0;
+    fprintf(out,
+            "[tx] batch=%u packets=%llu bytes=%llu syscalls=%llu pkts/syscall=%.2f errors=%llu eagain=%llu\n",
+            tx->batch, (unsigned long long)st->packets, (unsigned long long)st->bytes,
+            (unsigned long long)st->syscalls, per_call,
+            (unsigned long long)st->errors, (unsigned long long)st->eagain);
+    if (st->gso_sends)
+        fprintf(out, "[tx] gso=%u super-packets=%llu segs/send=%.2f\n",
+                tx->gso, (unsigned long long)st->gso_sends,
+                (double)st->gso_segs / (double)st->gso_sends);
+}
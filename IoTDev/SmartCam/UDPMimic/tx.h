@@ -0,0 +1,85 @@
+/*
+ * Transmit path for the SmartCam simulator stream.
+ *
+ * The stream payload is "4-byte sequence header + filler", where filler byte p
+ * is (seq + p) & 0xFF. The filler therefore only depends on the low byte of the
+ * sequence number, so 256 pre-generated payloads cover every packet and only the
+ * header has to be patched before each send.
+ *
+ * Packets go out one sendto() per datagram (batch = 1, the original behaviour),
+ * in groups through sendmmsg() (batch > 1), as UDP GSO super-packets (the
+ * pool slots of consecutive sequence numbers are adjacent, so N stamped slots
+ * form one buffer the kernel segments with UDP_SEGMENT), or through an
+ * AF_PACKET TX ring when one is attached (txring.h).
+ */
+
+#ifndef SMARTCAM_TX_H
+#define SMARTCAM_TX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define TX_POOL_SLOTS 256 /* One slot per value of the low sequence byte */
+#define TX_MAX_BATCH  TX_POOL_SLOTS /* Slots in one batch must not alias */
+#define TX_MAX_DGRAM  65507         /* Largest IPv4 UDP payload */
+#define TX_MAX_GSO    64            /* Segments per super-packet (kernel UDP_MAX_SEGMENTS) */
+
+struct txring;
+
+/* Pre-generated stream payloads, read-only apart from the sequence header */
+struct tx_pool {
+    unsigned char *slots; // TX_POOL_SLOTS * pkt_size bytes
+    size_t pkt_size;      // UDP payload size of every slot
+};
+
+/* Counters kept by the transmit path */
+struct tx_stats {
+    uint64_t packets;    // Datagrams handed to the kernel
+    uint64_t bytes;      // Payload bytes handed to the kernel
+    uint64_t syscalls;   // sendto()/sendmmsg() calls made
+    uint64_t errors;     // Failed send calls (datagrams dropped)
+    uint64_t eagain;     // Failed send calls due to EAGAIN/ENOBUFS
+    uint64_t gso_sends;  // Super-packets sent with UDP_SEGMENT
+    uint64_t gso_segs;   // Datagrams carried by those super-packets
+};
+
+/* One destination socket plus its batching scratch space */
+struct tx_ctx {
+    int sock;                  // Connected or unconnected UDP socket
+    struct sockaddr_in dst;    // Destination used by sendto()/sendmmsg()
+    const struct tx_pool *pool;
+    unsigned batch;            // Datagrams per syscall (1 = sendto)
+    struct mmsghdr *msgs;      // batch entries, only when batch > 1
+    struct iovec *iov;         // batch entries, only when batch > 1
+    unsigned gso;              // Segments per UDP GSO super-packet, 0 = off
+    struct txring *ring;       // Raw frame backend for stream packets, NULL = socket
+    struct tx_stats stats;
+};
+
+int  tx_pool_init(struct tx_pool *pool, size_t pkt_size);
+void tx_pool_free(struct tx_pool *pool);
+
+int  tx_init(struct tx_ctx *tx, int sock, const struct sockaddr_in *dst,
+             const struct tx_pool *pool, unsigned batch);
+void tx_free(struct tx_ctx *tx);
+
+/* Enable UDP GSO with up to `segs` segments per send; returns the count in
+   effect (clamped to the 64 KB datagram limit), 0 if the kernel lacks it */
+unsigned tx_enable_gso(struct tx_ctx *tx, unsigned segs);
+
+/* Send `count` stream packets starting at *seq; advances *seq by count */
+void tx_send_stream(struct tx_ctx *tx, uint64_t *seq, unsigned count);
+
+/* Send one stream packet of arbitrary length (4..TX_MAX_DGRAM) at *seq; advances *seq */
+void tx_send_sized(struct tx_ctx *tx, uint64_t *seq, size_t len);
+
+/* Send one ad-hoc datagram (keepalive, metadata) */
+void tx_send_raw(struct tx_ctx *tx, const void *buf, size_t len);
+
+void tx_report(const struct tx_ctx *tx, FILE *out);
+
+#endif /* SMARTCAM_TX_H */
@@ -0,0 +1,281 @@
+/*
+ * Zero-copy AF_PACKET transmit backend (see txring.h).
+ */
+
+#define _GNU_SOURCE /* struct ifreq, MSG_DONTWAIT */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <net/ethernet.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <linux/if_packet.h>
+
+#include "txring.h"
+#include "pacer.h"
+
+#define TXRING_SRC_PORT 50000 /* Fixed UDP source port of raw frames */
+
+/* Ones' complement sum over native 16-bit words (RFC 1071); byte order independent */
+static uint32_t csum_add(uint32_t sum, const void *data, size_t len) {
+    const unsigned char *p = data;
+    uint16_t w;
+    for (; len > 1; len -= 2, p += 2) {
+        memcpy(&w, p, sizeof(w));
+        sum += w;
+    }
+    if (len) {
+        unsigned char last[2] = { p[0], 0 };
+        memcpy(&w, last, sizeof(w));
+        sum += w;
+    }
+    return sum;
+}
+
+static uint16_t csum_fold(uint32_t sum) {
+    while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+/* "aa:bb:cc:dd:ee:ff" -> 6 bytes */
+static int parse_mac(const char *s, unsigned char mac[6]) {
+    unsigned v[6];
+    if (sscanf(s, "%x:%x:%x:%x:%x:%x", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]) != 6) return -1;
+    for (int i = 0; i < 6; ++i) {
+        if (v[i] > 0xFF) return -1;
+        mac[i] = (unsigned char)v[i];
+    }
+    return 0;
+}
+
+/* Completed neighbour entry for `ip` on `ifname` from the kernel ARP cache */
+static int arp_lookup(const char *ifname, struct in_addr ip, unsigned char mac[6]) {
+    FILE *f = fopen("/proc/net/arp", "r");
+    if (!f) return -1;
+
+    char line[256], addr[64], hw[64], dev[IFNAMSIZ + 1];
+    unsigned type, flags;
+    int rc = -1;
+    char want[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &ip, want, sizeof(want));
+
+    if (!fgets(line, sizeof(line), f)) { fclose(f); return -1; } // Header
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%63s 0x%x 0x%x %63s %*s %16s", addr, &type, &flags, hw, dev) != 5) continue;
+        if (strcmp(addr, want) == 0 && strcmp(dev, ifname) == 0 && (flags & 0x2) && parse_mac(hw, mac) == 0) {
+            rc = 0;
+            break;
+        }
+    }
+    fclose(f);
+    return rc;
+}
+
+static int if_query(int fd, const char *ifname, unsigned long req, struct ifreq *ifr) {
+    memset(ifr, 0, sizeof(*ifr));
+    strncpy(ifr->ifr_name, ifname, IFNAMSIZ - 1);
+    if (ioctl(fd, req, ifr) != 0) { perror(ifname); return -1; }
+    return 0;
+}
+
+/* Lay out one complete frame for slot `idx` and record its checksum base */
+static void build_frame(struct txring *r, unsigned idx, const unsigned char src_mac[6],
+                        const unsigned char dst_mac[6], struct in_addr src, const struct sockaddr_in *dst) {
+    unsigned char *f = r->map + (size_t)idx * r->frame_size + r->data_off;
+    struct ether_header *eth = (struct ether_header *)f;
+    struct iphdr *ip = (struct iphdr *)(f + sizeof(*eth));
+    struct udphdr *udp = (struct udphdr *)(f + sizeof(*eth) + sizeof(*ip));
+    unsigned char *payload = (unsigned char *)(udp + 1);
+    const uint16_t udp_len = (uint16_t)(sizeof(*udp) + r->pkt_size);
+
+    memcpy(eth->ether_dhost, dst_mac, 6);
+    memcpy(eth->ether_shost, src_mac, 6);
+    eth->ether_type = htons(ETHERTYPE_IP);
+
+    memset(ip, 0, sizeof(*ip));
+    ip->version = 4;
+    ip->ihl = 5;
+    ip->tot_len = htons((uint16_t)(sizeof(*ip) + udp_len));
+    ip->frag_off = htons(IP_DF); // No fragmentation, so the ID can stay 0
+    ip->ttl = 64;
+    ip->protocol = IPPROTO_UDP;
+    ip->saddr = src.s_addr;
+    ip->daddr = dst->sin_addr.s_addr;
+    ip->check = csum_fold(csum_add(0, ip, sizeof(*ip)));
+
+    udp->source = htons(TXRING_SRC_PORT);
+    udp->dest = dst->sin_port;
+    udp->len = htons(udp_len);
+    udp->check = 0;
+
+    /* Same payload as the socket path, with the sequence header zeroed */
+    memset(payload, 0, sizeof(uint32_t));
+    for (size_t p = sizeof(uint32_t); p < r->pkt_size; ++p)
+        payload[p] = (unsigned char)((idx + p) & 0xFF);
+
+    /* Pseudo-header + UDP header + payload; the sequence words are added per packet */
+    struct { uint32_t src, dst; uint8_t zero, proto; uint16_t len; } ph = {
+        src.s_addr, dst->sin_addr.s_addr, 0, IPPROTO_UDP, htons(udp_len)
+    };
+    uint32_t sum = csum_add(0, &ph, sizeof(ph));
+    sum = csum_add(sum, udp, udp_len);
+    r->base_sum[idx] = sum;
+}
+
+int txring_open(struct txring *r, const char *ifname, const struct sockaddr_in *dst,
+                const char *dst_mac, size_t pkt_size) {
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+    r->pkt_size = pkt_size;
+    r->frame_len = sizeof(struct ether_header) + sizeof(struct iphdr) + sizeof(struct udphdr) + pkt_size;
+    r->data_off = TPACKET2_HDRLEN - sizeof(struct sockaddr_ll); // Where the kernel expects the frame
+    r->nframes = TXRING_FRAMES;
+
+    r->fd = socket(AF_PACKET, SOCK_RAW, 0); // Protocol 0: transmit only, nothing is queued for receive
+    if (r->fd < 0) { perror("socket(AF_PACKET)"); return -1; }
+
+    /* Interface details: index, MAC, IPv4 address, MTU */
+    struct ifreq ifr;
+    unsigned char src_mac[6], dmac[6];
+    struct in_addr src;
+    int ifindex = (int)if_nametoindex(ifname);
+    if (ifindex == 0) { fprintf(stderr, "Unknown interface: %s\n", ifname); goto fail; }
+    if (if_query(r->fd, ifname, SIOCGIFHWADDR, &ifr) != 0) goto fail;
+    memcpy(src_mac, ifr.ifr_hwaddr.sa_data, 6);
+    if (if_query(r->fd, ifname, SIOCGIFADDR, &ifr) != 0) goto fail;
+    src = ((struct sockaddr_in *)&ifr.ifr_addr)->sin_addr;
+    if (if_query(r->fd, ifname, SIOCGIFMTU, &ifr) != 0) goto fail;
+    if (r->frame_len - sizeof(struct ether_header) > (size_t)ifr.ifr_mtu) {
+        fprintf(stderr, "Payload %zuB does not fit the %s MTU (%d); raw frames cannot fragment\n",
+                pkt_size, ifname, ifr.ifr_mtu);
+        goto fail;
+    }
+
+    if (dst_mac) {
+        if (parse_mac(dst_mac, dmac) != 0) { fprintf(stderr, "Invalid MAC: %s\n", dst_mac); goto fail; }
+    } else if (arp_lookup(ifname, dst->sin_addr, dmac) != 0) {
+        fprintf(stderr, "No ARP entry for the server on %s; ping it first or pass -M <mac>\n", ifname);
+        goto fail;
+    }
+
+    /* TPACKET_V2 TX ring: power-of-two slots, page-multiple blocks */
+    int ver = TPACKET_V2;
+    if (setsockopt(r->fd, SOL_PACKET, PACKET_VERSION, &ver, sizeof(ver)) != 0) { perror("PACKET_VERSION"); goto fail; }
+
+    unsigned fs = 1;
+    while (fs < r->data_off + r->frame_len) fs <<= 1;
+    r->frame_size = fs;
+    unsigned page = (unsigned)sysconf(_SC_PAGESIZE);
+    unsigned block = fs > page ? fs : page;
+    unsigned per_block = block / fs;
+
+    struct tpacket_req req;
+    memset(&req, 0, sizeof(req));
+    req.tp_frame_size = fs;
+    req.tp_frame_nr = r->nframes;
+    req.tp_block_size = block;
+    req.tp_block_nr = r->nframes / per_block;
+    if (setsockopt(r->fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) != 0) { perror("PACKET_TX_RING"); goto fail; }
+
+    r->map_len = (size_t)req.tp_block_size * req.tp_block_nr;
+    r->map = mmap(NULL, r->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, r->fd, 0);
+    if (r->map == MAP_FAILED) { r->map = NULL; perror("mmap(TX_RING)"); goto fail; }
+
+    struct sockaddr_ll sll;
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_IP);
+    sll.sll_ifindex = ifindex;
+    if (bind(r->fd, (struct sockaddr *)&sll, sizeof(sll)) != 0) { perror("bind(AF_PACKET)"); goto fail; }
+
+    r->base_sum = calloc(r->nframes, sizeof(*r->base_sum));
+    if (!r->base_sum) { fprintf(stderr, "Out of memory\n"); goto fail; }
+    for (unsigned i = 0; i < r->nframes; ++i)
+        build_frame(r, i, src_mac, dmac, src, dst);
+
+    fprintf(stderr, "[txring] if=%s frames=%u slot=%uB frame=%zuB dst=%02x:%02x:%02x:%02x:%02x:%02x\n",
+            ifname, r->nframes, r->frame_size, r->frame_len,
+            dmac[0], dmac[1], dmac[2], dmac[3], dmac[4], dmac[5]);
+    return 0;
+
+fail:
+    txring_close(r);
+    return -1;
+}
+
+void txring_close(struct txring *r) {
+    if (r->map) munmap(r->map, r->map_len);
+    if (r->fd >= 0) close(r->fd);
+    free(r->base_sum);
+    r->map = NULL;
+    r->fd = -1;
+    r->base_sum = NULL;
+}
+
+static void flush(struct txring *r) {
+    r->stats.flushes++;
+    if (send(r->fd, NULL, 0, MSG_DONTWAIT) < 0 && errno != EAGAIN && errno != ENOBUFS)
+        r->stats.errors++;
+}
+
+/* Wait for slot `hdr` to come back from the kernel */
+static int reclaim(struct txring *r, struct tpacket2_hdr *hdr) {
+    for (int waited = 0;; waited = 1) {
+        uint32_t st = __atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE);
+        if (st == TP_STATUS_AVAILABLE) return 0;
+        if (st & TP_STATUS_WRONG_FORMAT) {
+            r->stats.rejected++;
+            __atomic_store_n(&hdr->tp_status, TP_STATUS_AVAILABLE, __ATOMIC_RELEASE);
+            return 0;
+        }
+        if (!waited) r->stats.stalls++; // Ring full: count once, kick it and wait for space
+        flush(r);
+        struct pollfd pfd = { r->fd, POLLOUT, 0 };
+        if (poll(&pfd, 1, 100) < 0 && errno == EINTR) return -1;
+    }
+}
+
+void txring_send(struct txring *r, uint64_t *seq, unsigned count) {
+    if (r->start_ns == 0) r->start_ns = now_ns();
+
+    const size_t seq_off = r->data_off + sizeof(struct ether_header) + sizeof(struct iphdr) + sizeof(struct udphdr);
+    const size_t csum_off = r->data_off + sizeof(struct ether_header) + sizeof(struct iphdr) + offsetof(struct udphdr, check);
+
+    for (unsigned i = 0; i < count; ++i) {
+        unsigned char *slot = r->map + (size_t)r->cur * r->frame_size;
+        struct tpacket2_hdr *hdr = (struct tpacket2_hdr *)slot;
+        if (reclaim(r, hdr) != 0) break;
+
+        /* Patch the sequence header and fold it into the precomputed checksum */
+        uint32_t s = (uint32_t)(*seq)++;
+        memcpy(slot + seq_off, &s, sizeof(s));
+        uint16_t c = csum_fold(csum_add(r->base_sum[r->cur], &s, sizeof(s)));
+        if (c == 0) c = 0xFFFF; // 0 means "no checksum" in UDP
+        memcpy(slot + csum_off, &c, sizeof(c));
+
+        hdr->tp_len = (uint32_t)r->frame_len;
+        __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+        r->stats.frames++;
+        r->cur = (r->cur + 1) % r->nframes;
+    }
+    flush(r); // One send() for the whole batch
+}
+
+void txring_report(const struct txring *r, FILE *out) {
+    double secs = r->start_ns ? (double)(now_ns() - r->start_ns) / 1e9 : 0.0;
+    fprintf(out, "[txring] frames=%llu fps=%.0f flushes=%llu frames/flush=%.2f stalls=%llu rejected=%llu errors=%llu\n",
+            (unsigned long long)r->stats.frames, secs > 0 ? (double)r->stats.frames / secs : 0.0,
+            (unsigned long long)r->stats.flushes,
+            r->stats.flushes ? (double)r->stats.frames / (double)r->stats.flushes : 0.0,
+            (unsigned long long)r->stats.stalls, (unsigned long long)r->stats.rejected,
+            (unsigned long long)r->stats.errors);
+}
@@ -0,0 +1,110 @@
+/*
+ * CRC32C (see crc32c.h).
+ */
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC_X86 1
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define CRC_ARM 1
+#endif
+
+#include "crc32c.h"
+
+#define POLY 0x82F63B78u           // Castagnoli, reflected
+
+/* ------------------- Slicing-by-8 ------------------- */
+
+static uint32_t table[8][256];
+static int table_ready;
+
+static void table_init(void) {
+    for (unsigned i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c >> 1) ^ (POLY & (0u - (c & 1)));
+        table[0][i] = c;
+    }
+    for (unsigned i = 0; i < 256; i++)
+        for (unsigned t = 1; t < 8; t++)
+            table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xFF];
+    table_ready = 1;               // Racing first calls build identical tables
+}
+
+static uint32_t update_table(uint32_t crc, const void *data, size_t n) {
+    const uint8_t *p = data;
+    if (!table_ready) table_init();
+    crc = ~crc;
+    for (; n && ((uintptr_t)p & 7); n--) crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xFF];
+    for (; n >= 8; n -= 8, p += 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);          // Little-endian load (x86, Arm64)
+        v ^= crc;
+        crc = table[7][v & 0xFF] ^ table[6][(v >> 8) & 0xFF] ^ table[5][(v >> 16) & 0xFF] ^
+              table[4][(v >> 24) & 0xFF] ^ table[3][(v >> 32) & 0xFF] ^ table[2][(v >> 40) & 0xFF] ^
+              table[1][(v >> 48) & 0xFF] ^ table[0][v >> 56];
+    }
+    while (n--) crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xFF];
+    return ~crc;
+}
+
+static const struct crc32c_impl impl_table = { "table", update_table };
+
+/* ------------------- x86 SSE4.2 ------------------- */
+
+#if defined(CRC_X86) && defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t update_sse42(uint32_t crc, const void *data, size_t n) {
+    const uint8_t *p = data;
+    uint64_t c = ~crc;
+    for (; n && ((uintptr_t)p & 7); n--) c = _mm_crc32_u8((uint32_t)c, *p++);
+    for (; n >= 8; n -= 8, p += 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+    }
+    while (n--) c = _mm_crc32_u8((uint32_t)c, *p++);
+    return ~(uint32_t)c;
+}
+
+static const struct crc32c_impl impl_hw = { "sse4.2", update_sse42 };
+static int hw_supported(void) { return __builtin_cpu_supports("sse4.2"); }
+
+/* ------------------- ARMv8 CRC32 ------------------- */
+
+#elif defined(CRC_ARM)
+__attribute__((target("+crc")))
+static uint32_t update_armv8(uint32_t crc, const void *data, size_t n) {
+    const uint8_t *p = data;
+    crc = ~crc;
+    for (; n && ((uintptr_t)p & 7); n--) crc = __crc32cb(crc, *p++);
+    for (; n >= 8; n -= 8, p += 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        crc = __crc32cd(crc, v);
+    }
+    while (n--) crc = __crc32cb(crc, *p++);
+    return ~crc;
+}
+
+static const struct crc32c_impl impl_hw = { "armv8", update_armv8 };
+static int hw_supported(void) { return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0; }
+#endif
+
+const struct crc32c_impl *crc32c_get(const char *name) {
+#if (defined(CRC_X86) && defined(__x86_64__)) || defined(CRC_ARM)
+    if ((!name || strcmp(name, impl_hw.name) == 0) && hw_supported()) return &impl_hw;
+#endif
+    if (!name || strcmp(name, impl_table.name) == 0) return &impl_table;
+    return NULL;
+}
+
+uint32_t crc32c(uint32_t crc, const void *p, size_t n) {
+    static const struct crc32c_impl *best;
+    if (!best) best = crc32c_get(NULL);
+    return best->update(crc, p, n);
+}
@@ -0,0 +1,29 @@
+/*
+ * CRC32C (Castagnoli), as used by iSCSI, ext4 and the v2 upload framing.
+ *
+ * Hardware versions: the SSE4.2 crc32 instruction on x86 (picked at run
+ * time) and the ARMv8 CRC32 extension on Arm64 (HWCAP_CRC32). Fallback:
+ * slicing-by-8 tables, built on first use.
+ *
+ * crc32c(0, p, n) is the CRC of p[0..n); pass the result back in as `crc`
+ * to continue over more data.
+ */
+
+#ifndef SMARTCAM_CRC32C_H
+#define SMARTCAM_CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct crc32c_impl {
+    const char *name;
+    uint32_t (*update)(uint32_t crc, const void *p, size_t n);
+};
+
+/* Best for this CPU, or the one named ("table", "sse4.2", "armv8"); NULL if unavailable */
+const struct crc32c_impl *crc32c_get(const char *name);
+
+/* With the best implementation */
+uint32_t crc32c(uint32_t crc, const void *p, size_t n);
+
+#endif /* SMARTCAM_CRC32C_H */
@@ -0,0 +1,228 @@
+/*
+ * Warm in-process GStreamer capture (see gstcap.h).
+ */
+
+#define _POSIX_C_SOURCE 200809L /* clock_gettime() */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gstcap.h"
+
+#define NS_PER_S  1000000000ULL
+
+void gc_report(const struct gc_stats *st, FILE *out) {
+    fprintf(out, "[gst] captures=%llu failed=%llu frames=%llu written=%.1fMB open=%.1fms startup avg=%.1fms max=%.1fms\n",
+            (unsigned long long)st->captures, (unsigned long long)st->failures, (unsigned long long)st->frames,
+            (double)st->bytes / 1e6, (double)st->open_ns / 1e6,
+            st->captures ? (double)st->startup_sum_ns / (double)st->captures / 1e6 : 0.0,
+            (double)st->startup_max_ns / 1e6);
+}
+
+#ifdef HAVE_GST
+
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+
+#define GC_WARMUP_NS (10 * NS_PER_S) // First encoded frame at open time (camera start-up, encoder init)
+#define GC_EOS_NS    (5 * NS_PER_S)  // mp4mux writing the moov after EOS
+
+struct gc_pipe {
+    GstElement *head, *sink;       // Source to encoded frames, parked in PAUSED between captures
+    GstElement *writer, *src, *file; // Encoded frames to an MP4, one segment per capture
+};
+
+static uint64_t mono_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * NS_PER_S + (uint64_t)t.tv_nsec;
+}
+
+static void print_error(GstMessage *m, const char *what) {
+    GError *err = NULL;
+    gchar *dbg = NULL;
+    gst_message_parse_error(m, &err, &dbg);
+    fprintf(stderr, "[gst] %s: %s\n", what, err ? err->message : "error");
+    g_clear_error(&err);
+    g_free(dbg);
+}
+
+/* Report and consume a pending error on `pipe`'s bus; 0 if there was none */
+static int bus_error(GstElement *pipe, const char *what) {
+    GstBus *bus = gst_element_get_bus(pipe);
+    GstMessage *m = gst_bus_pop_filtered(bus, GST_MESSAGE_ERROR);
+    gst_object_unref(bus);
+    if (!m) return 0;
+    print_error(m, what);
+    gst_message_unref(m);
+    return -1;
+}
+
+/* Drop frames left over from the previous run so a segment never starts with stale video */
+static void drain(struct gc_pipe *p) {
+    GstSample *s;
+    while ((s = gst_app_sink_try_pull_sample(GST_APP_SINK(p->sink), 0))) gst_sample_unref(s);
+}
+
+/* Ask the encoder for a key frame (with SPS/PPS) on the next input frame */
+static void request_keyframe(struct gc_pipe *p) {
+    GstStructure *s = gst_structure_new("GstForceKeyUnit", "all-headers", G_TYPE_BOOLEAN, TRUE, NULL);
+    gst_element_send_event(p->sink, gst_event_new_custom(GST_EVENT_CUSTOM_UPSTREAM, s));
+}
+
+static GstElement *launch(const char *desc) {
+    GError *err = NULL;
+    GstElement *e = gst_parse_launch(desc, &err);
+    if (err) { // Also set for a recoverable error, e.g. a missing property
+        fprintf(stderr, "[gst] %s: %s\n", desc, err->message);
+        g_clear_error(&err);
+        if (e) gst_object_unref(e);
+        return NULL;
+    }
+    return e;
+}
+
+struct gc_pipe *gc_open(const struct gc_cfg *cfg, struct gc_stats *st) {
+    uint64_t t0 = mono_ns();
+    GError *err = NULL;
+    if (!gst_init_check(NULL, NULL, &err)) {
+        fprintf(stderr, "[gst] init: %s\n", err ? err->message : "failed");
+        g_clear_error(&err);
+        return NULL;
+    }
+    struct gc_pipe *p = calloc(1, sizeof(*p));
+    if (!p) return NULL;
+
+    char desc[1024];
+    snprintf(desc, sizeof(desc),
+             "%s ! video/x-raw,width=%d,height=%d,framerate=%d/1 ! %s ! "
+             "h264parse ! video/x-h264,stream-format=avc,alignment=au ! "
+             "appsink name=sink sync=false max-buffers=%d",
+             cfg->source, cfg->width, cfg->height, cfg->fps, cfg->encoder, 2 * cfg->fps);
+    p->head = launch(desc);
+    p->writer = launch("appsrc name=src format=time ! mp4mux ! filesink name=file");
+    if (!p->head || !p->writer) goto fail;
+    p->sink = gst_bin_get_by_name(GST_BIN(p->head), "sink");
+    p->src = gst_bin_get_by_name(GST_BIN(p->writer), "src");
+    p->file = gst_bin_get_by_name(GST_BIN(p->writer), "file");
+
+    /* Warm-up: run until the first encoded frame, so the device, negotiation and
+       encoder set-up are paid here and not inside the first labelled capture */
+    if (gst_element_set_state(p->head, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+        bus_error(p->head, "start");
+        goto fail;
+    }
+    GstSample *s = gst_app_sink_try_pull_sample(GST_APP_SINK(p->sink), GC_WARMUP_NS);
+    if (!s) {
+        if (bus_error(p->head, "warm-up") == 0) fprintf(stderr, "[gst] warm-up: no frame within %llu s\n",
+                                                       (unsigned long long)(GC_WARMUP_NS / NS_PER_S));
+        goto fail;
+    }
+    gst_sample_unref(s);
+    gst_element_set_state(p->head, GST_STATE_PAUSED);
+    drain(p);
+
+    st->open_ns = mono_ns() - t0;
+    fprintf(stderr, "[gst] pipeline warm in %.1f ms: %s\n", (double)st->open_ns / 1e6, desc);
+    return p;
+
+fail:
+    gc_close(p);
+    return NULL;
+}
+
+int gc_capture(struct gc_pipe *p, int seconds, const char *filename, struct gc_stats *st) {
+    uint64_t t_req = mono_ns(), end = t_req + (uint64_t)seconds * NS_PER_S;
+    uint64_t startup = 0, frames = 0, bytes = 0;
+    GstClockTime base = 0;
+    int started = 0, rc = 0;
+
+    g_object_set(p->file, "location", filename, NULL);
+    if (gst_element_set_state(p->writer, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+        bus_error(p->writer, filename);
+        gst_element_set_state(p->writer, GST_STATE_NULL);
+        st->failures++;
+        return -1;
+    }
+    drain(p);
+    request_keyframe(p);
+    gst_element_set_state(p->head, GST_STATE_PLAYING);
+
+    for (uint64_t now; (now = mono_ns()) < end;) {
+        GstSample *s = gst_app_sink_try_pull_sample(GST_APP_SINK(p->sink), end - now);
+        if (!s) {
+            if (gst_app_sink_is_eos(GST_APP_SINK(p->sink)) || bus_error(p->head, "capture") != 0) { rc = -1; break; }
+            continue;
+        }
+        GstBuffer *b = gst_sample_get_buffer(s);
+        if (!started) {
+            if (GST_BUFFER_FLAG_IS_SET(b, GST_BUFFER_FLAG_DELTA_UNIT)) { gst_sample_unref(s); continue; } // Wait for the key frame
+            started = 1;
+            startup = mono_ns() - t_req;
+            base = GST_BUFFER_DTS_IS_VALID(b) ? GST_BUFFER_DTS(b) : GST_BUFFER_PTS(b); // DTS <= PTS: the earlier one
+            gst_app_src_set_caps(GST_APP_SRC(p->src), gst_sample_get_caps(s)); // Carries the avcC codec data
+        }
+        GstBuffer *out = gst_buffer_copy(b); // Metadata only, the frame memory is shared
+        gst_sample_unref(s);
+        /* One shift for both: DTS counts from its own first value and every PTS keeps its
+           distance from its DTS, so mp4mux gets monotonic DTS and PTS >= DTS */
+        if (GST_BUFFER_DTS_IS_VALID(out)) GST_BUFFER_DTS(out) = GST_BUFFER_DTS(out) > base ? GST_BUFFER_DTS(out) - base : 0;
+        if (GST_BUFFER_PTS_IS_VALID(out)) GST_BUFFER_PTS(out) = GST_BUFFER_PTS(out) > base ? GST_BUFFER_PTS(out) - base : 0;
+        bytes += gst_buffer_get_size(out);
+        frames++;
+        if (gst_app_src_push_buffer(GST_APP_SRC(p->src), out) != GST_FLOW_OK) { rc = -1; break; } // Takes `out`
+    }
+    gst_element_set_state(p->head, GST_STATE_PAUSED);
+
+    /* Finish the file: EOS makes mp4mux write the index */
+    gst_app_src_end_of_stream(GST_APP_SRC(p->src));
+    GstBus *bus = gst_element_get_bus(p->writer);
+    GstMessage *m = gst_bus_timed_pop_filtered(bus, GC_EOS_NS, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    if (!m || GST_MESSAGE_TYPE(m) == GST_MESSAGE_ERROR) {
+        if (m) print_error(m, filename); else fprintf(stderr, "[gst] %s: no EOS from the muxer\n", filename);
+        rc = -1;
+    }
+    if (m) gst_message_unref(m);
+    gst_object_unref(bus);
+    gst_element_set_state(p->writer, GST_STATE_NULL); // filesink only takes a new location when stopped
+    if (!started) rc = -1;
+
+    if (rc == 0) {
+        st->captures++;
+        st->frames += frames;
+        st->bytes += bytes;
+        st->startup_ns = startup;
+        st->startup_sum_ns += startup;
+        if (startup > st->startup_max_ns) st->startup_max_ns = startup;
+    } else {
+        st->failures++;
+    }
+    fprintf(stderr, "[gst] %s: startup %.1f ms, %llu frames, %.2f MB%s\n", filename, (double)startup / 1e6,
+            (unsigned long long)frames, (double)bytes / 1e6, rc == 0 ? "" : " (failed)");
+    return rc;
+}
+
+void gc_close(struct gc_pipe *p) {
+    if (!p) return;
+    if (p->head) gst_element_set_state(p->head, GST_STATE_NULL);
+    if (p->writer) gst_element_set_state(p->writer, GST_STATE_NULL);
+    if (p->sink) gst_object_unref(p->sink);
+    if (p->src) gst_object_unref(p->src);
+    if (p->file) gst_object_unref(p->file);
+    if (p->head) gst_object_unref(p->head);
+    if (p->writer) gst_object_unref(p->writer);
+    free(p);
+}
+
+#else /* !HAVE_GST */
+
+struct gc_pipe *gc_open(const struct gc_cfg *cfg, struct gc_stats *st) { (void)cfg; (void)st; return NULL; }
+int  gc_capture(struct gc_pipe *p, int seconds, const char *filename, struct gc_stats *st) {
+    (void)p; (void)seconds; (void)filename; (void)st;
+    return -1;
+}
+void gc_close(struct gc_pipe *p) { (void)p; }
+
+#endif
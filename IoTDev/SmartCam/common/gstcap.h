@@ -0,0 +1,59 @@
+/*
+ * Warm in-process GStreamer capture for the camera emulators, instead of
+ * running gst-launch-1.0 for every clip.
+ *
+ * Two pipelines are built once through the C API:
+ *   head:   <source> ! <raw caps> ! <encoder> ! h264parse ! appsink
+ *   writer: appsrc ! mp4mux ! filesink
+ * The head is run once at open time so the device, caps and encoder are
+ * all set up before the first capture, then parked in PAUSED. A capture
+ * points the writer at a new file, asks the encoder for a key frame and
+ * sets the head to PLAYING. Encoded frames go to the writer from the first
+ * key frame on, until the duration is up. Timestamps are rebased so that
+ * decode time starts at 0; presentation times move by the same amount and
+ * keep their lead over decode time (encoders with B-frames).
+ * The head then goes back to PAUSED and the writer gets EOS so mp4mux
+ * finishes the file. A capture costs a state change and a key frame
+ * instead of fork/exec, plugin registry, negotiation and encoder init.
+ *
+ * Startup latency, from the capture request to the first key frame in the
+ * segment, is measured for every capture (gc_capture() prints it).
+ *
+ * Build with -DHAVE_GST and `pkg-config --cflags --libs gstreamer-app-1.0`.
+ * Without it, gc_open() returns NULL and callers keep gst-launch-1.0.
+ */
+
+#ifndef SMARTCAM_GSTCAP_H
+#define SMARTCAM_GSTCAP_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define GC_TEST_SOURCE  "videotestsrc is-live=true pattern=ball" // -t: no camera needed
+#define GC_TEST_ENCODER "x264enc tune=zerolatency"               // ... nor a hardware encoder
+
+struct gc_cfg {
+    const char *source;            // Pipeline fragment, e.g. "v4l2src device=/dev/video0" or GC_TEST_SOURCE
+    const char *encoder;           // e.g. "x264enc tune=zerolatency" or "v4l2h264enc"
+    int width, height, fps;
+};
+
+struct gc_stats {
+    uint64_t captures, failures;
+    uint64_t frames, bytes;        // Written to segments
+    uint64_t open_ns;              // Building and warming the pipelines
+    uint64_t startup_ns, startup_sum_ns, startup_max_ns; // Last, sum, worst
+};
+
+struct gc_pipe;
+
+/* Build and warm the pipelines; NULL (with a message) if GStreamer is missing or fails */
+struct gc_pipe *gc_open(const struct gc_cfg *cfg, struct gc_stats *st);
+
+/* Record `seconds` of video into a new MP4 at `filename`; 0 or -1 */
+int gc_capture(struct gc_pipe *p, int seconds, const char *filename, struct gc_stats *st);
+
+void gc_close(struct gc_pipe *p);
+void gc_report(const struct gc_stats *st, FILE *out);
+
+#endif /* SMARTCAM_GSTCAP_H */
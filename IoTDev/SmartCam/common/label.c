@@ -0,0 +1,104 @@
+/*
+ * Binary event labels (see label.h).
+ */
+
+#define _POSIX_C_SOURCE 200809L /* clock_gettime() */
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "be.h"
+#include "label.h"
+
+static uint64_t clock_ns(clockid_t id) {
+    struct timespec t;
+    clock_gettime(id, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+int lbl_open(struct lbl_chan *ch, const char *host, int port, uint16_t device, unsigned batch) {
+    memset(ch, 0, sizeof(*ch));
+    ch->fd = -1;
+    if (batch < 1 || batch > LBL_BATCH_MAX) {
+        fprintf(stderr, "Label batch must be 1..%u\n", LBL_BATCH_MAX);
+        return -1;
+    }
+    struct sockaddr_in dst = {0};
+    dst.sin_family = AF_INET;
+    dst.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, host, &dst.sin_addr) != 1) {
+        fprintf(stderr, "Label destination %s: not an IPv4 address\n", host);
+        return -1;
+    }
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&dst, sizeof(dst)) != 0) { // Fixes the route once
+        perror("label socket");
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    ch->fd = fd;
+    ch->batch = batch;
+    memcpy(ch->hdr, LBL_MAGIC, 4);
+    be_put16(ch->hdr + 4, device);
+    return 0;
+}
+
+void lbl_flush(struct lbl_chan *ch) {
+    if (ch->fd < 0 || ch->n == 0) return;
+    /* A collector that is not up yet answers with ICMP and the next send() reports
+       ECONNREFUSED: count it and carry on, labels are best effort like before */
+    if (send(ch->fd, ch->buf, (size_t)ch->n * LBL_REC_LEN, MSG_DONTWAIT) < 0) ch->errors++;
+    ch->datagrams++;
+    ch->n = 0;
+}
+
+void lbl_emit(struct lbl_chan *ch, const char *name, unsigned nargs, const int32_t *arg) {
+    if (ch->fd < 0) return;
+    uint8_t *r = ch->buf + (size_t)ch->n * LBL_REC_LEN;
+    uint64_t mono = clock_ns(CLOCK_MONOTONIC), real = clock_ns(CLOCK_REALTIME);
+
+    if (nargs > LBL_ARGS) nargs = LBL_ARGS;
+    memset(r, 0, LBL_REC_LEN);
+    memcpy(r, ch->hdr, 6);
+    r[6] = (uint8_t)nargs;
+    be_put32(r + 8, ch->seq++);
+    be_put64(r + 12, mono);
+    be_put64(r + 20, real);
+    size_t len = strnlen(name, LBL_NAME_LEN);
+    memcpy(r + 28, name, len);
+    for (unsigned i = 0; i < nargs; i++) be_put32(r + 48 + 4 * i, (uint32_t)arg[i]);
+
+    ch->records++;
+    if (++ch->n == ch->batch) lbl_flush(ch);
+}
+
+void lbl_close(struct lbl_chan *ch) {
+    if (ch->fd < 0) return;
+    lbl_flush(ch);
+    close(ch->fd);
+    ch->fd = -1;
+}
+
+void lbl_report(const struct lbl_chan *ch, FILE *out) {
+    fprintf(out, "[labels] records=%llu datagrams=%llu (%.1f per send) batch=%u send errors=%llu\n",
+            (unsigned long long)ch->records, (unsigned long long)ch->datagrams,
+            ch->datagrams ? (double)ch->records / (double)ch->datagrams : 0.0, ch->batch,
+            (unsigned long long)ch->errors);
+}
+
+int lbl_decode(const uint8_t *p, struct lbl_event *e) {
+    if (memcmp(p, LBL_MAGIC, 4) != 0 || p[6] > LBL_ARGS) return -1;
+    e->device = be_get16(p + 4);
+    e->nargs = p[6];
+    e->seq = be_get32(p + 8);
+    e->mono_ns = be_get64(p + 12);
+    e->real_ns = be_get64(p + 20);
+    memcpy(e->name, p + 28, LBL_NAME_LEN);
+    e->name[LBL_NAME_LEN] = '\0';
+    for (unsigned i = 0; i < LBL_ARGS; i++) e->arg[i] = (int32_t)be_get32(p + 48 + 4 * i);
+    return 0;
+}
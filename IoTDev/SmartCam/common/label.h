@@ -0,0 +1,80 @@
+/*
+ * Binary event labels for the SmartCam emulators (decoder:
+ * NetData/LABELS/labeldec.c).
+ *
+ * The JSON labels cost a socket(), inet_pton(), an ISO timestamp, a JSON
+ * snprintf(), sendto() and close() each, right at the phase boundaries the
+ * power trace is meant to show. A label channel opens one connected UDP
+ * socket at start-up and encodes every label as a fixed-size record: a copy
+ * of a header prepared at open, two clock_gettime() reads (vDSO, no
+ * syscall) and a send(). With batching (batch > 1) records collect in the
+ * channel and go out LBL_REC_LEN * n bytes at a time when the batch is
+ * full or on lbl_flush(), which the emulators call where they are about to
+ * sleep anyway. Records carry their own timestamps, so a delayed datagram
+ * does not move a label.
+ *
+ * Record, all integers big-endian (as in the upload framings):
+ *
+ *   "SCL1" | device u16 | nargs u8 | 0 u8 | seq u32 | mono_ns u64 | real_ns u64 | name[20] | arg i32 x4
+ *
+ * mono_ns is CLOCK_MONOTONIC (the clock of the V4L2 buffer timestamps),
+ * real_ns CLOCK_REALTIME; seq counts records per channel so the decoder
+ * can report losses. Names longer than LBL_NAME_LEN are cut; unused name
+ * bytes and arguments are zero. A datagram holds 1..LBL_BATCH_MAX records.
+ *
+ * Build: add ../common/label.c to the emulator's compile line.
+ */
+
+#ifndef SMARTCAM_LABEL_H
+#define SMARTCAM_LABEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define LBL_MAGIC     "SCL1"
+#define LBL_REC_LEN   64
+#define LBL_NAME_LEN  20
+#define LBL_ARGS      4
+#define LBL_BATCH_MAX 16             // 1 KB datagrams, well under any MTU
+
+struct lbl_chan {
+    int fd;                          // -1: not open, labels are dropped
+    unsigned batch;                  // Records per datagram
+    unsigned n;                      // Records waiting in buf
+    uint32_t seq;
+    uint64_t records, datagrams, errors;
+    uint8_t hdr[8];                  // Magic and device, prepared at open
+    uint8_t buf[LBL_BATCH_MAX * LBL_REC_LEN];
+};
+
+/* A decoded record */
+struct lbl_event {
+    uint16_t device;
+    uint32_t seq;
+    uint64_t mono_ns, real_ns;
+    char name[LBL_NAME_LEN + 1];
+    unsigned nargs;
+    int32_t arg[LBL_ARGS];
+};
+
+/* Connect to host:port; batch 1..LBL_BATCH_MAX. 0, or -1 (message on stderr, channel stays closed) */
+int  lbl_open(struct lbl_chan *ch, const char *host, int port, uint16_t device, unsigned batch);
+
+/* Record one label with up to LBL_ARGS arguments; sent now (batch 1) or when the batch is full */
+void lbl_emit(struct lbl_chan *ch, const char *name, unsigned nargs, const int32_t *arg);
+
+static inline void lbl_event(struct lbl_chan *ch, const char *name) { lbl_emit(ch, name, 0, NULL); }
+
+/* Send whatever is waiting */
+void lbl_flush(struct lbl_chan *ch);
+
+/* Flush and close */
+void lbl_close(struct lbl_chan *ch);
+
+void lbl_report(const struct lbl_chan *ch, FILE *out);
+
+/* Decode the record at p (LBL_REC_LEN bytes); 0, or -1 if it is not one */
+int  lbl_decode(const uint8_t *p, struct lbl_event *e);
+
+#endif /* SMARTCAM_LABEL_H */
@@ -0,0 +1,203 @@
+/*
+ * Resumable chunked upload client (see resume.h).
+ */
+
+#define _POSIX_C_SOURCE 200809L /* clock_gettime(), nanosleep() */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "crc32c.h"
+#include "resume.h"
+
+static uint64_t mono_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+/* Whole buffer or -1; MSG_NOSIGNAL so a dropped link is an error, not SIGPIPE */
+static int send_all(int sock, const void *buf, size_t n, int flags) {
+    const uint8_t *p = buf;
+    while (n > 0) {
+        ssize_t r = send(sock, p, n, flags | MSG_NOSIGNAL);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+        p += r;
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+static int recv_all(int sock, void *buf, size_t n) {
+    uint8_t *p = buf;
+    while (n > 0) {
+        ssize_t r = recv(sock, p, n, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+        p += r;
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+static int read_reply(int sock, uint64_t *committed) {
+    uint8_t r[RS_REPLY_LEN];
+    if (recv_all(sock, r, sizeof(r)) != 0 || memcmp(r, RS_MAGIC_REPLY, 4) != 0) return -1;
+    *committed = be_get64(r + 8);
+    return r[4];
+}
+
+static int dial(const char *host, int port) {
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) return -1;
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) return -1;
+    struct timeval tv = { RS_IO_TIMEOUT_S, 0 };
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) { close(sock); return -1; }
+    return sock;
+}
+
+/* One connection: HELLO, then chunks from the committed offset. Server status, or -1 */
+static int attempt(int sock, int fd, const char *name, uint32_t chunk, uint32_t ident, uint8_t *buf,
+                   const struct up_shape *shape, struct rs_stats *st) {
+    size_t name_len = strlen(name);
+    uint8_t hello[RS_HELLO_LEN + RS_NAME_MAX];
+    memset(hello, 0, RS_HELLO_LEN);
+    memcpy(hello, RS_MAGIC_HELLO, 4);
+    hello[4] = RS_VERSION;
+    be_put16(hello + 6, (uint16_t)name_len);
+    be_put64(hello + 8, st->size);
+    be_put32(hello + 16, chunk);
+    be_put32(hello + 20, ident);
+    memcpy(hello + RS_HELLO_LEN, name, name_len);
+
+    uint64_t t = mono_ns(), off;
+    if (send_all(sock, hello, RS_HELLO_LEN + name_len, 0) != 0) return -1;
+    int status = read_reply(sock, &off);
+    if (status != RS_OK) return status;
+    if (off > st->committed) st->committed = off;
+    if (st->handshakes++ == 0) st->first_offset = off;
+    else { st->resume_offset = off; st->resume_ns = mono_ns() - t; }
+    if (off == st->size) return RS_OK; // Server already has all of it
+
+    while (off < st->size) {
+        uint32_t len = st->size - off < chunk ? (uint32_t)(st->size - off) : chunk;
+        for (uint32_t got = 0; got < len;) {
+            ssize_t r = pread(fd, buf + got, len - got, (off_t)(off + got));
+            if (r <= 0) return -1; // File shrank or unreadable: nothing a retry would fix soon
+            got += (uint32_t)r;
+        }
+        uint64_t c = mono_ns();
+        uint32_t crc = crc32c(0, buf, len);
+        st->crc_ns += mono_ns() - c;
+
+        uint8_t hdr[RS_CHUNK_HDR_LEN];
+        be_put64(hdr, off);
+        be_put32(hdr + 8, len);
+        be_put32(hdr + 12, crc);
+        if (send_all(sock, hdr, sizeof(hdr), MSG_MORE) != 0) return -1;
+        uint64_t moved = st->up.bytes;
+        int rc = up_send_part(sock, fd, (off_t)off, len, shape, &st->up); // Payload from the page cache
+        st->sent += st->up.bytes - moved;
+        if (rc != 0) return -1;
+        st->chunks++;
+        off += len;
+    }
+    if (up_wait_sent(sock, shape, &st->up) != 0) return -1; // Paced: the rate counts data on the wire
+    if (read_reply(sock, &off) != RS_OK) return -1;
+    if (off > st->committed) st->committed = off;
+    return off == st->size ? RS_OK : -1;
+}
+
+uint32_t rs_ident(uint64_t size, int64_t mtime_s, long mtime_ns) {
+    uint8_t id[20];
+    be_put64(id, size);
+    be_put64(id + 8, (uint64_t)mtime_s);
+    be_put32(id + 16, (uint32_t)mtime_ns);
+    return crc32c(0, id, sizeof(id));
+}
+
+int rs_upload(const char *host, int port, const char *path, const char *name, uint32_t chunk,
+              const struct up_shape *shape, struct rs_stats *st) {
+    static const struct up_shape unshaped;
+    if (!shape) shape = &unshaped;
+    memset(st, 0, sizeof(*st));
+    st->status = -1;
+    st->crc_impl = crc32c_get(NULL)->name;
+    if (strlen(name) > RS_NAME_MAX || chunk == 0 || chunk > RS_CHUNK_MAX) { errno = EINVAL; return -1; }
+
+    int fd = open(path, O_RDONLY);
+    struct stat sb;
+    if (fd < 0 || fstat(fd, &sb) != 0) { if (fd >= 0) close(fd); return -1; }
+    st->size = (uint64_t)sb.st_size;
+    uint32_t ident = rs_ident(st->size, (int64_t)sb.st_mtim.tv_sec, sb.st_mtim.tv_nsec);
+    uint8_t *buf = malloc(chunk);
+    if (!buf) { close(fd); return -1; }
+
+    /* sendfile() has no MSG_NOSIGNAL: a dropped link must be an error, not SIGPIPE */
+    struct sigaction ign = { .sa_handler = SIG_IGN }, old_pipe;
+    sigaction(SIGPIPE, &ign, &old_pipe);
+
+    uint64_t t0 = mono_ns();
+    unsigned backoff = RS_BACKOFF_MS, stalled = 0;
+    while (stalled < RS_ATTEMPTS) {
+        if (st->attempts > 0) {    // Back off before reconnecting
+            struct timespec ts = { backoff / 1000, (long)(backoff % 1000) * 1000000L };
+            nanosleep(&ts, NULL);
+            backoff = backoff * 2 > RS_BACKOFF_MAX_MS ? RS_BACKOFF_MAX_MS : backoff * 2;
+        }
+        st->attempts++;
+        uint64_t before = st->committed;
+        int sock = dial(host, port);
+        if (sock >= 0) {
+            st->status = attempt(sock, fd, name, chunk, ident, buf, shape, st);
+            close(sock);
+            if (st->status == RS_OK || st->status == RS_BAD_REQUEST) break; // Done, or retrying cannot help
+        }
+        if (st->committed > before) {  // The server has more than before: start counting afresh
+            stalled = 0;
+            backoff = RS_BACKOFF_MS;
+        } else if (++stalled > st->stalls) {
+            st->stalls = stalled;
+        }
+    }
+    st->total_ns = mono_ns() - t0;
+    sigaction(SIGPIPE, &old_pipe, NULL);
+    free(buf);
+    close(fd);
+    return st->status == RS_OK ? 0 : -1;
+}
+
+void rs_report(const struct rs_stats *st, FILE *out) {
+    double secs = (double)st->total_ns / 1e9;
+    fprintf(out, "[upload] v2 %.2f MB in %.2fs (%.2f MB/s) attempts=%u chunks=%llu sent=%.2f MB",
+            (double)st->size / 1e6, secs, secs > 0 ? (double)st->sent / secs / 1e6 : 0.0,
+            st->attempts, (unsigned long long)st->chunks, (double)st->sent / 1e6);
+    if (st->stalls)
+        fprintf(out, " stalls=%u", st->stalls);
+    if (st->first_offset)
+        fprintf(out, " continued at %.2f MB", (double)st->first_offset / 1e6);
+    if (st->handshakes > 1)
+        fprintf(out, " resumed at %.2f MB (handshake %.2fms)", (double)st->resume_offset / 1e6,
+                (double)st->resume_ns / 1e6);
+    if (st->up.paced) fprintf(out, " paced=kernel");
+    else if (st->up.bursts) fprintf(out, " paced=bucket(%llu bursts)", (unsigned long long)st->up.bursts);
+    fprintf(out, " crc=%s %.0f MB/s status=%s\n", st->crc_impl,
+            st->crc_ns ? (double)st->sent / ((double)st->crc_ns / 1e9) / 1e6 : 0.0, rs_status_name(st->status));
+}
@@ -0,0 +1,110 @@
+/*
+ * Resumable chunked upload, framing v2 (client side; the reference receiver
+ * is NetData/TCPSERVER_OUTPUT/tcprecv.c).
+ *
+ * v1 is a bare header (u64 size, u16 name_len, name) and then the payload:
+ * a dropped connection loses the whole clip and a short file looks
+ * complete. v2 frames the payload into chunks with their own offset and
+ * CRC32C, and lets a reconnecting client continue from what the server has
+ * committed. All integers are big-endian, as in v1. v2 is opt-in
+ * (CameraAttempt4 -2): tcpserver.py and the NetData ingest server only
+ * accept v1.
+ *
+ *   client  HELLO   "SCU2" | version u8 | flags u8 | name_len u16 | size u64 | chunk u32 | ident u32 | name
+ *   server  REPLY   "SCR2" | status u8 | 0 u8 x3 | committed u64
+ *   client  CHUNK   offset u64 | len u32 | crc32c u32 | payload     (offset == committed so far)
+ *   ...
+ *   server  REPLY   after the last chunk, or on an error just before closing
+ *
+ * The server keeps a partial upload as <name>.part, writes only chunks whose
+ * CRC matched and renames it to <name> once `size` bytes are in. `ident`
+ * names the source file (rs_ident(): CRC32C of its size and mtime) and the
+ * server stores it with the .part, so a leftover of another upload under
+ * the same name is started over instead of continued. On HELLO it reports
+ * the .part length rounded down to whole chunks, or `size` for a complete
+ * file with the same size and ident (the client is done). Resuming with a
+ * different chunk size is allowed but only whole chunks count.
+ *
+ * rs_upload() retries with backoff: reconnect, HELLO, continue from the
+ * committed offset. Only connections that move the committed offset reset
+ * the retry budget, so a long upload over a flaky link keeps going while a
+ * dead one gives up after RS_ATTEMPTS. Socket timeouts turn a dead link into
+ * a retry instead of a hang. Chunk payloads go out with up_send_part(), so
+ * a shape (upload.h) paces v2 like v1.
+ *
+ * Build: add ../common/resume.c ../common/crc32c.c ../common/upload.c
+ * ../common/scenario.c.
+ */
+
+#ifndef SMARTCAM_RESUME_H
+#define SMARTCAM_RESUME_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "be.h"
+#include "upload.h"
+
+#define RS_MAGIC_HELLO   "SCU2"
+#define RS_MAGIC_REPLY   "SCR2"
+#define RS_VERSION       2
+#define RS_HELLO_LEN     24
+#define RS_REPLY_LEN     16
+#define RS_CHUNK_HDR_LEN 16
+#define RS_NAME_MAX      255
+#define RS_CHUNK_DEFAULT (1u << 20)
+#define RS_CHUNK_MAX     (16u << 20)
+
+#define RS_ATTEMPTS      8              // Connections in a row without progress before giving up
+#define RS_BACKOFF_MS    500            // First retry delay, doubling...
+#define RS_BACKOFF_MAX_MS 8000          // ...up to this
+#define RS_IO_TIMEOUT_S  10             // Send/receive stall that counts as a dead link
+
+enum rs_status {
+    RS_OK,
+    RS_BAD_REQUEST,            // Malformed HELLO or name
+    RS_BAD_OFFSET,             // Chunk out of order or past the end
+    RS_BAD_CRC,
+    RS_IO_ERROR,               // Server could not store the data
+};
+
+static inline const char *rs_status_name(int status) {
+    switch (status) {
+    case RS_OK:          return "ok";
+    case RS_BAD_REQUEST: return "bad request";
+    case RS_BAD_OFFSET:  return "bad offset";
+    case RS_BAD_CRC:     return "bad crc";
+    case RS_IO_ERROR:    return "server io error";
+    }
+    return "connection lost";
+}
+
+struct rs_stats {
+    unsigned attempts;         // Connections tried
+    unsigned stalls;           // ...most in a row that committed nothing new
+    unsigned handshakes;       // ...that got as far as the server's REPLY
+    uint64_t size;
+    uint64_t sent;             // Payload bytes sent, resends included
+    uint64_t chunks;
+    uint64_t first_offset;     // Committed at the first HELLO (an earlier run's partial upload)
+    uint64_t resume_offset;    // Committed at the last reconnect
+    uint64_t resume_ns;        // Last reconnect: connect + HELLO + REPLY
+    uint64_t committed;        // Highest offset the server has confirmed
+    uint64_t crc_ns, total_ns;
+    const char *crc_impl;
+    struct up_stats up;        // Payload sends (sendfile calls, pacing)
+    int status;                // Last server status, or -1 (connection/IO failure)
+};
+
+/* Identity of a file for HELLO: CRC32C of size u64 | mtime s u64 | mtime ns u32 */
+uint32_t rs_ident(uint64_t size, int64_t mtime_s, long mtime_ns);
+
+/* Upload `path` as `name` to host:port in `chunk`-byte chunks shaped by `shape`
+ * (NULL = unshaped); 0 once the server has committed the whole file, -1 after
+ * RS_ATTEMPTS connections in a row that committed nothing new */
+int  rs_upload(const char *host, int port, const char *path, const char *name, uint32_t chunk,
+               const struct up_shape *shape, struct rs_stats *st);
+
+void rs_report(const struct rs_stats *st, FILE *out);
+
+#endif /* SMARTCAM_RESUME_H */
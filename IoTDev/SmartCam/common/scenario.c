@@ -0,0 +1,393 @@
+/*
+ * Scenario files and reproducible event timelines (see scenario.h).
+ */
+
+#define _POSIX_C_SOURCE 200809L /* strtok_r(), clock_gettime(), clock_nanosleep() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "scenario.h"
+
+#define SC_LINE_MAX 256
+#define SC_MIN_GAP_NS 1000000ULL /* Repeating events at least 1 ms apart, so zero-length draws cannot stall */
+
+/* ------------------- Generator ------------------- */
+
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void sc_rng_seed(struct sc_rng *r, uint64_t seed, uint64_t stream) {
+    uint64_t x = seed ^ splitmix64(&stream); // Decorrelate neighbouring stream ids
+    for (int i = 0; i < 4; ++i) r->s[i] = splitmix64(&x);
+    if (!(r->s[0] | r->s[1] | r->s[2] | r->s[3])) r->s[0] = 1; // All-zero state is a fixed point
+}
+
+int sc_sleep_until(const struct timespec *t0, uint64_t offset_ns) {
+    uint64_t ns = (uint64_t)t0->tv_nsec + offset_ns % SC_NS_PER_S;
+    struct timespec ts = { t0->tv_sec + (time_t)(offset_ns / SC_NS_PER_S + ns / SC_NS_PER_S),
+                           (long)(ns % SC_NS_PER_S) };
+    return clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == 0;
+}
+
+uint64_t sc_elapsed_ns(const struct timespec *t0) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - t0->tv_sec) * SC_NS_PER_S + (uint64_t)now.tv_nsec - (uint64_t)t0->tv_nsec;
+}
+
+/* The timeline of device d uses stream 2d; its auxiliary draws take the odd
+   streams, one per (device, purpose) */
+void sc_aux_rng(struct sc_rng *r, uint64_t seed, unsigned device, enum sc_aux purpose) {
+    sc_rng_seed(r, seed, 2ULL * ((uint64_t)device * SC_AUX_KINDS + purpose) + 1);
+}
+
+static uint64_t add_sat(uint64_t a, uint64_t b) {
+    return (a == SC_NEVER || b == SC_NEVER || a > SC_NEVER - b) ? SC_NEVER : a + b;
+}
+
+static uint64_t min_u64(uint64_t a, uint64_t b) { return a < b ? a : b; }
+
+/* One sample of `d` in ns; SC_NEVER when off (see scenario.h) */
+uint64_t sc_draw(struct sc_rng *r, const struct sc_dist *d) {
+    switch (d->kind) {
+    case SC_DIST_FIXED:
+        return d->a_ns;
+    case SC_DIST_UNIFORM:
+        return sc_rng_range(r, d->a_ns, d->b_ns);
+    case SC_DIST_EXP: {
+        double v = -(double)d->a_ns * log(1.0 - sc_rng_double(r));
+        if (d->b_ns && v > (double)d->b_ns) v = (double)d->b_ns;
+        return (uint64_t)v;
+    }
+    case SC_DIST_NORMAL: {
+        double u1 = 1.0 - sc_rng_double(r), u2 = sc_rng_double(r); // Box-Muller, u1 in (0, 1]
+        double v = (double)d->a_ns + (double)d->b_ns * sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2);
+        return v > 0 ? (uint64_t)v : 0;
+    }
+    case SC_DIST_OFF:
+    default:
+        return SC_NEVER;
+    }
+}
+
+void sc_gen_init(struct sc_gen *g, const struct scenario *sc, uint64_t seed, unsigned device) {
+    memset(g, 0, sizeof(*g));
+    g->sc = sc;
+    sc_rng_seed(&g->rng, seed, 2ULL * device);
+}
+
+/* Enter the current phase at `start` and schedule its first events */
+static void arm_phase(struct sc_gen *g, uint64_t start) {
+    const struct sc_phase *p = &g->sc->phase[g->phase];
+    g->phase_end_ns = p->len_ns ? add_sat(start, p->len_ns) : SC_NEVER;
+    g->next_keepalive_ns = p->keepalive_ns ? add_sat(start, p->keepalive_ns) : SC_NEVER;
+    g->next_motion_ns = add_sat(g->busy_until_ns > start ? g->busy_until_ns : start, sc_draw(&g->rng, &p->idle));
+    g->next_sync_ns = add_sat(start, sc_draw(&g->rng, &p->sync));
+}
+
+static int append(struct sc_event **ev, size_t *n, size_t *cap, struct sc_event e) {
+    if (*n == *cap) {
+        size_t c = *cap ? *cap * 2 : 16;
+        struct sc_event *p = realloc(*ev, c * sizeof(*p));
+        if (!p) return -1;
+        *ev = p;
+        *cap = c;
+    }
+    (*ev)[(*n)++] = e;
+    return 0;
+}
+
+static int push(struct sc_timeline *tl, uint64_t t, uint64_t dur, enum sc_event_type type, unsigned phase) {
+    struct sc_event e = { t, dur, (uint16_t)type, (uint16_t)phase };
+    if (type != SC_EV_MOTION) return append(&tl->ev, &tl->n, &tl->cap, e);
+
+    /* Motions queue across windows until popped; drop the consumed prefix first */
+    if (tl->mq_head > 0 && tl->mq_n == tl->mq_cap) {
+        memmove(tl->mq, tl->mq + tl->mq_head, (tl->mq_n - tl->mq_head) * sizeof(*tl->mq));
+        tl->mq_n -= tl->mq_head;
+        tl->mq_head = 0;
+    }
+    return append(&tl->mq, &tl->mq_n, &tl->mq_cap, e);
+}
+
+/* Compile the next window into tl (replacing its contents) */
+static int fill(struct sc_gen *g, struct sc_timeline *tl, uint64_t window_ns) {
+    const struct scenario *sc = g->sc;
+    uint64_t end = sc->duration_ns ? sc->duration_ns : SC_NEVER;
+    uint64_t horizon = add_sat(g->t_ns, window_ns ? window_ns : 1);
+    int rc = 0;
+
+    tl->n = tl->pos = 0; // Queued motions carry over
+    if (!g->started) {
+        g->started = 1;
+        arm_phase(g, 0);
+        rc |= push(tl, 0, 0, SC_EV_PHASE, 0);
+    }
+
+    while (rc == 0) {
+        /* Earliest pending event; ties resolve phase > keepalive > motion > sync */
+        uint64_t t = min_u64(min_u64(g->phase_end_ns, g->next_keepalive_ns),
+                             min_u64(g->next_motion_ns, g->next_sync_ns));
+        if (t >= end) {
+            if (end != SC_NEVER && end < horizon) {
+                rc |= push(tl, end, 0, SC_EV_END, g->phase);
+                g->done = 1;
+            } else if (end == SC_NEVER && t == SC_NEVER) {
+                g->done = 1; // Nothing scheduled and nothing will change
+            }
+            break;
+        }
+        if (t >= horizon) break;
+
+        const struct sc_phase *p = &sc->phase[g->phase];
+        if (t == g->phase_end_ns) {
+            g->phase = (g->phase + 1) % sc->nphases;
+            arm_phase(g, t);
+            rc |= push(tl, t, 0, SC_EV_PHASE, g->phase);
+        } else if (t == g->next_keepalive_ns) {
+            rc |= push(tl, t, 0, SC_EV_KEEPALIVE, g->phase);
+            g->next_keepalive_ns = add_sat(t, p->keepalive_ns);
+        } else if (t == g->next_motion_ns) {
+            uint64_t dur = sc_draw(&g->rng, &p->capture);
+            if (dur == SC_NEVER) dur = 0;
+            rc |= push(tl, t, dur, SC_EV_MOTION, g->phase);
+            g->busy_until_ns = add_sat(t, dur);
+            g->next_motion_ns = add_sat(g->busy_until_ns, sc_draw(&g->rng, &p->idle));
+            if (g->next_motion_ns < t + SC_MIN_GAP_NS) g->next_motion_ns = t + SC_MIN_GAP_NS;
+        } else {
+            rc |= push(tl, t, 0, SC_EV_SYNC, g->phase);
+            g->next_sync_ns = add_sat(t, sc_draw(&g->rng, &p->sync));
+            if (g->next_sync_ns < t + SC_MIN_GAP_NS) g->next_sync_ns = t + SC_MIN_GAP_NS;
+        }
+    }
+
+    g->t_ns = horizon;
+    return rc;
+}
+
+const struct sc_event *sc_peek(struct sc_gen *g, struct sc_timeline *tl, uint64_t window_ns) {
+    for (;;) {
+        const struct sc_event *ev = tl->pos < tl->n ? &tl->ev[tl->pos] : NULL;
+        if (tl->mq_head < tl->mq_n) {
+            /* Shifted motion goes first unless it is later than the next other
+               event (same-time ties keep the compile order: before sync only),
+               or later than anything compiled so far */
+            uint64_t t = add_sat(tl->mq[tl->mq_head].t_ns, tl->shift_ns);
+            int first = ev ? t < ev->t_ns || (t == ev->t_ns && ev->type == SC_EV_SYNC)
+                           : g->done || t < g->t_ns;
+            if (first) {
+                tl->cur = tl->mq[tl->mq_head];
+                tl->cur.t_ns = t;
+                tl->cur_is_motion = 1;
+                return &tl->cur;
+            }
+        }
+        if (ev) {
+            tl->cur_is_motion = 0;
+            return ev;
+        }
+        if (g->done) return NULL;
+        if (fill(g, tl, window_ns) != 0) {
+            fprintf(stderr, "[scenario] out of memory compiling the timeline\n");
+            g->done = 1;
+            return NULL;
+        }
+    }
+}
+
+void sc_pop(struct sc_timeline *tl) {
+    if (!tl->cur_is_motion) {
+        tl->pos++;
+        return;
+    }
+    tl->motion_end_ns = add_sat(tl->cur.t_ns, tl->cur.dur_ns);
+    tl->motion_open = 1;
+    tl->mq_head++;
+    tl->cur_is_motion = 0;
+}
+
+void sc_motion_done(struct sc_timeline *tl, uint64_t t_ns) {
+    if (tl->motion_open && t_ns > tl->motion_end_ns) tl->shift_ns += t_ns - tl->motion_end_ns;
+    tl->motion_open = 0; // One report per motion
+}
+
+void sc_timeline_free(struct sc_timeline *tl) {
+    free(tl->ev);
+    free(tl->mq);
+    memset(tl, 0, sizeof(*tl));
+}
+
+/* ------------------- Scenario files ------------------- */
+
+struct sc_dist sc_uniform(uint64_t lo_ns, uint64_t hi_ns) {
+    struct sc_dist d = { SC_DIST_UNIFORM, lo_ns, hi_ns < lo_ns ? lo_ns : hi_ns };
+    return d;
+}
+
+void scenario_init(struct scenario *sc) {
+    memset(sc, 0, sizeof(*sc));
+    sc->nphases = 1;
+    strcpy(sc->phase[0].name, "default");
+}
+
+/* "90", "1.5m", "250ms" -> ns; -1 on a bad value */
+static int parse_time(const char *s, uint64_t *out) {
+    char *end;
+    double v = strtod(s, &end);
+    if (end == s || v < 0) return -1;
+    double mul;
+    if (*end == '\0' || strcmp(end, "s") == 0) mul = 1e9;
+    else if (strcmp(end, "ms") == 0) mul = 1e6;
+    else if (strcmp(end, "us") == 0) mul = 1e3;
+    else if (strcmp(end, "m") == 0) mul = 60e9;
+    else if (strcmp(end, "h") == 0) mul = 3600e9;
+    else return -1;
+    *out = (uint64_t)(v * mul + 0.5);
+    return 0;
+}
+
+static int parse_dist(char **tok, int ntok, struct sc_dist *d) {
+    if (ntok == 1 && strcmp(tok[0], "off") == 0) { d->kind = SC_DIST_OFF; return 0; }
+    if (ntok == 1) { d->kind = SC_DIST_FIXED; return parse_time(tok[0], &d->a_ns); } // Bare time = fixed
+    d->b_ns = 0;
+    if (strcmp(tok[0], "fixed") == 0 && ntok == 2) {
+        d->kind = SC_DIST_FIXED;
+        return parse_time(tok[1], &d->a_ns);
+    }
+    if (strcmp(tok[0], "uniform") == 0 && ntok == 3) {
+        d->kind = SC_DIST_UNIFORM;
+        if (parse_time(tok[1], &d->a_ns) || parse_time(tok[2], &d->b_ns)) return -1;
+        return d->b_ns < d->a_ns ? -1 : 0;
+    }
+    if (strcmp(tok[0], "exp") == 0 && (ntok == 2 || ntok == 3)) {
+        d->kind = SC_DIST_EXP;
+        return parse_time(tok[1], &d->a_ns) || (ntok == 3 && parse_time(tok[2], &d->b_ns)) ? -1 : 0;
+    }
+    if (strcmp(tok[0], "normal") == 0 && ntok == 3) {
+        d->kind = SC_DIST_NORMAL;
+        return parse_time(tok[1], &d->a_ns) || parse_time(tok[2], &d->b_ns) ? -1 : 0;
+    }
+    return -1;
+}
+
+int scenario_load(struct scenario *sc, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) { perror(path); return -1; }
+
+    char line[SC_LINE_MAX];
+    unsigned lineno = 0, declared = 0;
+    struct sc_phase *cur = &sc->phase[0]; // Defaults until the first "phase"
+    int rc = 0;
+
+    while (rc == 0 && fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+
+        char *tok[8], *save = NULL;
+        int ntok = 0;
+        for (char *t = strtok_r(line, " \t\r\n", &save); t && ntok < 8; t = strtok_r(NULL, " \t\r\n", &save))
+            tok[ntok++] = t;
+        if (ntok == 0) continue;
+
+        const char *key = tok[0];
+        int bad = 0;
+        if (strcmp(key, "seed") == 0 && ntok == 2) {
+            char *end;
+            sc->seed = strtoull(tok[1], &end, 0);
+            sc->has_seed = 1;
+            bad = *end != '\0';
+        } else if (strcmp(key, "duration") == 0 && ntok == 2) {
+            bad = parse_time(tok[1], &sc->duration_ns);
+        } else if (strcmp(key, "phase") == 0 && ntok == 3) {
+            if (declared == SC_MAX_PHASES) {
+                fprintf(stderr, "%s:%u: more than %d phases\n", path, lineno, SC_MAX_PHASES);
+                rc = -1;
+                break;
+            }
+            if (declared > 0 && cur->len_ns == 0) {
+                fprintf(stderr, "%s:%u: only the last phase may have length 0\n", path, lineno);
+                rc = -1;
+                break;
+            }
+            sc->phase[declared] = *cur; // Start from the previous phase (or the defaults)
+            cur = &sc->phase[declared++];
+            snprintf(cur->name, sizeof(cur->name), "%s", tok[1]);
+            bad = parse_time(tok[2], &cur->len_ns);
+        } else if (strcmp(key, "base") == 0 && ntok == 2) {
+            cur->base_mbps = strtod(tok[1], NULL);
+            bad = cur->base_mbps < 0;
+        } else if (strcmp(key, "motion") == 0 && ntok == 2) {
+            cur->motion_mbps = strtod(tok[1], NULL);
+            bad = cur->motion_mbps < 0;
+        } else if (strcmp(key, "keepalive") == 0 && ntok == 2) {
+            if (strcmp(tok[1], "off") == 0) cur->keepalive_ns = 0;
+            else bad = parse_time(tok[1], &cur->keepalive_ns);
+        } else if (strcmp(key, "idle") == 0 && ntok >= 2) {
+            bad = parse_dist(tok + 1, ntok - 1, &cur->idle);
+        } else if (strcmp(key, "capture") == 0 && ntok >= 2) {
+            bad = parse_dist(tok + 1, ntok - 1, &cur->capture);
+        } else if (strcmp(key, "sync") == 0 && ntok >= 2) {
+            bad = parse_dist(tok + 1, ntok - 1, &cur->sync);
+        } else {
+            bad = 1;
+        }
+        if (bad) {
+            fprintf(stderr, "%s:%u: cannot parse '%s' line\n", path, lineno, key);
+            rc = -1;
+        }
+    }
+    fclose(f);
+    if (rc != 0) return rc;
+
+    if (declared > 0) sc->nphases = declared;
+    sc->path = path;
+    return 0;
+}
+
+uint64_t scenario_seed(const struct scenario *sc, const char *z_opt) {
+    if (z_opt) return strtoull(z_opt, NULL, 0);
+    if (sc->has_seed) return sc->seed;
+
+    /* Fresh seed; printed by scenario_print() so the run can be repeated with -z */
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    uint64_t x = ((uint64_t)t.tv_sec * SC_NS_PER_S + (uint64_t)t.tv_nsec) ^ ((uint64_t)getpid() << 32);
+    return splitmix64(&x);
+}
+
+static void dist_str(const struct sc_dist *d, char *out, size_t len) {
+    switch (d->kind) {
+    case SC_DIST_FIXED:   snprintf(out, len, "%.3fs", (double)d->a_ns / 1e9); break;
+    case SC_DIST_UNIFORM: snprintf(out, len, "uniform %.3fs..%.3fs", (double)d->a_ns / 1e9, (double)d->b_ns / 1e9); break;
+    case SC_DIST_EXP:     snprintf(out, len, "exp mean %.3fs cap %.3fs", (double)d->a_ns / 1e9, (double)d->b_ns / 1e9); break;
+    case SC_DIST_NORMAL:  snprintf(out, len, "normal %.3fs sd %.3fs", (double)d->a_ns / 1e9, (double)d->b_ns / 1e9); break;
+    default:              snprintf(out, len, "off"); break;
+    }
+}
+
+void scenario_print(const struct scenario *sc, uint64_t seed, FILE *out) {
+    fprintf(out, "[scenario] file=%s seed=%llu phases=%u duration=%s\n",
+            sc->path ? sc->path : "(options)", (unsigned long long)seed, sc->nphases,
+            sc->duration_ns ? "bounded" : "unbounded");
+    for (unsigned i = 0; i < sc->nphases; ++i) {
+        const struct sc_phase *p = &sc->phase[i];
+        char idle[64], cap[64], sync[64];
+        dist_str(&p->idle, idle, sizeof(idle));
+        dist_str(&p->capture, cap, sizeof(cap));
+        dist_str(&p->sync, sync, sizeof(sync));
+        fprintf(out, "[scenario]   %-12s len=%.0fs base=%.2fMbps motion=%.2fMbps keepalive=%.0fs idle=%s capture=%s sync=%s\n",
+                p->name, (double)p->len_ns / 1e9, p->base_mbps, p->motion_mbps,
+                (double)p->keepalive_ns / 1e9, idle, cap, sync);
+    }
+    if (sc->duration_ns) fprintf(out, "[scenario]   ends after %.0fs\n", (double)sc->duration_ns / 1e9);
+}
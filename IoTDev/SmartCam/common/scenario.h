@@ -0,0 +1,219 @@
+/*
+ * Scenario files and reproducible event timelines for the SmartCam emulators.
+ *
+ * A scenario is a list of phases (e.g. "night", "day"), each with its own
+ * stream bitrates, keepalive interval and distributions for the gap between
+ * motion/capture events, their length and the sync schedule. It is compiled
+ * into a flat array of timestamped events, sorted by construction, which the
+ * emulators walk in order: all random draws happen at compile time, from a
+ * per-device xoshiro256** generator, so the same scenario, seed and device
+ * index always give the same event schedule.
+ *
+ * Emulators whose captures are followed by an upload report when each
+ * capture+upload finished (sc_motion_done()); later motion events then move
+ * by however long that overran the capture, so every idle gap counts from
+ * the real end of the previous cycle. The draws themselves do not change.
+ *
+ * File format (one setting per line, '#' starts a comment, times take an
+ * optional ms/s/m/h suffix and default to seconds):
+ *
+ *   seed 42                    # Default seed (the emulators' -z overrides it)
+ *   duration 8h                # Stop after this long; 0 = cycle phases forever
+ *   phase night 6h             # Settings below apply to this phase...
+ *     base 1.5                 # Stream Mbps outside motion
+ *     motion 4                 # Stream Mbps during motion
+ *     keepalive 30s            # Or "off"
+ *     idle uniform 20m 2h      # End of one motion/capture to start of the next
+ *     capture uniform 10s 30s  # Motion/capture length
+ *     sync off                 # Gap between sync bursts
+ *   phase day 2h               # ...and a new phase starts as a copy of the last
+ *     idle exp 5m 30m          # Exponential, mean 5 min, capped at 30 min
+ *
+ * Distributions: fixed T | uniform A B | exp MEAN [CAP] | normal MEAN SD | off.
+ * Settings given before the first phase (and the emulator's command-line
+ * options) are what the first phase starts from; every later phase starts
+ * as a copy of the one before it, so a setting changed in one phase carries
+ * on until a later phase changes it again. Phases play in order
+ * and repeat until `duration`; the last phase may have length 0 (open-ended).
+ *
+ * Build: add ../common/scenario.c and -lm to the emulator's compile line.
+ */
+
+#ifndef SMARTCAM_SCENARIO_H
+#define SMARTCAM_SCENARIO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define SC_MAX_PHASES 32
+#define SC_NEVER      UINT64_MAX
+#define SC_NS_PER_S   1000000000ULL
+
+/* ------------------- xoshiro256** ------------------- */
+
+struct sc_rng { uint64_t s[4]; };
+
+/* Independent generator for (`seed`, `stream`); streams never overlap in practice */
+void sc_rng_seed(struct sc_rng *r, uint64_t seed, uint64_t stream);
+
+static inline uint64_t sc_rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+static inline uint64_t sc_rng_next(struct sc_rng *r) {
+    uint64_t *s = r->s;
+    uint64_t out = sc_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = sc_rotl(s[3], 45);
+    return out;
+}
+
+/* Uniform integer in [lo, hi] (multiply-shift, no division) */
+static inline uint64_t sc_rng_range(struct sc_rng *r, uint64_t lo, uint64_t hi) {
+    if (hi <= lo) return lo;
+    uint64_t span = hi - lo + 1;
+    if (span == 0) return sc_rng_next(r); // Full 64-bit range
+    return lo + (uint64_t)(((unsigned __int128)sc_rng_next(r) * span) >> 64);
+}
+
+/* Uniform double in [0, 1) */
+static inline double sc_rng_double(struct sc_rng *r) {
+    return (double)(sc_rng_next(r) >> 11) * 0x1.0p-53;
+}
+
+/* ------------------- Scenario ------------------- */
+
+enum sc_dist_kind { SC_DIST_OFF, SC_DIST_FIXED, SC_DIST_UNIFORM, SC_DIST_EXP, SC_DIST_NORMAL };
+
+struct sc_dist {
+    enum sc_dist_kind kind;
+    uint64_t a_ns;             // fixed: value, uniform: low, exp/normal: mean
+    uint64_t b_ns;             // uniform: high, exp: cap (0 = none), normal: standard deviation
+};
+
+struct sc_phase {
+    char name[32];
+    uint64_t len_ns;           // 0 = open-ended
+    double base_mbps;          // Stream bitrate outside motion
+    double motion_mbps;        // Stream bitrate during motion
+    uint64_t keepalive_ns;     // 0 = off
+    struct sc_dist idle;       // End of one motion/capture to start of the next
+    struct sc_dist capture;    // Motion/capture length
+    struct sc_dist sync;       // Gap between sync events
+};
+
+struct scenario {
+    const char *path;          // Source file, NULL = built from command-line defaults
+    uint64_t seed;
+    int has_seed;              // File gave a seed
+    uint64_t duration_ns;      // 0 = unbounded
+    unsigned nphases;
+    struct sc_phase phase[SC_MAX_PHASES];
+};
+
+/* One open-ended phase with everything off; callers then fill phase[0] with their defaults */
+void scenario_init(struct scenario *sc);
+
+/* Parse a scenario file on top of the defaults in phase[0]; returns 0 or -1 (message on stderr) */
+int scenario_load(struct scenario *sc, const char *path);
+
+/* Convenience for the common "min..max" defaults */
+struct sc_dist sc_uniform(uint64_t lo_ns, uint64_t hi_ns);
+
+/* One sample of `d` in ns (SC_NEVER when off), for draws made outside the timeline */
+uint64_t sc_draw(struct sc_rng *r, const struct sc_dist *d);
+
+/* -z argument if given (NULL = not given), else the file's seed, else a fresh one */
+uint64_t scenario_seed(const struct scenario *sc, const char *z_opt);
+
+void scenario_print(const struct scenario *sc, uint64_t seed, FILE *out);
+
+/* ------------------- Compiled timeline ------------------- */
+
+enum sc_event_type {
+    SC_EV_PHASE,               // Phase `phase` starts: new rates/settings
+    SC_EV_MOTION,              // Motion/capture of `dur_ns` starts
+    SC_EV_KEEPALIVE,
+    SC_EV_SYNC,
+    SC_EV_END,                 // Scenario duration reached
+};
+
+struct sc_event {
+    uint64_t t_ns;             // Offset from the start of the run
+    uint64_t dur_ns;           // SC_EV_MOTION only
+    uint16_t type;             // enum sc_event_type
+    uint16_t phase;            // Index into scenario.phase[]
+};
+
+struct sc_timeline {
+    struct sc_event *ev;       // Everything but motion, current window
+    size_t n;                  // Events in the current window
+    size_t cap;
+    size_t pos;                // Next event to act on
+    struct sc_event *mq;       // Motion events compiled so far, nominal times
+    size_t mq_head, mq_n, mq_cap;
+    uint64_t shift_ns;         // Added to every queued motion (sc_motion_done)
+    uint64_t motion_end_ns;    // Shifted end of the last motion popped...
+    int motion_open;           // ...not yet reported by sc_motion_done()
+    struct sc_event cur;       // Motion handed out by sc_peek(), shifted
+    int cur_is_motion;         // sc_pop() takes from mq rather than ev
+};
+
+/* Incremental compiler: state carried from one window to the next */
+struct sc_gen {
+    const struct scenario *sc;
+    struct sc_rng rng;
+    unsigned phase;
+    uint64_t phase_end_ns;
+    uint64_t next_keepalive_ns;
+    uint64_t next_motion_ns;
+    uint64_t next_sync_ns;
+    uint64_t busy_until_ns;    // End of the current motion/capture (nominal clock)
+    uint64_t t_ns;             // Compiled up to here
+    int started;
+    int done;                  // Nothing left to compile
+};
+
+/* Generator for device `device` (0 for single-camera emulators) */
+void sc_gen_init(struct sc_gen *g, const struct scenario *sc, uint64_t seed, unsigned device);
+
+/* Next event to act on, compiling `window_ns` of schedule at a time into `tl`
+   (windows only bound memory; the schedule does not depend on them). NULL
+   when nothing further will ever happen; a bounded scenario ends with an
+   SC_EV_END event at `duration`. */
+const struct sc_event *sc_peek(struct sc_gen *g, struct sc_timeline *tl, uint64_t window_ns);
+
+/* Consume the event returned by the last sc_peek() */
+void sc_pop(struct sc_timeline *tl);
+
+/* The motion last popped, and whatever it triggered (upload), finished at
+   offset `t_ns`: later motion events move back by any overrun past its
+   capture, so the next idle gap starts at `t_ns` */
+void sc_motion_done(struct sc_timeline *tl, uint64_t t_ns);
+
+void sc_timeline_free(struct sc_timeline *tl);
+
+/* What an auxiliary generator is for: each gets its own stream per device */
+enum sc_aux { SC_AUX_STAGGER, SC_AUX_JITTER, SC_AUX_CAPTURE, SC_AUX_KINDS };
+
+/* ------------------- Walking a timeline ------------------- */
+
+#define SC_WINDOW_NS (24ULL * 3600 * SC_NS_PER_S) // sc_peek() window of the camera emulators: a day at a time
+
+/* Sleep until `offset_ns` after `t0` (CLOCK_MONOTONIC); 0 if a signal cut it short */
+int sc_sleep_until(const struct timespec *t0, uint64_t offset_ns);
+
+/* Time since `t0` (CLOCK_MONOTONIC), on the timeline's clock */
+uint64_t sc_elapsed_ns(const struct timespec *t0);
+
+/* Generator for per-device run-time draws (start stagger, upload jitter, -D
+   capture lengths), separate from the timeline stream so using it does not
+   shift the schedule, and from every other device's and purpose's draws */
+void sc_aux_rng(struct sc_rng *r, uint64_t seed, unsigned device, enum sc_aux purpose);
+
+#endif /* SMARTCAM_SCENARIO_H */
@@ -0,0 +1,94 @@
+/*
+ * Coded sync pulses (see syncpulse.h).
+ */
+
+#define _POSIX_C_SOURCE 200809L /* clock_nanosleep() */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/socket.h>
+
+#include "be.h"
+#include "syncpulse.h"
+
+/* Feedback taps (1-based register positions) of a primitive polynomial per degree */
+static const uint8_t taps[SP_DEGREE_MAX + 1][4] = {
+    [5] = { 5, 3 },  [6] = { 6, 5 },           [7] = { 7, 6 },            [8] = { 8, 6, 5, 4 },
+    [9] = { 9, 5 },  [10] = { 10, 7 },         [11] = { 11, 9 },          [12] = { 12, 6, 4, 1 },
+    [13] = { 13, 4, 3, 1 }, [14] = { 14, 5, 3, 1 }, [15] = { 15, 14 },   [16] = { 16, 15, 13, 4 },
+};
+
+static uint64_t mono_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t t) {
+    struct timespec ts = { (time_t)(t / 1000000000ULL), (long)(t % 1000000000ULL) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {} // EINTR: sleep on
+}
+
+unsigned sp_mls(unsigned degree, uint8_t *bits) {
+    if (degree < SP_DEGREE_MIN || degree > SP_DEGREE_MAX) return 0;
+    uint32_t mask = 0;
+    for (unsigned i = 0; i < 4 && taps[degree][i]; i++) mask |= 1u << (taps[degree][i] - 1);
+    uint32_t state = (1u << degree) - 1; // Any non-zero seed; all ones makes the code start with a run of 1s
+    unsigned len = (1u << degree) - 1;
+    for (unsigned i = 0; i < len; i++) {
+        bits[i] = (uint8_t)(state >> (degree - 1) & 1);
+        state = (state << 1 | (uint32_t)__builtin_parity(state & mask)) & len;
+    }
+    return len;
+}
+
+int sp_parse(const char *str, struct sp_params *p) {
+    char *end;
+    long deg = strtol(str, &end, 10);
+    double chip = SP_CHIP_MS_DEFAULT;
+    if (*end == ':') chip = strtod(end + 1, &end);
+    if (*end || deg < SP_DEGREE_MIN || deg > SP_DEGREE_MAX || chip < 2 * SP_PACKET_MS) return -1;
+    p->degree = (unsigned)deg;
+    p->chip_ms = chip;
+    return 0;
+}
+
+int sp_emit(const struct sp_params *p, int sock, struct sp_stats *st) {
+    uint8_t *bits = malloc((size_t)1 << p->degree);
+    if (!bits) return -1;
+    unsigned len = sp_mls(p->degree, bits);
+    if (len == 0) { free(bits); return -1; }
+
+    uint64_t chip_ns = (uint64_t)(p->chip_ms * 1e6), gap_ns = (uint64_t)(SP_PACKET_MS * 1e6);
+    uint8_t pkt[SP_PKT_LEN] = {0};
+    memcpy(pkt, SP_PKT_MAGIC, 4);
+    pkt[4] = (uint8_t)p->degree;
+    be_put32(pkt + 12, (uint32_t)(chip_ns / 1000));
+
+    uint64_t t0 = mono_ns() + 1000000; // First edge 1 ms out, so chip 0 is not already late
+    for (unsigned k = 0; k < len; k++) {
+        uint64_t start = t0 + k * chip_ns, end = start + chip_ns;
+        if (!bits[k]) { sleep_until_ns(end); continue; }
+        sleep_until_ns(start);     // Only waits after a 0 chip; 1 chips run back to back
+        uint64_t late = mono_ns() - start;
+        if (late > st->late_ns) st->late_ns = late;
+        be_put32(pkt + 8, k);
+        /* Spin for the whole chip (that is the load step) with a packet every SP_PACKET_MS */
+        for (uint64_t next = start, now; (now = mono_ns()) < end;) {
+            if (now < next || sock < 0) continue;
+            if (send(sock, pkt, sizeof(pkt), MSG_DONTWAIT) < 0) st->errors++;
+            st->packets++;
+            next += gap_ns;
+        }
+    }
+    free(bits);
+    return 0;
+}
+
+void sp_report(const struct sp_params *p, const struct sp_stats *st, FILE *out) {
+    fprintf(out, "[sync] mls degree=%u chips=%u chip=%.1fms packets=%llu errors=%llu worst edge late=%.1fus\n",
+            p->degree, (1u << p->degree) - 1, p->chip_ms, (unsigned long long)st->packets,
+            (unsigned long long)st->errors, (double)st->late_ns / 1e3);
+}
@@ -0,0 +1,56 @@
+/*
+ * Coded sync pulses for aligning the power trace with the network capture
+ * (correlator: IoTDev/scripts/SyncAlign/syncalign.c).
+ *
+ * A sync is a maximal-length sequence (MLS) of 2^degree - 1 chips played on
+ * an absolute CLOCK_MONOTONIC schedule. During a 1 chip the CPU spins and a
+ * packet goes out every SP_PACKET_MS from the chip edge on; during a 0 chip
+ * the thread sleeps. The current draw and the packet train therefore both
+ * carry the same code. An MLS correlates with itself as one sharp peak
+ * with flat sidelobes at every other shift, so the correlator can find it
+ * in hours of data and place it to a fraction of a chip. The old fixed burst
+ * could only be lined up by eye.
+ *
+ * Packet, big-endian: "SCP1" | degree u8 | 0 u8 x3 | chip index u32 | chip_us u32.
+ * The correlator only needs the send times. The payload identifies sync
+ * packets in a capture and says which chip each one belongs to.
+ *
+ * Build: add ../common/syncpulse.c to the emulator's compile line.
+ */
+
+#ifndef SMARTCAM_SYNCPULSE_H
+#define SMARTCAM_SYNCPULSE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define SP_DEGREE_MIN     5
+#define SP_DEGREE_MAX     16
+#define SP_DEGREE_DEFAULT 9        // 511 chips
+#define SP_CHIP_MS_DEFAULT 10.0    // 5.1 s per sync at the default degree
+#define SP_PACKET_MS      1.0      // Packet spacing inside a 1 chip
+#define SP_PKT_MAGIC      "SCP1"
+#define SP_PKT_LEN        16
+
+struct sp_params {
+    unsigned degree;
+    double chip_ms;
+};
+
+struct sp_stats {
+    uint64_t packets, errors;
+    uint64_t late_ns;              // Worst lateness of a chip edge
+};
+
+/* The sequence for `degree` as 0/1 bytes into bits[2^degree - 1]; its length, or 0 for an unsupported degree */
+unsigned sp_mls(unsigned degree, uint8_t *bits);
+
+/* "DEG[:CHIP_MS]", e.g. "9:10"; 0 or -1 */
+int sp_parse(const char *str, struct sp_params *p);
+
+/* Play one sync on a connected UDP socket (-1: CPU pattern only); blocks for the code's length. 0 or -1 */
+int sp_emit(const struct sp_params *p, int sock, struct sp_stats *st);
+
+void sp_report(const struct sp_params *p, const struct sp_stats *st, FILE *out);
+
+#endif /* SMARTCAM_SYNCPULSE_H */
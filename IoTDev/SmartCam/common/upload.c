@@ -0,0 +1,176 @@
+/*
+ * Shaped bulk upload (see upload.h).
+ */
+
+#define _DEFAULT_SOURCE /* struct tcp_info, nanosleep() */
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/sockios.h>
+
+#include "upload.h"
+
+#ifndef SO_MAX_PACING_RATE
+#define SO_MAX_PACING_RATE 47
+#endif
+
+#define UP_MAX_CALL 0x7ffff000u    // sendfile() moves at most this much per call
+
+static uint64_t mono_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+int up_jitter_parse(const char *str, struct up_shape *s) {
+    if (strcmp(str, "none") == 0) { s->jitter = UP_JITTER_NONE; return 0; }
+    if (strcmp(str, "exp") == 0) { s->jitter = UP_JITTER_EXP; return 0; }
+    if (strncmp(str, "uniform", 7) == 0 && (str[7] == '\0' || str[7] == ':')) {
+        s->jitter = UP_JITTER_UNIFORM;
+        s->frac = str[7] ? atof(str + 8) : 0.5;
+        return s->frac >= 0 && s->frac <= 1 ? 0 : -1;
+    }
+    return -1;
+}
+
+/* Current congestion window in bytes, 0 if unknown */
+static uint64_t cwnd_bytes(int sock) {
+    struct tcp_info ti;
+    socklen_t len = sizeof(ti);
+    if (getsockopt(sock, IPPROTO_TCP, TCP_INFO, &ti, &len) != 0) return 0;
+    return (uint64_t)ti.tcpi_snd_cwnd * ti.tcpi_snd_mss;
+}
+
+/* Send exactly n bytes (fewer only on error); 0 or -1 */
+static int send_span(int sock, int fd, off_t *off, uint64_t n, struct up_stats *st) {
+    while (n > 0) {
+        ssize_t r = sendfile(sock, fd, off, n > UP_MAX_CALL ? UP_MAX_CALL : (size_t)n);
+        st->calls++;
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) { st->error = r < 0 ? errno : EPIPE; return -1; } // 0: file shorter than promised
+        n -= (uint64_t)r;
+        st->bytes += (uint64_t)r;
+    }
+    return 0;
+}
+
+/* Paced sends return once the data is queued: sleep off what is still in the send queue at
+ * the target rate, so the time (and rate) reported is for data on the wire */
+static void wait_sent(int sock, double rate, struct up_stats *st) {
+    int queued;
+    while (ioctl(sock, SIOCOUTQ, &queued) == 0 && queued > 0) {
+        struct tcp_info ti;
+        socklen_t len = sizeof(ti);
+        if (getsockopt(sock, IPPROTO_TCP, TCP_INFO, &ti, &len) != 0 || ti.tcpi_state != TCP_ESTABLISHED) {
+            st->error = ECONNRESET; // A reset link keeps its unacked count: it would never drain
+            return;
+        }
+        uint64_t ns = (uint64_t)((double)queued / rate * 1e9);
+        if (ns < 1000000) ns = 1000000;
+        struct timespec ts = { (time_t)(ns / 1000000000ULL), (long)(ns % 1000000000ULL) };
+        if (nanosleep(&ts, NULL) != 0) break; // Signal: stop waiting
+        st->sleeps++;
+    }
+}
+
+/* Gap after a burst of n bytes: the mean keeps the target rate, jitter scales it */
+static uint64_t gap_ns(const struct up_shape *s, uint64_t n) {
+    double mean = (double)n / s->rate * 1e9;
+    switch (s->jitter) {
+    case UP_JITTER_UNIFORM: return (uint64_t)(mean * (1.0 + s->frac * (2.0 * sc_rng_double(s->rng) - 1.0)));
+    case UP_JITTER_EXP:     return (uint64_t)(-mean * log(1.0 - sc_rng_double(s->rng)));
+    default:                return (uint64_t)mean;
+    }
+}
+
+static int send_shaped(int sock, int fd, off_t off, uint64_t len, const struct up_shape *s, int drain,
+                       struct up_stats *st) {
+    uint64_t t0 = mono_ns();
+    int rc;
+
+    if (s->rate <= 0) {
+        rc = send_span(sock, fd, &off, len, st);
+        st->ns += mono_ns() - t0;
+        return rc;
+    }
+
+    if (s->jitter == UP_JITTER_NONE) {
+        unsigned rate = s->rate >= (double)UINT32_MAX ? UINT32_MAX - 1 : (unsigned)s->rate;
+        if (setsockopt(sock, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate)) == 0) {
+            st->paced = 1;
+            rc = send_span(sock, fd, &off, len, st);
+            if (rc == 0 && drain) wait_sent(sock, s->rate, st);
+            if (st->error) rc = -1;
+            st->ns += mono_ns() - t0;
+            return rc;
+        }
+    }
+
+    /* Token bucket: a window at a time, released on a schedule that averages out to the rate */
+    uint64_t max_burst = (uint64_t)(s->rate * (double)UP_MAX_GAP_NS / 1e9);
+    if (max_burst < UP_MIN_BURST) max_burst = UP_MIN_BURST;
+    uint64_t release = t0;
+    rc = 0;
+    while (len > 0) {
+        uint64_t burst = cwnd_bytes(sock);
+        if (burst < UP_MIN_BURST) burst = UP_MIN_BURST;
+        if (burst > max_burst) burst = max_burst;
+        if (burst > len) burst = len;
+        if ((rc = send_span(sock, fd, &off, burst, st)) != 0) break;
+        st->bursts++;
+        st->burst_sum += burst;
+        len -= burst;
+        if (len == 0) break;
+
+        release += gap_ns(s, burst);
+        if (release > mono_ns()) {     // Behind schedule (slow network): no sleep, no catching up later
+            struct timespec ts = { (time_t)(release / 1000000000ULL), (long)(release % 1000000000ULL) };
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+            st->sleeps++;
+        } else {
+            release = mono_ns();
+        }
+    }
+    st->ns += mono_ns() - t0;
+    return rc;
+}
+
+int up_send_file(int sock, int fd, off_t off, uint64_t len, const struct up_shape *s, struct up_stats *st) {
+    return send_shaped(sock, fd, off, len, s, 1, st);
+}
+
+int up_send_part(int sock, int fd, off_t off, uint64_t len, const struct up_shape *s, struct up_stats *st) {
+    return send_shaped(sock, fd, off, len, s, 0, st);
+}
+
+int up_wait_sent(int sock, const struct up_shape *s, struct up_stats *st) {
+    if (!st->paced || s->rate <= 0) return 0; // The token bucket returns with its last burst sent
+    uint64_t t0 = mono_ns();
+    wait_sent(sock, s->rate, st);
+    st->ns += mono_ns() - t0;
+    return st->error ? -1 : 0;
+}
+
+void up_report(const struct up_stats *st, const struct up_shape *s, FILE *out) {
+    static const char *const jitter[] = { "none", "uniform", "exp" };
+    double secs = (double)st->ns / 1e9;
+    fprintf(out, "[upload] %.2f MB in %.2fs (%.2f MB/s", (double)st->bytes / 1e6, secs,
+            secs > 0 ? (double)st->bytes / secs / 1e6 : 0.0);
+    if (s->rate > 0)
+        fprintf(out, ", target %.2f, %s", s->rate / 1e6,
+                st->paced ? "kernel pacing" : "token bucket");
+    if (s->rate > 0 && !st->paced)
+        fprintf(out, " jitter=%s bursts=%llu of %.0fKB", jitter[s->jitter], (unsigned long long)st->bursts,
+                st->bursts ? (double)st->burst_sum / (double)st->bursts / 1024.0 : 0.0);
+    fprintf(out, ") sendfile=%llu wakeups=%llu%s%s\n", (unsigned long long)st->calls,
+            (unsigned long long)st->sleeps, st->error ? " error=" : "", st->error ? strerror(st->error) : "");
+}
@@ -0,0 +1,68 @@
+/*
+ * Shaped bulk upload for the SmartCam emulators.
+ *
+ * The payload goes from the file to the socket with sendfile(): no copies
+ * through user space and one call per burst instead of one per small chunk.
+ * The shape comes from one of two places:
+ *
+ *   kernel pacing   target rate, no jitter: SO_MAX_PACING_RATE on the socket
+ *                   and the whole file in a few sendfile() calls; TCP spreads
+ *                   the segments out itself, with no wakeups on our side
+ *   token bucket    target rate with jitter (or no pacing support): bursts of
+ *                   one congestion window (snd_cwnd * mss from TCP_INFO, kept
+ *                   between UP_MIN_BURST and UP_MAX_GAP_NS worth of the rate),
+ *                   each followed by a sleep that keeps the mean at the target
+ *
+ * Jitter scales each gap between bursts: uniform within +-frac of the mean
+ * gap, or exponential (bursts as a Poisson process). Either way the mean
+ * rate stays at the target. Rate 0 sends as fast as the network allows.
+ *
+ * Build: add ../common/upload.c (and ../common/scenario.c for the rng).
+ */
+
+#ifndef SMARTCAM_UPLOAD_H
+#define SMARTCAM_UPLOAD_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "scenario.h"
+
+#define UP_MIN_BURST  (16u * 1024)         // Smallest token-bucket burst (bytes)
+#define UP_MAX_GAP_NS (50ULL * 1000000ULL) // Largest mean gap between bursts
+
+enum up_jitter { UP_JITTER_NONE, UP_JITTER_UNIFORM, UP_JITTER_EXP };
+
+struct up_shape {
+    double rate;               // Target bytes/s, 0 = unlimited
+    enum up_jitter jitter;
+    double frac;               // Uniform: gap varies by +-frac of the mean
+    struct sc_rng *rng;        // Jitter draws; may be NULL without jitter
+};
+
+struct up_stats {
+    uint64_t bytes, ns;
+    uint64_t calls;            // sendfile() calls
+    uint64_t sleeps;           // Token-bucket waits (our wakeups)
+    uint64_t bursts, burst_sum;    // Token bucket only
+    int paced;                 // Kernel pacing was used
+    int error;                 // errno of a failed send, 0 if none
+};
+
+/* "none", "uniform[:frac]" (default frac 0.5) or "exp" into s; 0 or -1 */
+int up_jitter_parse(const char *str, struct up_shape *s);
+
+/* Send len bytes of fd from offset off on a connected TCP socket, shaped by s.
+ * Stats are added to st. 0 or -1 (st->error says why). */
+int up_send_file(int sock, int fd, off_t off, uint64_t len, const struct up_shape *s, struct up_stats *st);
+
+/* The same for one part of a longer upload on the socket: with kernel pacing
+ * it returns once the part is queued; up_wait_sent() after the last part
+ * waits for the send queue to drain, once */
+int up_send_part(int sock, int fd, off_t off, uint64_t len, const struct up_shape *s, struct up_stats *st);
+int up_wait_sent(int sock, const struct up_shape *s, struct up_stats *st);
+
+void up_report(const struct up_stats *st, const struct up_shape *s, FILE *out);
+
+#endif /* SMARTCAM_UPLOAD_H */
@@ -0,0 +1,728 @@
+/*
+ * syncalign: find the SmartCam sync code in a power log and in a network
+ * capture and print the offset between their clocks
+ * - The code is the maximal-length sequence smartcam_sim -Y plays in CPU
+ *   load and UDP packets (IoTDev/SmartCam/common/syncpulse.h)
+ * - Both traces are reduced to a coarse grid (8 bins per chip) and
+ *   correlated with the code by FFT (overlap-save, two blocks per complex
+ *   transform), normalised so a score of 1 is a perfect match; every peak
+ *   over the threshold is a sync
+ * - Each sync is then placed at full resolution: power by a sub-sample
+ *   search of the correlation around the peak, network by the first packet
+ *   of every chip that follows a silent one
+ * - With more than one sync in both traces the clock drift is fitted too
+ * - Replaces the hand-set master_start_str in powertimetomastertime.py and
+ *   nettimetomastertime.py
+ *
+ * Build:
+ *   gcc -O2 -std=c11 -o syncalign syncalign.c ../../SmartCam/common/syncpulse.c -lm
+ *
+ * Usage:
+ *   ./syncalign [-p <power.csv>] [-n <capture.pcap|capture.csv>] [options]
+ *
+ * Options:
+ *   -p <file>    Power log CSV: time in seconds and current (rows that do not
+ *                parse, like the logger's preamble and header, are skipped)
+ *   -c <col>     Current column in the power log, 1-based (default: 2)
+ *   -n <file>    Network capture: pcap, or a Wireshark/tshark CSV export
+ *                ("Time" and "Info" columns; Time in seconds, e.g. "Seconds
+ *                since beginning of capture", UTF-8, and the UDP Info with
+ *                either "40000  >  9001 Len=16" or the newer "40000 → 9001
+ *                Len=16")
+ *   -s <port>    Sync port (default: 9001)
+ *   -y <d[:ms]>  Code: MLS degree and chip length, as given to -Y on the
+ *                camera (default: 9:10)
+ *   -t <score>   Detection threshold, 0..1 (default: 0.4)
+ *   -h           Show this help and exit
+ *
+ * Output: one line per sync found in each trace, then the offset (network
+ * time = power time + offset, plus drift when it can be fitted). With a
+ * pcap, whose times are absolute, the wall-clock time of power t = 0 is
+ * printed as well: that is master_start_str for powertimetomastertime.py.
+ */
+
+#define _GNU_SOURCE /* localtime_r(), MAP_POPULATE */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../../SmartCam/common/syncpulse.h"
+
+#define BINS_PER_CHIP 8
+#define MARK_EVERY    64                /* Power: file offset kept for every 64th coarse bin */
+#define MAX_SYNCS     1024
+#define SYNC_PORT     9001
+#define THRESHOLD     0.4
+
+#define PCAP_MAGIC_US 0xa1b2c3d4u
+#define PCAP_MAGIC_NS 0xa1b23c4du
+
+static uint64_t mono_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+/* ------------------- Code ------------------- */
+
+struct code {
+    uint8_t *bits;
+    unsigned len;
+    double chip;                        /* Seconds */
+    double *cum;                        /* cum[k] = sum of +-1 over chips < k */
+};
+
+static int code_init(struct code *c, const struct sp_params *p) {
+    c->bits = malloc((size_t)1 << p->degree);
+    c->cum = malloc((((size_t)1 << p->degree) + 1) * sizeof(double));
+    if (!c->bits || !c->cum) return -1;
+    c->len = sp_mls(p->degree, c->bits);
+    c->chip = p->chip_ms / 1e3;
+    c->cum[0] = 0;
+    for (unsigned k = 0; k < c->len; k++) c->cum[k + 1] = c->cum[k] + (c->bits[k] ? 1 : -1);
+    return 0;
+}
+
+/* Integral of the +-1 code waveform from 0 to u seconds (0 before the code, flat after it) */
+static double code_integral(const struct code *c, double u) {
+    if (u <= 0) return 0;
+    double k = floor(u / c->chip);
+    if (k >= c->len) return c->cum[c->len] * c->chip;
+    return c->cum[(size_t)k] * c->chip + (u - k * c->chip) * (c->bits[(size_t)k] ? 1 : -1);
+}
+
+/* ------------------- FFT ------------------- */
+
+struct cpx { double re, im; };
+
+struct fft {
+    unsigned n;
+    unsigned *rev;
+    struct cpx *tw;                     /* e^(-2 pi i k / n), k < n/2 */
+};
+
+static int fft_init(struct fft *f, unsigned n) {
+    f->n = n;
+    f->rev = malloc(n * sizeof(*f->rev));
+    f->tw = malloc(n / 2 * sizeof(*f->tw));
+    if (!f->rev || !f->tw) return -1;
+    unsigned bits = (unsigned)__builtin_ctz(n);
+    for (unsigned i = 0; i < n; i++) {
+        unsigned r = 0;
+        for (unsigned b = 0; b < bits; b++) r |= (i >> b & 1) << (bits - 1 - b);
+        f->rev[i] = r;
+    }
+    for (unsigned k = 0; k < n / 2; k++) {
+        f->tw[k].re = cos(-2 * M_PI * k / n);
+        f->tw[k].im = sin(-2 * M_PI * k / n);
+    }
+    return 0;
+}
+
+/* In place; inverse without the 1/n scale */
+static void fft_run(const struct fft *f, struct cpx *a, int inverse) {
+    unsigned n = f->n;
+    for (unsigned i = 0; i < n; i++)
+        if (i < f->rev[i]) { struct cpx t = a[i]; a[i] = a[f->rev[i]]; a[f->rev[i]] = t; }
+    for (unsigned len = 2; len <= n; len <<= 1) {
+        unsigned half = len / 2, step = n / len;
+        for (unsigned i = 0; i < n; i += len) {
+            for (unsigned j = 0; j < half; j++) {
+                struct cpx w = f->tw[j * step];
+                if (inverse) w.im = -w.im;
+                struct cpx *u = &a[i + j], *v = &a[i + j + half];
+                double tr = v->re * w.re - v->im * w.im, ti = v->re * w.im + v->im * w.re;
+                v->re = u->re - tr;
+                v->im = u->im - ti;
+                u->re += tr;
+                u->im += ti;
+            }
+        }
+    }
+}
+
+/* ------------------- Correlation ------------------- */
+
+/* Coarse trace: one value per bin of `bin` seconds from t0 */
+struct series {
+    double t0, bin;
+    float *x;
+    size_t n, cap;
+};
+
+static int series_push(struct series *s, float v) {
+    if (s->n == s->cap) {
+        size_t cap = s->cap ? s->cap * 2 : 1 << 16;
+        float *x = realloc(s->x, cap * sizeof(*x));
+        if (!x) return -1;
+        s->x = x;
+        s->cap = cap;
+    }
+    s->x[s->n++] = v;
+    return 0;
+}
+
+struct peak { size_t lag; double score; };
+
+struct peaks {
+    struct peak p[MAX_SYNCS];
+    unsigned n;
+    struct peak cand;                   /* Best so far within one code length */
+    int have;
+};
+
+static void peak_offer(struct peaks *pk, size_t lag, double score, size_t m) {
+    if (pk->have && lag >= pk->cand.lag + m) { // Out of the candidate's reach: it stands
+        if (pk->n < MAX_SYNCS) pk->p[pk->n++] = pk->cand;
+        pk->have = 0;
+    }
+    if (!pk->have || score > pk->cand.score) {
+        pk->cand.lag = lag;
+        pk->cand.score = score;
+        pk->have = 1;
+    }
+}
+
+/* Normalised correlation of s->x with the code at BINS_PER_CHIP bins per chip; peaks over thr into pk */
+static void correlate(const struct series *s, const struct code *c, double thr, struct peaks *pk) {
+    size_t m = (size_t)c->len * BINS_PER_CHIP, n = s->n;
+    memset(pk, 0, sizeof(*pk));
+    if (n < m) return;
+
+    unsigned fn = 1u << 14;
+    while (fn < 4 * m) fn <<= 1;
+    struct fft f;
+    struct cpx *tmpl = calloc(fn, sizeof(*tmpl)), *buf = malloc(fn * sizeof(*buf));
+    if (fft_init(&f, fn) != 0 || !tmpl || !buf) { fprintf(stderr, "Out of memory\n"); exit(1); }
+    double tsum = 0;
+    for (size_t j = 0; j < m; j++) {
+        tmpl[j].re = c->bits[j / BINS_PER_CHIP] ? 1 : -1;
+        tsum += tmpl[j].re;
+    }
+    fft_run(&f, tmpl, 0);
+    double tnorm = sqrt((double)m - tsum * tsum / (double)m);
+
+    /* Sliding window sums for the normalisation, advanced in step with the lags */
+    double sx = 0, sxx = 0;
+    for (size_t j = 0; j < m; j++) { sx += s->x[j]; sxx += (double)s->x[j] * s->x[j]; }
+
+    size_t valid = fn - m + 1, lags = n - m + 1, lag = 0;
+    while (lag < lags) {
+        /* Block A in the real part, block B in the imaginary part: one transform for both */
+        for (unsigned i = 0; i < fn; i++) {
+            size_t a = lag + i, b = lag + valid + i;
+            buf[i].re = a < n ? s->x[a] : 0;
+            buf[i].im = b < n ? s->x[b] : 0;
+        }
+        fft_run(&f, buf, 0);
+        for (unsigned i = 0; i < fn; i++) {     /* Multiply by conj(T) */
+            double re = buf[i].re * tmpl[i].re + buf[i].im * tmpl[i].im;
+            double im = buf[i].im * tmpl[i].re - buf[i].re * tmpl[i].im;
+            buf[i].re = re;
+            buf[i].im = im;
+        }
+        fft_run(&f, buf, 1);
+        for (int half = 0; half < 2; half++) {
+            for (size_t k = 0; k < valid && lag < lags; k++, lag++) {
+                double dot = (half ? buf[k].im : buf[k].re) / fn;
+                double var = sxx - sx * sx / (double)m;
+                double score = var > 1e-12 ? (dot - sx * tsum / (double)m) / (sqrt(var) * tnorm) : 0;
+                if (score >= thr) peak_offer(pk, lag, score, m);
+                if (lag + m < n) {                /* Slide the window one bin */
+                    sx += s->x[lag + m] - s->x[lag];
+                    sxx += (double)s->x[lag + m] * s->x[lag + m] - (double)s->x[lag] * s->x[lag];
+                }
+            }
+        }
+    }
+    if (pk->have && pk->n < MAX_SYNCS) pk->p[pk->n++] = pk->cand;
+    free(tmpl);
+    free(buf);
+    free(f.rev);
+    free(f.tw);
+}
+
+/* ------------------- Input ------------------- */
+
+struct mapped { const char *p; size_t size; };
+
+static int map_file(const char *path, struct mapped *m) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) { perror(path); return -1; }
+    m->size = (size_t)st.st_size;
+    m->p = m->size ? mmap(NULL, m->size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (m->p == MAP_FAILED) { perror(path); return -1; }
+    if (m->size) madvise((void *)m->p, m->size, MADV_SEQUENTIAL);
+    return 0;
+}
+
+/* Decimal number at *pp (optional quotes/spaces, sign, fraction, exponent); 0 and *pp past it, or -1 */
+static int parse_num(const char **pp, const char *end, double *out) {
+    const char *p = *pp;
+    while (p < end && (*p == ' ' || *p == '"')) p++;
+    int neg = 0;
+    if (p < end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+    uint64_t mant = 0;
+    int digits = 0, scale = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+        if (mant < 1000000000000000000ULL) mant = mant * 10 + (uint64_t)(*p - '0'); else scale++;
+    if (p < end && *p == '.')
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+            if (mant < 1000000000000000000ULL) { mant = mant * 10 + (uint64_t)(*p - '0'); scale--; }
+    if (!digits) return -1;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        int eneg = 0, e = 0;
+        if (q < end && (*q == '-' || *q == '+')) eneg = *q++ == '-';
+        if (q < end && *q >= '0' && *q <= '9') {
+            for (; q < end && *q >= '0' && *q <= '9'; q++) e = e * 10 + (*q - '0');
+            scale += eneg ? -e : e;
+            p = q;
+        }
+    }
+    while (p < end && (*p == ' ' || *p == '"')) p++;
+    double v = (double)mant;
+    if (scale) v *= pow(10, scale);
+    *out = neg ? -v : v;
+    *pp = p;
+    return 0;
+}
+
+/* Time and current from one power log line; 0, or -1 if it is not a sample */
+static int power_line(const char *p, const char *eol, unsigned col, double *t, double *v) {
+    if (parse_num(&p, eol, t) != 0) return -1;
+    for (unsigned c = 2; c <= col; c++) {
+        if (p >= eol || *p != ',') return -1;
+        p++;
+        if (c < col) { while (p < eol && *p != ',') p++; continue; }
+        return parse_num(&p, eol, v);
+    }
+    return -1;
+}
+
+struct power {
+    struct mapped f;
+    unsigned col;
+    struct series s;
+    size_t *mark;                       /* File offset of bin i * MARK_EVERY */
+    size_t nmark;
+    size_t samples;
+    double t_first, t_last;
+};
+
+static int power_load(struct power *pw, const char *path, double bin) {
+    if (map_file(path, &pw->f) != 0) return -1;
+    const char *p = pw->f.p, *end = p + pw->f.size;
+    size_t cap_mark = 0;
+    double sum = 0;
+    size_t cnt = 0;
+    pw->s.bin = bin;
+    while (p < end) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        double t, v;
+        if (power_line(p, eol, pw->col, &t, &v) == 0) {
+            if (!pw->samples) { pw->t_first = pw->s.t0 = t; }
+            pw->samples++;
+            pw->t_last = t;
+            double fb = (t - pw->s.t0) / bin;
+            size_t b = fb > 0 ? (size_t)fb : 0;
+            while (pw->s.n < b) {       /* Close the current bin; gaps hold its value */
+                float mean = cnt ? (float)(sum / (double)cnt) : pw->s.n ? pw->s.x[pw->s.n - 1] : (float)v;
+                if (series_push(&pw->s, mean) != 0) return -1;
+                sum = 0;
+                cnt = 0;
+            }
+            while (pw->nmark <= pw->s.n / MARK_EVERY) { /* Every mark crossed, a gap may skip some */
+                if (pw->nmark == cap_mark) {
+                    cap_mark = cap_mark ? cap_mark * 2 : 1024;
+                    size_t *mk = realloc(pw->mark, cap_mark * sizeof(*mk));
+                    if (!mk) return -1;
+                    pw->mark = mk;
+                }
+                pw->mark[pw->nmark++] = (size_t)(p - pw->f.p);
+            }
+            sum += v;
+            cnt++;
+        }
+        p = eol + 1;
+    }
+    if (cnt && series_push(&pw->s, (float)(sum / (double)cnt)) != 0) return -1;
+    return 0;
+}
+
+/* Full-resolution start time of the code near coarse lag `lag` */
+static double power_refine(const struct power *pw, const struct code *c, size_t lag) {
+    double bin = pw->s.bin, tc = pw->s.t0 + (double)lag * bin;
+    double lo = tc - 4 * bin, hi = tc + c->len * c->chip + 4 * bin;
+    size_t first = lag > 8 ? (lag - 8) / MARK_EVERY : 0;
+    if (!pw->nmark) return tc;
+    if (first >= pw->nmark) first = pw->nmark - 1;
+    const char *p = pw->f.p + pw->mark[first], *end = pw->f.p + pw->f.size;
+
+    size_t n = 0, cap = 1 << 16;
+    double *t = malloc(cap * sizeof(*t)), *x = malloc(cap * sizeof(*x)), mean = 0;
+    while (t && x && p < end) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        double ts, v;
+        if (power_line(p, eol, pw->col, &ts, &v) == 0) {
+            if (ts > hi) break;
+            if (ts >= lo) {
+                if (n == cap) {
+                    cap *= 2;
+                    t = realloc(t, cap * sizeof(*t));
+                    x = realloc(x, cap * sizeof(*x));
+                    if (!t || !x) break;
+                }
+                t[n] = ts;
+                x[n++] = v;
+                mean += v;
+            }
+        }
+        p = eol + 1;
+    }
+    if (!t || !x || n < 2) { free(t); free(x); return tc; }
+    mean /= (double)n;
+    double dt = (t[n - 1] - t[0]) / (double)(n - 1);
+
+    /* Each sample covers [t - dt/2, t + dt/2): the score is continuous in the start time */
+    double step = dt / 4, best = -INFINITY, best_t = tc, prev = 0, next = 0;
+    unsigned steps = (unsigned)(4 * bin / step) + 1;
+    double *score = malloc(steps * sizeof(*score));
+    if (!score) { free(t); free(x); return tc; }
+    unsigned best_i = 0;
+    for (unsigned i = 0; i < steps; i++) {
+        double T = tc - 2 * bin + i * step, acc = 0;
+        for (size_t j = 0; j < n; j++)
+            acc += (x[j] - mean) * (code_integral(c, t[j] + dt / 2 - T) - code_integral(c, t[j] - dt / 2 - T));
+        score[i] = acc;
+        if (acc > best) { best = acc; best_t = T; best_i = i; }
+    }
+    if (best_i > 0 && best_i + 1 < steps) { /* Parabola through the peak and its neighbours */
+        prev = score[best_i - 1];
+        next = score[best_i + 1];
+        double den = prev - 2 * best + next;
+        if (den < 0) best_t += step * 0.5 * (prev - next) / den;
+    }
+    free(score);
+    free(t);
+    free(x);
+    return best_t;
+}
+
+/* ------------------- Network ------------------- */
+
+struct network {
+    double *t;                          /* Sync packet times, sorted */
+    size_t n, cap;
+    int absolute;                       /* Epoch seconds (pcap), else the export's relative Time */
+    struct series s;
+};
+
+static int net_push(struct network *nw, double t) {
+    if (nw->n == nw->cap) {
+        nw->cap = nw->cap ? nw->cap * 2 : 4096;
+        double *p = realloc(nw->t, nw->cap * sizeof(*p));
+        if (!p) return -1;
+        nw->t = p;
+    }
+    nw->t[nw->n++] = t;
+    return 0;
+}
+
+static uint32_t rd32(const uint8_t *p, int swapped) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return swapped ? __builtin_bswap32(v) : v;
+}
+
+static uint16_t be16(const uint8_t *p) { return (uint16_t)(p[0] << 8 | p[1]); }
+
+/* Sync packets in a pcap: UDP to `port` carrying the SP_PKT_MAGIC payload */
+static int net_load_pcap(struct network *nw, const struct mapped *f, int port) {
+    const uint8_t *b = (const uint8_t *)f->p;
+    uint32_t magic;
+    memcpy(&magic, b, sizeof(magic));
+    int swapped = magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS;
+    if (swapped) magic = __builtin_bswap32(magic);
+    int nsec = magic == PCAP_MAGIC_NS;
+    uint32_t link = rd32(b + 20, swapped) & 0x0FFFFFFF;
+    size_t off = 24;
+    nw->absolute = 1;
+    while (off + 16 <= f->size) {
+        const uint8_t *h = b + off;
+        uint32_t caplen = rd32(h + 8, swapped);
+        if (off + 16 + caplen > f->size) break;
+        const uint8_t *fr = h + 16;
+        off += 16 + caplen;
+        size_t l3;
+        if (link == 1 && caplen >= 14 && be16(fr + 12) == 0x0800) l3 = 14;             /* Ethernet */
+        else if (link == 113 && caplen >= 16 && be16(fr + 14) == 0x0800) l3 = 16;      /* Linux cooked */
+        else if (link == 276 && caplen >= 20 && be16(fr) == 0x0800) l3 = 20;           /* Linux cooked v2 */
+        else if (link == 101) l3 = 0;                                                   /* Raw IP */
+        else continue;
+        if (caplen < l3 + 20) continue;
+        const uint8_t *ip = fr + l3;
+        size_t ihl = (size_t)(ip[0] & 0x0F) * 4;
+        if ((ip[0] >> 4) != 4 || ip[9] != 17 || caplen < l3 + ihl + 8 + 4) continue;
+        const uint8_t *udp = ip + ihl;
+        if (be16(udp + 2) != port || memcmp(udp + 8, SP_PKT_MAGIC, 4) != 0) continue;
+        double t = rd32(h, swapped) + rd32(h + 4, swapped) / (nsec ? 1e9 : 1e6);
+        if (net_push(nw, t) != 0) return -1;
+    }
+    return 0;
+}
+
+/* CSV field `want` (0-based) of the line [p, eol), quotes removed; length, or -1 */
+static int csv_field(const char *p, const char *eol, int want, const char **fs) {
+    for (int i = 0; p <= eol; i++) {
+        const char *s = p, *e;
+        if (p < eol && *p == '"') {
+            s = ++p;
+            while (p < eol && *p != '"') p++;
+            e = p;
+            if (p < eol) p++;
+            while (p < eol && *p != ',') p++;
+        } else {
+            while (p < eol && *p != ',') p++;
+            e = p;
+        }
+        if (i == want) { *fs = s; return (int)(e - s); }
+        p++;
+    }
+    return -1;
+}
+
+/* Port arrow in an Info column: "  >  " (older Wireshark, labelcollect) or UTF-8 "→" */
+static const char *info_arrow(const char *info, size_t len, size_t *alen) {
+    for (size_t i = 0; i < len; i++) {
+        if (info[i] == '>') { *alen = 1; return info + i; }
+        if (i + 2 < len && (uint8_t)info[i] == 0xe2 && (uint8_t)info[i + 1] == 0x86 && (uint8_t)info[i + 2] == 0x92) {
+            *alen = 3;
+            return info + i;
+        }
+    }
+    return NULL;
+}
+
+/* Sync packets in a Wireshark CSV export: Info "... > <port> Len=<SP_PKT_LEN>" (or "→") */
+static int net_load_csv(struct network *nw, const struct mapped *f, int port) {
+    const char *p = f->p, *end = p + f->size;
+    const char *eol = memchr(p, '\n', f->size);
+    if (!eol) return -1;
+    int tcol = -1, icol = -1;
+    for (int i = 0;; i++) {
+        const char *s;
+        int len = csv_field(p, eol, i, &s);
+        if (len < 0) break;
+        if (len == 4 && memcmp(s, "Time", 4) == 0) tcol = i;
+        if (len == 4 && memcmp(s, "Info", 4) == 0) icol = i;
+    }
+    if (tcol < 0 || icol < 0) { fprintf(stderr, "Network CSV needs Time and Info columns\n"); return -1; }
+    char want[32], len_tag[16];
+    snprintf(want, sizeof(want), "%d", port);
+    snprintf(len_tag, sizeof(len_tag), "Len=%d", SP_PKT_LEN);
+    for (p = eol + 1; p < end; p = eol + 1) {
+        eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        const char *info, *ts;
+        int ilen = csv_field(p, eol, icol, &info);
+        if (ilen < 0) continue;
+        size_t alen;
+        const char *gt = info_arrow(info, (size_t)ilen, &alen);
+        if (!gt) continue;
+        const char *q = gt + alen, *iend = info + ilen;
+        while (q < iend && *q == ' ') q++;
+        size_t wl = strlen(want);
+        if ((size_t)(iend - q) < wl || memcmp(q, want, wl) != 0 || (q + wl < iend && q[wl] >= '0' && q[wl] <= '9'))
+            continue;
+        if (!memmem(info, (size_t)ilen, len_tag, strlen(len_tag))) continue;
+        int tlen = csv_field(p, eol, tcol, &ts);
+        double t;
+        if (tlen <= 0 || parse_num(&ts, ts + tlen, &t) != 0) continue;
+        if (net_push(nw, t) != 0) return -1;
+    }
+    return 0;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int net_load(struct network *nw, const char *path, int port, double bin, double pad) {
+    struct mapped f;
+    if (map_file(path, &f) != 0) return -1;
+    uint32_t magic = 0;
+    if (f.size >= 24) memcpy(&magic, f.p, sizeof(magic));
+    int pcap = magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS ||
+               __builtin_bswap32(magic) == PCAP_MAGIC_US || __builtin_bswap32(magic) == PCAP_MAGIC_NS;
+    int rc = pcap ? net_load_pcap(nw, &f, port) : net_load_csv(nw, &f, port);
+    if (f.size) munmap((void *)f.p, f.size);
+    if (rc != 0 || nw->n == 0) return rc;
+
+    qsort(nw->t, nw->n, sizeof(*nw->t), cmp_double);
+    /* Packet count per bin, padded so a code at either end still fits the window */
+    nw->s.bin = bin;
+    nw->s.t0 = nw->t[0] - pad;
+    size_t nb = (size_t)((nw->t[nw->n - 1] - nw->s.t0 + pad) / bin) + 1;
+    for (size_t i = 0; i < nb; i++)
+        if (series_push(&nw->s, 0) != 0) return -1;
+    for (size_t i = 0; i < nw->n; i++) nw->s.x[(size_t)((nw->t[i] - nw->s.t0) / bin)] += 1;
+    return 0;
+}
+
+/* Median lateness of the first packet of every chip after a silent one */
+static double net_refine(const struct network *nw, const struct code *c, size_t lag) {
+    double bin = nw->s.bin, tc = nw->s.t0 + (double)lag * bin;
+    double *d = malloc(c->len * sizeof(*d));
+    size_t nd = 0;
+    for (unsigned k = 0; d && k < c->len; k++) {
+        if (!c->bits[k] || (k > 0 && c->bits[k - 1])) continue;
+        double edge = tc + k * c->chip;
+        size_t lo = 0, hi = nw->n;      /* First packet at or after edge - 2 bins */
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (nw->t[mid] < edge - 2 * bin) lo = mid + 1; else hi = mid;
+        }
+        if (lo < nw->n && nw->t[lo] <= edge + 2 * bin) d[nd++] = nw->t[lo] - edge;
+    }
+    double t = tc;
+    if (nd) {
+        qsort(d, nd, sizeof(*d), cmp_double);
+        t += d[nd / 2];
+    }
+    free(d);
+    return t;
+}
+
+/* ------------------- main ------------------- */
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-p <power.csv>] [-n <capture.pcap|capture.csv>] [options]\n"
+            "  -p <file>    Power log CSV (time in seconds, current)\n"
+            "  -c <col>     Current column in the power log, 1-based (default: 2)\n"
+            "  -n <file>    Network capture: pcap or Wireshark CSV export\n"
+            "  -s <port>    Sync port (default: %d)\n"
+            "  -y <d[:ms]>  Code degree and chip length, as -Y on the camera (default: %u:%g)\n"
+            "  -t <score>   Detection threshold 0..1 (default: %g)\n"
+            "  -h           Show this help and exit\n",
+            prog, SYNC_PORT, SP_DEGREE_DEFAULT, SP_CHIP_MS_DEFAULT, THRESHOLD);
+}
+
+static void print_wall(const char *what, double epoch) {
+    time_t s = (time_t)floor(epoch);
+    struct tm tm;
+    localtime_r(&s, &tm);
+    char buf[64];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    printf("%s %s.%06u (local time)\n", what, buf, (unsigned)((epoch - (double)s) * 1e6));
+}
+
+int main(int argc, char **argv) {
+    const char *power_path = NULL, *net_path = NULL;
+    struct sp_params sp = { SP_DEGREE_DEFAULT, SP_CHIP_MS_DEFAULT };
+    unsigned col = 2;
+    int port = SYNC_PORT, opt;
+    double thr = THRESHOLD;
+    while ((opt = getopt(argc, argv, "p:c:n:s:y:t:h")) != -1) {
+        switch (opt) {
+        case 'p': power_path = optarg; break;
+        case 'c': col = (unsigned)atoi(optarg); break;
+        case 'n': net_path = optarg; break;
+        case 's': port = atoi(optarg); break;
+        case 'y':
+            if (sp_parse(optarg, &sp) != 0) { fprintf(stderr, "-y wants <degree 5-16>[:<chip ms>]\n"); return 1; }
+            break;
+        case 't': thr = atof(optarg); break;
+        default: print_usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if ((!power_path && !net_path) || col < 2) { print_usage(argv[0]); return 1; }
+
+    struct code c;
+    if (code_init(&c, &sp) != 0) { fprintf(stderr, "Out of memory\n"); return 1; }
+    double bin = c.chip / BINS_PER_CHIP;
+    printf("code: mls degree %u, %u chips of %.1f ms (%.2f s), bin %.3f ms\n", sp.degree, c.len, c.chip * 1e3,
+           c.len * c.chip, bin * 1e3);
+
+    double tp[MAX_SYNCS], tn[MAX_SYNCS];
+    unsigned np = 0, nn = 0;
+    struct peaks pk;
+
+    struct power pw = { .col = col };
+    if (power_path) {
+        uint64_t t0 = mono_ns();
+        if (power_load(&pw, power_path, bin) != 0) return 1;
+        uint64_t t1 = mono_ns();
+        correlate(&pw.s, &c, thr, &pk);
+        uint64_t t2 = mono_ns();
+        printf("power: %zu samples (%.1f Hz) over %.1f s, %.1f MB parsed in %.2f s, correlated in %.2f s\n",
+               pw.samples, pw.samples > 1 ? (double)(pw.samples - 1) / (pw.t_last - pw.t_first) : 0.0,
+               pw.t_last - pw.t_first, (double)pw.f.size / 1e6, (double)(t1 - t0) / 1e9, (double)(t2 - t1) / 1e9);
+        for (unsigned i = 0; i < pk.n; i++) {
+            tp[np] = power_refine(&pw, &c, pk.p[i].lag);
+            printf("power sync %u at %.6f s (score %.2f)\n", np + 1, tp[np], pk.p[i].score);
+            np++;
+        }
+    }
+
+    struct network nw = {0};
+    if (net_path) {
+        uint64_t t0 = mono_ns();
+        if (net_load(&nw, net_path, port, bin, c.len * c.chip) != 0) return 1;
+        correlate(&nw.s, &c, thr, &pk);
+        printf("network: %zu sync packets, loaded and correlated in %.2f s\n", nw.n, (double)(mono_ns() - t0) / 1e9);
+        for (unsigned i = 0; i < pk.n; i++) {
+            tn[nn] = net_refine(&nw, &c, pk.p[i].lag);
+            printf("network sync %u at %.6f s (score %.2f)\n", nn + 1, tn[nn], pk.p[i].score);
+            nn++;
+        }
+    }
+
+    unsigned pairs = np < nn ? np : nn;
+    if (!power_path || !net_path) return 0;
+    if (pairs == 0) { printf("no sync found in %s\n", np ? "the network capture" : "the power log"); return 1; }
+    if (np != nn) printf("warning: %u syncs in the power log, %u in the capture: pairing the first %u in order\n", np, nn, pairs);
+
+    /* network = a + b * power; b = 1 with a single sync */
+    double a, b = 1;
+    if (pairs == 1) {
+        a = tn[0] - tp[0];
+    } else {
+        double mx = 0, my = 0, sxx = 0, sxy = 0;
+        for (unsigned i = 0; i < pairs; i++) { mx += tp[i]; my += tn[i]; }
+        mx /= pairs;
+        my /= pairs;
+        for (unsigned i = 0; i < pairs; i++) {
+            sxx += (tp[i] - mx) * (tp[i] - mx);
+            sxy += (tp[i] - mx) * (tn[i] - my);
+        }
+        b = sxx > 0 ? sxy / sxx : 1;
+        a = my - b * mx;
+    }
+    double worst = 0;
+    for (unsigned i = 0; i < pairs; i++) {
+        double r = tn[i] - (a + b * tp[i]);
+        if (fabs(r) > worst) worst = fabs(r);
+    }
+    printf("offset: network = power + %.6f s", a);
+    if (pairs > 1) printf(", drift %+.2f ppm, worst residual %.1f us", (b - 1) * 1e6, worst * 1e6);
+    printf(" (%u sync%s)\n", pairs, pairs > 1 ? "s" : "");
+    if (nw.absolute) print_wall("power t=0 is", a);
+    return 0;
+}
@@ -0,0 +1,405 @@
+/*
+ * Label collector: writes the labels CSV in master time as labels arrive,
+ * replacing the Wireshark export -> netlabelseparator.py ->
+ * nettimetomastertime.py pass
+ * - Listens on the label and sync ports and drains them with recvmmsg()
+ * - Every datagram is stamped by the kernel on arrival (SO_TIMESTAMPNS), so
+ *   a JSON row's time is the time the label reached this host, as in the
+ *   pcap, and does not depend on how quickly the collector is scheduled
+ * - A binary batch is anchored to its receive time too: the newest record
+ *   gets the arrival time and the others keep their spacing from it, taken
+ *   from the records' own CLOCK_REALTIME stamps. Every row stays in the
+ *   collector's clock, and batched records are not all stamped alike
+ * - Understands the JSON labels ({"event":...}, {"type":...}) and the binary
+ *   records (IoTDev/SmartCam/common/label.h), one row per record
+ * - Rows of one wakeup (all ports) are written sorted by time, so labels
+ *   coming in on both ports interleave correctly. The older records of a
+ *   late batch can still fall before rows an earlier wakeup wrote: sort by
+ *   time when a batched run needs strict order
+ * - Sync pulse packets (syncpulse.h) are counted, not written: they are
+ *   for syncalign, not labelling
+ * - Reports kernel receive-queue drops (SO_RXQ_OVFL) on exit, so a burst
+ *   the collector did not keep up with is visible instead of silent
+ *
+ * Build x86:
+ *   gcc -O2 -std=c11 -o labelcollect labelcollect.c ../../IoTDev/SmartCam/common/label.c
+ * Build Arm64:
+ *   aarch64-linux-gnu-gcc -O2 -std=c11 -o labelcollect labelcollect.c ../../IoTDev/SmartCam/common/label.c
+ *
+ * Usage:
+ *   ./labelcollect [options] > run_labels_mastertime.csv
+ *
+ * Options:
+ *   -a <addr>    Local IPv4 address to bind (default: 0.0.0.0)
+ *   -p <ports>   Comma-separated UDP ports (default: 9000,9001: RealDataFlow
+ *                labels and sync; the CameraAttempt emulators use port+1)
+ *   -o <file>    CSV output (default: stdout)
+ *   -O <s>       Offset added to the kernel receive time (binary batches are
+ *                anchored to it, see above) to get master time, e.g.
+ *                from syncalign when this host is not the master clock
+ *                (default: 0)
+ *   -u           Date and time in UTC (default: local time, like the
+ *                master_start_str of nettimetomastertime.py)
+ *   -B <n>       Datagrams per recvmmsg() call (default: 64)
+ *   -h           Show this help and exit
+ *
+ * CSV columns: the Wireshark export's No., Time, Source, Destination,
+ * Protocol, Length and Info, with date inserted before Time exactly as
+ * nettimetomastertime.py did (labelling.py reads date and time), then
+ * event, device and seq. Length is the Ethernet frame length (payload +
+ * 42), as Wireshark shows it.
+ */
+
+#define _GNU_SOURCE /* recvmmsg(), IP_PKTINFO, localtime_r() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <getopt.h>
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "../../IoTDev/SmartCam/common/label.h"
+
+#define MAX_PORTS     8
+#define MAX_DGRAM     2048              /* Labels are small; a bigger datagram is not one */
+#define BATCH_DEFAULT 64
+#define RCVBUF        (8 << 20)
+#define FRAME_OVERHEAD 42               /* Ethernet + IPv4 + UDP headers */
+#define SYNC_MAGIC    "SCP1"            /* syncpulse.h */
+
+static volatile sig_atomic_t stop = 0;
+static void handle_sigint(int sig) { (void)sig; stop = 1; }
+
+static uint64_t realtime_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+struct port {
+    int sock, port;
+    uint32_t kernel_drops;              /* SO_RXQ_OVFL, cumulative per socket */
+};
+
+static struct {
+    uint64_t rows, datagrams, json, binary, sync, other, calls;
+    unsigned max_batch;
+} st;
+
+/* ------------------- Output ------------------- */
+
+static struct {
+    FILE *out;
+    int64_t offset_ns;
+    int utc;
+    int64_t sec;                        /* Second the cached strings belong to */
+    char date[16], hms[16];
+} csv = { .sec = -1 };
+
+static void csv_header(void) {
+    fprintf(csv.out, "\"No.\",\"date\",\"Time\",\"Source\",\"Destination\",\"Protocol\",\"Length\",\"Info\","
+                     "\"event\",\"device\",\"seq\"\n");
+}
+
+/* A parsed label waiting for the end of the wakeup */
+struct row {
+    uint64_t t_ns;                      /* Arrival (JSON) or the record's own stamp (binary) */
+    uint64_t order;                     /* Arrival order, for equal timestamps */
+    struct sockaddr_in from;
+    struct in_addr to;
+    int dport;
+    size_t len;
+    char event[64], device[64], seq[16];
+};
+
+static struct {
+    struct row *r;
+    size_t n, cap;
+    uint64_t order;
+} pending;
+
+static void csv_add(uint64_t t_ns, const struct sockaddr_in *from, const struct in_addr *to, int dport, size_t len,
+                    const char *event, const char *device, const char *seq) {
+    if (pending.n == pending.cap) {
+        size_t cap = pending.cap ? pending.cap * 2 : 1024;
+        struct row *r = realloc(pending.r, cap * sizeof(*r));
+        if (!r) return; // Out of memory: the row is lost, the collector carries on
+        pending.r = r;
+        pending.cap = cap;
+    }
+    struct row *w = &pending.r[pending.n++];
+    w->t_ns = t_ns;
+    w->order = pending.order++;
+    w->from = *from;
+    w->to = *to;
+    w->dport = dport;
+    w->len = len;
+    snprintf(w->event, sizeof(w->event), "%s", event);
+    snprintf(w->device, sizeof(w->device), "%s", device);
+    snprintf(w->seq, sizeof(w->seq), "%s", seq);
+}
+
+/* One row; the date/time strings are only rebuilt when the second changes */
+static void csv_row(const struct row *w) {
+    int64_t t = (int64_t)w->t_ns + csv.offset_ns;
+    int64_t sec = t / 1000000000LL;
+    if (sec != csv.sec) {
+        time_t tt = (time_t)sec;
+        struct tm tm;
+        if (csv.utc) gmtime_r(&tt, &tm); else localtime_r(&tt, &tm);
+        strftime(csv.date, sizeof(csv.date), "%Y-%m-%d", &tm);
+        strftime(csv.hms, sizeof(csv.hms), "%H:%M:%S", &tm);
+        csv.sec = sec;
+    }
+    char src[INET_ADDRSTRLEN], dst[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &w->from.sin_addr, src, sizeof(src));
+    inet_ntop(AF_INET, &w->to, dst, sizeof(dst));
+    fprintf(csv.out, "\"%llu\",\"%s\",\"%s.%06lld\",\"%s\",\"%s\",\"UDP\",\"%zu\",\"%u  >  %d Len=%zu\",\"%s\",\"%s\",\"%s\"\n",
+            (unsigned long long)++st.rows, csv.date, csv.hms, (long long)(t % 1000000000LL / 1000), src, dst,
+            w->len + FRAME_OVERHEAD, ntohs(w->from.sin_port), w->dport, w->len, w->event, w->device, w->seq);
+}
+
+static int row_cmp(const void *a, const void *b) {
+    const struct row *x = a, *y = b;
+    if (x->t_ns != y->t_ns) return x->t_ns < y->t_ns ? -1 : 1;
+    return x->order < y->order ? -1 : x->order > y->order;
+}
+
+/* Write what this wakeup collected, in time order across ports */
+static void csv_flush(void) {
+    qsort(pending.r, pending.n, sizeof(*pending.r), row_cmp);
+    for (size_t i = 0; i < pending.n; i++) csv_row(&pending.r[i]);
+    pending.n = 0;
+    fflush(csv.out);
+}
+
+/* ------------------- Parsing ------------------- */
+
+/* String value of "key" in a flat JSON object, CSV-safe; 0, or -1 if absent */
+static int json_str(const char *p, size_t len, const char *key, char *out, size_t outlen) {
+    size_t kl = strlen(key);
+    const char *end = p + len;
+    for (const char *q = p; (q = memchr(q, '"', (size_t)(end - q))) != NULL; q++) {
+        if ((size_t)(end - q) < kl + 2 || memcmp(q + 1, key, kl) != 0 || q[kl + 1] != '"') continue;
+        const char *v = q + kl + 2;
+        while (v < end && (*v == ' ' || *v == ':')) v++;
+        if (v >= end || *v != '"') return -1;
+        size_t n = 0;
+        for (v++; v < end && *v != '"' && n + 1 < outlen; v++)
+            out[n++] = *v == ',' ? ';' : *v;
+        out[n] = '\0';
+        return 0;
+    }
+    return -1;
+}
+
+static void handle(const uint8_t *p, size_t len, uint64_t rx_ns, const struct sockaddr_in *from,
+                   const struct in_addr *to, int dport) {
+    st.datagrams++;
+    if (len >= 4 && memcmp(p, SYNC_MAGIC, 4) == 0) { st.sync++; return; }
+
+    if (len >= LBL_REC_LEN && len % LBL_REC_LEN == 0 && memcmp(p, LBL_MAGIC, 4) == 0) {
+        uint64_t newest = 0;
+        struct lbl_event e;
+        for (size_t off = 0; off < len; off += LBL_REC_LEN)
+            if (lbl_decode(p + off, &e) == 0 && e.real_ns > newest) newest = e.real_ns;
+        for (size_t off = 0; off < len; off += LBL_REC_LEN) { // One row per record, spaced as they were emitted
+            if (lbl_decode(p + off, &e) != 0) continue;
+            char dev[8], seq[16];
+            snprintf(dev, sizeof(dev), "%u", e.device);
+            snprintf(seq, sizeof(seq), "%u", e.seq);
+            csv_add(rx_ns - (newest - e.real_ns), from, to, dport, len, e.name, dev, seq);
+            st.binary++;
+        }
+        return;
+    }
+
+    if (len > 0 && p[0] == '{') {
+        char event[64], device[64];
+        if (json_str((const char *)p, len, "event", event, sizeof(event)) != 0 &&
+            json_str((const char *)p, len, "type", event, sizeof(event)) != 0) { st.other++; return; }
+        if (json_str((const char *)p, len, "device", device, sizeof(device)) != 0) device[0] = '\0';
+        csv_add(rx_ns, from, to, dport, len, event, device, "");
+        st.json++;
+        return;
+    }
+    st.other++;
+}
+
+/* ------------------- Receive ------------------- */
+
+struct rx {
+    unsigned n;
+    uint8_t *bufs;
+    struct mmsghdr *msgs;
+    struct iovec *iov;
+    struct sockaddr_in *from;
+    union ctrl {
+        char buf[CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(struct in_pktinfo)) +
+                 CMSG_SPACE(sizeof(uint32_t))];
+        struct cmsghdr align;
+    } *ctrl;
+};
+
+/* Everything queued on one socket, n datagrams per call */
+static void drain(struct rx *rx, struct port *pt, struct in_addr bound) {
+    for (;;) {
+        for (unsigned i = 0; i < rx->n; i++) { // recvmmsg() overwrites the lengths
+            rx->iov[i].iov_base = rx->bufs + (size_t)i * MAX_DGRAM;
+            rx->iov[i].iov_len = MAX_DGRAM;
+            rx->msgs[i].msg_hdr.msg_name = &rx->from[i];
+            rx->msgs[i].msg_hdr.msg_namelen = sizeof(rx->from[i]);
+            rx->msgs[i].msg_hdr.msg_iov = &rx->iov[i];
+            rx->msgs[i].msg_hdr.msg_iovlen = 1;
+            rx->msgs[i].msg_hdr.msg_control = rx->ctrl[i].buf;
+            rx->msgs[i].msg_hdr.msg_controllen = sizeof(rx->ctrl[i].buf);
+        }
+        int got = recvmmsg(pt->sock, rx->msgs, rx->n, MSG_DONTWAIT, NULL);
+        st.calls++;
+        if (got <= 0) return; // EAGAIN: queue empty
+        if ((unsigned)got > st.max_batch) st.max_batch = (unsigned)got;
+
+        for (int i = 0; i < got; i++) {
+            uint64_t ts = 0;
+            struct in_addr to = bound;
+            for (struct cmsghdr *cm = CMSG_FIRSTHDR(&rx->msgs[i].msg_hdr); cm; cm = CMSG_NXTHDR(&rx->msgs[i].msg_hdr, cm)) {
+                if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPNS) {
+                    struct timespec t;
+                    memcpy(&t, CMSG_DATA(cm), sizeof(t));
+                    ts = (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+                } else if (cm->cmsg_level == IPPROTO_IP && cm->cmsg_type == IP_PKTINFO) {
+                    struct in_pktinfo pi;
+                    memcpy(&pi, CMSG_DATA(cm), sizeof(pi));
+                    to = pi.ipi_addr;
+                } else if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_RXQ_OVFL) {
+                    memcpy(&pt->kernel_drops, CMSG_DATA(cm), sizeof(pt->kernel_drops));
+                }
+            }
+            if (ts == 0) ts = realtime_ns();
+            handle(rx->iov[i].iov_base, rx->msgs[i].msg_len, ts, &rx->from[i], &to, pt->port);
+        }
+        if ((unsigned)got < rx->n) return;
+    }
+}
+
+static int open_port(struct port *pt, struct in_addr addr, int port) {
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) { perror("socket"); return -1; }
+    int one = 1, rcvbuf = RCVBUF;
+    if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one)) != 0) perror("SO_TIMESTAMPNS");
+    setsockopt(sock, IPPROTO_IP, IP_PKTINFO, &one, sizeof(one));
+    setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one));
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) != 0) // Root: past rmem_max
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct sockaddr_in sa = {0};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons((uint16_t)port);
+    sa.sin_addr = addr;
+    if (bind(sock, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+        fprintf(stderr, "bind port %d: %s\n", port, strerror(errno));
+        close(sock);
+        return -1;
+    }
+    pt->sock = sock;
+    pt->port = port;
+    return 0;
+}
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -a <addr>    Local IPv4 address to bind (default: 0.0.0.0)\n"
+            "  -p <ports>   Comma-separated UDP ports (default: 9000,9001)\n"
+            "  -o <file>    CSV output (default: stdout)\n"
+            "  -O <s>       Offset added to the kernel receive time (binary batches anchored to it) to get master time (default: 0)\n"
+            "  -u           Date and time in UTC (default: local time)\n"
+            "  -B <n>       Datagrams per recvmmsg() call (default: %d)\n"
+            "  -h           Show this help and exit\n",
+            prog, BATCH_DEFAULT);
+}
+
+int main(int argc, char **argv) {
+    const char *addr = "0.0.0.0", *ports = "9000,9001", *out_path = NULL;
+    unsigned batch = BATCH_DEFAULT;
+    int opt;
+    while ((opt = getopt(argc, argv, "a:p:o:O:uB:h")) != -1) {
+        switch (opt) {
+        case 'a': addr = optarg; break;
+        case 'p': ports = optarg; break;
+        case 'o': out_path = optarg; break;
+        case 'O': csv.offset_ns = (int64_t)(atof(optarg) * 1e9); break;
+        case 'u': csv.utc = 1; break;
+        case 'B': batch = (unsigned)atoi(optarg); break;
+        default: print_usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    struct in_addr bound;
+    if (batch == 0 || inet_pton(AF_INET, addr, &bound) != 1) { print_usage(argv[0]); return 1; }
+
+    struct port pt[MAX_PORTS];
+    struct pollfd pfd[MAX_PORTS];
+    unsigned np = 0;
+    for (const char *p = ports; *p && np < MAX_PORTS;) {
+        char *end;
+        long port = strtol(p, &end, 10);
+        if (end == p || port <= 0 || port > 65535) { print_usage(argv[0]); return 1; }
+        if (open_port(&pt[np], bound, (int)port) != 0) return 1;
+        pfd[np].fd = pt[np].sock;
+        pfd[np].events = POLLIN;
+        np++;
+        p = *end == ',' ? end + 1 : end;
+    }
+
+    struct rx rx = { .n = batch };
+    rx.bufs = malloc((size_t)batch * MAX_DGRAM);
+    rx.msgs = calloc(batch, sizeof(*rx.msgs));
+    rx.iov = calloc(batch, sizeof(*rx.iov));
+    rx.from = calloc(batch, sizeof(*rx.from));
+    rx.ctrl = calloc(batch, sizeof(*rx.ctrl));
+    if (!rx.bufs || !rx.msgs || !rx.iov || !rx.from || !rx.ctrl) { fprintf(stderr, "Out of memory\n"); return 1; }
+
+    csv.out = out_path ? fopen(out_path, "w") : stdout;
+    if (!csv.out) { perror(out_path); return 1; }
+    static char obuf[1 << 20];
+    setvbuf(csv.out, obuf, _IOFBF, sizeof(obuf)); // Flushed once per wakeup, not per row
+    csv_header();
+    fflush(csv.out);
+
+    struct sigaction act = {0};
+    act.sa_handler = handle_sigint; /* No SA_RESTART: poll() returns on Ctrl-C */
+    sigaction(SIGINT, &act, NULL);
+    sigaction(SIGTERM, &act, NULL);
+    fprintf(stderr, "Collecting labels on %s port %s (master time = kernel receive time %+.6f s, %s)\n", addr, ports,
+            (double)csv.offset_ns / 1e9, csv.utc ? "UTC" : "local time");
+
+    while (!stop) {
+        if (poll(pfd, np, 500) <= 0) continue;
+        for (unsigned i = 0; i < np; i++)
+            if (pfd[i].revents & POLLIN) drain(&rx, &pt[i], bound);
+        csv_flush();
+    }
+
+    uint64_t drops = 0;
+    for (unsigned i = 0; i < np; i++) {
+        drops += pt[i].kernel_drops;
+        close(pt[i].sock);
+    }
+    csv_flush();
+    if (out_path) fclose(csv.out);
+    fprintf(stderr, "[collect] datagrams=%llu rows=%llu (json=%llu binary=%llu) sync=%llu other=%llu "
+                    "kernel drops=%llu recvmmsg=%llu (%.1f per call, max %u)\n",
+            (unsigned long long)st.datagrams, (unsigned long long)st.rows, (unsigned long long)st.json,
+            (unsigned long long)st.binary, (unsigned long long)st.sync, (unsigned long long)st.other,
+            (unsigned long long)drops, (unsigned long long)st.calls,
+            st.calls ? (double)st.datagrams / (double)st.calls : 0.0, st.max_batch);
+    return 0;
+}
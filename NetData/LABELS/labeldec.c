@@ -0,0 +1,344 @@
+/*
+ * Decoder for the SmartCam binary labels (-L; record layout in
+ * IoTDev/SmartCam/common/label.h)
+ * - Live: listens on the label port and writes one CSV row per record as it arrives
+ * - Offline: pulls the label datagrams out of a pcap capture (-r)
+ * - Rows carry date and time (UTC, from the camera's CLOCK_REALTIME) first,
+ *   so labelling.py reads them like the tshark-exported labels; device
+ *   clock (CLOCK_MONOTONIC), sequence and arguments follow
+ * - Reports sequence gaps (lost label datagrams) per camera on exit
+ * - -b measures the per-label cost on the sending side: JSON labels as the
+ *   emulators sent them before, against binary records unbatched and batched
+ *
+ * Build x86:
+ *   gcc -O2 -std=c11 -o labeldec labeldec.c ../../IoTDev/SmartCam/common/label.c
+ * Build Arm64 (for -b on the camera):
+ *   aarch64-linux-gnu-gcc -O2 -std=c11 -o labeldec labeldec.c ../../IoTDev/SmartCam/common/label.c
+ *
+ * Usage:
+ *   ./labeldec [options]
+ *
+ * Options:
+ *   -a <addr>    Local IPv4 address to bind (default: 0.0.0.0)
+ *   -p <port>    UDP label port (default: 9001, where CameraAttempt2-5 send,
+ *                port+1; use -p 9000 for RealDataFlow -L); with -r, only
+ *                datagrams to this port are read (default: any that hold
+ *                label records)
+ *   -r <pcap>    Decode a capture file instead of listening
+ *   -o <file>    CSV output (default: stdout)
+ *   -b           Benchmark label sending over loopback and exit
+ *   -n <count>   -b: labels per variant (default: 100000)
+ *   -h           Show this help and exit
+ *
+ * CSV columns: date, time, event, source, device, seq, mono_ns, real_ns,
+ * arg0..arg3. Arguments are per event (CAPTURE_END: frames, drops, p50 and
+ * p99 latency in us; MOTION_*: score x 100, threshold x 100, persist).
+ */
+
+#define _GNU_SOURCE /* gmtime_r() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <getopt.h>
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "../../IoTDev/SmartCam/common/label.h"
+
+#define LABEL_PORT    9001              /* CameraAttempt2-5: upload port + 1 */
+#define MAX_SOURCES   64                /* Cameras tracked for sequence gaps */
+#define BENCH_DEFAULT 100000
+
+#define PCAP_MAGIC_US 0xa1b2c3d4u
+#define PCAP_MAGIC_NS 0xa1b23c4du
+#define DLT_NULL      0
+#define DLT_EN10MB    1
+#define DLT_RAW       101
+#define DLT_LOOP      108
+#define DLT_LINUX_SLL 113
+#define DLT_LINUX_SLL2 276
+
+static volatile sig_atomic_t stop = 0;
+static void handle_sigint(int sig) { (void)sig; stop = 1; }
+
+static uint64_t mono_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+/* ------------------- Decoding ------------------- */
+
+static struct source {
+    uint32_t addr;                      /* IPv4, network order */
+    uint16_t device;
+    uint32_t next_seq;
+    uint64_t records, lost, late;
+} sources[MAX_SOURCES];
+static unsigned nsources;
+
+static void track(uint32_t addr, const struct lbl_event *e) {
+    struct source *s = NULL;
+    for (unsigned i = 0; i < nsources && !s; i++)
+        if (sources[i].addr == addr && sources[i].device == e->device) s = &sources[i];
+    if (!s) {
+        if (nsources == MAX_SOURCES) return;
+        s = &sources[nsources++];
+        s->addr = addr;
+        s->device = e->device;
+        s->next_seq = e->seq;
+    }
+    s->records++;
+    int32_t d = (int32_t)(e->seq - s->next_seq);
+    if (d >= 0) {
+        s->lost += (uint64_t)d;
+        s->next_seq = e->seq + 1;
+    } else {
+        s->late++;                      /* Reordered or duplicated */
+        if (s->lost) s->lost--;
+    }
+}
+
+static void write_row(FILE *out, uint32_t addr, const struct lbl_event *e) {
+    time_t sec = (time_t)(e->real_ns / 1000000000ULL);
+    struct tm tm;
+    gmtime_r(&sec, &tm);
+    char src[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr, src, sizeof(src));
+    fprintf(out, "%04d-%02d-%02d,%02d:%02d:%02d.%06u,%s,%s,%u,%u,%llu,%llu",
+            tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+            (unsigned)(e->real_ns % 1000000000ULL / 1000), e->name, src, e->device, e->seq,
+            (unsigned long long)e->mono_ns, (unsigned long long)e->real_ns);
+    for (unsigned i = 0; i < LBL_ARGS; i++) {
+        if (i < e->nargs) fprintf(out, ",%d", e->arg[i]);
+        else fputc(',', out);
+    }
+    fputc('\n', out);
+}
+
+/* Every record in one datagram; number decoded (0: not a label datagram) */
+static unsigned decode_datagram(FILE *out, uint32_t addr, const uint8_t *p, size_t len) {
+    if (len == 0 || len % LBL_REC_LEN != 0) return 0;
+    unsigned n = 0;
+    for (size_t off = 0; off < len; off += LBL_REC_LEN) {
+        struct lbl_event e;
+        if (lbl_decode(p + off, &e) != 0) continue;
+        track(addr, &e);
+        write_row(out, addr, &e);
+        n++;
+    }
+    return n;
+}
+
+static void print_sources(void) {
+    for (unsigned i = 0; i < nsources; i++) {
+        char src[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &sources[i].addr, src, sizeof(src));
+        fprintf(stderr, "[labels] %s device %u: records=%llu lost=%llu reordered=%llu\n", src, sources[i].device,
+                (unsigned long long)sources[i].records, (unsigned long long)sources[i].lost,
+                (unsigned long long)sources[i].late);
+    }
+}
+
+/* ------------------- Live ------------------- */
+
+static int run_live(FILE *out, const char *addr, int port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in sa = {0};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, addr, &sa.sin_addr) != 1 || bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+        perror("bind");
+        return 1;
+    }
+    struct sigaction act = {0};
+    act.sa_handler = handle_sigint; /* No SA_RESTART: recvfrom() returns on Ctrl-C */
+    sigaction(SIGINT, &act, NULL);
+    sigaction(SIGTERM, &act, NULL);
+    fprintf(stderr, "Waiting for labels on %s:%d\n", addr, port);
+
+    uint8_t buf[LBL_BATCH_MAX * LBL_REC_LEN + 1];
+    while (!stop) {
+        struct sockaddr_in from;
+        socklen_t flen = sizeof(from);
+        ssize_t r = recvfrom(fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &flen);
+        if (r < 0) continue;
+        if (decode_datagram(out, from.sin_addr.s_addr, buf, (size_t)r)) fflush(out);
+    }
+    close(fd);
+    return 0;
+}
+
+/* ------------------- pcap ------------------- */
+
+static uint32_t rd32(const uint8_t *p, int swapped) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return swapped ? __builtin_bswap32(v) : v;
+}
+
+static uint16_t be16(const uint8_t *p) { return (uint16_t)(p[0] << 8 | p[1]); }
+
+/* Offset of the IPv4 header in a link-layer frame, or -1 */
+static long l3_offset(uint32_t linktype, const uint8_t *f, size_t caplen) {
+    switch (linktype) {
+    case DLT_EN10MB: {
+        size_t off = 12;
+        if (caplen < 14) return -1;
+        while ((be16(f + off) == 0x8100 || be16(f + off) == 0x88a8) && caplen >= off + 6) off += 4; /* VLAN tags */
+        return be16(f + off) == 0x0800 ? (long)off + 2 : -1;
+    }
+    case DLT_LINUX_SLL:  return caplen >= 16 && be16(f + 14) == 0x0800 ? 16 : -1;
+    case DLT_LINUX_SLL2: return caplen >= 20 && be16(f) == 0x0800 ? 20 : -1;
+    case DLT_NULL:
+    case DLT_LOOP:       return caplen >= 4 && (f[0] == 2 || f[3] == 2) ? 4 : -1; /* AF_INET, either order */
+    case DLT_RAW:        return 0;
+    default:             return -1;
+    }
+}
+
+static int run_pcap(FILE *out, const char *path, int port) {
+    FILE *f = fopen(path, "rb");
+    if (!f) { perror(path); return 1; }
+    uint8_t gh[24];
+    if (fread(gh, 1, sizeof(gh), f) != sizeof(gh)) { fprintf(stderr, "%s: not a pcap file\n", path); return 1; }
+    uint32_t magic;
+    memcpy(&magic, gh, sizeof(magic));
+    int swapped = magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS;
+    if (swapped && __builtin_bswap32(magic) != PCAP_MAGIC_US && __builtin_bswap32(magic) != PCAP_MAGIC_NS) {
+        fprintf(stderr, "%s: unsupported capture format (pcapng? convert with editcap -F pcap)\n", path);
+        return 1;
+    }
+    uint32_t linktype = rd32(gh + 20, swapped) & 0x0FFFFFFF;
+
+    static uint8_t frame[262144];
+    uint8_t rh[16];
+    uint64_t packets = 0, datagrams = 0, records = 0;
+    while (fread(rh, 1, sizeof(rh), f) == sizeof(rh)) {
+        uint32_t caplen = rd32(rh + 8, swapped);
+        if (caplen > sizeof(frame) || fread(frame, 1, caplen, f) != caplen) break; /* Truncated */
+        packets++;
+        long l3 = l3_offset(linktype, frame, caplen);
+        if (l3 < 0 || caplen < (size_t)l3 + 20) continue;
+        const uint8_t *ip = frame + l3;
+        size_t ihl = (size_t)(ip[0] & 0x0F) * 4, left = caplen - (size_t)l3;
+        if ((ip[0] >> 4) != 4 || ip[9] != IPPROTO_UDP || (be16(ip + 6) & 0x3FFF) != 0 || left < ihl + 8) continue;
+        const uint8_t *udp = ip + ihl;
+        if (port && be16(udp + 2) != port) continue;
+        size_t len = be16(udp + 4) >= 8 ? be16(udp + 4) - 8u : 0;
+        if (len > left - ihl - 8) continue;   /* Snaplen cut the payload */
+        uint32_t src;
+        memcpy(&src, ip + 12, sizeof(src));
+        unsigned n = decode_datagram(out, src, udp + 8, len);
+        datagrams += n > 0;
+        records += n;
+    }
+    fclose(f);
+    fprintf(stderr, "[labels] %s: %llu packets, %llu label datagrams, %llu records\n", path,
+            (unsigned long long)packets, (unsigned long long)datagrams, (unsigned long long)records);
+    return 0;
+}
+
+/* ------------------- Benchmark ------------------- */
+
+/* The emulators' JSON label: new socket, inet_pton, ISO timestamp, snprintf, sendto, close */
+static void json_label(const char *host, int port, const char *event) {
+    char ts[64], json[256];
+    struct timespec t;
+    struct tm tm;
+    clock_gettime(CLOCK_REALTIME, &t);
+    gmtime_r(&t.tv_sec, &tm);
+    snprintf(ts, sizeof(ts), "%04d-%02d-%02dT%02d:%02d:%02d.%03ldZ", tm.tm_year + 1900, tm.tm_mon + 1,
+             tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, t.tv_nsec / 1000000);
+    snprintf(json, sizeof(json), "{ \"type\":\"LABEL\", \"event\":\"%s\", \"timestamp\":\"%s\" }\n", event, ts);
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    inet_pton(AF_INET, host, &addr.sin_addr);
+    sendto(sock, json, strlen(json), 0, (struct sockaddr *)&addr, sizeof(addr));
+    close(sock);
+}
+
+static int bench(unsigned n) {
+    /* A bound sink on loopback, never read: labels beyond its buffer are dropped like any other */
+    int sink = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in sa = {0};
+    socklen_t slen = sizeof(sa);
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(sink, (struct sockaddr *)&sa, sizeof(sa)) != 0 || getsockname(sink, (struct sockaddr *)&sa, &slen) != 0) {
+        perror("bench sink");
+        return 1;
+    }
+    int port = ntohs(sa.sin_port);
+    printf("%u labels per variant to 127.0.0.1:%d\n", n, port);
+
+    uint64_t t = mono_ns();
+    for (unsigned i = 0; i < n; i++) json_label("127.0.0.1", port, "CAPTURE_START");
+    double json_ns = (double)(mono_ns() - t) / n;
+    printf("json       %8.0f ns/label  syscalls/label 3    (socket, sendto, close)\n", json_ns);
+
+    static const unsigned batches[] = { 1, LBL_BATCH_MAX };
+    for (unsigned b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+        struct lbl_chan ch;
+        if (lbl_open(&ch, "127.0.0.1", port, 0, batches[b]) != 0) return 1;
+        t = mono_ns();
+        for (unsigned i = 0; i < n; i++) lbl_event(&ch, "CAPTURE_START");
+        lbl_flush(&ch);
+        double ns = (double)(mono_ns() - t) / n;
+        printf("binary x%-2u %8.0f ns/label  syscalls/label %-4.2g (%.1fx faster)\n", batches[b], ns,
+               (double)ch.datagrams / n, json_ns / ns);
+        lbl_close(&ch);
+    }
+    close(sink);
+    return 0;
+}
+
+/* ------------------- main ------------------- */
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -a <addr>    Local IPv4 address to bind (default: 0.0.0.0)\n"
+            "  -p <port>    UDP label port (default: %d; RealDataFlow -L sends to 9000)\n"
+            "  -r <pcap>    Decode a capture file instead of listening\n"
+            "  -o <file>    CSV output (default: stdout)\n"
+            "  -b           Benchmark label sending over loopback and exit\n"
+            "  -n <count>   -b: labels per variant (default: %d)\n"
+            "  -h           Show this help and exit\n",
+            prog, LABEL_PORT, BENCH_DEFAULT);
+}
+
+int main(int argc, char **argv) {
+    const char *addr = "0.0.0.0", *pcap = NULL, *out_path = NULL;
+    int port = LABEL_PORT, port_given = 0, do_bench = 0, opt;
+    unsigned count = BENCH_DEFAULT;
+    while ((opt = getopt(argc, argv, "a:p:r:o:bn:h")) != -1) {
+        switch (opt) {
+        case 'a': addr = optarg; break;
+        case 'p': port = atoi(optarg); port_given = 1; break;
+        case 'r': pcap = optarg; break;
+        case 'o': out_path = optarg; break;
+        case 'b': do_bench = 1; break;
+        case 'n': count = (unsigned)atoi(optarg); break;
+        default: print_usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (do_bench) return bench(count ? count : 1);
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) { perror(out_path); return 1; }
+    fprintf(out, "date,time,event,source,device,seq,mono_ns,real_ns,arg0,arg1,arg2,arg3\n");
+    int rc = pcap ? run_pcap(out, pcap, port_given ? port : 0) : run_live(out, addr, port);
+    print_sources();
+    if (out != stdout && fclose(out) != 0) { perror(out_path); return 1; }
+    return rc;
+}
@@ -0,0 +1,625 @@
+/*
+ * Packet recorder: writes the run's packet table in master time while it
+ * captures, replacing tcpdump -> pcap -> Wireshark CSV export ->
+ * netcsvcleaner.py -> nettimetomastertime.py
+ * - One AF_PACKET socket per worker thread, each with a TPACKET_V3 block
+ *   ring mmap()ed into the process; the workers are one fanout group
+ *   (PACKET_FANOUT_HASH), so the kernel spreads flows across cores and both
+ *   directions of a TCP connection land on the same worker
+ * - A one-instruction BPF program truncates every packet to SNAPLEN bytes
+ *   in the kernel: only the headers are needed, so the ring holds far more
+ *   packets than whole frames would allow
+ * - Workers decode Ethernet/IPv4/TCP/UDP/ICMP straight from the ring, apply
+ *   the device IP filter (both Source and Destination in the list, as
+ *   netcsvcleaner.py) and format the row fields; the main thread merges
+ *   the workers' rows by kernel timestamp and writes them, so the CSV is in
+ *   time order like the Wireshark export
+ * - Reports the rings' own drops (PACKET_STATISTICS) every few seconds and
+ *   on exit: drops=0 means every packet the interface saw was decoded
+ *
+ * Build x86:
+ *   gcc -O2 -std=c11 -pthread -o pktrec pktrec.c
+ * Build Arm64:
+ *   aarch64-linux-gnu-gcc -O2 -std=c11 -pthread -o pktrec pktrec.c
+ *
+ * Usage:
+ *   sudo ./pktrec -i wlan0 -o feb17normalrun_datasetdata_mastertime.csv
+ *
+ * Options:
+ *   -i <iface>   Interface to capture on, the AP interface (required)
+ *   -o <file>    CSV output (default: stdout)
+ *   -f <ips>     Comma-separated device IPs; a packet is kept when both its
+ *                Source and Destination are in the list, "any" keeps every
+ *                IPv4 packet (default: 10.0.0.1,10.0.0.67)
+ *   -x <ports>   Comma-separated UDP destination ports to leave out, e.g.
+ *                9001 when labelcollect writes the labels (default: none)
+ *   -t <n>       Worker threads in the fanout group (default: online CPUs,
+ *                at most 8)
+ *   -b <KB>      Ring block size (default: 1024)
+ *   -n <n>       Ring blocks per worker (default: 32)
+ *   -O <s>       Offset added to the capture time to get master time, e.g.
+ *                from syncalign (default: 0)
+ *   -u           Date and time in UTC (default: local time, like the
+ *                master_start_str of nettimetomastertime.py)
+ *   -d <s>       Stop after this many seconds (default: until Ctrl-C)
+ *   -r <s>       Stats interval on stderr, 0 for none (default: 5)
+ *   -h           Show this help and exit
+ *
+ * CSV columns: No., date, Time, Source, Destination, Protocol, Length and
+ * Info, as in the Wireshark export after nettimetomastertime.py (the
+ * columns csvmerge6.py reads). Length is the frame length on the wire.
+ * Info follows Wireshark: "sport  >  dport Len=n" for UDP and
+ * "sport  >  dport [FLAGS] Seq=n Ack=n Win=n Len=n" for TCP, with sequence
+ * numbers relative to the first one seen in each direction.
+ *
+ * Notes:
+ * - Needs CAP_NET_RAW (root)
+ * - On lo every packet passes the tap twice; the outgoing copy is skipped,
+ *   as tcpdump does. On the AP interface both directions are kept.
+ * - "ring packets" is what the kernel offered the rings, drops included
+ *   (on lo both copies); "decoded" is what the workers read from them
+ * - A worker's rows are written once every other worker has caught up to
+ *   their timestamp (or has been idle for a few ring block timeouts), so
+ *   the CSV lags the capture by a few tens of ms
+ * - Rows are never dropped between the rings and the CSV: a worker whose
+ *   queue is full waits for the writer, and the ring then absorbs (or
+ *   drops, and reports) the backlog
+ */
+
+#define _GNU_SOURCE /* pthread_setaffinity_np(), localtime_r() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <net/if.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+
+#define MAX_WORKERS   8
+#define MAX_HOSTS     16
+#define MAX_EXCLUDE   8
+#define SNAPLEN       256               /* Ethernet + VLAN + IPv4 + TCP with options, and then some */
+#define FRAME_SIZE    2048              /* tp_frame_size: only a sanity bound for V3, which packs packets */
+#define BLOCK_KB      1024
+#define BLOCKS        32
+#define RETIRE_MS     10                /* A partly filled block is handed over after this long */
+#define QUEUE_LEN     (1 << 16)         /* Rows per worker between decode and write, a power of 2 */
+#define FLOWS         4096              /* TCP directions per worker for relative Seq/Ack, a power of 2 */
+#define TAIL_LEN      192               /* "Source",...,"Info" of a row */
+
+static volatile sig_atomic_t stop = 0;
+static void handle_sigint(int sig) { (void)sig; stop = 1; }
+
+static _Atomic unsigned running;        /* Workers still capturing */
+
+static uint64_t realtime_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+static uint16_t be16(const uint8_t *p) { return (uint16_t)(p[0] << 8 | p[1]); }
+static uint32_t be32(const uint8_t *p) { return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]; }
+
+static struct {
+    uint32_t hosts[MAX_HOSTS];          /* Network order; none = any */
+    unsigned nhosts;
+    uint16_t exclude[MAX_EXCLUDE];
+    unsigned nexclude;
+    int loopback;
+} filt;
+
+/* One direction of a TCP connection, for Wireshark's relative sequence numbers */
+struct flow {
+    uint32_t saddr, daddr;
+    uint16_t sport, dport;
+    uint32_t base;                      /* First sequence number seen */
+    int used;
+};
+
+/* A decoded packet: kernel timestamp and the row after No., date and Time */
+struct rec {
+    uint64_t ts_ns;
+    char tail[TAIL_LEN];
+};
+
+struct worker {
+    pthread_t thread;
+    int id, sock;
+    uint8_t *ring;
+    size_t block_size, ring_len;
+    unsigned nblocks;
+
+    /* Single producer (the worker), single consumer (the writer) */
+    struct rec *q;
+    _Atomic uint64_t head, tail;
+    _Atomic uint64_t watermark;         /* No row older than this is still to come from this worker */
+
+    _Atomic uint64_t seen, kept, blocks, waits;
+    uint64_t kernel_pkts, drops, freezes; /* PACKET_STATISTICS, summed by the main thread */
+    struct flow *flows;
+};
+
+/* ------------------- Decoding ------------------- */
+
+static int host_ok(uint32_t a) {
+    if (filt.nhosts == 0) return 1;
+    for (unsigned i = 0; i < filt.nhosts; i++)
+        if (filt.hosts[i] == a) return 1;
+    return 0;
+}
+
+/* Sequence number base of this direction; the first packet seen sets it */
+static uint32_t flow_base(struct worker *w, uint32_t saddr, uint32_t daddr, uint16_t sport, uint16_t dport,
+                          uint32_t seq, int create) {
+    uint32_t h = (saddr * 2654435761u) ^ (daddr * 40503u) ^ ((uint32_t)sport << 16 | dport);
+    h ^= h >> 15;
+    for (unsigned i = 0; i < 8; i++) { // Short probe; a full neighbourhood reuses the first slot
+        struct flow *f = &w->flows[(h + i) & (FLOWS - 1)];
+        if (f->used && f->saddr == saddr && f->daddr == daddr && f->sport == sport && f->dport == dport) return f->base;
+        if (!f->used) {
+            if (!create) return seq;
+            *f = (struct flow){ saddr, daddr, sport, dport, seq, 1 };
+            return seq;
+        }
+    }
+    if (!create) return seq;
+    w->flows[h & (FLOWS - 1)] = (struct flow){ saddr, daddr, sport, dport, seq, 1 };
+    return seq;
+}
+
+static void tcp_flags(uint8_t fl, char *out, size_t len) {
+    static const struct { uint8_t bit; const char *name; } names[] = {
+        { 0x02, "SYN" }, { 0x01, "FIN" }, { 0x04, "RST" }, { 0x08, "PSH" }, { 0x10, "ACK" }, { 0x20, "URG" },
+    };
+    size_t n = 0;
+    out[0] = '\0';
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (!(fl & names[i].bit)) continue;
+        int r = snprintf(out + n, len - n, "%s%s", n ? ", " : "", names[i].name);
+        if (r < 0 || (size_t)r >= len - n) break;
+        n += (size_t)r;
+    }
+    if (n == 0) snprintf(out, len, "<None>");
+}
+
+/* Decode one frame into `r`; 0 to keep it, -1 if it is filtered out */
+static int decode(struct worker *w, const uint8_t *p, uint32_t snap, uint32_t wire, struct rec *r) {
+    if (snap < 14) return -1;
+    uint16_t type = be16(p + 12);
+    uint32_t off = 14;
+    if (type == ETH_P_8021Q && snap >= 18) { type = be16(p + 16); off = 18; }
+    if (type != ETH_P_IP || snap < off + 20) return -1; // The device filter is on IPv4 addresses
+    const uint8_t *ip = p + off;
+    uint32_t ihl = (uint32_t)(ip[0] & 0x0f) * 4;
+    if ((ip[0] >> 4) != 4 || ihl < 20) return -1;
+    uint32_t saddr, daddr;
+    memcpy(&saddr, ip + 12, 4);
+    memcpy(&daddr, ip + 16, 4);
+    if (!host_ok(saddr) || !host_ok(daddr)) return -1;
+
+    uint32_t ip_len = be16(ip + 2);
+    const uint8_t *l4 = ip + ihl;
+    uint32_t avail = snap > off + ihl ? snap - off - ihl : 0;
+    int first_frag = (be16(ip + 6) & 0x1fff) == 0;
+    const char *proto = "IPv4";
+    char info[128];
+    snprintf(info, sizeof(info), "Protocol %u", ip[9]);
+
+    if (!first_frag) {
+        snprintf(info, sizeof(info), "Fragmented IP protocol (proto=%u, off=%u)", ip[9], (be16(ip + 6) & 0x1fff) * 8);
+    } else if (ip[9] == IPPROTO_TCP && avail >= 20) {
+        uint16_t sport = be16(l4), dport = be16(l4 + 2);
+        uint32_t seq = be32(l4 + 4), ack = be32(l4 + 8);
+        uint32_t doff = (uint32_t)(l4[12] >> 4) * 4;
+        uint8_t fl = l4[13];
+        uint32_t len = ip_len > ihl + doff ? ip_len - ihl - doff : 0;
+        uint32_t rseq = seq - flow_base(w, saddr, daddr, sport, dport, seq, 1);
+        char flags[48];
+        tcp_flags(fl, flags, sizeof(flags));
+        proto = "TCP";
+        if (fl & 0x10) {
+            uint32_t rack = ack - flow_base(w, daddr, saddr, dport, sport, ack, 0);
+            snprintf(info, sizeof(info), "%u  >  %u [%s] Seq=%u Ack=%u Win=%u Len=%u", sport, dport, flags, rseq, rack,
+                     be16(l4 + 14), len);
+        } else {
+            snprintf(info, sizeof(info), "%u  >  %u [%s] Seq=%u Win=%u Len=%u", sport, dport, flags, rseq,
+                     be16(l4 + 14), len);
+        }
+    } else if (ip[9] == IPPROTO_UDP && avail >= 8) {
+        uint16_t sport = be16(l4), dport = be16(l4 + 2), ulen = be16(l4 + 4);
+        for (unsigned i = 0; i < filt.nexclude; i++)
+            if (filt.exclude[i] == dport) return -1;
+        proto = "UDP";
+        snprintf(info, sizeof(info), "%u  >  %u Len=%u", sport, dport, ulen >= 8 ? ulen - 8 : 0);
+    } else if (ip[9] == IPPROTO_ICMP && avail >= 8) {
+        proto = "ICMP";
+        if (l4[0] == 8 || l4[0] == 0)
+            snprintf(info, sizeof(info), "Echo (ping) %s  id=0x%04x, seq=%u/%u, ttl=%u", l4[0] == 8 ? "request" : "reply",
+                     be16(l4 + 4), be16(l4 + 6), (unsigned)(l4[6] | l4[7] << 8), ip[8]);
+        else if (l4[0] == 3)
+            snprintf(info, sizeof(info), "Destination unreachable (code %u)", l4[1]);
+        else
+            snprintf(info, sizeof(info), "Type=%u Code=%u", l4[0], l4[1]);
+    } else if (ip[9] == IPPROTO_IGMP) {
+        proto = "IGMP";
+    }
+
+    char src[INET_ADDRSTRLEN], dst[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &saddr, src, sizeof(src));
+    inet_ntop(AF_INET, &daddr, dst, sizeof(dst));
+    snprintf(r->tail, sizeof(r->tail), "\"%s\",\"%s\",\"%s\",\"%u\",\"%s\"", src, dst, proto, wire, info);
+    return 0;
+}
+
+/* ------------------- Capture ------------------- */
+
+/* Hand a row to the writer; waits (the ring keeps filling) rather than dropping it */
+static void push(struct worker *w, const struct rec *r) {
+    uint64_t t = atomic_load_explicit(&w->tail, memory_order_relaxed);
+    int waited = 0;
+    while (t - atomic_load_explicit(&w->head, memory_order_acquire) >= QUEUE_LEN) {
+        waited = 1;
+        sched_yield();
+    }
+    if (waited) atomic_fetch_add_explicit(&w->waits, 1, memory_order_relaxed);
+    w->q[t & (QUEUE_LEN - 1)] = *r;
+    atomic_store_explicit(&w->watermark, r->ts_ns, memory_order_relaxed);
+    atomic_store_explicit(&w->tail, t + 1, memory_order_release);
+}
+
+static void walk_block(struct worker *w, struct tpacket_block_desc *bd) {
+    uint32_t n = bd->hdr.bh1.num_pkts;
+    const struct tpacket3_hdr *h = (const void *)((uint8_t *)bd + bd->hdr.bh1.offset_to_first_pkt);
+    struct rec r;
+    for (uint32_t i = 0; i < n; i++, h = (const void *)((const uint8_t *)h + h->tp_next_offset)) {
+        const struct sockaddr_ll *sll = (const void *)((const uint8_t *)h + TPACKET_ALIGN(sizeof(*h)));
+        if (filt.loopback && sll->sll_pkttype == PACKET_OUTGOING) continue; // Seen again on the way in
+        atomic_fetch_add_explicit(&w->seen, 1, memory_order_relaxed);
+        if (decode(w, (const uint8_t *)h + h->tp_mac, h->tp_snaplen, h->tp_len, &r) != 0) continue;
+        r.ts_ns = (uint64_t)h->tp_sec * 1000000000ULL + h->tp_nsec;
+        push(w, &r);
+        atomic_fetch_add_explicit(&w->kept, 1, memory_order_relaxed);
+    }
+}
+
+/* Decode block `*b` and hand it back to the kernel; 0 if it is not ours yet */
+static int take_block(struct worker *w, unsigned *b) {
+    struct tpacket_block_desc *bd = (void *)(w->ring + (size_t)*b * w->block_size);
+    if (!(__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) return 0;
+    walk_block(w, bd);
+    __atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    atomic_fetch_add_explicit(&w->blocks, 1, memory_order_relaxed);
+    *b = (*b + 1) % w->nblocks;
+    return 1;
+}
+
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    struct pollfd pfd = { .fd = w->sock, .events = POLLIN | POLLERR };
+    unsigned b = 0;
+    while (!stop) {
+        if (take_block(w, &b)) continue;
+        /* Idle: a packet still in an open block is at most RETIRE_MS old when the block is retired */
+        uint64_t idle = realtime_ns() - 4ULL * RETIRE_MS * 1000000ULL;
+        if (idle > atomic_load_explicit(&w->watermark, memory_order_relaxed))
+            atomic_store_explicit(&w->watermark, idle, memory_order_relaxed);
+        poll(&pfd, 1, RETIRE_MS);
+    }
+    /* Stopping: decode the blocks the kernel has already handed over (at most one
+       ring's worth, so a busy link cannot keep the worker here) */
+    for (unsigned left = w->nblocks; left > 0 && take_block(w, &b); left--) {}
+    atomic_store(&w->watermark, UINT64_MAX); // Never holds back the others' rows again
+    atomic_fetch_sub(&running, 1);
+    return NULL;
+}
+
+static int open_ring(struct worker *w, int ifindex, int fanout_id) {
+    /* Protocol 0: not hooked into any interface until bind(). The fanout group only
+       takes a bound (running) socket, so a drop-all filter keeps the ring empty
+       between bind() and the join; otherwise it would start with packets of other
+       interfaces (socket to bind) or another worker's share (bind to join) */
+    int sock = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (sock < 0) { perror("socket(AF_PACKET)"); return -1; }
+    w->sock = sock;
+    struct sock_filter none[] = { BPF_STMT(BPF_RET | BPF_K, 0) };
+    struct sock_fprog drop = { .len = 1, .filter = none };
+    if (setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &drop, sizeof(drop)) != 0) { perror("SO_ATTACH_FILTER"); return -1; }
+
+    int ver = TPACKET_V3;
+    if (setsockopt(sock, SOL_PACKET, PACKET_VERSION, &ver, sizeof(ver)) != 0) { perror("PACKET_VERSION"); return -1; }
+    struct tpacket_req3 req = {0};
+    req.tp_block_size = (unsigned)w->block_size;
+    req.tp_block_nr = w->nblocks;
+    req.tp_frame_size = FRAME_SIZE;
+    req.tp_frame_nr = (unsigned)(w->block_size / FRAME_SIZE) * w->nblocks;
+    req.tp_retire_blk_tov = RETIRE_MS;
+    if (setsockopt(sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) != 0) { perror("PACKET_RX_RING"); return -1; }
+    w->ring_len = w->block_size * w->nblocks;
+    w->ring = mmap(NULL, w->ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, sock, 0);
+    if (w->ring == MAP_FAILED) // MAP_LOCKED needs the memlock limit; the ring works without it
+        w->ring = mmap(NULL, w->ring_len, PROT_READ | PROT_WRITE, MAP_SHARED, sock, 0);
+    if (w->ring == MAP_FAILED) { perror("mmap ring"); w->ring = NULL; return -1; }
+
+    struct sockaddr_ll sll = {0};
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex = ifindex;
+    if (bind(sock, (struct sockaddr *)&sll, sizeof(sll)) != 0) { perror("bind"); return -1; }
+
+    /* No PACKET_FANOUT_FLAG_DEFRAG: a fragmented datagram stays one row per fragment
+       with its own wire length, as in the Wireshark export */
+    int fanout = (fanout_id & 0xffff) | PACKET_FANOUT_HASH << 16;
+    if (setsockopt(sock, SOL_PACKET, PACKET_FANOUT, &fanout, sizeof(fanout)) != 0) { perror("PACKET_FANOUT"); return -1; }
+
+    /* In the group: let packets in, truncated in the kernel before the copy into the ring */
+    struct sock_filter code[] = { BPF_STMT(BPF_RET | BPF_K, SNAPLEN) };
+    struct sock_fprog prog = { .len = 1, .filter = code };
+    if (setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) != 0) { perror("SO_ATTACH_FILTER"); return -1; }
+    return 0;
+}
+
+/* Fold the ring counters in; the kernel resets them on every read */
+static void ring_stats(struct worker *w) {
+    struct tpacket_stats_v3 s;
+    socklen_t len = sizeof(s);
+    if (getsockopt(w->sock, SOL_PACKET, PACKET_STATISTICS, &s, &len) != 0) return;
+    w->kernel_pkts += s.tp_packets;
+    w->drops += s.tp_drops;
+    w->freezes += s.tp_freeze_q_cnt;
+}
+
+/* ------------------- Output ------------------- */
+
+static struct {
+    FILE *out;
+    int64_t offset_ns;
+    int utc;
+    int64_t sec;                        /* Second the cached strings belong to */
+    char date[16], hms[16];
+    uint64_t rows;
+} csv = { .sec = -1 };
+
+static void csv_row(const struct rec *r) {
+    int64_t t = (int64_t)r->ts_ns + csv.offset_ns;
+    int64_t sec = t / 1000000000LL;
+    if (sec != csv.sec) {
+        time_t tt = (time_t)sec;
+        struct tm tm;
+        if (csv.utc) gmtime_r(&tt, &tm); else localtime_r(&tt, &tm);
+        strftime(csv.date, sizeof(csv.date), "%Y-%m-%d", &tm);
+        strftime(csv.hms, sizeof(csv.hms), "%H:%M:%S", &tm);
+        csv.sec = sec;
+    }
+    fprintf(csv.out, "\"%llu\",\"%s\",\"%s.%06lld\",%s\n", (unsigned long long)++csv.rows, csv.date, csv.hms,
+            (long long)(t % 1000000000LL / 1000), r->tail);
+}
+
+/*
+ * Write the oldest queued row if no worker can still produce an older one.
+ * `all`: the workers have stopped, write whatever is queued. 1 if a row was
+ * written.
+ */
+static int merge_one(struct worker *ws, unsigned nw, int all) {
+    int best = -1;
+    uint64_t best_ts = UINT64_MAX;
+    for (unsigned i = 0; i < nw; i++) {
+        uint64_t h = atomic_load_explicit(&ws[i].head, memory_order_relaxed);
+        if (h == atomic_load_explicit(&ws[i].tail, memory_order_acquire)) continue;
+        uint64_t ts = ws[i].q[h & (QUEUE_LEN - 1)].ts_ns;
+        if (ts < best_ts) { best_ts = ts; best = (int)i; }
+    }
+    if (best < 0) return 0;
+    if (!all) {
+        for (unsigned i = 0; i < nw; i++) {
+            if (atomic_load_explicit(&ws[i].head, memory_order_relaxed) !=
+                atomic_load_explicit(&ws[i].tail, memory_order_acquire)) continue;
+            if (atomic_load_explicit(&ws[i].watermark, memory_order_relaxed) < best_ts) return 0;
+        }
+    }
+    struct worker *w = &ws[best];
+    uint64_t h = atomic_load_explicit(&w->head, memory_order_relaxed);
+    csv_row(&w->q[h & (QUEUE_LEN - 1)]);
+    atomic_store_explicit(&w->head, h + 1, memory_order_release);
+    return 1;
+}
+
+static void report(struct worker *ws, unsigned nw, double secs, int final) {
+    uint64_t seen = 0, kept = 0, pkts = 0, drops = 0, freezes = 0, blocks = 0, waits = 0;
+    for (unsigned i = 0; i < nw; i++) {
+        ring_stats(&ws[i]);
+        seen += atomic_load(&ws[i].seen);
+        kept += atomic_load(&ws[i].kept);
+        blocks += atomic_load(&ws[i].blocks);
+        waits += atomic_load(&ws[i].waits);
+        pkts += ws[i].kernel_pkts;
+        drops += ws[i].drops;
+        freezes += ws[i].freezes;
+    }
+    fprintf(stderr, "[%s] %.1fs ring packets=%llu drops=%llu freezes=%llu blocks=%llu | decoded=%llu kept=%llu "
+                    "written=%llu (%.0f rows/s) writer waits=%llu\n",
+            final ? "pktrec" : "rate", secs, (unsigned long long)pkts, (unsigned long long)drops,
+            (unsigned long long)freezes, (unsigned long long)blocks, (unsigned long long)seen,
+            (unsigned long long)kept, (unsigned long long)csv.rows, secs > 0 ? (double)csv.rows / secs : 0.0,
+            (unsigned long long)waits);
+    if (final && nw > 1) {
+        for (unsigned i = 0; i < nw; i++)
+            fprintf(stderr, "  worker %u: ring packets=%llu drops=%llu kept=%llu\n", i,
+                    (unsigned long long)ws[i].kernel_pkts, (unsigned long long)ws[i].drops,
+                    (unsigned long long)atomic_load(&ws[i].kept));
+    }
+}
+
+static int parse_list(const char *s, int (*one)(const char *, size_t)) {
+    while (*s) {
+        size_t n = strcspn(s, ",");
+        if (n == 0 || one(s, n) != 0) return -1;
+        s += n;
+        if (*s == ',') s++;
+    }
+    return 0;
+}
+
+static int add_host(const char *s, size_t n) {
+    char ip[INET_ADDRSTRLEN];
+    if (n >= sizeof(ip) || filt.nhosts == MAX_HOSTS) return -1;
+    memcpy(ip, s, n);
+    ip[n] = '\0';
+    return inet_pton(AF_INET, ip, &filt.hosts[filt.nhosts++]) == 1 ? 0 : -1;
+}
+
+static int add_exclude(const char *s, size_t n) {
+    char *end;
+    long port = strtol(s, &end, 10);
+    if ((size_t)(end - s) != n || port <= 0 || port > 65535 || filt.nexclude == MAX_EXCLUDE) return -1;
+    filt.exclude[filt.nexclude++] = (uint16_t)port;
+    return 0;
+}
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s -i <iface> [options]\n"
+            "  -i <iface>   Interface to capture on (required)\n"
+            "  -o <file>    CSV output (default: stdout)\n"
+            "  -f <ips>     Device IPs, both ends must match, or \"any\" (default: 10.0.0.1,10.0.0.67)\n"
+            "  -x <ports>   UDP destination ports to leave out (default: none)\n"
+            "  -t <n>       Worker threads in the fanout group (default: online CPUs, at most %d)\n"
+            "  -b <KB>      Ring block size (default: %d)\n"
+            "  -n <n>       Ring blocks per worker (default: %d)\n"
+            "  -O <s>       Offset added to the capture time to get master time (default: 0)\n"
+            "  -u           Date and time in UTC (default: local time)\n"
+            "  -d <s>       Stop after this many seconds (default: until Ctrl-C)\n"
+            "  -r <s>       Stats interval, 0 for none (default: 5)\n"
+            "  -h           Show this help and exit\n",
+            prog, MAX_WORKERS, BLOCK_KB, BLOCKS);
+}
+
+int main(int argc, char **argv) {
+    const char *iface = NULL, *out_path = NULL, *hosts = "10.0.0.1,10.0.0.67", *exclude = "";
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned nw = ncpu > MAX_WORKERS ? MAX_WORKERS : ncpu < 1 ? 1 : (unsigned)ncpu;
+    unsigned block_kb = BLOCK_KB, nblocks = BLOCKS;
+    double duration = 0, interval = 5;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:o:f:x:t:b:n:O:ud:r:h")) != -1) {
+        switch (opt) {
+        case 'i': iface = optarg; break;
+        case 'o': out_path = optarg; break;
+        case 'f': hosts = optarg; break;
+        case 'x': exclude = optarg; break;
+        case 't': nw = (unsigned)atoi(optarg); break;
+        case 'b': block_kb = (unsigned)atoi(optarg); break;
+        case 'n': nblocks = (unsigned)atoi(optarg); break;
+        case 'O': csv.offset_ns = (int64_t)(atof(optarg) * 1e9); break;
+        case 'u': csv.utc = 1; break;
+        case 'd': duration = atof(optarg); break;
+        case 'r': interval = atof(optarg); break;
+        default: print_usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    /* Blocks are page-multiple and hold at least one full-size frame */
+    long page = sysconf(_SC_PAGESIZE);
+    size_t block_size = (size_t)block_kb * 1024;
+    if (!iface || nw == 0 || nw > MAX_WORKERS || nblocks == 0 || block_size < FRAME_SIZE ||
+        block_size % (size_t)page != 0 || (strcmp(hosts, "any") != 0 && parse_list(hosts, add_host) != 0) ||
+        parse_list(exclude, add_exclude) != 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    int ifindex = (int)if_nametoindex(iface);
+    if (ifindex == 0) { fprintf(stderr, "%s: %s\n", iface, strerror(errno)); return 1; }
+    filt.loopback = strcmp(iface, "lo") == 0;
+
+    struct worker *ws = calloc(nw, sizeof(*ws));
+    if (!ws) { fprintf(stderr, "Out of memory\n"); return 1; }
+    int fanout_id = getpid() & 0xffff;
+    for (unsigned i = 0; i < nw; i++) {
+        struct worker *w = &ws[i];
+        w->id = (int)i;
+        w->block_size = block_size;
+        w->nblocks = nblocks;
+        w->q = malloc(QUEUE_LEN * sizeof(*w->q));
+        w->flows = calloc(FLOWS, sizeof(*w->flows));
+        if (!w->q || !w->flows) { fprintf(stderr, "Out of memory\n"); return 1; }
+        if (open_ring(w, ifindex, fanout_id) != 0) return 1;
+        ring_stats(w); // Zero the counters: nothing before the start is ours
+        w->kernel_pkts = w->drops = w->freezes = 0;
+    }
+
+    csv.out = out_path ? fopen(out_path, "w") : stdout;
+    if (!csv.out) { perror(out_path); return 1; }
+    static char obuf[1 << 20];
+    setvbuf(csv.out, obuf, _IOFBF, sizeof(obuf));
+    fprintf(csv.out, "\"No.\",\"date\",\"Time\",\"Source\",\"Destination\",\"Protocol\",\"Length\",\"Info\"\n");
+
+    struct sigaction act = {0};
+    act.sa_handler = handle_sigint; /* No SA_RESTART: the sleeps below return on Ctrl-C */
+    sigaction(SIGINT, &act, NULL);
+    sigaction(SIGTERM, &act, NULL);
+
+    for (unsigned i = 0; i < nw; i++) {
+        atomic_store(&ws[i].watermark, realtime_ns());
+        atomic_fetch_add(&running, 1);
+        if (pthread_create(&ws[i].thread, NULL, worker_main, &ws[i]) != 0) { fprintf(stderr, "pthread_create failed\n"); return 1; }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET((int)(i % (unsigned)(ncpu > 0 ? ncpu : 1)), &set);
+        pthread_setaffinity_np(ws[i].thread, sizeof(set), &set); // Best effort
+    }
+    fprintf(stderr, "Recording %s with %u worker%s (ring %u x %u KB each, fanout %d), filter %s%s%s, "
+                    "master time = capture time %+.6f s, %s\n",
+            iface, nw, nw == 1 ? "" : "s", nblocks, block_kb, fanout_id, hosts, *exclude ? ", without UDP port " : "",
+            exclude, (double)csv.offset_ns / 1e9, csv.utc ? "UTC" : "local time");
+
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    double next_report = interval;
+    while (!stop) {
+        int wrote = 0;
+        while (merge_one(ws, nw, 0) && ++wrote < 4096) {}
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double secs = (double)(now.tv_sec - t0.tv_sec) + (double)(now.tv_nsec - t0.tv_nsec) / 1e9;
+        if (duration > 0 && secs >= duration) break;
+        if (interval > 0 && secs >= next_report) {
+            fflush(csv.out);
+            report(ws, nw, secs, 0);
+            next_report += interval;
+        }
+        if (wrote == 0) {
+            struct timespec nap = { 0, 1000000 };
+            nanosleep(&nap, NULL);
+        }
+    }
+    stop = 1;
+    while (atomic_load(&running) > 0) // Keep writing: a worker may be waiting for queue space
+        if (!merge_one(ws, nw, 0)) sched_yield();
+    for (unsigned i = 0; i < nw; i++) pthread_join(ws[i].thread, NULL);
+    while (merge_one(ws, nw, 1)) {}
+    if (out_path) fclose(csv.out); else fflush(csv.out);
+
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    report(ws, nw, (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9, 1);
+    for (unsigned i = 0; i < nw; i++) {
+        munmap(ws[i].ring, ws[i].ring_len);
+        close(ws[i].sock);
+    }
+    return 0;
+}
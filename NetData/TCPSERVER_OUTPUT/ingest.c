@@ -0,0 +1,386 @@
+/*
+ * Multi-camera upload ingest server for the v1 upload header
+ * - v1: u64 size, u16 name_len, name, payload, as tcpserver.py reads it:
+ *   what CameraAttempt4 sends without -2, and the other emulators
+ * - Any number of concurrent uploads from one epoll loop; nothing blocks on a
+ *   slow client
+ * - Payload goes socket -> pipe -> file with splice(), never through user
+ *   space, into a file preallocated with fallocate() to the announced size
+ * - Files land per device, in <dir>/<client IP>/<name>.part, renamed to
+ *   <name> once every byte is in; a short upload stays .part, trimmed to
+ *   what arrived
+ * - Prints one line per finished upload (size, time, throughput) and every
+ *   interval the total and per-connection receive rates
+ *
+ * Build x86:
+ *   gcc -O2 -std=c11 -o ingest ingest.c
+ * Build Arm64:
+ *   aarch64-linux-gnu-gcc -O2 -std=c11 -o ingest ingest.c
+ *
+ * Usage:
+ *   ./ingest [options]
+ *
+ * Options:
+ *   -a <addr>    Local IPv4 address to bind (default: 0.0.0.0)
+ *   -p <port>    TCP port to listen on (default: 9000)
+ *   -d <dir>     Where device directories are created (default: .)
+ *   -n <conns>   Concurrent uploads; more are refused (default: 64)
+ *   -i <s>       Rate report interval in seconds, 0 = off (default: 1)
+ *   -P <KB>      Pipe size per connection for splice() (default: 1024)
+ *   -h           Show this help and exit
+ *
+ * Notes:
+ * - v2 (resumable) clients get RS_BAD_REQUEST; tcprecv serves those.
+ * - Readiness is level-triggered and each connection moves at most
+ *   BODY_ROUNDS pipe loads per wakeup, so one fast camera cannot starve the
+ *   others.
+ * - Writeback is started every SYNC_EVERY bytes (sync_file_range), so the
+ *   fdatasync() before the rename has little left to do and does not stall
+ *   the loop for the other uploads.
+ * - A client that sends nothing for 30 s is dropped.
+ */
+
+#define _GNU_SOURCE /* splice(), fallocate(), sync_file_range(), F_SETPIPE_SZ, accept4() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <getopt.h>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "../../IoTDev/SmartCam/common/resume.h"
+
+#define IO_TIMEOUT_S  30                /* Client silent this long: drop it */
+#define V1_HDR_LEN    10
+#define BODY_ROUNDS   8                 /* Pipe loads per connection per wakeup */
+#define SYNC_EVERY    (8u << 20)        /* Start writeback this often */
+#define MAX_EVENTS    64
+#define REPORT_CONNS  8                 /* Connections listed per rate line */
+
+static volatile sig_atomic_t stop = 0;
+static void handle_sigint(int sig) { (void)sig; stop = 1; }
+
+static uint64_t mono_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+enum { ST_HEADER, ST_NAME, ST_BODY };
+
+struct conn {
+    int sock, fd, pipe[2];
+    int state;
+    uint8_t hdr[V1_HDR_LEN];
+    unsigned have;                      /* Header or name bytes so far */
+    uint16_t name_len;
+    char name[RS_NAME_MAX + 1];
+    const char *base;
+    uint64_t size, got, inpipe, synced;
+    uint64_t last_got;                  /* At the previous rate report */
+    uint64_t t0, t_seen;
+    char ip[INET_ADDRSTRLEN], peer[64];
+    char path[4096], part[4200];
+};
+
+struct server {
+    const char *dir;
+    int ep, ls;
+    size_t pipe_sz;
+    struct conn **slot;
+    unsigned nslot, active;
+    uint64_t bytes, last_bytes, files, complete, refused;
+    double peak;                        /* MB/s over a report interval */
+};
+
+/* Last path component of a received name; NULL if nothing usable is left */
+static const char *safe_name(char *name) {
+    char *base = strrchr(name, '/');
+    base = base ? base + 1 : name;
+    if (!*base || strcmp(base, ".") == 0 || strcmp(base, "..") == 0) return NULL;
+    return base;
+}
+
+static void conn_close(struct server *s, struct conn *c) {
+    for (unsigned i = 0; i < s->nslot; i++)
+        if (s->slot[i] == c) s->slot[i] = NULL;
+    s->active--;
+    close(c->sock);             /* Also takes it out of the epoll set */
+    if (c->fd >= 0) close(c->fd);
+    if (c->pipe[0] >= 0) { close(c->pipe[0]); close(c->pipe[1]); }
+    free(c);
+}
+
+static void conn_finish(struct server *s, struct conn *c) {
+    int complete = c->got == c->size && fdatasync(c->fd) == 0 && rename(c->part, c->path) == 0;
+    if (!complete && ftruncate(c->fd, (off_t)c->got) != 0) {} // Give back the preallocation past what arrived
+    double secs = (double)(mono_ns() - c->t0) / 1e9;
+    printf("[recv] v1 %s/%s from %s %.2f/%.2f MB in %.2fs (%.1f MB/s)%s\n", c->ip, c->base, c->peer,
+           (double)c->got / 1e6, (double)c->size / 1e6, secs, secs > 0 ? (double)c->got / secs / 1e6 : 0.0,
+           complete ? "" : " SHORT: kept as .part");
+    s->files++;
+    s->complete += complete;
+    conn_close(s, c);
+}
+
+/* Header complete: device directory, preallocated .part file, splice pipe */
+static int conn_open_file(struct server *s, struct conn *c) {
+    char devdir[3800], fallback[64];
+    c->name[c->name_len] = '\0';
+    c->base = safe_name(c->name);
+    if (!c->base) {
+        snprintf(fallback, sizeof(fallback), "received_%ld.mp4", (long)time(NULL));
+        memcpy(c->name, fallback, strlen(fallback) + 1);
+        c->base = c->name;
+    }
+    snprintf(devdir, sizeof(devdir), "%s/%s", s->dir, c->ip);
+    if (mkdir(devdir, 0755) != 0 && errno != EEXIST) { fprintf(stderr, "%s: %s\n", devdir, strerror(errno)); return -1; }
+    snprintf(c->path, sizeof(c->path), "%s/%s", devdir, c->base);
+    snprintf(c->part, sizeof(c->part), "%s.part", c->path);
+
+    c->fd = open(c->part, O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+    if (c->fd < 0) { fprintf(stderr, "%s: %s\n", c->part, strerror(errno)); return -1; }
+    /* Whole file reserved up front: contiguous extents, and a full disk fails here rather than mid-upload.
+       KEEP_SIZE so the .part length still says how much arrived */
+    if (c->size && fallocate(c->fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)c->size) != 0 && errno != EOPNOTSUPP) {
+        fprintf(stderr, "%s: fallocate %.2f MB: %s\n", c->part, (double)c->size / 1e6, strerror(errno));
+        return -1;
+    }
+    if (pipe2(c->pipe, O_NONBLOCK | O_CLOEXEC) != 0) { c->pipe[0] = c->pipe[1] = -1; perror("pipe"); return -1; }
+    fcntl(c->pipe[1], F_SETPIPE_SZ, (int)s->pipe_sz); // May be capped by fs.pipe-max-size; the default still works
+    return 0;
+}
+
+/* recv() exactly up to `want` header/name bytes; 1 when complete, 0 to wait, -1 to drop */
+static int recv_part(struct conn *c, uint8_t *buf, unsigned want) {
+    while (c->have < want) {
+        ssize_t r = recv(c->sock, buf + c->have, want - c->have, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0 && errno == EAGAIN) return 0;
+        if (r <= 0) return -1;
+        c->have += (unsigned)r;
+    }
+    return 1;
+}
+
+/* Move payload: socket -> pipe -> file, draining the pipe every round. 0 to wait, 1 done, -1 error */
+static int conn_body(struct server *s, struct conn *c) {
+    for (int round = 0; round < BODY_ROUNDS; round++) {
+        uint64_t want = c->size - c->got;
+        if (want > s->pipe_sz) want = s->pipe_sz;
+        ssize_t r = splice(c->sock, NULL, c->pipe[1], NULL, (size_t)want, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (r == 0) return -1; // Peer closed early
+        if (r < 0) {
+            if (errno == EAGAIN) return 0;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        c->inpipe = (uint64_t)r;
+        while (c->inpipe) {
+            loff_t off = (loff_t)c->got;
+            ssize_t w = splice(c->pipe[0], NULL, c->fd, &off, (size_t)c->inpipe, SPLICE_F_MOVE);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) { fprintf(stderr, "%s: %s\n", c->part, w < 0 ? strerror(errno) : "short write"); return -1; }
+            c->inpipe -= (uint64_t)w;
+            c->got += (uint64_t)w;
+            s->bytes += (uint64_t)w;
+        }
+        if (c->got - c->synced >= SYNC_EVERY) {
+            sync_file_range(c->fd, (off_t)c->synced, (off_t)(c->got - c->synced), SYNC_FILE_RANGE_WRITE);
+            c->synced = c->got;
+        }
+        if (c->got == c->size) return 1;
+    }
+    return 0; // Budget used up; level-triggered epoll brings us back
+}
+
+static void conn_event(struct server *s, struct conn *c) {
+    c->t_seen = mono_ns();
+    int rc = 0;
+    switch (c->state) {
+    case ST_HEADER:
+        rc = recv_part(c, c->hdr, V1_HDR_LEN);
+        if (c->have >= 4 && memcmp(c->hdr, RS_MAGIC_HELLO, 4) == 0) { // v2 client: say so instead of hanging it
+            uint8_t r[RS_REPLY_LEN] = {0};
+            memcpy(r, RS_MAGIC_REPLY, 4);
+            r[4] = RS_BAD_REQUEST;
+            send(c->sock, r, sizeof(r), MSG_NOSIGNAL);
+            printf("[recv] %s: v2 upload refused, use tcprecv\n", c->peer);
+            conn_close(s, c);
+            return;
+        }
+        if (rc <= 0) break;
+        c->size = be_get64(c->hdr);
+        c->name_len = be_get16(c->hdr + 8);
+        if (c->name_len > RS_NAME_MAX) { rc = -1; break; }
+        c->state = ST_NAME;
+        c->have = 0;
+        /* fall through */
+    case ST_NAME:
+        rc = recv_part(c, (uint8_t *)c->name, c->name_len);
+        if (rc <= 0) break;
+        if (conn_open_file(s, c) != 0) { rc = -1; break; }
+        c->state = ST_BODY;
+        if (c->size == 0) { conn_finish(s, c); return; }
+        /* fall through */
+    case ST_BODY:
+        rc = conn_body(s, c);
+        if (rc != 0) { conn_finish(s, c); return; }
+        break;
+    }
+    if (rc < 0) {
+        if (c->state == ST_BODY || c->fd >= 0) conn_finish(s, c);
+        else conn_close(s, c); // Nothing on disk yet
+    }
+}
+
+static void accept_all(struct server *s) {
+    for (;;) {
+        struct sockaddr_in from;
+        socklen_t flen = sizeof(from);
+        int sock = accept4(s->ls, (struct sockaddr *)&from, &flen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (sock < 0) return; // EAGAIN: backlog drained
+        unsigned i = 0;
+        while (i < s->nslot && s->slot[i]) i++;
+        struct conn *c = i < s->nslot ? calloc(1, sizeof(*c)) : NULL;
+        if (!c) {
+            s->refused++;
+            close(sock);
+            continue;
+        }
+        c->sock = sock;
+        c->fd = c->pipe[0] = c->pipe[1] = -1;
+        c->t0 = c->t_seen = mono_ns();
+        inet_ntop(AF_INET, &from.sin_addr, c->ip, sizeof(c->ip));
+        snprintf(c->peer, sizeof(c->peer), "%s:%u", c->ip, ntohs(from.sin_port));
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = c };
+        if (epoll_ctl(s->ep, EPOLL_CTL_ADD, sock, &ev) != 0) { close(sock); free(c); continue; }
+        s->slot[i] = c;
+        s->active++;
+    }
+}
+
+/* Total and per-connection receive rates since the last call; drops idle clients */
+static void report(struct server *s, double secs, int print) {
+    double total = (double)(s->bytes - s->last_bytes) / secs / 1e6;
+    s->last_bytes = s->bytes;
+    if (total > s->peak) s->peak = total;
+    if (print) printf("[rate] conns=%u in=%.1f MB/s total=%.1f MB", s->active, total, (double)s->bytes / 1e6);
+    unsigned listed = 0;
+    uint64_t now = mono_ns();
+    for (unsigned i = 0; i < s->nslot; i++) {
+        struct conn *c = s->slot[i];
+        if (!c) continue;
+        if (print && listed++ < REPORT_CONNS)
+            printf(" | %s %s %.1f MB/s %.0f%%", c->peer, c->state == ST_BODY ? c->base : "(header)",
+                   (double)(c->got - c->last_got) / secs / 1e6, c->size ? 100.0 * (double)c->got / (double)c->size : 0.0);
+        c->last_got = c->got;
+        if (now - c->t_seen > (uint64_t)IO_TIMEOUT_S * 1000000000ULL) {
+            printf("[recv] %s silent for %d s, dropped\n", c->peer, IO_TIMEOUT_S);
+            if (c->state == ST_BODY) conn_finish(s, c); else conn_close(s, c);
+        }
+    }
+    if (print) {
+        if (listed > REPORT_CONNS) printf(" | +%u more", listed - REPORT_CONNS);
+        printf("\n");
+    }
+    fflush(stdout);
+}
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -a <addr>    Local IPv4 address to bind (default: 0.0.0.0)\n"
+            "  -p <port>    TCP port to listen on (default: 9000)\n"
+            "  -d <dir>     Where device directories are created (default: .)\n"
+            "  -n <conns>   Concurrent uploads; more are refused (default: 64)\n"
+            "  -i <s>       Rate report interval in seconds, 0 = off (default: 1)\n"
+            "  -P <KB>      Pipe size per connection for splice() (default: 1024)\n"
+            "  -h           Show this help and exit\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    const char *addr = "0.0.0.0";
+    struct server s = { .dir = ".", .nslot = 64, .pipe_sz = 1024 * 1024 };
+    int port = 9000, opt;
+    double interval = 1;
+    while ((opt = getopt(argc, argv, "a:p:d:n:i:P:h")) != -1) {
+        switch (opt) {
+        case 'a': addr = optarg; break;
+        case 'p': port = atoi(optarg); break;
+        case 'd': s.dir = optarg; break;
+        case 'n': s.nslot = (unsigned)atoi(optarg); break;
+        case 'i': interval = atof(optarg); break;
+        case 'P': s.pipe_sz = (size_t)atoi(optarg) * 1024; break;
+        default: print_usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (s.nslot == 0 || s.pipe_sz < 4096 || interval < 0) { print_usage(argv[0]); return 1; }
+    s.slot = calloc(s.nslot, sizeof(*s.slot));
+    if (!s.slot) return 1;
+
+    s.ls = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    struct sockaddr_in sa = {0};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons((uint16_t)port);
+    setsockopt(s.ls, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (inet_pton(AF_INET, addr, &sa.sin_addr) != 1 ||
+        bind(s.ls, (struct sockaddr *)&sa, sizeof(sa)) != 0 || listen(s.ls, 128) != 0) {
+        perror("bind/listen");
+        return 1;
+    }
+    s.ep = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event lev = { .events = EPOLLIN, .data.ptr = NULL };
+    if (s.ep < 0 || epoll_ctl(s.ep, EPOLL_CTL_ADD, s.ls, &lev) != 0) { perror("epoll"); return 1; }
+
+    struct sigaction act = {0};
+    act.sa_handler = handle_sigint;
+    sigaction(SIGINT, &act, NULL);
+    sigaction(SIGTERM, &act, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    printf("Waiting for uploads on %s:%d into %s/<device>/ (up to %u at once)\n", addr, port, s.dir, s.nslot);
+    fflush(stdout);
+
+    uint64_t period = interval > 0 ? (uint64_t)(interval * 1e9) : 1000000000ULL; // Idle checks run regardless
+    uint64_t t_start = mono_ns(), next = t_start + period, last = t_start;
+    struct epoll_event evs[MAX_EVENTS];
+    while (!stop) {
+        uint64_t now = mono_ns();
+        int n = epoll_wait(s.ep, evs, MAX_EVENTS, now < next ? (int)((next - now) / 1000000) + 1 : 0);
+        for (int i = 0; i < n; i++) {
+            if (!evs[i].data.ptr) accept_all(&s);
+            else conn_event(&s, evs[i].data.ptr);
+        }
+        if ((now = mono_ns()) >= next) {
+            report(&s, (double)(now - last) / 1e9, interval > 0);
+            last = now;
+            next = now + period;
+        }
+    }
+
+    for (unsigned i = 0; i < s.nslot; i++) // Interrupted uploads stay .part
+        if (s.slot[i]) {
+            if (s.slot[i]->state == ST_BODY) conn_finish(&s, s.slot[i]); else conn_close(&s, s.slot[i]);
+        }
+    double secs = (double)(mono_ns() - t_start) / 1e9;
+    printf("[ingest] uploads=%llu complete=%llu refused=%llu received=%.1f MB in %.1fs avg=%.1f MB/s peak=%.1f MB/s\n",
+           (unsigned long long)s.files, (unsigned long long)s.complete, (unsigned long long)s.refused,
+           (double)s.bytes / 1e6, secs, secs > 0 ? (double)s.bytes / secs / 1e6 : 0.0, s.peak);
+    close(s.ep);
+    close(s.ls);
+    free(s.slot);
+    return 0;
+}
@@ -0,0 +1,327 @@
+/*
+ * Reference upload receiver for the SmartCam clients (v1 and resumable v2)
+ * - v1: u64 size, u16 name_len, name, payload (what tcpserver.py speaks)
+ * - v2: chunked with per-chunk offset and CRC32C, resumable after a dropped
+ *   connection (framing in IoTDev/SmartCam/common/resume.h)
+ * - Data lands in <dir>/<name>.part and is renamed to <name> only once every
+ *   byte is in; a short upload stays .part and is reported as such
+ * - Prints one line per connection: bytes, time, where it resumed, CRC speed
+ *
+ * Build x86:
+ *   gcc -O2 -std=c11 -o tcprecv tcprecv.c ../../IoTDev/SmartCam/common/crc32c.c
+ * Build Arm64:
+ *   aarch64-linux-gnu-gcc -O2 -std=c11 -o tcprecv tcprecv.c ../../IoTDev/SmartCam/common/crc32c.c
+ *
+ * Usage:
+ *   ./tcprecv [options]
+ *
+ * Options:
+ *   -a <addr>    Local IPv4 address to bind (default: 0.0.0.0)
+ *   -p <port>    TCP port to listen on (default: 9000)
+ *   -d <dir>     Where files are stored (default: .)
+ *   -x <MB>      Drop every v2 connection after this much payload (tests resume)
+ *   -b           Benchmark the CRC32C implementations and exit
+ *   -h           Show this help and exit
+ *
+ * Notes:
+ * - Connections are served one at a time, like tcpserver.py. A client that
+ *   stalls for 30 s is dropped.
+ * - The name's directory part is ignored (v1 clients send their full path).
+ * - v2 resume point: the .part length rounded down to a whole chunk, so a
+ *   chunk cut short by a crash is sent again.
+ * - The HELLO's size and ident are kept on the .part as the xattr
+ *   user.smartcam.upload (it follows the rename). A .part or finished file
+ *   without a matching one is another upload under the same name: it is
+ *   started over, never continued or reported complete.
+ */
+
+#define _GNU_SOURCE /* MSG_NOSIGNAL, fdatasync() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <getopt.h>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/xattr.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "../../IoTDev/SmartCam/common/crc32c.h"
+#include "../../IoTDev/SmartCam/common/resume.h"
+
+#define IO_TIMEOUT_S  30                /* Client silent this long: drop it */
+#define V1_BUF        (64 * 1024)
+#define BENCH_BYTES   (64u << 20)
+#define UPLOAD_XATTR  "user.smartcam.upload"  /* size u64 | ident u32 of the v2 upload a file holds */
+
+static volatile sig_atomic_t stop = 0;
+static void handle_sigint(int sig) { (void)sig; stop = 1; }
+
+static uint64_t mono_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+static int recv_all(int sock, void *buf, size_t n) {
+    uint8_t *p = buf;
+    while (n > 0) {
+        ssize_t r = recv(sock, p, n, 0);
+        if (r < 0 && errno == EINTR && !stop) continue;
+        if (r <= 0) return -1;
+        p += r;
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+static void send_reply(int sock, int status, uint64_t committed) {
+    uint8_t r[RS_REPLY_LEN] = {0};
+    memcpy(r, RS_MAGIC_REPLY, 4);
+    r[4] = (uint8_t)status;
+    be_put64(r + 8, committed);
+    send(sock, r, sizeof(r), MSG_NOSIGNAL);
+}
+
+/* Last path component of a received name; NULL if nothing usable is left */
+static const char *safe_name(char *name) {
+    char *base = strrchr(name, '/');
+    base = base ? base + 1 : name;
+    if (!*base || strcmp(base, ".") == 0 || strcmp(base, "..") == 0) return NULL;
+    return base;
+}
+
+static int pwrite_all(int fd, const uint8_t *p, size_t n, off_t off) {
+    while (n > 0) {
+        ssize_t r = pwrite(fd, p, n, off);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+        p += r;
+        n -= (size_t)r;
+        off += r;
+    }
+    return 0;
+}
+
+/* ------------------- v1 ------------------- */
+
+static void serve_v1(int sock, const uint8_t first[4], const char *dir, const char *peer) {
+    uint8_t hdr[6];
+    char name[RS_NAME_MAX + 1], path[4096], part[4200];
+    if (recv_all(sock, hdr, sizeof(hdr)) != 0) return;
+    uint64_t size = (uint64_t)be_get32(first) << 32 | be_get32(hdr);
+    uint16_t name_len = be_get16(hdr + 4);
+    if (name_len > RS_NAME_MAX || recv_all(sock, name, name_len) != 0) return;
+    name[name_len] = '\0';
+    const char *base = safe_name(name);
+    char fallback[64];
+    if (!base) { snprintf(fallback, sizeof(fallback), "received_%ld.mp4", (long)time(NULL)); base = fallback; }
+    snprintf(path, sizeof(path), "%s/%s", dir, base);
+    snprintf(part, sizeof(part), "%s.part", path);
+
+    int fd = open(part, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0) { fprintf(stderr, "%s: %s\n", part, strerror(errno)); return; }
+    uint64_t t0 = mono_ns(), got = 0;
+    static uint8_t buf[V1_BUF];
+    while (got < size) {
+        ssize_t r = recv(sock, buf, size - got < sizeof(buf) ? (size_t)(size - got) : sizeof(buf), 0);
+        if (r < 0 && errno == EINTR && !stop) continue;
+        if (r <= 0 || pwrite_all(fd, buf, (size_t)r, (off_t)got) != 0) break;
+        got += (uint64_t)r;
+    }
+    int complete = got == size && fdatasync(fd) == 0;
+    close(fd);
+    if (complete) rename(part, path);
+    double secs = (double)(mono_ns() - t0) / 1e9;
+    printf("[recv] v1 %s from %s %.2f/%.2f MB in %.2fs%s\n", base, peer, (double)got / 1e6,
+           (double)size / 1e6, secs, complete ? "" : " SHORT: kept as .part");
+}
+
+/* ------------------- v2 ------------------- */
+
+/* 1 if the file holds the upload with this size and ident (see UPLOAD_XATTR) */
+static int same_upload(const char *path, int fd, uint64_t size, uint32_t ident) {
+    uint8_t id[12];
+    ssize_t n = fd >= 0 ? fgetxattr(fd, UPLOAD_XATTR, id, sizeof(id)) : getxattr(path, UPLOAD_XATTR, id, sizeof(id));
+    return n == (ssize_t)sizeof(id) && be_get64(id) == size && be_get32(id + 8) == ident;
+}
+
+static void serve_v2(int sock, const uint8_t first[4], const char *dir, const char *peer, uint64_t drop_after) {
+    uint8_t hello[RS_HELLO_LEN];
+    char name[RS_NAME_MAX + 1], path[4096], part[4200];
+    memcpy(hello, first, 4);
+    if (recv_all(sock, hello + 4, RS_HELLO_LEN - 4) != 0) return;
+    uint16_t name_len = be_get16(hello + 6);
+    uint64_t size = be_get64(hello + 8);
+    uint32_t chunk = be_get32(hello + 16), ident = be_get32(hello + 20);
+    if (name_len > RS_NAME_MAX || recv_all(sock, name, name_len) != 0) return;
+    name[name_len] = '\0';
+    const char *base = safe_name(name);
+    if (hello[4] != RS_VERSION || !base || chunk == 0 || chunk > RS_CHUNK_MAX) {
+        send_reply(sock, RS_BAD_REQUEST, 0);
+        return;
+    }
+    snprintf(path, sizeof(path), "%s/%s", dir, base);
+    snprintf(part, sizeof(part), "%s.part", path);
+
+    uint64_t t0 = mono_ns();
+    struct stat st;
+    if (stat(path, &st) == 0 && (uint64_t)st.st_size == size && same_upload(path, -1, size, ident)) { // Already complete
+        send_reply(sock, RS_OK, size);
+        printf("[recv] v2 %s from %s already complete (%.2f MB)\n", base, peer, (double)size / 1e6);
+        return;
+    }
+    int fd = open(part, O_CREAT | O_RDWR, 0644);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "%s: %s\n", part, strerror(errno));
+        send_reply(sock, RS_IO_ERROR, 0);
+        if (fd >= 0) close(fd);
+        return;
+    }
+    uint64_t committed = (uint64_t)st.st_size / chunk * chunk;
+    if (committed > size || !same_upload(part, fd, size, ident)) committed = 0; // Leftover of a different file
+    if (ftruncate(fd, (off_t)committed) != 0) committed = 0;
+    if (committed == 0) { // Starting over: claim the .part for this upload
+        uint8_t id[12];
+        be_put64(id, size);
+        be_put32(id + 8, ident);
+        if (ftruncate(fd, 0) != 0 || fsetxattr(fd, UPLOAD_XATTR, id, sizeof(id), 0) != 0)
+            fprintf(stderr, "%s: %s (upload will not resume)\n", part, strerror(errno));
+    }
+    uint64_t resumed_at = committed;
+    send_reply(sock, RS_OK, committed);
+    uint64_t handshake_ns = mono_ns() - t0;
+
+    uint8_t *buf = malloc(chunk);
+    uint64_t crc_ns = 0, received = 0;
+    int status = buf ? -1 : RS_IO_ERROR;
+    while (buf && committed < size && !stop) {
+        uint8_t hdr[RS_CHUNK_HDR_LEN];
+        if (recv_all(sock, hdr, sizeof(hdr)) != 0) break;
+        uint64_t off = be_get64(hdr);
+        uint32_t len = be_get32(hdr + 8), crc = be_get32(hdr + 12);
+        if (off != committed || len == 0 || len > chunk || len > size - off ||
+            (len < chunk && off + len != size)) { status = RS_BAD_OFFSET; break; }
+        if (recv_all(sock, buf, len) != 0) break;
+        uint64_t c = mono_ns();
+        int ok = crc32c(0, buf, len) == crc;
+        crc_ns += mono_ns() - c;
+        if (!ok) { status = RS_BAD_CRC; break; }
+        if (pwrite_all(fd, buf, len, (off_t)off) != 0) { status = RS_IO_ERROR; break; }
+        committed += len;
+        received += len;
+        if (drop_after && received >= drop_after && committed < size) break; // -x: simulate a lost link
+    }
+    if (committed == size) {
+        status = fdatasync(fd) == 0 && rename(part, path) == 0 ? RS_OK : RS_IO_ERROR;
+        send_reply(sock, status, committed);
+    } else if (status > 0) {
+        send_reply(sock, status, committed);
+    }
+    close(fd);
+    free(buf);
+
+    double secs = (double)(mono_ns() - t0) / 1e9;
+    printf("[recv] v2 %s from %s %.2f/%.2f MB (+%.2f MB) in %.2fs", base, peer, (double)committed / 1e6,
+           (double)size / 1e6, (double)received / 1e6, secs);
+    if (resumed_at) printf(" resumed at %.2f MB", (double)resumed_at / 1e6);
+    printf(" handshake=%.2fms crc=%s %.0f MB/s %s\n", (double)handshake_ns / 1e6, crc32c_get(NULL)->name,
+           crc_ns ? (double)received / ((double)crc_ns / 1e9) / 1e6 : 0.0,
+           committed == size ? rs_status_name(status) : status > 0 ? rs_status_name(status) : "incomplete, kept as .part");
+}
+
+/* ------------------- main ------------------- */
+
+static int bench(void) {
+    uint8_t *buf = malloc(BENCH_BYTES);
+    if (!buf) return 1;
+    for (size_t i = 0; i < BENCH_BYTES; i++) buf[i] = (uint8_t)(i * 2654435761u >> 13);
+    static const char *const names[] = { "table", "sse4.2", "armv8" };
+    for (unsigned i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        const struct crc32c_impl *k = crc32c_get(names[i]);
+        if (!k) continue;
+        k->update(0, buf, 4096);   // Warm up (table build)
+        uint64_t t = mono_ns();
+        uint32_t crc = 0;
+        for (int rep = 0; rep < 4; rep++) crc = k->update(crc, buf, BENCH_BYTES);
+        double secs = (double)(mono_ns() - t) / 1e9;
+        printf("%-7s %8.0f MB/s  (crc %08x)\n", k->name, 4.0 * BENCH_BYTES / secs / 1e6, crc);
+    }
+    free(buf);
+    return 0;
+}
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -a <addr>    Local IPv4 address to bind (default: 0.0.0.0)\n"
+            "  -p <port>    TCP port to listen on (default: 9000)\n"
+            "  -d <dir>     Where files are stored (default: .)\n"
+            "  -x <MB>      Drop every v2 connection after this much payload (tests resume)\n"
+            "  -b           Benchmark the CRC32C implementations and exit\n"
+            "  -h           Show this help and exit\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    const char *addr = "0.0.0.0", *dir = ".";
+    int port = 9000, opt;
+    uint64_t drop_after = 0;
+    while ((opt = getopt(argc, argv, "a:p:d:x:bh")) != -1) {
+        switch (opt) {
+        case 'a': addr = optarg; break;
+        case 'p': port = atoi(optarg); break;
+        case 'd': dir = optarg; break;
+        case 'x': drop_after = (uint64_t)(atof(optarg) * 1e6); break;
+        case 'b': return bench();
+        default: print_usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    int ls = socket(AF_INET, SOCK_STREAM, 0), one = 1;
+    struct sockaddr_in sa = {0};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons((uint16_t)port);
+    setsockopt(ls, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (inet_pton(AF_INET, addr, &sa.sin_addr) != 1 ||
+        bind(ls, (struct sockaddr *)&sa, sizeof(sa)) != 0 || listen(ls, 5) != 0) {
+        perror("bind/listen");
+        return 1;
+    }
+    struct sigaction act = {0};
+    act.sa_handler = handle_sigint; /* No SA_RESTART: accept()/recv() return on Ctrl-C */
+    sigaction(SIGINT, &act, NULL);
+    sigaction(SIGTERM, &act, NULL);
+    printf("Waiting for uploads on %s:%d (crc32c: %s)\n", addr, port, crc32c_get(NULL)->name);
+    fflush(stdout);
+
+    while (!stop) {
+        struct sockaddr_in from;
+        socklen_t flen = sizeof(from);
+        int sock = accept(ls, (struct sockaddr *)&from, &flen);
+        if (sock < 0) continue;
+        struct timeval tv = { IO_TIMEOUT_S, 0 };
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        char peer[64];
+        snprintf(peer, sizeof(peer), "%s:%u", inet_ntoa(from.sin_addr), ntohs(from.sin_port));
+
+        uint8_t first[4];
+        if (recv_all(sock, first, sizeof(first)) == 0) {
+            if (memcmp(first, RS_MAGIC_HELLO, 4) == 0) serve_v2(sock, first, dir, peer, drop_after);
+            else serve_v1(sock, first, dir, peer);
+        }
+        close(sock);
+        fflush(stdout);
+    }
+    close(ls);
+    return 0;
+}
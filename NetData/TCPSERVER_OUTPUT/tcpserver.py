@@ -1,3 +1,4 @@
+import os
 import socket
 import struct
 import time
@@ -5,6 +6,18 @@ import time
 HOST = "10.0.0.1"
 PORT = 9000
 
+
+def recv_exact(conn, n):
+    # recv() may return fewer bytes than asked for; None if the peer closed first
+    buf = b""
+    while len(buf) < n:
+        chunk = conn.recv(n - len(buf))
+        if not chunk:
+            return None
+        buf += chunk
+    return buf
+
+
 s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
 s.bind((HOST, PORT))
 s.listen(5)
@@ -14,31 +27,37 @@ while True:
     conn, addr = s.accept()
     print("Connected from", addr)
 
-    # Read 8-byte file size
-    size_data = conn.recv(8)
-    if len(size_data) < 8:
+    # Read 8-byte file size and 2-byte filename length
+    header = recv_exact(conn, 10)
+    if header is None:
         conn.close()
         continue
-    file_size = struct.unpack("!Q", size_data)[0]
-
-    # Read 2-byte filename length
-    name_len_data = conn.recv(2)
-    name_len = struct.unpack("!H", name_len_data)[0]
+    file_size, name_len = struct.unpack("!QH", header)
 
     # Read filename
-    filename = conn.recv(name_len).decode()
+    name_data = recv_exact(conn, name_len)
+    if name_data is None:
+        conn.close()
+        continue
+    filename = name_data.decode(errors="replace")
     if not filename:
         filename = f"received_{int(time.time())}.mp4"
 
+    # Write under a temporary name: only a complete upload gets the final one
+    out_name = f"received_{int(time.time())}.mp4"
+    part_name = out_name + ".part"
     received = 0
-    with open(f"received_{int(time.time())}.mp4", "wb") as f:
+    with open(part_name, "wb") as f:
         while received < file_size:
-            chunk = conn.recv(min(4096, file_size - received))
+            chunk = conn.recv(min(65536, file_size - received))
             if not chunk:
                 break
             f.write(chunk)
             received += len(chunk)
 
     conn.close()
-    print(f"Saved {filename}, bytes received: {received}")
-
+    if received == file_size:
+        os.replace(part_name, out_name)
+        print(f"Saved {filename} as {out_name}, bytes received: {received}")
+    else:
+        print(f"SHORT upload of {filename}: {received} of {file_size} bytes, kept as {part_name}")
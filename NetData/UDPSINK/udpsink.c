@@ -0,0 +1,512 @@
+/*
+ * UDP sink for the SmartCam simulator stream (ground truth for capture loss)
+ * - Drains the stream with recvmmsg() and kernel SO_TIMESTAMPNS receive timestamps
+ * - Reads the 32-bit sequence header smartcam_sim stamps into every stream packet
+ * - Tracks per-source loss, duplicates, reordering depth and inter-arrival jitter
+ * - Prints one-second summaries; nothing is allocated after startup
+ *
+ * Build x86:
+ *   gcc -O2 -std=c11 -o udpsink udpsink.c -pthread
+ * Build Arm64:
+ *   aarch64-linux-gnu-gcc -O2 -std=c11 -o udpsink udpsink.c -pthread
+ *
+ * Usage:
+ *   ./udpsink [options]
+ *
+ * Options:
+ *   -a <addr>    Local IPv4 address to bind (default: 0.0.0.0)
+ *   -p <port>    UDP port to listen on (default: 9000)
+ *   -t <n>       Receiver threads sharing the port via SO_REUSEPORT (default: 1)
+ *   -B <n>       Datagrams per recvmmsg() call (default: 64)
+ *   -S <n>       Sources tracked per thread (default: 256)
+ *   -q           Only print the final summary
+ *   -h           Show this help and exit
+ *
+ * Notes:
+ * - Control packets ({"type":...} keepalive/motion/sync JSON) are counted but
+ *   not sequence-checked.
+ * - Histograms are log-linear (HDR-style, 32 sub-buckets per power of two,
+ *   about 3% resolution). Receiver threads are their only writers and update
+ *   them with relaxed atomic stores; the reporting thread reads them without
+ *   locks and diffs against its own copy for the per-second view.
+ * - A sequence number more than 65536 behind the highest one seen is taken
+ *   as a sender restart and the source is re-based.
+ */
+
+#define _GNU_SOURCE /* recvmmsg(), SO_REUSEPORT */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#define MAX_DGRAM     65536
+#define SEQ_WINDOW    4096              /* Sequence numbers remembered for duplicate detection */
+#define RESTART_GAP   65536             /* Jump back this far = sender restarted */
+#define H_SUB_BITS    5                 /* 32 sub-buckets per power of two */
+#define H_SUB         (1u << H_SUB_BITS)
+#define H_MAX_MSB     40                /* Values up to 2^41 ns (~36 min) */
+#define H_BUCKETS     ((H_MAX_MSB - H_SUB_BITS + 2) * H_SUB)
+
+volatile sig_atomic_t stop = 0;
+static void handle_sigint(int sig) { (void)sig; stop = 1; }
+
+typedef _Atomic uint64_t counter_t;
+
+/* Single-writer increment: no locked instruction needed */
+static inline void bump(counter_t *c, uint64_t n) {
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static inline uint64_t peek(counter_t *c) {
+    return atomic_load_explicit(c, memory_order_relaxed);
+}
+
+/* ------------------- HDR-style histogram ------------------- */
+
+struct hist { counter_t b[H_BUCKETS]; };
+
+static unsigned h_index(uint64_t v) {
+    if (v < H_SUB) return (unsigned)v;
+    unsigned msb = 63u - (unsigned)__builtin_clzll(v);
+    if (msb > H_MAX_MSB) return H_BUCKETS - 1;
+    return ((msb - H_SUB_BITS + 1) << H_SUB_BITS) | (unsigned)((v >> (msb - H_SUB_BITS)) & (H_SUB - 1));
+}
+
+/* Lowest value that lands in bucket i */
+static uint64_t h_value(unsigned i) {
+    if (i < H_SUB) return i;
+    unsigned m = i >> H_SUB_BITS;
+    return (uint64_t)(H_SUB + (i & (H_SUB - 1))) << (m - 1);
+}
+
+static void h_add(struct hist *h, uint64_t v) { bump(&h->b[h_index(v)], 1); }
+
+/* Quantile of a plain (snapshot/delta) bucket array */
+static uint64_t h_quantile(const uint64_t *b, uint64_t total, double q) {
+    if (total == 0) return 0;
+    uint64_t want = (uint64_t)(q * (double)(total - 1)), seen = 0;
+    for (unsigned i = 0; i < H_BUCKETS; ++i) {
+        seen += b[i];
+        if (seen > want) return h_value(i);
+    }
+    return h_value(H_BUCKETS - 1);
+}
+
+/* ------------------- Per-source state ------------------- */
+
+/* Written only by the receiver thread that owns the table */
+struct source {
+    _Atomic int active;        // Published with release once key is set
+    uint32_t addr;             // Key: IPv4 source (network order)
+    uint16_t port;             //      and UDP source port
+    uint64_t max_seq;          // Highest extended sequence seen
+    uint64_t base_seq;         // First sequence of the current stream
+    uint64_t window[SEQ_WINDOW / 64]; // Bit per sequence in (max_seq - SEQ_WINDOW, max_seq]
+    uint64_t last_arrival_ns;  // Previous stream packet (kernel timestamp)
+    uint64_t last_ia_ns;       // Previous inter-arrival time
+    double jitter_ns;          // RFC 3550-style smoothed |delta inter-arrival|
+
+    counter_t packets, bytes, control;
+    counter_t expected;        // Sequence span covered (max - base + 1, summed over restarts)
+    counter_t duplicates, reordered, too_late, restarts;
+    counter_t max_depth;       // Deepest reordering seen
+    counter_t jitter_x1000;    // jitter_ns * 1000 for lock-free readers
+    struct hist ia;            // Inter-arrival times (ns)
+    struct hist depth;         // Reordering depth (packets)
+};
+
+/* Reporter-side copy of the previous snapshot, for per-interval deltas */
+struct source_prev {
+    uint64_t packets, bytes, expected, duplicates, reordered;
+    uint64_t ia[H_BUCKETS];
+};
+
+struct rx_thread {
+    pthread_t thread;
+    int sock;
+    unsigned batch;
+    unsigned nsources;
+    struct source *src;        // Open-addressed table
+    struct source_prev *prev;  // Same indexing, reporter only
+    counter_t dropped_sources; // Packets from sources beyond the table
+    counter_t syscalls;
+};
+
+static uint64_t now_realtime_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+static struct source *lookup(struct rx_thread *rx, uint32_t addr, uint16_t port) {
+    uint32_t h = (addr * 2654435761u) ^ (port * 40503u);
+    for (unsigned probe = 0; probe < rx->nsources; ++probe) {
+        struct source *s = &rx->src[(h + probe) % rx->nsources];
+        if (!atomic_load_explicit(&s->active, memory_order_relaxed)) {
+            s->addr = addr;
+            s->port = port;
+            atomic_store_explicit(&s->active, 1, memory_order_release);
+            return s;
+        }
+        if (s->addr == addr && s->port == port) return s;
+    }
+    return NULL; // Table full
+}
+
+static int win_test_set(struct source *s, uint64_t seq) {
+    uint64_t bit = seq % SEQ_WINDOW;
+    uint64_t mask = 1ULL << (bit % 64);
+    int was = (s->window[bit / 64] & mask) != 0;
+    s->window[bit / 64] |= mask;
+    return was;
+}
+
+static void win_clear(struct source *s, uint64_t seq) {
+    uint64_t bit = seq % SEQ_WINDOW;
+    s->window[bit / 64] &= ~(1ULL << (bit % 64));
+}
+
+/* Start a fresh stream at `seq` */
+static void rebase(struct source *s, uint64_t seq) {
+    memset(s->window, 0, sizeof(s->window));
+    s->base_seq = s->max_seq = seq;
+    win_test_set(s, seq);
+    bump(&s->expected, 1);
+}
+
+static void account(struct source *s, uint32_t seq32, uint64_t arrival_ns, size_t len) {
+    bump(&s->packets, 1);
+    bump(&s->bytes, len);
+
+    /* Inter-arrival and smoothed jitter */
+    if (s->last_arrival_ns && arrival_ns >= s->last_arrival_ns) {
+        uint64_t ia = arrival_ns - s->last_arrival_ns;
+        h_add(&s->ia, ia);
+        if (s->last_ia_ns) {
+            double d = (double)ia - (double)s->last_ia_ns;
+            if (d < 0) d = -d;
+            s->jitter_ns += (d - s->jitter_ns) / 16.0;
+            atomic_store_explicit(&s->jitter_x1000, (uint64_t)(s->jitter_ns * 1000.0), memory_order_relaxed);
+        }
+        s->last_ia_ns = ia;
+    }
+    s->last_arrival_ns = arrival_ns;
+
+    if (peek(&s->packets) == 1) { rebase(s, seq32); return; }
+
+    /* Extend the 32-bit sequence to 64 bits around the highest one seen */
+    uint64_t seq = (s->max_seq & ~0xFFFFFFFFULL) | seq32;
+    if (seq + 0x80000000ULL < s->max_seq) seq += 0x100000000ULL;
+    else if (seq > s->max_seq + 0x80000000ULL && seq >= 0x100000000ULL) seq -= 0x100000000ULL;
+
+    if (seq > s->max_seq) {
+        uint64_t gap = seq - s->max_seq;
+        if (gap >= SEQ_WINDOW) memset(s->window, 0, sizeof(s->window));
+        else for (uint64_t q = s->max_seq + 1; q < seq; ++q) win_clear(s, q);
+        win_test_set(s, seq);
+        bump(&s->expected, gap);
+        s->max_seq = seq;
+        return;
+    }
+
+    uint64_t behind = s->max_seq - seq;
+    if (behind > RESTART_GAP) {                  // Sender restarted from a low sequence
+        bump(&s->restarts, 1);
+        rebase(s, seq);
+        return;
+    }
+    if (behind >= SEQ_WINDOW || seq < s->base_seq) { bump(&s->too_late, 1); return; }
+    if (win_test_set(s, seq)) { bump(&s->duplicates, 1); return; }
+
+    bump(&s->reordered, 1);                      // Filled a hole: arrived out of order
+    h_add(&s->depth, behind);
+    if (behind > peek(&s->max_depth))
+        atomic_store_explicit(&s->max_depth, behind, memory_order_relaxed);
+}
+
+/* JSON control messages from smartcam_sim start with {"type" */
+static int is_control(const unsigned char *p, size_t len) {
+    return len >= 7 && memcmp(p, "{\"type\"", 7) == 0;
+}
+
+static void *rx_main(void *arg) {
+    struct rx_thread *rx = arg;
+    unsigned n = rx->batch;
+
+    /* All receive buffers up front */
+    unsigned char *bufs = malloc((size_t)n * MAX_DGRAM);
+    struct mmsghdr *msgs = calloc(n, sizeof(*msgs));
+    struct iovec *iov = calloc(n, sizeof(*iov));
+    struct sockaddr_in *from = calloc(n, sizeof(*from));
+    union ctrl { char buf[CMSG_SPACE(sizeof(struct timespec))]; struct cmsghdr align; } *ctrl = calloc(n, sizeof(*ctrl));
+    if (!bufs || !msgs || !iov || !from || !ctrl) {
+        fprintf(stderr, "Out of memory\n");
+        stop = 1;
+        goto out;
+    }
+
+    while (!stop) {
+        for (unsigned i = 0; i < n; ++i) { // recvmmsg() overwrites the lengths
+            iov[i].iov_base = bufs + (size_t)i * MAX_DGRAM;
+            iov[i].iov_len = MAX_DGRAM;
+            msgs[i].msg_hdr.msg_name = &from[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_control = ctrl[i].buf;
+            msgs[i].msg_hdr.msg_controllen = sizeof(ctrl[i].buf);
+        }
+
+        /* Block for the first datagram, then take whatever else is queued */
+        int got = recvmmsg(rx->sock, msgs, n, MSG_WAITFORONE, NULL);
+        bump(&rx->syscalls, 1);
+        if (got < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            perror("recvmmsg");
+            break;
+        }
+
+        for (int i = 0; i < got; ++i) {
+            uint64_t ts = 0;
+            for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cm; cm = CMSG_NXTHDR(&msgs[i].msg_hdr, cm)) {
+                if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPNS) {
+                    struct timespec t;
+                    memcpy(&t, CMSG_DATA(cm), sizeof(t));
+                    ts = (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+                }
+            }
+            if (ts == 0) ts = now_realtime_ns();
+
+            struct source *s = lookup(rx, from[i].sin_addr.s_addr, from[i].sin_port);
+            if (!s) { bump(&rx->dropped_sources, 1); continue; }
+
+            const unsigned char *p = iov[i].iov_base;
+            size_t len = msgs[i].msg_len;
+            if (is_control(p, len) || len < sizeof(uint32_t)) { bump(&s->control, 1); continue; }
+
+            uint32_t seq;
+            memcpy(&seq, p, sizeof(seq)); // Host order, as stamped by the sender (both ends little-endian)
+            account(s, seq, ts, len);
+        }
+    }
+
+out:
+    free(bufs);
+    free(msgs);
+    free(iov);
+    free(from);
+    free(ctrl);
+    return NULL;
+}
+
+/* ------------------- Reporting ------------------- */
+
+static void src_name(const struct source *s, char *out, size_t len) {
+    char a[INET_ADDRSTRLEN];
+    struct in_addr in = { .s_addr = s->addr };
+    inet_ntop(AF_INET, &in, a, sizeof(a));
+    snprintf(out, len, "%s:%u", a, (unsigned)ntohs(s->port));
+}
+
+/* One line per active source for the last interval (or the whole run when final) */
+static void report(struct rx_thread *rxs, int nthreads, double secs, int final, uint64_t *scratch) {
+    uint64_t tot_pkts = 0, tot_bytes = 0, tot_lost = 0;
+
+    for (int t = 0; t < nthreads; ++t) {
+        struct rx_thread *rx = &rxs[t];
+        for (unsigned i = 0; i < rx->nsources; ++i) {
+            struct source *s = &rx->src[i];
+            if (!atomic_load_explicit(&s->active, memory_order_acquire)) continue;
+            struct source_prev *pv = &rx->prev[i];
+
+            uint64_t pk = peek(&s->packets), by = peek(&s->bytes), ex = peek(&s->expected);
+            uint64_t du = peek(&s->duplicates), ro = peek(&s->reordered);
+            uint64_t d_pk = pk - (final ? 0 : pv->packets);
+            uint64_t d_by = by - (final ? 0 : pv->bytes);
+            uint64_t d_ex = ex - (final ? 0 : pv->expected);
+            uint64_t d_du = du - (final ? 0 : pv->duplicates);
+            uint64_t d_ro = ro - (final ? 0 : pv->reordered);
+
+            uint64_t ia_total = 0;
+            for (unsigned b = 0; b < H_BUCKETS; ++b) {
+                uint64_t v = peek(&s->ia.b[b]);
+                scratch[b] = v - (final ? 0 : pv->ia[b]);
+                ia_total += scratch[b];
+                pv->ia[b] = v;
+            }
+            pv->packets = pk; pv->bytes = by; pv->expected = ex; pv->duplicates = du; pv->reordered = ro;
+
+            if (d_pk == 0 && !final) continue; // Quiet this interval
+            uint64_t unique = d_pk - d_du;
+            int64_t lost = (int64_t)d_ex - (int64_t)unique; // Late fills can make this briefly negative
+            if (lost < 0) lost = 0;
+
+            char name[48];
+            src_name(s, name, sizeof(name));
+            printf("%s %-21s rx=%llu pps=%.0f Mbps=%.2f lost=%lld (%.3f%%) dup=%llu reord=%llu maxdepth=%llu "
+                   "late=%llu restarts=%llu ctrl=%llu ia_p50=%.1fus ia_p99=%.1fus ia_max=%.1fus jitter=%.1fus\n",
+                   final ? "[total]" : "[1s]", name,
+                   (unsigned long long)d_pk, (double)d_pk / secs, (double)d_by * 8.0 / secs / 1e6,
+                   (long long)lost, d_ex ? 100.0 * (double)lost / (double)d_ex : 0.0,
+                   (unsigned long long)d_du, (unsigned long long)d_ro,
+                   (unsigned long long)peek(&s->max_depth), (unsigned long long)peek(&s->too_late),
+                   (unsigned long long)peek(&s->restarts), (unsigned long long)peek(&s->control),
+                   (double)h_quantile(scratch, ia_total, 0.50) / 1000.0,
+                   (double)h_quantile(scratch, ia_total, 0.99) / 1000.0,
+                   (double)h_quantile(scratch, ia_total, 1.0) / 1000.0,
+                   (double)peek(&s->jitter_x1000) / 1e6);
+            tot_pkts += d_pk;
+            tot_bytes += d_by;
+            tot_lost += (uint64_t)lost;
+        }
+    }
+
+    uint64_t over = 0, calls = 0;
+    for (int t = 0; t < nthreads; ++t) { over += peek(&rxs[t].dropped_sources); calls += peek(&rxs[t].syscalls); }
+    printf("%s all rx=%llu pps=%.0f Mbps=%.2f lost=%llu untracked=%llu",
+           final ? "[total]" : "[1s]", (unsigned long long)tot_pkts, (double)tot_pkts / secs,
+           (double)tot_bytes * 8.0 / secs / 1e6, (unsigned long long)tot_lost, (unsigned long long)over);
+    if (final) printf(" pkts/syscall=%.2f", calls ? (double)tot_pkts / (double)calls : 0.0);
+    printf("\n");
+    fflush(stdout);
+}
+
+static int open_socket(const char *addr, int port) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) { perror("socket"); return -1; }
+
+    int one = 1, rcvbuf = 8 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one)) != 0) perror("SO_TIMESTAMPNS");
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) != 0) // Root: past rmem_max
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    /* Wake periodically so the stop flag is noticed on an idle port */
+    struct timeval tv = { 0, 200000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, addr, &sa.sin_addr) != 1) {
+        fprintf(stderr, "Invalid bind address: %s\n", addr);
+        close(sock);
+        return -1;
+    }
+    if (bind(sock, (struct sockaddr *)&sa, sizeof(sa)) != 0) { perror("bind"); close(sock); return -1; }
+    return sock;
+}
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -a <addr>    Local IPv4 address to bind (default: 0.0.0.0)\n"
+            "  -p <port>    UDP port (default: 9000)\n"
+            "  -t <n>       Receiver threads via SO_REUSEPORT (default: 1)\n"
+            "  -B <n>       Datagrams per recvmmsg() (default: 64)\n"
+            "  -S <n>       Sources tracked per thread (default: 256)\n"
+            "  -q           Only print the final summary\n"
+            "  -h           Show this help and exit\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    const char *bind_addr = "0.0.0.0";
+    int port = 9000, nthreads = 1, batch = 64, nsources = 256, quiet = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "a:p:t:B:S:qh")) != -1) {
+        switch (opt) {
+        case 'a': bind_addr = optarg; break;
+        case 'p':
+            port = atoi(optarg);
+            if (port <= 0 || port > 65535) { fprintf(stderr, "Invalid port: %s\n", optarg); return 1; }
+            break;
+        case 't':
+            nthreads = atoi(optarg);
+            if (nthreads < 1) { fprintf(stderr, "Invalid thread count\n"); return 1; }
+            break;
+        case 'B':
+            batch = atoi(optarg);
+            if (batch < 1 || batch > 1024) { fprintf(stderr, "Batch must be 1..1024\n"); return 1; }
+            break;
+        case 'S':
+            nsources = atoi(optarg);
+            if (nsources < 1) { fprintf(stderr, "Invalid source count\n"); return 1; }
+            break;
+        case 'q': quiet = 1; break;
+        case 'h':
+        default:
+            print_usage(argv[0]);
+            return 0;
+        }
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_sigint; // No SA_RESTART: blocked receives return EINTR
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    struct rx_thread *rxs = calloc((size_t)nthreads, sizeof(*rxs));
+    uint64_t *scratch = calloc(H_BUCKETS, sizeof(*scratch));
+    if (!rxs || !scratch) { fprintf(stderr, "Out of memory\n"); return 1; }
+
+    int started = 0, rc = 0;
+    for (int t = 0; t < nthreads; ++t) {
+        struct rx_thread *rx = &rxs[t];
+        rx->batch = (unsigned)batch;
+        rx->nsources = (unsigned)nsources;
+        rx->src = calloc((size_t)nsources, sizeof(*rx->src));
+        rx->prev = calloc((size_t)nsources, sizeof(*rx->prev));
+        if (!rx->src || !rx->prev) { fprintf(stderr, "Out of memory\n"); rc = 1; break; }
+        rx->sock = open_socket(bind_addr, port);
+        if (rx->sock < 0) { rc = 1; break; }
+        if (pthread_create(&rx->thread, NULL, rx_main, rx) != 0) { fprintf(stderr, "pthread_create failed\n"); close(rx->sock); rc = 1; break; }
+        started++;
+    }
+    if (rc) stop = 1;
+
+    fprintf(stderr, "Listening on %s:%d threads=%d batch=%d sources/thread=%d\n",
+            bind_addr, port, started, batch, nsources);
+
+    /* One-second summaries on absolute ticks */
+    struct timespec tick;
+    clock_gettime(CLOCK_MONOTONIC, &tick);
+    struct timespec t0 = tick;
+    while (!stop) {
+        tick.tv_sec += 1;
+        if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tick, NULL) != 0) continue; // EINTR: re-check stop
+        if (!quiet) report(rxs, started, 1.0, 0, scratch);
+    }
+
+    for (int t = 0; t < started; ++t) pthread_join(rxs[t].thread, NULL);
+
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double secs = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+    if (started) report(rxs, started, secs > 0 ? secs : 1.0, 1, scratch);
+
+    for (int t = 0; t < nthreads; ++t) {
+        if (t < started) close(rxs[t].sock);
+        free(rxs[t].src);
+        free(rxs[t].prev);
+    }
+    free(rxs);
+    free(scratch);
+    fprintf(stderr, "Sink stopped cleanly.\n");
+    return rc;
+}